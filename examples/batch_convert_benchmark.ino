@@ -0,0 +1,45 @@
+#include <esp23_fast_timestamp.h>
+#include <fast_batch_convert.h>
+using namespace fasttime;
+
+static constexpr size_t kValues = 4096;
+static uint32_t cycles[kValues];
+static uint64_t out[kValues];
+
+void setup()
+{
+    Serial.begin(115200);
+    for (size_t i = 0; i < kValues; ++i)
+    {
+        cycles[i] = esp_random();
+    }
+}
+
+void loop()
+{
+    const UsConverter us = UsConverter::make();
+    const NsConverter ns = NsConverter::make();
+
+    // Baseline: one 64-bit division per value
+    Timestamp t0 = Timestamp::now();
+    for (size_t i = 0; i < kValues; ++i)
+    {
+        out[i] = cycles_to_us(cycles[i]);
+    }
+    uint64_t div_cycles = cycles_between(t0, Timestamp::now());
+
+    Timestamp t1 = Timestamp::now();
+    cycles_to_us(cycles, out, kValues, us);
+    uint64_t us_cycles = cycles_between(t1, Timestamp::now());
+
+    Timestamp t2 = Timestamp::now();
+    cycles_to_ns(cycles, out, kValues, ns);
+    uint64_t ns_cycles = cycles_between(t2, Timestamp::now());
+
+    const double hz = double(FASTTIME_FREQ_HZ);
+    Serial.printf("division: %.2f Mvalues/s, batch us: %.2f Mvalues/s, batch ns: %.2f Mvalues/s\n",
+                  kValues * hz / div_cycles / 1e6,
+                  kValues * hz / us_cycles / 1e6,
+                  kValues * hz / ns_cycles / 1e6);
+    delay(1000);
+}
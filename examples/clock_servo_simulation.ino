@@ -0,0 +1,66 @@
+#include <esp23_fast_timestamp.h>
+#include <fast_clock_servo.h>
+using namespace fasttime;
+
+// Feed both servos a simulated reference: +40 ppm frequency error that steps to +55 ppm
+// halfway (a temperature change), 1 µs measurement noise, one sample per simulated second.
+// Prints the prediction error half a second after each sample and the cost per update.
+static constexpr uint32_t kSamples = 3600;
+
+static uint32_t rng = 12345;
+static int32_t noise_ns()
+{
+    // Sum of four uniforms: roughly normal, sigma ~1 µs.
+    int32_t sum = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        rng = rng * 1664525u + 1013904223u;
+        sum += int32_t(rng >> 21) - 1024;
+    }
+    return sum;
+}
+
+template <typename Servo>
+static void simulate(const char *name, Servo &servo)
+{
+    uint64_t local = 1000000000ULL;
+    uint64_t ref = 5000000000ULL;
+    int64_t ppb = 40000;
+    uint64_t update_cycles = 0;
+    for (uint32_t i = 0; i < kSamples; ++i)
+    {
+        if (i == kSamples / 2)
+        {
+            ppb = 55000;
+        }
+        local += 1000000000ULL;
+        ref += 1000000000ULL + ppb;
+
+        Timestamp t0 = Timestamp::now();
+        servo.sample(local, ref + noise_ns());
+        update_cycles += cycles_between(t0, Timestamp::now());
+
+        if (i % 300 == 299)
+        {
+            const int64_t err = int64_t(servo.to_reference_ns(local + 500000000ULL) -
+                                        (ref + 500000000ULL + ppb / 2));
+            Serial.printf("%s t=%4u s freq=%ld ppb error=%lld ns\n", name, (unsigned)i + 1,
+                          (long)servo.freq_ppb(), (long long)err);
+        }
+    }
+    Serial.printf("%s: %.0f cycles per update\n", name, double(update_cycles) / kSamples);
+}
+
+void setup()
+{
+    Serial.begin(115200);
+}
+
+void loop()
+{
+    PiServo pi;
+    KalmanServo kalman;
+    simulate("PI", pi);
+    simulate("Kalman", kalman);
+    delay(10000);
+}
@@ -0,0 +1,65 @@
+#include <esp23_fast_timestamp.h>
+#include <fast_cycle_stats.h>
+using namespace fasttime;
+
+static constexpr uint32_t kSamples = 10000;
+static volatile uint32_t sink[16];
+
+// Short region with memory traffic that the plain read can be reordered around
+static inline void region()
+{
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+        sink[i] = sink[i] + i;
+    }
+}
+
+static void report(const char *name, const CycleAccumulator &s)
+{
+    Serial.printf("%-8s mean %4llu cycles, sd %3llu, min %4u, max %5u\n", name,
+                  (unsigned long long)s.mean_cycles(), (unsigned long long)s.stddev_cycles(),
+                  (unsigned)s.min, (unsigned)s.max);
+}
+
+void setup()
+{
+    Serial.begin(115200);
+}
+
+void loop()
+{
+    CycleAccumulator plain_empty, fenced_empty, plain, fenced;
+    plain_empty.reset();
+    fenced_empty.reset();
+    plain.reset();
+    fenced.reset();
+
+    for (uint32_t i = 0; i < kSamples; ++i)
+    {
+        Timestamp a = Timestamp::now();
+        Timestamp b = Timestamp::now();
+        plain_empty.add(cycles_between(a, b));
+
+        Timestamp c = Timestamp::now_begin();
+        Timestamp d = Timestamp::now_end();
+        fenced_empty.add(cycles_between(c, d));
+
+        Timestamp e = Timestamp::now();
+        region();
+        Timestamp f = Timestamp::now();
+        plain.add(cycles_between(e, f));
+
+        Timestamp g = Timestamp::now_begin();
+        region();
+        Timestamp h = Timestamp::now_end();
+        fenced.add(cycles_between(g, h));
+    }
+
+    // Empty regions show the probe cost; the region rows show the variance difference.
+    report("now()", plain_empty);
+    report("fenced", fenced_empty);
+    report("region", plain);
+    report("region+f", fenced);
+    Serial.println();
+    delay(1000);
+}
@@ -0,0 +1,62 @@
+#include <esp23_fast_timestamp.h>
+#include <fast_trace_file.h>
+using namespace fasttime;
+
+// Log trace blocks to a raw flash partition that outlives RAM and resets, and summarize the
+// previous run's log at boot. Needs a data partition named "trace" in the partition table:
+//
+//   trace, data, 0x40, , 1M
+static const esp_partition_t *part =
+    esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "trace");
+
+static Tracer<> tracer;
+static TraceSectorLog flash_log(trace_partition_flash(part));
+static TraceAsyncWriter writer(TraceSectorLog::write, &flash_log);
+// Blocks must fit in a sector minus its 16-byte header.
+static TraceStream<2048> stream(TraceAsyncWriter::sink, &writer);
+
+static void summarize()
+{
+    esp_partition_mmap_handle_t handle;
+    const uint8_t *data = trace_partition_map(part, handle);
+    if (!data)
+    {
+        Serial.println("no trace partition");
+        return;
+    }
+    TraceLogView view(data, part->size, part->erase_size);
+    uint64_t first = 0, last = 0;
+    const uint64_t n = view.for_each([&](const TraceEvent &e) {
+        first = first ? first : e.ticks;
+        last = e.ticks;
+    });
+    Serial.printf("previous log: %llu events in %u sectors spanning %llu ms\n", (unsigned long long)n,
+                  view.sectors_read(), (unsigned long long)cycles_to_ms(last - first));
+    esp_partition_munmap(handle);
+}
+
+void setup()
+{
+    Serial.begin(115200);
+    summarize();
+    if (!flash_log.open() || !writer.start(3, 0))
+    {
+        Serial.println("trace log unavailable");
+    }
+}
+
+void loop()
+{
+    static uint32_t step = 0;
+    tracer.emit(TraceType::kMarker, step++);
+    if (step % 64 == 0)
+    {
+        stream.pump(tracer);
+    }
+    if (step % 100000 == 0)
+    {
+        const TraceStreamStats &s = stream.stats();
+        Serial.printf("%llu events, %llu bytes, %u erases, %u dropped\n", (unsigned long long)s.events,
+                      (unsigned long long)s.bytes, flash_log.erases(), s.dropped_events);
+    }
+}
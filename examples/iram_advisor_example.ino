@@ -0,0 +1,70 @@
+#include <esp23_fast_timestamp.h>
+#include <fast_iram_advisor.h>
+using namespace fasttime;
+
+// Rank two flash-resident routines by cold-cache penalty and print IRAM_ATTR candidates.
+static ProfileZone crc_zone("crc32");
+static ProfileZone filter_zone("fir.filter");
+
+static uint8_t data[256];
+static float taps[16], hist[16];
+static volatile uint32_t sink;
+
+static uint32_t __attribute__((noinline)) crc32(const uint8_t *p, size_t n)
+{
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < n; ++i)
+    {
+        crc ^= p[i];
+        for (int k = 0; k < 8; ++k)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+    return ~crc;
+}
+
+static float __attribute__((noinline)) fir(float x)
+{
+    for (int i = 15; i > 0; --i)
+    {
+        hist[i] = hist[i - 1];
+    }
+    hist[0] = x;
+    float y = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+        y += taps[i] * hist[i];
+    }
+    return y;
+}
+
+static IramCandidate crc_probe(crc_zone, [](void *) { sink = crc32(data, sizeof(data)); }, nullptr,
+                               (const void *)&crc32);
+static IramCandidate fir_probe(filter_zone, [](void *) { sink = uint32_t(fir(1.0f)); }, nullptr,
+                               (const void *)&fir);
+
+void setup()
+{
+    Serial.begin(115200);
+}
+
+void loop()
+{
+    // Normal operation feeds the zones, so the ranking weighs penalty by real call counts.
+    for (int i = 0; i < 1000; ++i)
+    {
+        {
+            FASTTIME_ZONE(filter_zone);
+            sink = uint32_t(fir(float(i)));
+        }
+        if (i % 10 == 0)
+        {
+            FASTTIME_ZONE(crc_zone);
+            sink = crc32(data, sizeof(data));
+        }
+    }
+    iram_advise([](void *, const char *line) { Serial.println(line); }, nullptr);
+    registry_reset();
+    delay(5000);
+}
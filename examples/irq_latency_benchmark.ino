@@ -0,0 +1,46 @@
+#include <esp23_fast_timestamp.h>
+#include <fast_irq_latency.h>
+using namespace fasttime;
+
+// GPIO edge → ISR latency. The pin is driven and sensed at the same time (OUTPUT mode keeps
+// the input path enabled), so no external wiring is needed.
+static constexpr uint8_t kPin = 4;
+static constexpr uint32_t kSourceGpio = 0;
+static constexpr uint32_t kIterations = 2000;
+
+static IrqLatencyProbe<> probe;
+
+static void IRAM_ATTR on_edge()
+{
+    probe.isr_enter(kSourceGpio);
+}
+
+void setup()
+{
+    Serial.begin(115200);
+    pinMode(kPin, OUTPUT);
+    digitalWrite(kPin, LOW);
+    attachInterrupt(kPin, on_edge, RISING);
+}
+
+void loop()
+{
+    for (uint32_t i = 0; i < kIterations; ++i)
+    {
+        probe.trigger(kSourceGpio);
+        digitalWrite(kPin, HIGH);
+        delayMicroseconds(50);
+        digitalWrite(kPin, LOW);
+        delayMicroseconds(50);
+    }
+
+    const CycleHistogram<> &h = probe.histogram(kSourceGpio);
+    const NsConverter ns = NsConverter::make();
+    Serial.printf("GPIO ISR latency: p50=%llu ns p99=%llu ns p99.9=%llu ns (n=%llu, spurious=%u, lost=%u)\n",
+                  (unsigned long long)ns.to_ns(h.percentile(50.0)),
+                  (unsigned long long)ns.to_ns(h.percentile(99.0)),
+                  (unsigned long long)ns.to_ns(h.percentile(99.9)),
+                  (unsigned long long)h.count(), probe.spurious(kSourceGpio), probe.lost(kSourceGpio));
+    probe.reset();
+    delay(1000);
+}
@@ -0,0 +1,57 @@
+#include <esp23_fast_timestamp.h>
+#include <fast_perf_counters.h>
+using namespace fasttime;
+
+// Compare IPC and flash-cache stalls of the same loop running from flash and from IRAM.
+static const PerfEvent events[] = {PerfEvent::kInstructions, PerfEvent::kICacheStalls};
+static PerfCounterSet pmu;
+
+static volatile uint32_t sink;
+
+static void __attribute__((noinline)) work_flash()
+{
+    for (uint32_t i = 0; i < 2000; ++i)
+    {
+        sink = sink * 31 + i;
+    }
+}
+
+static void IRAM_ATTR __attribute__((noinline)) work_iram()
+{
+    for (uint32_t i = 0; i < 2000; ++i)
+    {
+        sink = sink * 31 + i;
+    }
+}
+
+static void report(const char *name, const PerfStats &s)
+{
+    Serial.printf("%-6s n=%llu ipc=%.2f icache-stall/cycle=%.3f\n", name, (unsigned long long)s.count(),
+                  s.ipc(), s.per_cycle(1));
+}
+
+void setup()
+{
+    Serial.begin(115200);
+    // Counters are per core: open them on the core that runs loop().
+    Serial.printf("counting %u of 2 events\n", pmu.open(events, 2));
+}
+
+void loop()
+{
+    PerfStats flash(pmu), iram(pmu);
+    for (int i = 0; i < 100; ++i)
+    {
+        {
+            PerfScope scope(pmu, flash);
+            work_flash();
+        }
+        {
+            PerfScope scope(pmu, iram);
+            work_iram();
+        }
+    }
+    report("flash", flash);
+    report("iram", iram);
+    delay(2000);
+}
@@ -0,0 +1,44 @@
+#include <esp23_fast_timestamp.h>
+#include <esp_system.h>
+#include <esp_task_wdt.h>
+#include <fast_trace_retention.h>
+using namespace fasttime;
+
+// Keep the last events in RAM that survives a reset, then trip the task watchdog on purpose.
+// After the reboot, setup() prints what the loop was doing right before the reset.
+FASTTIME_NOINIT static RetainedTraceImage<> crash_image;
+static RetainedTrace<> crash(crash_image);
+
+static constexpr uint32_t kZoneWork = 1;
+static constexpr uint32_t kZoneIo = 2;
+
+void setup()
+{
+    Serial.begin(115200);
+    delay(500);
+    Serial.printf("reset reason %d\n", int(esp_reset_reason()));
+    crash.dump(Serial);
+    crash.start();
+    esp_task_wdt_add(nullptr);
+}
+
+void loop()
+{
+    static uint32_t iteration = 0;
+    crash.emit(TraceType::kMarker, iteration);
+
+    crash.emit(TraceType::kZoneBegin, kZoneWork);
+    delayMicroseconds(200);
+    crash.emit(TraceType::kZoneEnd, kZoneWork);
+
+    crash.emit(TraceType::kZoneBegin, kZoneIo);
+    if (++iteration == 5000)
+    {
+        for (;;)
+        {
+            // Hang inside the zone: the watchdog resets the chip, the trace shows where.
+        }
+    }
+    crash.emit(TraceType::kZoneEnd, kZoneIo);
+    esp_task_wdt_reset();
+}
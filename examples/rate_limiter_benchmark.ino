@@ -0,0 +1,60 @@
+#include <esp23_fast_timestamp.h>
+#include <fast_rate_limiter.h>
+using namespace fasttime;
+
+static constexpr uint32_t kIterations = 100000;
+
+// Baseline: the usual millis()-based throttle (one event per 100 ms)
+static uint32_t last_ms = 0;
+static bool millis_allow()
+{
+    uint32_t now = millis();
+    if (now - last_ms >= 100)
+    {
+        last_ms = now;
+        return true;
+    }
+    return false;
+}
+
+static TokenBucket bucket;
+static AtomicTokenBucket shared_bucket;
+
+void setup()
+{
+    Serial.begin(115200);
+    bucket = TokenBucket::make(10, 1);
+    shared_bucket.init(10, 1);
+}
+
+void loop()
+{
+    volatile uint32_t granted = 0;
+
+    Timestamp t0 = Timestamp::now();
+    for (uint32_t i = 0; i < kIterations; ++i)
+    {
+        granted = granted + millis_allow();
+    }
+    uint64_t millis_cycles = cycles_between(t0, Timestamp::now());
+
+    Timestamp t1 = Timestamp::now();
+    for (uint32_t i = 0; i < kIterations; ++i)
+    {
+        granted = granted + bucket.try_acquire();
+    }
+    uint64_t bucket_cycles = cycles_between(t1, Timestamp::now());
+
+    Timestamp t2 = Timestamp::now();
+    for (uint32_t i = 0; i < kIterations; ++i)
+    {
+        granted = granted + shared_bucket.try_acquire();
+    }
+    uint64_t atomic_cycles = cycles_between(t2, Timestamp::now());
+
+    Serial.printf("millis(): %.1f cycles/check, TokenBucket: %.1f, AtomicTokenBucket: %.1f\n",
+                  double(millis_cycles) / kIterations,
+                  double(bucket_cycles) / kIterations,
+                  double(atomic_cycles) / kIterations);
+    delay(1000);
+}
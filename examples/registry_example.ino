@@ -0,0 +1,34 @@
+#include <esp23_fast_timestamp.h>
+#include <fast_registry.h>
+using namespace fasttime;
+
+// Instruments register themselves at static init; one call prints all of them.
+static ProfileZone work_zone("loop.work");
+static ProfileHistogram work_latency("loop.work.latency");
+static ProfileCounter iterations("loop.iterations");
+
+static volatile uint32_t sink;
+
+void setup()
+{
+    Serial.begin(115200);
+}
+
+void loop()
+{
+    for (uint32_t i = 0; i < 10000; ++i)
+    {
+        FASTTIME_ZONE(work_zone);
+        FASTTIME_ZONE(work_latency);
+        for (uint32_t j = 0; j < (esp_random() & 63); ++j)
+        {
+            sink = sink + j;
+        }
+        iterations.add();
+    }
+
+    registry_dump(Serial);
+    Serial.println();
+    registry_reset();
+    delay(1000);
+}
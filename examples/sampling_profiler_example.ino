@@ -0,0 +1,61 @@
+#include <esp23_fast_timestamp.h>
+#include <fast_sampling_profiler.h>
+using namespace fasttime;
+
+// Sample the interrupted PC at 1 kHz and print the hottest addresses every few seconds.
+// Symbolize with: xtensa-esp32-elf-addr2line -f -C -e build/sketch.ino.elf <addresses>
+static SamplingProfiler<256, 512> prof;
+static hw_timer_t *timer;
+
+static void IRAM_ATTR on_timer()
+{
+    prof.sample_from_isr();
+}
+
+static volatile float sink;
+
+static void __attribute__((noinline)) busy_math()
+{
+    for (int i = 0; i < 20000; ++i)
+    {
+        sink = sink * 0.999f + sqrtf(float(i));
+    }
+}
+
+static void __attribute__((noinline)) busy_memory()
+{
+    static uint8_t buf[4096];
+    for (int i = 0; i < 20; ++i)
+    {
+        memset(buf, i, sizeof(buf));
+    }
+}
+
+void setup()
+{
+    Serial.begin(115200);
+#if defined(ESP_ARDUINO_VERSION_MAJOR) && ESP_ARDUINO_VERSION_MAJOR >= 3
+    timer = timerBegin(1000000);
+    timerAttachInterrupt(timer, &on_timer);
+    timerAlarm(timer, 1000, true, 0);
+#else
+    timer = timerBegin(0, 80, true);
+    timerAttachInterrupt(timer, &on_timer, true);
+    timerAlarmWrite(timer, 1000, true);
+    timerAlarmEnable(timer);
+#endif
+}
+
+void loop()
+{
+    const Timestamp start = Timestamp::now();
+    while (elapsed_ms(start) < 3000)
+    {
+        busy_math();
+        busy_memory();
+        prof.drain();
+    }
+    prof.drain();
+    prof.dump([](void *, const char *line) { Serial.println(line); }, nullptr, 16);
+    prof.reset();
+}
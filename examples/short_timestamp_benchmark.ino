@@ -0,0 +1,47 @@
+#include <esp23_fast_timestamp.h>
+#include <fast_cycle_stats.h>
+using namespace fasttime;
+
+// Compare zone instrumentation cost with Timestamp (tear-free 64-bit on RISC-V)
+// and ShortTimestamp (single 32-bit read). On Xtensa both are the same.
+static constexpr uint32_t kIterations = 100000;
+
+static CycleStats zone_full;
+static CycleStats zone_short;
+static volatile uint32_t work;
+
+void setup()
+{
+    Serial.begin(115200);
+}
+
+void loop()
+{
+    Timestamp b0 = Timestamp::now();
+    for (uint32_t i = 0; i < kIterations; ++i)
+    {
+        Timestamp t0 = Timestamp::now();
+        work = work + i;
+        zone_full.record(cycles_between(t0, Timestamp::now()));
+    }
+    uint64_t full_cycles = cycles_between(b0, Timestamp::now());
+
+    Timestamp b1 = Timestamp::now();
+    for (uint32_t i = 0; i < kIterations; ++i)
+    {
+        ShortTimestamp t0 = ShortTimestamp::now();
+        work = work + i;
+        zone_short.record(cycles_between(t0, ShortTimestamp::now()));
+    }
+    uint64_t short_cycles = cycles_between(b1, Timestamp::now());
+
+    CycleAccumulator f = zone_full.snapshot();
+    CycleAccumulator s = zone_short.snapshot();
+    Serial.printf("Timestamp zone: %.1f cycles/iter (measured %llu)\n",
+                  double(full_cycles) / kIterations, (unsigned long long)f.mean_cycles());
+    Serial.printf("ShortTimestamp zone: %.1f cycles/iter (measured %llu)\n",
+                  double(short_cycles) / kIterations, (unsigned long long)s.mean_cycles());
+    zone_full.reset();
+    zone_short.reset();
+    delay(1000);
+}
@@ -0,0 +1,57 @@
+#include <esp23_fast_timestamp.h>
+#include <fast_timer_wheel.h>
+using namespace fasttime;
+
+// 2048 timers keep the pool (~64 KB) inside internal DRAM.
+static constexpr size_t kTimers = 2048;
+
+static TimerWheel<kTimers> wheel(8); // 256-cycle ticks
+static TimerHandle handles[kTimers];
+static volatile uint32_t fired = 0;
+
+static void on_timeout(void *)
+{
+    fired = fired + 1;
+}
+
+void setup()
+{
+    Serial.begin(115200);
+}
+
+void loop()
+{
+    fired = 0;
+
+    // Arm: spread deadlines over ~10 ms
+    Timestamp t0 = Timestamp::now();
+    for (size_t i = 0; i < kTimers; ++i)
+    {
+        handles[i] = wheel.schedule_after(t0, (esp_random() % 2400000u) + 1, on_timeout, nullptr);
+    }
+    uint64_t arm_cycles = cycles_between(t0, Timestamp::now());
+
+    // Cancel every other timer
+    Timestamp t1 = Timestamp::now();
+    for (size_t i = 0; i < kTimers; i += 2)
+    {
+        wheel.cancel(handles[i]);
+    }
+    uint64_t cancel_cycles = cycles_between(t1, Timestamp::now());
+
+    // Drain the rest
+    uint64_t advance_cycles = 0;
+    while (wheel.armed() > 0)
+    {
+        Timestamp a = Timestamp::now();
+        wheel.advance(a);
+        advance_cycles += cycles_between(a, Timestamp::now());
+    }
+
+    Serial.printf("arm: %.1f cycles/timer, cancel: %.1f cycles/timer, advance: %.1f cycles/fired (%u fired)\n",
+                  double(arm_cycles) / kTimers,
+                  double(cancel_cycles) / (kTimers / 2),
+                  double(advance_cycles) / (fired ? fired : 1),
+                  (unsigned)fired);
+    delay(1000);
+}
@@ -0,0 +1,90 @@
+#include <esp23_fast_timestamp.h>
+#include <fast_trace_stream.h>
+using namespace fasttime;
+
+// Stream trace blocks to Serial1 at 2 Mbaud while a producer task emits as fast as it can,
+// and report events/s per backpressure policy on Serial. Capture Serial1 (TX pin) with a
+// USB-UART adapter to decode the stream on a PC.
+static constexpr uint32_t kRunMs = 2000;
+
+static Tracer<> tracer;
+static TraceAsyncWriter writer(trace_write_print, &Serial1);
+static TraceStream<> stream(TraceAsyncWriter::sink, &writer);
+
+static volatile bool producing = false;
+static volatile uint32_t emitted = 0;
+
+static void producer(void *)
+{
+    for (;;)
+    {
+        if (!producing)
+        {
+            vTaskDelay(1);
+            continue;
+        }
+        tracer.emit(TraceType::kValue, emitted, 1);
+        emitted = emitted + 1;
+    }
+}
+
+static const char *policy_name(TraceBackpressure p)
+{
+    switch (p)
+    {
+    case TraceBackpressure::kBlock:
+        return "block";
+    case TraceBackpressure::kDropNewest:
+        return "drop-newest";
+    default:
+        return "drop-oldest";
+    }
+}
+
+void setup()
+{
+    Serial.begin(115200);
+    Serial1.setTxBufferSize(8192);
+    Serial1.begin(2000000);
+    writer.start(5, 0);
+    xTaskCreatePinnedToCore(producer, "producer", 2048, nullptr, 1, nullptr, 1);
+}
+
+void loop()
+{
+    static const TraceBackpressure kPolicies[] = {TraceBackpressure::kBlock, TraceBackpressure::kDropNewest,
+                                                   TraceBackpressure::kDropOldest};
+    for (TraceBackpressure policy : kPolicies)
+    {
+        stream.set_policy(policy);
+        const TraceStreamStats before = stream.stats();
+        const uint32_t emitted0 = emitted;
+        const uint32_t start = millis();
+        uint64_t pump_cycles = 0;
+
+        producing = true;
+        while (millis() - start < kRunMs)
+        {
+            const Timestamp t0 = Timestamp::now();
+            stream.pump(tracer);
+            pump_cycles += cycles_between(t0, Timestamp::now());
+            vTaskDelay(1);
+        }
+        producing = false;
+        stream.pump(tracer);
+        stream.flush(true);
+
+        const TraceStreamStats &s = stream.stats();
+        const double secs = kRunMs / 1000.0;
+        const uint64_t events = s.events - before.events;
+        Serial.printf("%-12s emitted %8.0f ev/s  streamed %8.0f ev/s  %.1f B/ev  dropped %u  "
+                      "blocks %u (%u lost)  stalls %u  pump %.1f%% CPU\n",
+                      policy_name(policy), (emitted - emitted0) / secs, events / secs,
+                      events ? double(s.bytes - before.bytes) / events : 0.0,
+                      s.dropped_events - before.dropped_events, s.blocks - before.blocks,
+                      s.dropped_blocks - before.dropped_blocks, s.stalls - before.stalls,
+                      100.0 * double(pump_cycles) / (secs * FASTTIME_FREQ_HZ));
+    }
+    Serial.println();
+    delay(1000);
+}
@@ -0,0 +1,62 @@
+#!/bin/sh
+# Verify that no FASTTIME_HOT / FASTTIME_ALWAYS_INLINE function calls code outside the hot set.
+#
+# Usage: extras/hot_path_check/check_hot_path.sh [extra compiler flags]
+# Env:   CXX (default g++), OBJDUMP (default objdump)
+#
+# Host x86-64 / AArch64 only. Calls listed in ALLOW are host stand-ins for single
+# instructions on target (sched_getcpu is rsr.prid / csrr mhartid there). Target-only
+# libgcc helpers (64-bit division on Xtensa/RV32) are ROM routines on ESP32 and are not
+# visible here. Flags follow the ESP-IDF defaults (no exceptions, no stack protector).
+set -eu
+
+dir=$(cd "$(dirname "$0")" && pwd)
+src="$dir/../../src"
+obj="${TMPDIR:-/tmp}/fasttime_hot_path_check.$$.o"
+trap 'rm -f "$obj"' EXIT INT TERM
+
+CXX=${CXX:-g++}
+OBJDUMP=${OBJDUMP:-objdump}
+ALLOW="sched_getcpu"
+
+$CXX -std=gnu++17 -O2 -fno-exceptions -fno-stack-protector -DFASTTIME_CHECK_HOT_PATH \
+    -I"$src" "$@" -c "$dir/hot_path_check.cpp" -o "$obj"
+
+{
+    # Pass 1: symbols defined in hot sections.
+    $OBJDUMP -t "$obj" | awk '{ for (i = 1; i < NF; ++i) if ($i ~ /^fasttime_hot\./) print "HOT", $NF }'
+    echo "END"
+    # Pass 2: disassembly with relocations.
+    $OBJDUMP -dr --no-show-raw-insn "$obj"
+} | awk -v allow="$ALLOW" '
+    BEGIN { n = split(allow, ok, " "); bad = 0; checked = 0 }
+    !done && $1 == "HOT" { hot[$2] = 1; next }
+    !done && $1 == "END" { done = 1; next }
+    /^Disassembly of section / {
+        sec = $4; sub(/:$/, "", sec)
+        in_hot = (sec ~ /^fasttime_hot\./)
+        next
+    }
+    !in_hot { next }
+    /^[0-9a-f]+ <.*>:$/ { fn = $2; ++checked; next }
+    $2 ~ /^R_/ {
+        if ($2 ~ /(PLT32|CALL26|JUMP26)$/ || ($2 ~ /PC32$/ && last ~ /^(call|jmp)/)) {
+            sym = $3
+            sub(/[-+]0x[0-9a-f]+$/, "", sym)
+            if (sym in hot) next
+            for (i = 1; i <= n; ++i) if (sym == ok[i]) next
+            printf "%s calls %s\n", fn, sym; bad = 1
+        }
+        next
+    }
+    $1 ~ /:$/ {
+        last = $2
+        if (($2 ~ /^(call|callq|jmp|jmpq)$/ && $3 ~ /^\*/) || $2 == "blr" || $2 == "br") {
+            printf "%s: indirect %s %s\n", fn, $2, $3; bad = 1
+        }
+    }
+    END {
+        if (!checked) { print "hot_path_check: no hot functions found" > "/dev/stderr"; exit 1 }
+        if (bad) { print "hot_path_check: FAILED" > "/dev/stderr"; exit 1 }
+        printf "hot_path_check: ok (%d functions)\n", checked
+    }'
@@ -0,0 +1,130 @@
+// Host build check: hot-path functions never call out-of-line code.
+//
+// Built with FASTTIME_CHECK_HOT_PATH, every FASTTIME_HOT function gets its own non-inlined body
+// in a "fasttime_hot.N" section. Template recording functions are FASTTIME_ALWAYS_INLINE, so
+// each is exercised from a FASTTIME_HOT probe below and checked as part of it. Non-template hot
+// functions (the FreeRTOS task switch hooks, TraceTransfer::complete) are checked directly.
+// check_hot_path.sh disassembles the hot sections and fails on any call or jump to a function
+// that is not itself hot. This file is compiled, never run.
+//
+//   extras/hot_path_check/check_hot_path.sh            # g++ -O2
+//   CXX=clang++ extras/hot_path_check/check_hot_path.sh -Os
+
+#define FASTTIME_TASK_TRACE_IMPLEMENTATION
+#include <esp23_fast_timestamp.h>
+#include <fast_core_local.h>
+#include <fast_core_sync.h>
+#include <fast_cycle_stats.h>
+#include <fast_histogram.h>
+#include <fast_irq_latency.h>
+#include <fast_lock_profile.h>
+#include <fast_perf_counters.h>
+#include <fast_queue_latency.h>
+#include <fast_registry.h>
+#include <fast_ring_buffer.h>
+#include <fast_sampling_profiler.h>
+#include <fast_sharded_stats.h>
+#include <fast_task_trace.h>
+#include <fast_task_trace_hooks.h>
+#include <fast_trace.h>
+#include <fast_trace_retention.h>
+#include <fast_trace_stream.h>
+
+using namespace fasttime;
+
+static ProfileZone zone("check.zone");
+static ProfileCounter counter("check.counter");
+static ProfileHistogram histogram("check.histogram");
+static CycleStats stats;
+static ShardedStats<> sharded;
+static CycleHistogram<> cycle_histogram;
+static Tracer<64> tracer;
+static SamplingProfiler<16, 16> profiler;
+static IrqLatencyProbe<2> irq;
+static ProfiledSpscQueue<uint32_t, 8> queue("check.queue");
+static LockProfile<> lock_profile;
+static PerfStats perf;
+static PerfCounterSet pmu;
+static ProfilePerfZone perf_zone("check.perf_zone", pmu);
+static RetainedTraceImage<16> retained_image;
+static RetainedTrace<16> retained(retained_image);
+static TraceTransfer transfer;
+
+static FASTTIME_HOT void probe_zones()
+{
+    const Timestamp t0 = Timestamp::now();
+    {
+        FASTTIME_ZONE(zone);
+        FASTTIME_ZONE_FROM_ISR(histogram);
+        counter.add();
+        counter.add_from_isr();
+    }
+    stats.record(cycles_between(t0, Timestamp::now()));
+}
+
+static FASTTIME_HOT void probe_sharded(uint64_t cycles)
+{
+    sharded.record(cycles);
+    sharded.record_from_isr(cycles);
+    cycle_histogram.record(cycles);
+    cycle_histogram.record_from_isr(cycles);
+}
+
+static FASTTIME_HOT void probe_trace(uint32_t arg)
+{
+    tracer.emit(TraceType::kMarker, arg);
+    tracer.emit_from_isr(TraceType::kValue, arg, 1);
+    retained.emit(TraceType::kMarker, arg);
+    retained.emit_from_isr(TraceType::kValue, arg, 1);
+}
+
+static FASTTIME_HOT void probe_profiler(uintptr_t pc)
+{
+    profiler.record(pc);
+    profiler.record_from_isr(pc);
+}
+
+static FASTTIME_HOT void probe_irq()
+{
+    irq.trigger(0);
+    irq.isr_enter(0);
+}
+
+static FASTTIME_HOT uint32_t probe_queue(uint32_t v)
+{
+    queue.push(v);
+    uint32_t out = 0;
+    queue.pop(out);
+    return out;
+}
+
+static FASTTIME_HOT void probe_lock(const void *site)
+{
+    lock_profile.on_acquired(1, false);
+    lock_profile.on_release(site, 1);
+}
+
+static FASTTIME_HOT void probe_perf(uint64_t cycles)
+{
+    PerfDelta d{};
+    d.cycles = cycles;
+    perf.record(d);
+    perf_zone.record(d);
+}
+
+int main()
+{
+    probe_zones();
+    probe_sharded(1);
+    probe_trace(1);
+    probe_profiler(0);
+    probe_irq();
+    probe_lock(&queue);
+    probe_perf(1);
+    // Scheduler hooks and DMA completion run with the cache possibly disabled.
+    fasttime_trace_task_ready(&transfer);
+    fasttime_trace_task_switched_in();
+    fasttime_trace_task_switched_out();
+    transfer.complete();
+    return int(probe_queue(0));
+}
@@ -0,0 +1,171 @@
+// Offline trace report: zone percentiles, critical paths, task utilization, timeline.
+//
+// Reads fast_trace_format.h blocks from a file written by TraceFileWriter, a raw UART capture,
+// stdin, or (with --log) a TraceSectorLog partition dump. Memory use is constant, so multi-GB
+// captures stream through.
+//
+//   g++ -std=gnu++17 -O2 -I src extras/trace_tool/trace_tool.cpp -o trace_tool -pthread
+//   ./trace_tool capture.ftb
+//   cat /dev/ttyUSB1 | ./trace_tool --freq 240000000 --names zones.txt -
+//   parttool.py read_partition --partition-name trace --output trace.bin && ./trace_tool --log 4096 trace.bin
+//
+// --names takes lines of "<id> <name>" (id in decimal or 0x hex) for zones and tasks.
+
+#include <fast_trace_analysis.h>
+#include <fast_trace_file.h>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <unordered_map>
+
+using namespace fasttime;
+
+static void usage()
+{
+    fprintf(stderr, "usage: trace_tool [--freq HZ] [--names FILE] [--log SECTOR_BYTES] [--buckets N] "
+                    "[--zones N] FILE|-\n");
+    exit(2);
+}
+
+static bool load_names(const char *path, std::unordered_map<uint32_t, std::string> &names)
+{
+    FILE *f = fopen(path, "r");
+    if (!f)
+    {
+        return false;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), f))
+    {
+        char *end;
+        const unsigned long id = strtoul(line, &end, 0);
+        if (end == line)
+        {
+            continue;
+        }
+        while (*end == ' ' || *end == '\t')
+        {
+            ++end;
+        }
+        end[strcspn(end, "\r\n")] = '\0';
+        if (*end)
+        {
+            names[uint32_t(id)] = end;
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    double freq = 0;
+    const char *names_path = nullptr;
+    uint32_t log_sector = 0;
+    uint32_t buckets = 24;
+    size_t max_zones = 40;
+    const char *path = nullptr;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--freq" && has_value)
+        {
+            freq = atof(argv[++i]);
+        }
+        else if (arg == "--names" && has_value)
+        {
+            names_path = argv[++i];
+        }
+        else if (arg == "--log" && has_value)
+        {
+            log_sector = uint32_t(strtoul(argv[++i], nullptr, 0));
+        }
+        else if (arg == "--buckets" && has_value)
+        {
+            buckets = uint32_t(strtoul(argv[++i], nullptr, 0));
+        }
+        else if (arg == "--zones" && has_value)
+        {
+            max_zones = size_t(strtoul(argv[++i], nullptr, 0));
+        }
+        else if (!path && (arg == "-" || arg[0] != '-'))
+        {
+            path = argv[i];
+        }
+        else
+        {
+            usage();
+        }
+    }
+    if (!path)
+    {
+        usage();
+    }
+
+    std::unordered_map<uint32_t, std::string> names;
+    if (names_path && !load_names(names_path, names))
+    {
+        fprintf(stderr, "trace_tool: cannot read %s\n", names_path);
+        return 1;
+    }
+
+    static TraceAnalyzer<> analyzer(buckets);
+    analyzer.set_freq(freq);
+    auto feed = [](TraceBlockReader &b) { analyzer.feed_block(b); };
+
+    uint64_t skipped = 0;
+    if (log_sector)
+    {
+        // Sector logs wrap, so they are read oldest sector first from a mapping.
+        TraceFileMapping map;
+        if (!map.open(path))
+        {
+            fprintf(stderr, "trace_tool: cannot map %s\n", path);
+            return 1;
+        }
+        TraceLogView view(map.data(), map.size(), log_sector);
+        TraceBlockReader block;
+        while (view.next(block))
+        {
+            feed(block);
+        }
+    }
+    else
+    {
+        const int fd = strcmp(path, "-") == 0 ? 0 : open(path, O_RDONLY);
+        if (fd < 0)
+        {
+            fprintf(stderr, "trace_tool: cannot open %s\n", path);
+            return 1;
+        }
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        TraceByteDecoder decoder;
+        const bool ok = decoder.read_fd(fd, feed);
+        if (fd)
+        {
+            close(fd);
+        }
+        if (!ok)
+        {
+            fprintf(stderr, "trace_tool: read error on %s\n", path);
+            return 1;
+        }
+        skipped = decoder.skipped_bytes();
+    }
+    analyzer.finish();
+
+    auto lookup = [](void *ctx, uint32_t id) -> const char * {
+        const auto &m = *static_cast<const std::unordered_map<uint32_t, std::string> *>(ctx);
+        const auto it = m.find(id);
+        return it == m.end() ? nullptr : it->second.c_str();
+    };
+    analyzer.report(stdout, lookup, &names, max_zones);
+    if (skipped)
+    {
+        printf("\n%llu bytes outside intact blocks were skipped\n", (unsigned long long)skipped);
+    }
+    return analyzer.events() ? 0 : 1;
+}
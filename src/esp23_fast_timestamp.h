@@ -8,7 +8,10 @@
  * @details
  * This header provides a tiny API to read the CPU cycle counter and compute elapsed time with
  * minimal overhead. It hides architecture differences between ESP32 Xtensa (ESP32/S2/S3) and
- * ESP32 RISC‑V (C2/C3/C6/H2), and supplies wrap-safe comparison utilities.
+ * RISC‑V (ESP32 C2/C3/C6/H2/P4, generic RV32/RV64), and supplies wrap-safe comparison
+ * utilities. Outside Arduino, x86 and AArch64 hosts fall back to their time-stamp counter so
+ * timing code can be simulated and benchmarked off-target; FASTTIME_MOCK_COUNTER replaces the
+ * counter with a variable for deterministic tests. FASTTIME_BACKEND names the selected backend.
  *
  * ### Timing sources (rules of thumb, single-call overhead)
  * - `millis()` .................. ~0.7–0.9 µs
@@ -31,17 +34,82 @@
  * on cycle counts without converting to wall time.
  */
 
+// ============================================================================
+//  Hot-path placement
+// ============================================================================
+
+#define FASTTIME_STR_INNER(x) #x
+#define FASTTIME_STR(x) FASTTIME_STR_INNER(x)
+
+/**
+ * @def FASTTIME_HOT
+ * @brief Placement of recording-path functions that may be emitted out of line.
+ *
+ * @details Everything in this library is header inline, but the compiler can still emit an
+ *          out-of-line copy (at -Os/-Og, or for a function with many call sites). On ESP-IDF
+ *          targets that copy would land in flash and stall on a cache miss, or fault while the
+ *          cache is disabled for a flash write, so FASTTIME_HOT places it in IRAM
+ *          (@c .iram1.fasttime.N, collected by the linker's @c .iram1.* rule). Elsewhere it is
+ *          empty.
+ *
+ * @def FASTTIME_ALWAYS_INLINE
+ * @brief Forces a hot-path function into its caller, and thus into the caller's placement.
+ *
+ * @remarks GCC ignores section attributes on template instantiations, so template recording
+ *          functions use FASTTIME_ALWAYS_INLINE: called from an @c IRAM_ATTR handler, the
+ *          whole path is in IRAM.
+ *
+ * @par FASTTIME_CHECK_HOT_PATH
+ * Host builds defining FASTTIME_CHECK_HOT_PATH give every FASTTIME_HOT function its own
+ * non-inlined body in a @c fasttime_hot.N section, which @c extras/hot_path_check disassembles
+ * to prove that hot code only calls other hot code.
+ */
+#if defined(FASTTIME_CHECK_HOT_PATH)
+#define FASTTIME_HOT __attribute__((noipa, used, section("fasttime_hot." FASTTIME_STR(__COUNTER__))))
+#elif defined(ESP_PLATFORM)
+#define FASTTIME_HOT __attribute__((section(".iram1.fasttime." FASTTIME_STR(__COUNTER__))))
+#else
+#define FASTTIME_HOT
+#endif
+#define FASTTIME_ALWAYS_INLINE __attribute__((always_inline))
+
 // ============================================================================
 //  Low-level cycle counter read (architecture-specific)
 // ============================================================================
 
-#if defined(ARDUINO_ARCH_ESP32) &&                                      \
-    !defined(ARDUINO_ARCH_ESP32C2) && !defined(ARDUINO_ARCH_ESP32C3) && \
-    !defined(ARDUINO_ARCH_ESP32C6) && !defined(ARDUINO_ARCH_ESP32H2)
+#if defined(FASTTIME_MOCK_COUNTER)
+
+/**
+ * @brief Mock counter for host simulations and tests (define FASTTIME_MOCK_COUNTER).
+ *
+ * @details @ref fast_rdcycle returns @c fasttime_mock_cycles, which the simulation advances.
+ *          Set FASTTIME_MOCK_COUNTER_BITS to 32 to reproduce Xtensa wrap behavior.
+ */
+#ifndef FASTTIME_MOCK_COUNTER_BITS
+#define FASTTIME_MOCK_COUNTER_BITS 64
+#endif
+#define FASTTIME_HOST 1
+#define FASTTIME_BACKEND "mock"
+#if FASTTIME_MOCK_COUNTER_BITS == 32
+using fast_counter_t = uint32_t;
+#else
+using fast_counter_t = uint64_t;
+#endif
+
+/// Value returned by the mock @ref fast_rdcycle.
+inline volatile uint64_t fasttime_mock_cycles = 0;
+
+static inline FASTTIME_ALWAYS_INLINE fast_counter_t fast_rdcycle() { return (fast_counter_t)fasttime_mock_cycles; }
+static inline FASTTIME_ALWAYS_INLINE fast_counter_t fast_rdcycle_begin() { return fast_rdcycle(); }
+static inline FASTTIME_ALWAYS_INLINE fast_counter_t fast_rdcycle_end() { return fast_rdcycle(); }
+static inline FASTTIME_ALWAYS_INLINE uint32_t fast_rdcycle32() { return (uint32_t)fasttime_mock_cycles; }
+
+#elif defined(__XTENSA__)
 
 /**
  * @brief ESP32 Xtensa variant (ESP32 / S2 / S3).
  */
+#define FASTTIME_BACKEND "xtensa-ccount"
 using fast_counter_t = uint32_t;
 
 /**
@@ -50,39 +118,218 @@ using fast_counter_t = uint32_t;
  *
  * @remarks Typical overhead: ~4–8 ns when inlined with -O2/-O3.
  */
-static inline fast_counter_t fast_rdcycle()
+static inline FASTTIME_ALWAYS_INLINE fast_counter_t fast_rdcycle()
 {
     uint32_t c;
     asm volatile("rsr.ccount %0" : "=a"(c));
     return c;
 }
 
-#elif defined(ARDUINO_ARCH_ESP32C2) || defined(ARDUINO_ARCH_ESP32C3) || \
-    defined(ARDUINO_ARCH_ESP32C6) || defined(ARDUINO_ARCH_ESP32H2)
+/**
+ * @brief CCOUNT read that opens a measured region.
+ *
+ * @remarks LX cores are in-order, so only memory effects need fencing: MEMW drains pending
+ *          loads/stores issued before the read, and the clobber stops the compiler moving
+ *          region code above it.
+ */
+static inline FASTTIME_ALWAYS_INLINE fast_counter_t fast_rdcycle_begin()
+{
+    uint32_t c;
+    asm volatile("memw\n\trsr.ccount %0" : "=a"(c) : : "memory");
+    return c;
+}
+
+/**
+ * @brief CCOUNT read that closes a measured region (region memory traffic completes first).
+ */
+static inline FASTTIME_ALWAYS_INLINE fast_counter_t fast_rdcycle_end()
+{
+    uint32_t c;
+    asm volatile("memw\n\trsr.ccount %0" : "=a"(c) : : "memory");
+    return c;
+}
+
+/**
+ * @brief Low 32 bits of the cycle counter (same as @ref fast_rdcycle on Xtensa).
+ */
+static inline FASTTIME_ALWAYS_INLINE uint32_t fast_rdcycle32() { return fast_rdcycle(); }
+
+#elif defined(__riscv)
 
 /**
- * @brief ESP32 RISC‑V variants (C2/C3/C6/H2).
+ * @brief RISC‑V: ESP32 C2/C3/C6/H2/P4 and any other RV32/RV64 core.
+ *
+ * @details
+ * - RV64 reads the 64-bit counter with a single CSR access.
+ * - RV32 uses the tear-free hi/lo/hi sequence.
+ * - Bare-metal/FreeRTOS firmware runs in M-mode and reads @c mcycle. Under an OS (Linux) only
+ *   the user-level @c cycle CSR is accessible; define FASTTIME_RISCV_USER_COUNTER to force it
+ *   (it is selected automatically on Linux). The kernel must enable user access to it.
  */
+#if defined(__linux__) && !defined(FASTTIME_RISCV_USER_COUNTER)
+#define FASTTIME_RISCV_USER_COUNTER 1
+#endif
+#if defined(__linux__)
+#define FASTTIME_HOST 1
+#endif
+
+#if defined(FASTTIME_RISCV_USER_COUNTER)
+#define FASTTIME_RISCV_CSR_LO "cycle"
+#define FASTTIME_RISCV_CSR_HI "cycleh"
+#else
+#define FASTTIME_RISCV_CSR_LO "mcycle"
+#define FASTTIME_RISCV_CSR_HI "mcycleh"
+#endif
+
 using fast_counter_t = uint64_t;
 
+#if __riscv_xlen == 64
+#define FASTTIME_BACKEND "riscv64-" FASTTIME_RISCV_CSR_LO
+
+/**
+ * @brief Read the 64-bit RISC‑V cycle counter (single CSR read on RV64).
+ * @return Current 64-bit cycle count.
+ */
+static inline FASTTIME_ALWAYS_INLINE fast_counter_t fast_rdcycle()
+{
+    uint64_t c;
+    asm volatile("csrr %0, " FASTTIME_RISCV_CSR_LO : "=r"(c));
+    return c;
+}
+#else
+#define FASTTIME_BACKEND "riscv32-" FASTTIME_RISCV_CSR_LO
+
 /**
  * @brief Tear-free read of the 64-bit RISC‑V cycle counter.
  * @return Current 64-bit cycle count.
  *
- * @remarks Reads MCYCLEH/MCYCLE/MCYCLEH and retries if rollover detected.
+ * @remarks Reads high/low/high halves and retries if rollover detected.
  *          Typical overhead: ~12–15 ns when inlined.
  */
-static inline fast_counter_t fast_rdcycle()
+static inline FASTTIME_ALWAYS_INLINE fast_counter_t fast_rdcycle()
 {
     uint32_t hi1, lo, hi2;
     do
     {
-        asm volatile("csrr %0, mcycleh" : "=r"(hi1));
-        asm volatile("csrr %0, mcycle" : "=r"(lo));
-        asm volatile("csrr %0, mcycleh" : "=r"(hi2));
+        asm volatile("csrr %0, " FASTTIME_RISCV_CSR_HI : "=r"(hi1));
+        asm volatile("csrr %0, " FASTTIME_RISCV_CSR_LO : "=r"(lo));
+        asm volatile("csrr %0, " FASTTIME_RISCV_CSR_HI : "=r"(hi2));
     } while (hi1 != hi2);
     return (uint64_t(hi2) << 32) | lo;
 }
+#endif
+
+/**
+ * @brief Counter read that opens a measured region.
+ *
+ * @remarks FENCE orders earlier memory accesses before the read; the compiler barriers keep
+ *          region code from being hoisted above it.
+ */
+static inline FASTTIME_ALWAYS_INLINE fast_counter_t fast_rdcycle_begin()
+{
+    asm volatile("fence" : : : "memory");
+    const fast_counter_t c = fast_rdcycle();
+    asm volatile("" : : : "memory");
+    return c;
+}
+
+/**
+ * @brief Counter read that closes a measured region (region memory accesses complete first).
+ */
+static inline FASTTIME_ALWAYS_INLINE fast_counter_t fast_rdcycle_end()
+{
+    asm volatile("fence" : : : "memory");
+    const fast_counter_t c = fast_rdcycle();
+    asm volatile("" : : : "memory");
+    return c;
+}
+
+/**
+ * @brief Low 32 bits of the cycle counter: one CSR read, no retry loop.
+ *
+ * @remarks Wraps every ~2^32 cycles (~26.8 s @ 160 MHz); see @ref fasttime::ShortTimestamp.
+ */
+static inline FASTTIME_ALWAYS_INLINE uint32_t fast_rdcycle32()
+{
+    uint32_t c;
+    asm volatile("csrr %0, " FASTTIME_RISCV_CSR_LO : "=r"(c));
+    return c;
+}
+
+#elif !defined(ARDUINO) && (defined(__x86_64__) || defined(__i386__) || defined(__aarch64__))
+
+/**
+ * @brief Host build (x86 TSC / AArch64 virtual counter) for simulations and off-target benchmarks.
+ *
+ * @note The host counter does not tick at the CPU clock on every machine. Set FASTTIME_FREQ_HZ
+ *       to the TSC (or CNTFRQ_EL0) frequency before converting cycles to time.
+ */
+#define FASTTIME_HOST 1
+#define FASTTIME_BACKEND "host-tsc"
+using fast_counter_t = uint64_t;
+
+/**
+ * @brief Read the host time-stamp counter.
+ * @return Current 64-bit counter value.
+ *
+ * @remarks RDTSC is not serializing; see the x86 manuals if you need ordering guarantees.
+ */
+static inline FASTTIME_ALWAYS_INLINE fast_counter_t fast_rdcycle()
+{
+#if defined(__aarch64__)
+    uint64_t c;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(c));
+    return c;
+#else
+    uint32_t lo, hi;
+    asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return (uint64_t(hi) << 32) | lo;
+#endif
+}
+
+/**
+ * @brief Counter read that opens a measured region.
+ *
+ * @remarks x86: LFENCE; RDTSC; LFENCE — earlier instructions retire before the read and later
+ *          ones cannot start before it. AArch64: ISB on both sides.
+ */
+static inline FASTTIME_ALWAYS_INLINE fast_counter_t fast_rdcycle_begin()
+{
+#if defined(__aarch64__)
+    uint64_t c;
+    asm volatile("isb\n\tmrs %0, cntvct_el0\n\tisb" : "=r"(c) : : "memory");
+    return c;
+#else
+    uint32_t lo, hi;
+    asm volatile("lfence\n\trdtsc\n\tlfence" : "=a"(lo), "=d"(hi) : : "memory");
+    return (uint64_t(hi) << 32) | lo;
+#endif
+}
+
+/**
+ * @brief Counter read that closes a measured region.
+ *
+ * @remarks x86: RDTSCP waits for the region to retire, the trailing LFENCE keeps following
+ *          code out of the measurement. AArch64: ISB on both sides.
+ */
+static inline FASTTIME_ALWAYS_INLINE fast_counter_t fast_rdcycle_end()
+{
+#if defined(__aarch64__)
+    uint64_t c;
+    asm volatile("isb\n\tmrs %0, cntvct_el0\n\tisb" : "=r"(c) : : "memory");
+    return c;
+#else
+    uint32_t lo, hi, aux;
+    asm volatile("rdtscp\n\tlfence" : "=a"(lo), "=d"(hi), "=c"(aux) : : "memory");
+    (void)aux;
+    return (uint64_t(hi) << 32) | lo;
+#endif
+}
+
+/**
+ * @brief Low 32 bits of the host counter.
+ */
+static inline FASTTIME_ALWAYS_INLINE uint32_t fast_rdcycle32() { return (uint32_t)fast_rdcycle(); }
 
 #else
 #error "Unsupported ESP32 target. Add your arch guards here."
@@ -111,7 +358,23 @@ namespace fasttime
          *
          * @remarks Overhead is the same as @ref fast_rdcycle.
          */
-        static inline Timestamp now() { return Timestamp{fast_rdcycle()}; }
+        static inline FASTTIME_ALWAYS_INLINE Timestamp now() { return Timestamp{fast_rdcycle()}; }
+
+        /**
+         * @brief Timestamp for the start of a short measured region.
+         *
+         * @details Fenced so the read cannot drift into (or out of) the region, by the
+         *          compiler or the CPU. Pair with @ref now_end.
+         *
+         * @remarks Costs more than @ref now (a fence on targets, tens of cycles on x86); use it
+         *          when the region is short enough for reordering to matter.
+         */
+        static inline FASTTIME_ALWAYS_INLINE Timestamp now_begin() { return Timestamp{fast_rdcycle_begin()}; }
+
+        /**
+         * @brief Timestamp for the end of a region opened with @ref now_begin.
+         */
+        static inline FASTTIME_ALWAYS_INLINE Timestamp now_end() { return Timestamp{fast_rdcycle_end()}; }
     };
 
     /**
@@ -125,7 +388,7 @@ namespace fasttime
      * - Xtensa (32-bit): Uses modulo arithmetic to stay correct across wrap.
      * - RISC‑V (64-bit): Plain integer comparison.
      */
-    static inline bool before(const Timestamp a, const Timestamp b)
+    static inline FASTTIME_ALWAYS_INLINE bool before(const Timestamp a, const Timestamp b)
     {
         if constexpr (sizeof(fast_counter_t) == 4)
         {
@@ -144,7 +407,7 @@ namespace fasttime
      * @param b End timestamp.
      * @return Elapsed cycles as a non-negative value.
      */
-    static inline uint64_t cycles_between(const Timestamp a, const Timestamp b)
+    static inline FASTTIME_ALWAYS_INLINE uint64_t cycles_between(const Timestamp a, const Timestamp b)
     {
         if constexpr (sizeof(fast_counter_t) == 4)
         {
@@ -156,6 +419,83 @@ namespace fasttime
         }
     }
 
+    /**
+     * @brief Extends raw timestamps to a monotonic 64-bit cycle count.
+     *
+     * @details
+     * Feed timestamps in order (at least one per counter wrap period, ~17.9 s @ 240 MHz on
+     * Xtensa) and @ref extend returns a 64-bit running count that never wraps. On 64-bit
+     * counters the result equals the raw tick value.
+     */
+    struct CycleExtender
+    {
+        fast_counter_t last; ///< Raw ticks of the most recent timestamp seen.
+        uint64_t ext;        ///< Extended count matching @c last.
+
+        /**
+         * @brief Start extending from @p start.
+         */
+        static inline CycleExtender make(const Timestamp start = Timestamp::now())
+        {
+            return CycleExtender{start.ticks, (uint64_t)start.ticks};
+        }
+
+        /**
+         * @brief Extended count of @p ts without updating the state.
+         *
+         * @warning @p ts must not precede the last extended timestamp.
+         */
+        inline uint64_t peek(const Timestamp ts) const
+        {
+            return ext + cycles_between(Timestamp{last}, ts);
+        }
+
+        /**
+         * @brief Extend @p ts and make it the new reference point.
+         */
+        inline uint64_t extend(const Timestamp ts)
+        {
+            ext = peek(ts);
+            last = ts.ticks;
+            return ext;
+        }
+    };
+
+    /**
+     * @brief 32-bit timestamp from a single counter read, for short intervals.
+     *
+     * @details
+     * On RISC‑V, @ref Timestamp::now pays three CSR reads plus a retry check for a tear-free
+     * 64-bit value. When the measured region is far shorter than a counter wrap
+     * (~17.9 s @ 240 MHz), the low word alone is enough and costs one @c csrr. On Xtensa this
+     * is identical to @ref Timestamp.
+     *
+     * @warning Intervals must stay below 2^32 cycles; longer ones alias silently.
+     */
+    struct ShortTimestamp
+    {
+        uint32_t ticks; ///< Low 32 bits of the cycle counter.
+
+        /** @brief Read a 32-bit timestamp (single counter read). */
+        static inline ShortTimestamp now() { return ShortTimestamp{fast_rdcycle32()}; }
+    };
+
+    /**
+     * @brief Wrap-safe “a before b” for 32-bit timestamps.
+     */
+    static inline bool before(const ShortTimestamp a, const ShortTimestamp b)
+    {
+        return (int32_t)(a.ticks - b.ticks) < 0;
+    }
+
+    /**
+     * @brief Wrap-safe difference in cycles: @p b - @p a (same arithmetic as the Xtensa path).
+     */
+    static inline uint64_t cycles_between(const ShortTimestamp a, const ShortTimestamp b)
+    {
+        return (uint32_t)(b.ticks - a.ticks);
+    }
+
 // ----------------------------------------------------------------------------
 //  Frequency configuration
 // ----------------------------------------------------------------------------
@@ -296,4 +636,47 @@ namespace fasttime
         }
     };
 
+    /**
+     * @brief (@p a * @p b) >> 32 without a 128-bit intermediate (exact floor).
+     *
+     * @remarks Four 32×32→64 multiplies; cheaper than a 64-bit division on every target.
+     */
+    static inline uint64_t mul_shr32(uint64_t a, uint64_t b)
+    {
+        const uint64_t a_lo = (uint32_t)a, a_hi = a >> 32;
+        const uint64_t b_lo = (uint32_t)b, b_hi = b >> 32;
+        return ((a_hi * b_hi) << 32) + a_hi * b_lo + a_lo * b_hi + ((a_lo * b_lo) >> 32);
+    }
+
+    /**
+     * @brief Fixed-point reciprocal to convert cycles→ns without division.
+     *
+     * @details Same idea as @ref UsConverter with a Q32.32 factor of ~4.17 at 240 MHz. The
+     *          product needs more than 64 bits for intervals beyond a few seconds, so
+     *          @ref to_ns uses @ref mul_shr32.
+     */
+    struct NsConverter
+    {
+        uint64_t k; ///< Fixed-point reciprocal: k ≈ (1e9 / F_HZ) * 2^32
+
+        /**
+         * @brief Build a converter for the configured FASTTIME_FREQ_HZ.
+         */
+        static inline NsConverter make(uint64_t freq_hz = FASTTIME_FREQ_HZ)
+        {
+            NsConverter c;
+            c.k = ((1000000000ULL << 32) + (freq_hz / 2ULL)) / freq_hz;
+            return c;
+        }
+
+        /**
+         * @brief Convert cycles→ns (multiply + shift, no overflow for any 64-bit input
+         *        whose result fits 64 bits).
+         */
+        inline uint64_t to_ns(uint64_t cycles) const
+        {
+            return mul_shr32(cycles, k);
+        }
+    };
+
 } // namespace fasttime
@@ -0,0 +1,173 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp23_fast_timestamp.h"
+
+#if defined(FASTTIME_HOST) && defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(FASTTIME_HOST) && defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(FASTTIME_HOST) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/**
+ * @file fast_batch_convert.h
+ * @brief Convert arrays of cycle counts to µs/ns with the fixed-point reciprocal.
+ *
+ * @details
+ * Draining a trace buffer one @ref cycles_to_us call at a time pays a 64-bit division per
+ * value. These helpers apply a @ref UsConverter / @ref NsConverter factor to a whole array:
+ * - 32-bit inputs compute @c (c * k) >> 32 as @c c*k_lo>>32 + c*k_hi, i.e. two 32×32→64
+ *   multiplies per value with no carries between lanes. The loop is written to auto-vectorize
+ *   and has explicit AVX2 / SSE2 / NEON paths on host builds.
+ * - 64-bit inputs use @ref mul_shr32 (or a 128-bit multiply where the compiler has one).
+ *
+ * Targets use the scalar loop; Xtensa/RISC‑V cores have no 32×32→64 vector multiply that would
+ * beat the MUL/MULH pairs it compiles to.
+ *
+ * @code
+ * static uint32_t deltas[4096];
+ * static uint64_t us[4096];
+ * fasttime::cycles_to_us(deltas, us, 4096, fasttime::UsConverter::make());
+ * @endcode
+ */
+
+namespace fasttime
+{
+
+    namespace detail
+    {
+        /**
+         * @brief out[i] = (in[i] * k) >> 32 for 32-bit inputs.
+         */
+        static inline void convert_q32(const uint32_t *in, uint64_t *out, size_t n, uint64_t k)
+        {
+            const uint32_t k_lo = (uint32_t)k;
+            const uint32_t k_hi = (uint32_t)(k >> 32);
+            size_t i = 0;
+
+#if defined(FASTTIME_HOST) && defined(__AVX2__)
+            const __m256i vlo = _mm256_set1_epi64x(k_lo);
+            const __m256i vhi = _mm256_set1_epi64x(k_hi);
+            for (const size_t end = n & ~size_t(3); i < end; i += 4)
+            {
+                const __m256i c = _mm256_cvtepu32_epi64(_mm_loadu_si128((const __m128i *)(in + i)));
+                const __m256i lo = _mm256_srli_epi64(_mm256_mul_epu32(c, vlo), 32);
+                const __m256i hi = _mm256_mul_epu32(c, vhi);
+                _mm256_storeu_si256((__m256i *)(out + i), _mm256_add_epi64(lo, hi));
+            }
+#elif defined(FASTTIME_HOST) && defined(__SSE2__)
+            const __m128i vlo = _mm_set1_epi64x(k_lo);
+            const __m128i vhi = _mm_set1_epi64x(k_hi);
+            const __m128i zero = _mm_setzero_si128();
+            for (const size_t end = n & ~size_t(1); i < end; i += 2)
+            {
+                const __m128i c = _mm_unpacklo_epi32(_mm_loadl_epi64((const __m128i *)(in + i)), zero);
+                const __m128i lo = _mm_srli_epi64(_mm_mul_epu32(c, vlo), 32);
+                const __m128i hi = _mm_mul_epu32(c, vhi);
+                _mm_storeu_si128((__m128i *)(out + i), _mm_add_epi64(lo, hi));
+            }
+#elif defined(FASTTIME_HOST) && defined(__ARM_NEON)
+            const uint32x2_t vlo = vdup_n_u32(k_lo);
+            const uint32x2_t vhi = vdup_n_u32(k_hi);
+            for (const size_t end = n & ~size_t(1); i < end; i += 2)
+            {
+                const uint32x2_t c = vld1_u32(in + i);
+                const uint64x2_t lo = vshrq_n_u64(vmull_u32(c, vlo), 32);
+                vst1q_u64(out + i, vaddq_u64(lo, vmull_u32(c, vhi)));
+            }
+#endif
+            for (; i < n; ++i)
+            {
+                out[i] = (((uint64_t)in[i] * k_lo) >> 32) + (uint64_t)in[i] * k_hi;
+            }
+        }
+
+        /**
+         * @brief out[i] = (in[i] * k) >> 32 for 64-bit inputs.
+         */
+        static inline void convert_q32(const uint64_t *in, uint64_t *out, size_t n, uint64_t k)
+        {
+#if defined(__SIZEOF_INT128__)
+            __extension__ typedef unsigned __int128 u128; // GCC/Clang extension, quiet under -Wpedantic
+            for (size_t i = 0; i < n; ++i)
+            {
+                out[i] = (uint64_t)(((u128)in[i] * k) >> 32);
+            }
+#else
+            for (size_t i = 0; i < n; ++i)
+            {
+                out[i] = mul_shr32(in[i], k);
+            }
+#endif
+        }
+
+        /**
+         * @brief Generic shift (converters built with q != 32).
+         */
+        template <typename T>
+        static inline void convert_shift(const T *in, uint64_t *out, size_t n, uint64_t k, uint32_t shift)
+        {
+            for (size_t i = 0; i < n; ++i)
+            {
+                out[i] = ((uint64_t)in[i] * k) >> shift;
+            }
+        }
+    } // namespace detail
+
+    /**
+     * @brief Convert @p n 32-bit cycle deltas to microseconds.
+     *
+     * @param in  Cycle values (e.g. @ref cycles_between results).
+     * @param out Destination, may not alias @p in.
+     */
+    static inline void cycles_to_us(const uint32_t *in, uint64_t *out, size_t n,
+                                    const UsConverter &cvt = UsConverter::make())
+    {
+        if (cvt.shift == 32)
+        {
+            detail::convert_q32(in, out, n, cvt.k);
+        }
+        else
+        {
+            detail::convert_shift(in, out, n, cvt.k, cvt.shift);
+        }
+    }
+
+    /**
+     * @brief Convert @p n 64-bit cycle values to microseconds.
+     */
+    static inline void cycles_to_us(const uint64_t *in, uint64_t *out, size_t n,
+                                    const UsConverter &cvt = UsConverter::make())
+    {
+        if (cvt.shift == 32)
+        {
+            detail::convert_q32(in, out, n, cvt.k);
+        }
+        else
+        {
+            detail::convert_shift(in, out, n, cvt.k, cvt.shift);
+        }
+    }
+
+    /**
+     * @brief Convert @p n 32-bit cycle deltas to nanoseconds.
+     */
+    static inline void cycles_to_ns(const uint32_t *in, uint64_t *out, size_t n,
+                                    const NsConverter &cvt = NsConverter::make())
+    {
+        detail::convert_q32(in, out, n, cvt.k);
+    }
+
+    /**
+     * @brief Convert @p n 64-bit cycle values to nanoseconds.
+     */
+    static inline void cycles_to_ns(const uint64_t *in, uint64_t *out, size_t n,
+                                    const NsConverter &cvt = NsConverter::make())
+    {
+        detail::convert_q32(in, out, n, cvt.k);
+    }
+
+} // namespace fasttime
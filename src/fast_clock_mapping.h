@@ -0,0 +1,287 @@
+#pragma once
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp23_fast_timestamp.h"
+
+#include <sys/time.h>
+#if defined(FASTTIME_HOST)
+#include <time.h>
+#endif
+
+/**
+ * @file fast_clock_mapping.h
+ * @brief Map cycle timestamps to Unix-epoch nanoseconds.
+ *
+ * @details
+ * @ref ClockMapping periodically samples (cycle count, wall clock) pairs and fits a line through
+ * the last few of them, so the slope tracks the real counter frequency (drift compensation) and
+ * any @ref Timestamp can be converted to epoch time with one multiply-shift:
+ *
+ *     epoch_ns = base_epoch_ns + (ts - base_ticks) * ns_per_cycle
+ *
+ * Each sample brackets the wall-clock read between two counter reads and keeps the tightest of
+ * a few attempts. The fit parameters are published through a sequence lock: @ref update is the
+ * only writer, readers on any core never block and retry only if they race an update.
+ *
+ * @par Update period
+ * Call @ref ClockMapping::update periodically (e.g. once a second). On Xtensa the distance from
+ * the last update to a converted timestamp must stay below 2^31 cycles (~8.9 s @ 240 MHz).
+ *
+ * @code
+ * static fasttime::ClockMapping<> wall;
+ * // once per second, from one task:
+ * wall.update();
+ * // anywhere:
+ * uint64_t ns = wall.to_epoch_ns(event.ts);
+ * @endcode
+ */
+
+namespace fasttime
+{
+
+    /**
+     * @brief Wall-clock source returning Unix-epoch nanoseconds.
+     */
+    using EpochSource = uint64_t (*)();
+
+    /**
+     * @brief Default wall clock: @c gettimeofday (SNTP-disciplined on ESP32), @c CLOCK_REALTIME on host.
+     */
+    static inline uint64_t epoch_now_ns()
+    {
+#if defined(FASTTIME_HOST)
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        return uint64_t(ts.tv_sec) * 1000000000ULL + uint64_t(ts.tv_nsec);
+#else
+        struct timeval tv;
+        gettimeofday(&tv, nullptr);
+        return uint64_t(tv.tv_sec) * 1000000000ULL + uint64_t(tv.tv_usec) * 1000ULL;
+#endif
+    }
+
+    /**
+     * @brief Linear cycle→epoch mapping refined from periodic samples.
+     *
+     * @tparam Window Number of recent samples in the least-squares fit.
+     */
+    template <size_t Window = 8>
+    class ClockMapping
+    {
+        static_assert(Window >= 2, "fit needs at least two samples");
+
+    public:
+        /**
+         * @param source  Wall clock to follow.
+         * @param freq_hz Nominal counter frequency, used until two samples exist.
+         * @param step_ns Residual beyond which the wall clock is considered stepped and the
+         *                fit restarts from the new sample. Checked from the third sample on.
+         */
+        explicit ClockMapping(EpochSource source = epoch_now_ns,
+                              uint64_t freq_hz = FASTTIME_FREQ_HZ,
+                              uint64_t step_ns = 1000000)
+            : source_(source), nominal_q32_(NsConverter::make(freq_hz).k), step_ns_(step_ns),
+              clock_(CycleExtender::make())
+        {
+            params_.base_ticks = 0;
+            params_.base_epoch_ns = 0;
+            params_.ns_per_cycle_q32 = nominal_q32_;
+            params_.error_ns = UINT32_MAX;
+        }
+
+        /**
+         * @brief Take a sample, refit and publish new parameters.
+         * @return false if the wall clock stepped and the fit was restarted.
+         */
+        bool update()
+        {
+            // Bracket the wall-clock read; keep the narrowest of three tries.
+            uint64_t best_width = UINT64_MAX;
+            Timestamp at{0};
+            uint64_t epoch = 0;
+            for (int i = 0; i < 3; ++i)
+            {
+                const Timestamp t0 = Timestamp::now();
+                const uint64_t e = source_();
+                const Timestamp t1 = Timestamp::now();
+                const uint64_t width = cycles_between(t0, t1);
+                if (width < best_width)
+                {
+                    best_width = width;
+                    at = Timestamp{(fast_counter_t)(t0.ticks + (fast_counter_t)(width / 2))};
+                    epoch = e;
+                }
+            }
+            const uint64_t ext = clock_.extend(at);
+
+            // A single sample only has the nominal slope, which may be off by far more than
+            // step_ns over one update period; check residuals once two samples set the slope.
+            bool continuous = true;
+            if (count_ >= 2)
+            {
+                const uint64_t predicted = map(params(), at);
+                const uint64_t residual = predicted > epoch ? predicted - epoch : epoch - predicted;
+                if (residual > step_ns_)
+                {
+                    count_ = 0;
+                    continuous = false;
+                }
+            }
+
+            samples_[head_] = Sample{ext, epoch};
+            head_ = (head_ + 1) % Window;
+            if (count_ < Window)
+            {
+                ++count_;
+            }
+
+            publish(fit(at, uint32_t(NsConverter{nominal_q32_}.to_ns(best_width) / 2)));
+            return continuous;
+        }
+
+        /**
+         * @brief Convert @p ts to Unix-epoch nanoseconds (lock-free).
+         *
+         * @return 0 before the first @ref update.
+         */
+        inline uint64_t to_epoch_ns(const Timestamp ts) const
+        {
+            const Params p = params();
+            return p.base_epoch_ns ? map(p, ts) : 0;
+        }
+
+        /** @brief Current time as Unix-epoch nanoseconds. */
+        inline uint64_t now_epoch_ns() const { return to_epoch_ns(Timestamp::now()); }
+
+        /**
+         * @brief Error bound of the mapping: worst fit residual plus the sampling bracket.
+         */
+        inline uint32_t error_bound_ns() const { return params().error_ns; }
+
+        /**
+         * @brief Measured counter frequency error relative to the nominal one, in ppb
+         *        (positive: the counter runs slow).
+         */
+        inline int32_t drift_ppb() const
+        {
+            const double ratio = double(params().ns_per_cycle_q32) / double(nominal_q32_);
+            return int32_t((ratio - 1.0) * 1e9);
+        }
+
+    private:
+        struct Sample
+        {
+            uint64_t ext;      ///< Extended cycle count.
+            uint64_t epoch_ns; ///< Wall clock at that count.
+        };
+
+        struct Params
+        {
+            fast_counter_t base_ticks;  ///< Counter value at the reference point.
+            uint64_t base_epoch_ns;     ///< Epoch time at @ref base_ticks.
+            uint64_t ns_per_cycle_q32;  ///< Slope in Q32.32 ns per cycle.
+            uint32_t error_ns;          ///< Error bound.
+        };
+
+        static inline uint64_t map(const Params &p, const Timestamp ts)
+        {
+            const int64_t delta = sizeof(fast_counter_t) == 4
+                                      ? int64_t(int32_t(ts.ticks - p.base_ticks))
+                                      : int64_t(ts.ticks - p.base_ticks);
+            const uint64_t off = mul_shr32(uint64_t(delta < 0 ? -delta : delta), p.ns_per_cycle_q32);
+            return delta < 0 ? p.base_epoch_ns - off : p.base_epoch_ns + off;
+        }
+
+        /// Least-squares fit through the window, anchored at the newest sample.
+        Params fit(const Timestamp at, uint32_t bracket_ns) const
+        {
+            const size_t newest = (head_ + Window - 1) % Window;
+            const Sample &last = samples_[newest];
+            Params p;
+            p.base_ticks = at.ticks;
+            p.base_epoch_ns = last.epoch_ns;
+            p.ns_per_cycle_q32 = nominal_q32_;
+            p.error_ns = UINT32_MAX;
+            if (count_ < 2)
+            {
+                return p;
+            }
+
+            // Fit relative to the newest sample to keep the doubles small.
+            double sx = 0, sy = 0, sxx = 0, sxy = 0;
+            for (size_t i = 0; i < count_; ++i)
+            {
+                const Sample &s = samples_[(newest + Window - i) % Window];
+                const double x = -double(last.ext - s.ext);
+                const double y = double(int64_t(s.epoch_ns - last.epoch_ns));
+                sx += x;
+                sy += y;
+                sxx += x * x;
+                sxy += x * y;
+            }
+            const double n = double(count_);
+            const double den = n * sxx - sx * sx;
+            if (den <= 0)
+            {
+                return p;
+            }
+            const double slope = (n * sxy - sx * sy) / den;
+            const double icept = (sy - slope * sx) / n;
+
+            double worst = 0;
+            for (size_t i = 0; i < count_; ++i)
+            {
+                const Sample &s = samples_[(newest + Window - i) % Window];
+                const double x = -double(last.ext - s.ext);
+                const double r = double(int64_t(s.epoch_ns - last.epoch_ns)) - (icept + slope * x);
+                worst = r < 0 ? (-r > worst ? -r : worst) : (r > worst ? r : worst);
+            }
+
+            p.base_epoch_ns = uint64_t(int64_t(last.epoch_ns) + int64_t(icept));
+            p.ns_per_cycle_q32 = uint64_t(slope * 4294967296.0);
+            const double err = worst + bracket_ns;
+            p.error_ns = err >= 4294967295.0 ? UINT32_MAX : uint32_t(err);
+            return p;
+        }
+
+        inline void publish(const Params &p)
+        {
+            const uint32_t s = seq_.load(std::memory_order_relaxed);
+            seq_.store(s + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            params_ = p;
+            seq_.store(s + 2, std::memory_order_release);
+        }
+
+        inline Params params() const
+        {
+            for (;;)
+            {
+                const uint32_t s1 = seq_.load(std::memory_order_acquire);
+                if (s1 & 1u)
+                {
+                    continue;
+                }
+                Params copy = params_;
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (seq_.load(std::memory_order_relaxed) == s1)
+                {
+                    return copy;
+                }
+            }
+        }
+
+        EpochSource source_;
+        uint64_t nominal_q32_;
+        uint64_t step_ns_;
+        CycleExtender clock_;
+        Sample samples_[Window];
+        size_t head_ = 0;
+        size_t count_ = 0;
+        std::atomic<uint32_t> seq_{0};
+        Params params_;
+    };
+
+} // namespace fasttime
@@ -0,0 +1,447 @@
+#pragma once
+#include <stdint.h>
+
+#include "esp23_fast_timestamp.h"
+
+/**
+ * @file fast_clock_servo.h
+ * @brief Discipline the local cycle clock to a reference (PI servo and 2-state Kalman filter).
+ *
+ * @details
+ * @ref FASTTIME_FREQ_HZ is a nominal value; the crystal is off by a few ppm and moves with
+ * temperature by tens of ppm, which adds up to milliseconds over an hour. A servo consumes
+ * (local time, reference time) pairs — from @ref TimeTransferClient, SNTP, a GPS PPS edge — and
+ * keeps an estimate of the reference clock's offset and of its frequency relative to ours:
+ *
+ *     reference_ns ≈ local_ns + offset + (local_ns - t_sample) * freq_ppb / 1e9
+ *
+ * - @ref PiServo is the classic PTP servo: it estimates the frequency from the first two
+ *   samples, steps once, then steers phase through a proportional-integral frequency term.
+ * - @ref KalmanServo tracks [offset, frequency] with explicit measurement and process noise, so
+ *   it weights noisy samples automatically and reports its own uncertainty.
+ *
+ * With ~1.2 µs of measurement noise at one sample per second (tests/test_clock_servo.cpp), the
+ * PI servo passes each sample's noise into the frequency and predicts within about ±3.3 µs
+ * (1 µs rms); the Kalman servo stays within about ±1.4 µs (0.4 µs rms).
+ *
+ * Both run in integer arithmetic only (64-bit values, 128-bit intermediates for a*b/c), so they
+ * are equally cheap on chips without an FPU. Results feed back into the converters through
+ * @c ns_converter / @c us_converter, which return frequency-corrected factors.
+ *
+ * @code
+ * static fasttime::PiServo servo;
+ * // for every reference measurement:
+ * servo.sample(local_ns, reference_ns);
+ * // converters that follow the measured frequency:
+ * fasttime::NsConverter ns = servo.ns_converter();
+ * @endcode
+ */
+
+namespace fasttime
+{
+
+    namespace detail
+    {
+        /**
+         * @brief floor(@p a * @p b / @p c) with a 128-bit intermediate, saturating at UINT64_MAX.
+         */
+        static inline uint64_t mul_div_u64(uint64_t a, uint64_t b, uint64_t c)
+        {
+#if defined(__SIZEOF_INT128__)
+            __extension__ typedef unsigned __int128 u128; // GCC/Clang extension, quiet under -Wpedantic
+            const u128 q = (u128)a * b / c;
+            return q > UINT64_MAX ? UINT64_MAX : (uint64_t)q;
+#else
+            // 64×64→128 from 32-bit halves, then restoring long division.
+            const uint64_t a_lo = (uint32_t)a, a_hi = a >> 32;
+            const uint64_t b_lo = (uint32_t)b, b_hi = b >> 32;
+            const uint64_t ll = a_lo * b_lo, lh = a_lo * b_hi, hl = a_hi * b_lo, hh = a_hi * b_hi;
+            const uint64_t mid = (ll >> 32) + (uint32_t)lh + (uint32_t)hl;
+            uint64_t lo = (mid << 32) | (uint32_t)ll;
+            uint64_t hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+            if (hi >= c)
+            {
+                return UINT64_MAX;
+            }
+            uint64_t q = 0;
+            for (int i = 0; i < 64; ++i)
+            {
+                const bool carry = hi >> 63;
+                hi = (hi << 1) | (lo >> 63);
+                lo <<= 1;
+                q <<= 1;
+                if (carry || hi >= c)
+                {
+                    hi -= c;
+                    q |= 1;
+                }
+            }
+            return q;
+#endif
+        }
+
+        /**
+         * @brief Signed @p a * @p b / @p c (c > 0), truncating toward zero and saturating.
+         */
+        static inline int64_t mul_div(int64_t a, int64_t b, uint64_t c)
+        {
+            const bool neg = (a < 0) != (b < 0);
+            const uint64_t ua = a < 0 ? 0 - uint64_t(a) : uint64_t(a);
+            const uint64_t ub = b < 0 ? 0 - uint64_t(b) : uint64_t(b);
+            const uint64_t q = mul_div_u64(ua, ub, c);
+            if (q > uint64_t(INT64_MAX))
+            {
+                return neg ? INT64_MIN : INT64_MAX;
+            }
+            return neg ? -int64_t(q) : int64_t(q);
+        }
+
+        static inline int64_t clamp64(int64_t v, int64_t lim)
+        {
+            return v > lim ? lim : (v < -lim ? -lim : v);
+        }
+
+        static inline int64_t sat_add(int64_t a, int64_t b)
+        {
+            int64_t r;
+            return __builtin_add_overflow(a, b, &r) ? (b < 0 ? INT64_MIN : INT64_MAX) : r;
+        }
+
+        /// Scale a converter factor by (1 + ppb_q16 / 2^16 / 1e9).
+        static inline uint64_t scale_ppb(uint64_t k, int64_t ppb_q16)
+        {
+            static constexpr int64_t kOne = 1000000000LL << 16;
+            return (uint64_t)mul_div(int64_t(k), kOne + ppb_q16, uint64_t(kOne));
+        }
+    } // namespace detail
+
+    /**
+     * @brief Outcome of feeding one sample to a servo.
+     */
+    enum class ServoState : uint8_t
+    {
+        kUnlocked, ///< Not enough samples yet; estimates are not usable.
+        kStepped,  ///< Offset was stepped to the measurement (startup or a jump).
+        kLocked,   ///< Tracking; offset is steered through the frequency.
+    };
+
+    // ----------------------------------------------------------------------------
+    // PI servo
+    // ----------------------------------------------------------------------------
+
+    /**
+     * @brief Proportional-integral clock servo.
+     *
+     * @details Every sample measures the phase error @c e of the disciplined clock. The
+     *          frequency becomes
+     *
+     *              freq = kp * e / dt + Σ ki * e / dt
+     *
+     *          so a phase error is worked off over roughly one sample interval and the integral
+     *          converges on the crystal's actual frequency error. Gains are Q16 (65536 = 1.0);
+     *          the defaults (0.7 / 0.3) are the ones PTP daemons use for 1 s sync intervals.
+     */
+    class PiServo
+    {
+    public:
+        /**
+         * @param kp_q16       Proportional gain, Q16.
+         * @param ki_q16       Integral gain, Q16.
+         * @param step_ns      Phase error beyond which the clock is stepped instead of steered.
+         * @param max_freq_ppb Frequency correction limit.
+         */
+        explicit PiServo(uint32_t kp_q16 = 45875, uint32_t ki_q16 = 19661,
+                         uint64_t step_ns = 20000000, uint32_t max_freq_ppb = 500000)
+            : kp_(kp_q16), ki_(ki_q16), step_ns_(step_ns),
+              max_q16_(int64_t(max_freq_ppb) << 16) {}
+
+        /**
+         * @brief Feed one measurement: the reference read @p ref_ns when the local clock read
+         *        @p local_ns.
+         */
+        ServoState sample(uint64_t local_ns, uint64_t ref_ns)
+        {
+            const int64_t raw = int64_t(ref_ns - local_ns);
+            switch (count_)
+            {
+            case 0:
+                // Remember the first raw offset; the second gives a frequency estimate.
+                first_local_ = local_ns;
+                first_raw_ = raw;
+                count_ = 1;
+                rebase(local_ns, ref_ns);
+                return ServoState::kUnlocked;
+            case 1:
+            {
+                const uint64_t dt = local_ns - first_local_;
+                if (dt == 0)
+                {
+                    return ServoState::kUnlocked;
+                }
+                freq_q16_ = detail::clamp64(detail::mul_div(raw - first_raw_, 1000000000LL << 16, dt),
+                                            max_q16_);
+                integral_q16_ = freq_q16_;
+                count_ = 2;
+                rebase(local_ns, ref_ns);
+                return ServoState::kStepped;
+            }
+            default:
+                break;
+            }
+
+            const uint64_t dt = local_ns - base_local_;
+            const int64_t err = int64_t(ref_ns - to_reference_ns(local_ns));
+            last_error_ = err;
+            if ((err < 0 ? 0 - uint64_t(err) : uint64_t(err)) > step_ns_ || dt == 0)
+            {
+                rebase(local_ns, ref_ns);
+                return ServoState::kStepped;
+            }
+
+            // Error as a rate over the last interval, Q16 ppb.
+            const int64_t rate_q16 = detail::mul_div(err, 1000000000LL << 16, dt);
+            base_ref_ = to_reference_ns(local_ns);
+            base_local_ = local_ns;
+            integral_q16_ = detail::clamp64(
+                detail::sat_add(integral_q16_, detail::mul_div(rate_q16, ki_, 65536)), max_q16_);
+            freq_q16_ = detail::clamp64(
+                detail::sat_add(integral_q16_, detail::mul_div(rate_q16, kp_, 65536)), max_q16_);
+            return ServoState::kLocked;
+        }
+
+        /** @brief Reference time at local time @p local_ns. */
+        inline uint64_t to_reference_ns(uint64_t local_ns) const
+        {
+            const int64_t dt = int64_t(local_ns - base_local_);
+            return base_ref_ + uint64_t(dt) + uint64_t(detail::mul_div(dt, freq_q16_, 1000000000ULL << 16));
+        }
+
+        /** @brief Current offset (reference - local) at local time @p local_ns. */
+        inline int64_t offset_ns(uint64_t local_ns) const
+        {
+            return int64_t(to_reference_ns(local_ns) - local_ns);
+        }
+
+        /** @brief Reference frequency relative to the local clock, ppb (positive: we run slow). */
+        inline int32_t freq_ppb() const { return int32_t(freq_q16_ >> 16); }
+
+        /** @brief Phase error measured by the last locked sample. */
+        inline int64_t last_error_ns() const { return last_error_; }
+
+        /** @brief Nanosecond converter for @p freq_hz corrected by @ref freq_ppb. */
+        inline NsConverter ns_converter(uint64_t freq_hz = FASTTIME_FREQ_HZ) const
+        {
+            NsConverter c = NsConverter::make(freq_hz);
+            c.k = detail::scale_ppb(c.k, freq_q16_);
+            return c;
+        }
+
+        /** @brief Microsecond converter for @p freq_hz corrected by @ref freq_ppb. */
+        inline UsConverter us_converter(uint64_t freq_hz = FASTTIME_FREQ_HZ) const
+        {
+            UsConverter c = UsConverter::make(freq_hz);
+            c.k = detail::scale_ppb(c.k, freq_q16_);
+            return c;
+        }
+
+        /** @brief Forget all state (e.g. after switching reference). */
+        inline void reset() { *this = PiServo(kp_, ki_, step_ns_, uint32_t(max_q16_ >> 16)); }
+
+    private:
+        inline void rebase(uint64_t local_ns, uint64_t ref_ns)
+        {
+            base_local_ = local_ns;
+            base_ref_ = ref_ns;
+        }
+
+        uint32_t kp_;
+        uint32_t ki_;
+        uint64_t step_ns_;
+        int64_t max_q16_;
+
+        uint32_t count_ = 0;
+        uint64_t first_local_ = 0;
+        int64_t first_raw_ = 0;
+        uint64_t base_local_ = 0;
+        uint64_t base_ref_ = 0;
+        int64_t freq_q16_ = 0;
+        int64_t integral_q16_ = 0;
+        int64_t last_error_ = 0;
+    };
+
+    // ----------------------------------------------------------------------------
+    // Kalman servo
+    // ----------------------------------------------------------------------------
+
+    /**
+     * @brief Two-state Kalman filter over [offset, frequency].
+     *
+     * @details Model between samples @c dt seconds apart:
+     *
+     *              offset' = offset + freq * dt        P' = F P Fᵀ + Q
+     *              freq'   = freq
+     *
+     *          with white phase noise @c q_phase (ns²/s) and random-walk frequency noise
+     *          @c q_freq (ppb²/s). Each sample measures the offset with variance @c r (ns²).
+     *          Frequency is kept in Q16 ppb; covariances are in matching units and every
+     *          product goes through a 128-bit a*b/c, so the filter needs no floating point.
+     */
+    class KalmanServo
+    {
+    public:
+        /**
+         * @param r_ns2       Measurement variance (e.g. the square of the path-delay jitter).
+         * @param q_phase     Phase process noise, ns²/s.
+         * @param q_freq      Frequency random walk, ppb²/s.
+         * @param step_ns     Innovation beyond which the filter restarts from the measurement.
+         */
+        explicit KalmanServo(uint64_t r_ns2 = 1000000, uint64_t q_phase = 100,
+                             uint64_t q_freq = 100, uint64_t step_ns = 20000000)
+            : r_(r_ns2), q_phase_(q_phase), q_freq_q32_(q_freq << 32), step_ns_(step_ns) {}
+
+        /**
+         * @brief Feed one measurement: the reference read @p ref_ns when the local clock read
+         *        @p local_ns.
+         */
+        ServoState sample(uint64_t local_ns, uint64_t ref_ns)
+        {
+            const int64_t z = int64_t(ref_ns - local_ns);
+            if (!started_)
+            {
+                restart(local_ns, z);
+                return ServoState::kUnlocked;
+            }
+
+            // Predict.
+            const uint64_t dt = local_ns - t_;
+            const int64_t p11_dt = detail::mul_div(p11_, int64_t(dt), kPerSecQ16);
+            offset_ = detail::sat_add(offset_, detail::mul_div(freq_q16_, int64_t(dt), kPerSecQ16));
+            p00_ = cap(detail::sat_add(detail::sat_add(p00_, 2 * detail::mul_div(p01_, int64_t(dt), kPerSecQ16)),
+                                       detail::sat_add(detail::mul_div(p11_dt, int64_t(dt), kPerSecQ16),
+                                                       detail::mul_div(int64_t(q_phase_), int64_t(dt), 1000000000ULL))));
+            p01_ = cap(detail::sat_add(p01_, p11_dt));
+            p11_ = cap(detail::sat_add(p11_, detail::mul_div(int64_t(q_freq_q32_), int64_t(dt), 1000000000ULL)));
+            t_ = local_ns;
+
+            // Update.
+            const int64_t innov = z - offset_;
+            last_error_ = innov;
+            if ((innov < 0 ? 0 - uint64_t(innov) : uint64_t(innov)) > step_ns_)
+            {
+                restart(local_ns, z);
+                return ServoState::kStepped;
+            }
+            const uint64_t s = uint64_t(p00_) + r_;
+            offset_ += detail::mul_div(p00_, innov, s);
+            freq_q16_ = detail::sat_add(freq_q16_, detail::mul_div(p01_, innov, s));
+            const int64_t p11 = p11_ - detail::mul_div(p01_, p01_, s);
+            p01_ = detail::mul_div(p01_, int64_t(r_), s);
+            p00_ = detail::mul_div(p00_, int64_t(r_), s);
+            p11_ = p11 < 1 ? 1 : p11;
+            return ++updates_ >= 2 ? ServoState::kLocked : ServoState::kUnlocked;
+        }
+
+        /** @brief Reference time at local time @p local_ns. */
+        inline uint64_t to_reference_ns(uint64_t local_ns) const
+        {
+            return local_ns + uint64_t(offset_ns(local_ns));
+        }
+
+        /** @brief Estimated offset (reference - local) at local time @p local_ns. */
+        inline int64_t offset_ns(uint64_t local_ns) const
+        {
+            return offset_ + detail::mul_div(freq_q16_, int64_t(local_ns - t_), kPerSecQ16);
+        }
+
+        /** @brief Reference frequency relative to the local clock, ppb (positive: we run slow). */
+        inline int32_t freq_ppb() const { return int32_t(freq_q16_ >> 16); }
+
+        /** @brief One-sigma uncertainty of the offset estimate, ns. */
+        inline uint32_t offset_sigma_ns() const { return uint32_t(isqrt(uint64_t(p00_))); }
+
+        /** @brief One-sigma uncertainty of the frequency estimate, ppb. */
+        inline uint32_t freq_sigma_ppb() const { return uint32_t(isqrt(uint64_t(p11_)) >> 16); }
+
+        /** @brief Innovation (measurement minus prediction) of the last sample. */
+        inline int64_t last_error_ns() const { return last_error_; }
+
+        /** @brief Nanosecond converter for @p freq_hz corrected by @ref freq_ppb. */
+        inline NsConverter ns_converter(uint64_t freq_hz = FASTTIME_FREQ_HZ) const
+        {
+            NsConverter c = NsConverter::make(freq_hz);
+            c.k = detail::scale_ppb(c.k, freq_q16_);
+            return c;
+        }
+
+        /** @brief Microsecond converter for @p freq_hz corrected by @ref freq_ppb. */
+        inline UsConverter us_converter(uint64_t freq_hz = FASTTIME_FREQ_HZ) const
+        {
+            UsConverter c = UsConverter::make(freq_hz);
+            c.k = detail::scale_ppb(c.k, freq_q16_);
+            return c;
+        }
+
+        /** @brief Forget all state (e.g. after switching reference). */
+        inline void reset() { started_ = false; }
+
+    private:
+        /// ns per second × Q16: divides (Q16 ppb × ns) products back to ns.
+        static constexpr uint64_t kPerSecQ16 = 1000000000ULL << 16;
+        /// Covariance ceiling that keeps every intermediate inside int64.
+        static constexpr int64_t kPMax = int64_t(1) << 62;
+        /// Initial frequency uncertainty: 30 ppm, Q16 (its square must fit kPMax).
+        static constexpr int64_t kFreqSigma0Q16 = int64_t(30000) << 16;
+
+        static inline int64_t cap(int64_t v) { return detail::clamp64(v, kPMax); }
+
+        static inline uint64_t isqrt(uint64_t v)
+        {
+            uint64_t r = 0;
+            for (uint64_t bit = uint64_t(1) << 62; bit; bit >>= 2)
+            {
+                if (v >= r + bit)
+                {
+                    v -= r + bit;
+                    r = (r >> 1) + bit;
+                }
+                else
+                {
+                    r >>= 1;
+                }
+            }
+            return r;
+        }
+
+        inline void restart(uint64_t local_ns, int64_t z)
+        {
+            // Keep a learned frequency across steps; only the phase is reset.
+            if (!started_)
+            {
+                freq_q16_ = 0;
+                p11_ = cap(detail::mul_div(kFreqSigma0Q16, kFreqSigma0Q16, 1));
+                updates_ = 0;
+            }
+            offset_ = z;
+            p00_ = int64_t(r_);
+            p01_ = 0;
+            t_ = local_ns;
+            started_ = true;
+        }
+
+        uint64_t r_;
+        uint64_t q_phase_;
+        uint64_t q_freq_q32_;
+        uint64_t step_ns_;
+
+        bool started_ = false;
+        uint32_t updates_ = 0;
+        uint64_t t_ = 0;
+        int64_t offset_ = 0;
+        int64_t freq_q16_ = 0;
+        int64_t p00_ = 0;
+        int64_t p01_ = 0;
+        int64_t p11_ = 0;
+        int64_t last_error_ = 0;
+    };
+
+} // namespace fasttime
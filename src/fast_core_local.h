@@ -0,0 +1,231 @@
+#pragma once
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp23_fast_timestamp.h"
+
+#if defined(FASTTIME_HOST) && defined(__linux__)
+#include <sched.h>
+#elif !defined(FASTTIME_HOST) && defined(__has_include)
+#if __has_include(<sdkconfig.h>)
+#include <sdkconfig.h>
+#endif
+#endif
+
+/**
+ * @file fast_core_local.h
+ * @brief Core identification and core-local exclusion for per-core (sharded) data.
+ *
+ * @details
+ * Per-core data avoids shared atomics on the recording path, but two contexts on the same
+ * core (tasks, or a task and an ISR) can still interleave. @ref ShardLock closes that gap
+ * with the cheapest local primitive available:
+ * - Xtensa / RISC‑V targets: mask interrupts on the current core (a few cycles, no bus traffic).
+ * - Host: an uncontended test-and-set on the shard's own cache line, since several threads
+ *   may map to the same slot.
+ */
+
+/**
+ * @def FASTTIME_MAX_CORES
+ * @brief Number of hardware cores @ref fasttime::current_core can report.
+ */
+#ifndef FASTTIME_MAX_CORES
+#if defined(FASTTIME_HOST)
+#define FASTTIME_MAX_CORES 64
+#elif defined(CONFIG_FREERTOS_NUMBER_OF_CORES)
+#define FASTTIME_MAX_CORES CONFIG_FREERTOS_NUMBER_OF_CORES
+#elif defined(CONFIG_FREERTOS_UNICORE)
+#define FASTTIME_MAX_CORES 1
+#elif defined(__XTENSA__) || defined(CONFIG_IDF_TARGET_ESP32P4)
+#define FASTTIME_MAX_CORES 2
+#else
+#define FASTTIME_MAX_CORES 1
+#endif
+#endif
+
+/**
+ * @def FASTTIME_SHARDS
+ * @brief Default shard count: one per core on target, thread slots on host.
+ */
+#ifndef FASTTIME_SHARDS
+#if defined(FASTTIME_HOST)
+#define FASTTIME_SHARDS 16
+#else
+#define FASTTIME_SHARDS FASTTIME_MAX_CORES
+#endif
+#endif
+
+/**
+ * @def FASTTIME_CACHELINE
+ * @brief Alignment for per-shard data to avoid false sharing (internal SRAM is uncached on ESP32).
+ */
+#ifndef FASTTIME_CACHELINE
+#if defined(FASTTIME_HOST)
+#define FASTTIME_CACHELINE 64
+#else
+#define FASTTIME_CACHELINE 4
+#endif
+#endif
+
+namespace fasttime
+{
+
+    /**
+     * @brief Index of the core executing the caller.
+     *
+     * @remarks Xtensa reads PRID (same as @c xPortGetCoreID()), multi-core RISC‑V reads
+     *          @c mhartid, host uses @c sched_getcpu().
+     */
+    static inline FASTTIME_ALWAYS_INLINE uint32_t current_core()
+    {
+#if defined(FASTTIME_HOST)
+#if defined(__linux__)
+        const int cpu = sched_getcpu();
+        return cpu < 0 ? 0 : uint32_t(cpu) % FASTTIME_MAX_CORES;
+#else
+        return 0;
+#endif
+#elif defined(__XTENSA__)
+        uint32_t prid;
+        asm volatile("rsr.prid %0" : "=a"(prid));
+        return (prid >> 13) & 1u;
+#elif FASTTIME_MAX_CORES > 1
+        uint32_t hart;
+        asm volatile("csrr %0, mhartid" : "=r"(hart));
+        return hart % FASTTIME_MAX_CORES;
+#else
+        return 0;
+#endif
+    }
+
+    /**
+     * @brief Shard slot of the caller: the core on target, a stable per-thread slot on host.
+     */
+    inline FASTTIME_ALWAYS_INLINE uint32_t current_shard()
+    {
+#if defined(FASTTIME_HOST)
+        static std::atomic<uint32_t> next{0};
+        thread_local const uint32_t slot = next.fetch_add(1, std::memory_order_relaxed) % FASTTIME_SHARDS;
+        return slot;
+#else
+        return current_core();
+#endif
+    }
+
+    /**
+     * @brief Excludes other writers of the same shard on the current core.
+     *
+     * @details @ref enter returns the state @ref exit needs to restore. @ref enter_from_isr
+     *          does the same but never lowers the interrupt level, so it is safe in handlers
+     *          above level 3 (Xtensa high-priority interrupts), where @ref enter would let
+     *          lower-priority interrupts nest. It costs one extra register read.
+     *
+     * @warning On target this only excludes the local core. Writers on other cores must use
+     *          their own shard, so pick it with @ref enter_shard rather than indexing by
+     *          @ref current_shard before entering.
+     */
+    struct ShardLock
+    {
+#if defined(FASTTIME_HOST)
+        std::atomic_flag busy = ATOMIC_FLAG_INIT;
+
+        FASTTIME_ALWAYS_INLINE inline uint32_t enter()
+        {
+            while (busy.test_and_set(std::memory_order_acquire))
+            {
+            }
+            return 0;
+        }
+
+        FASTTIME_ALWAYS_INLINE inline uint32_t enter_from_isr() { return enter(); }
+
+        FASTTIME_ALWAYS_INLINE inline void exit(uint32_t)
+        {
+            busy.clear(std::memory_order_release);
+        }
+#elif defined(__XTENSA__)
+        FASTTIME_ALWAYS_INLINE inline uint32_t enter()
+        {
+            uint32_t ps;
+            asm volatile("rsil %0, 3" : "=a"(ps) : : "memory"); // XCHAL_EXCM_LEVEL
+            return ps;
+        }
+
+        FASTTIME_ALWAYS_INLINE inline uint32_t enter_from_isr()
+        {
+            uint32_t ps;
+            asm volatile("rsr.ps %0" : "=a"(ps) : : "memory");
+            if ((ps & 0xFu) < 3u)
+            {
+                asm volatile("rsil %0, 3" : "=a"(ps) : : "memory");
+            }
+            return ps;
+        }
+
+        FASTTIME_ALWAYS_INLINE inline void exit(uint32_t ps)
+        {
+            asm volatile("wsr.ps %0\n\trsync" : : "a"(ps) : "memory");
+        }
+#else
+        FASTTIME_ALWAYS_INLINE inline uint32_t enter()
+        {
+            uint32_t mstatus;
+            asm volatile("csrrci %0, mstatus, 8" : "=r"(mstatus) : : "memory"); // clear MIE
+            return mstatus;
+        }
+
+        /// Clearing MIE never unmasks anything, so this is @ref enter.
+        FASTTIME_ALWAYS_INLINE inline uint32_t enter_from_isr() { return enter(); }
+
+        FASTTIME_ALWAYS_INLINE inline void exit(uint32_t mstatus)
+        {
+            asm volatile("csrs mstatus, %0" : : "r"(mstatus & 8u) : "memory");
+        }
+#endif
+    };
+
+    /**
+     * @brief Enter the caller's shard of @p shards (elements with a @c lock member) and return it.
+     *
+     * @details On target the interrupt mask goes up before the core is read. A task that is
+     *          not pinned to a core therefore cannot be preempted and migrated between picking
+     *          a shard and locking it, which would leave it writing the other core's shard while
+     *          only its new core is masked. On host the shard is the thread's own slot, which
+     *          never changes, and its lock excludes the other threads sharing that slot.
+     *
+     * @tparam FromIsr Enter with @ref ShardLock::enter_from_isr.
+     * @param state    Receives the value to pass to @c lock.exit() of the returned shard.
+     */
+    template <bool FromIsr = false, typename Shard, size_t N>
+    FASTTIME_ALWAYS_INLINE inline Shard &enter_shard(Shard (&shards)[N], uint32_t &state)
+    {
+#if defined(FASTTIME_HOST)
+        Shard &s = shards[current_shard() % N];
+        state = FromIsr ? s.lock.enter_from_isr() : s.lock.enter();
+        return s;
+#else
+        // Masking is core-wide: any shard's lock masks the core the caller is now on.
+        state = FromIsr ? shards[0].lock.enter_from_isr() : shards[0].lock.enter();
+        return shards[current_shard() % N];
+#endif
+    }
+
+    /**
+     * @brief @ref enter_shard for a separate array of @p locks: enter the caller's lock and
+     *        return its index into the data the locks guard.
+     */
+    template <bool FromIsr = false, size_t N>
+    FASTTIME_ALWAYS_INLINE inline uint32_t enter_shard_index(ShardLock (&locks)[N], uint32_t &state)
+    {
+#if defined(FASTTIME_HOST)
+        const uint32_t i = current_shard() % N;
+        state = FromIsr ? locks[i].enter_from_isr() : locks[i].enter();
+        return i;
+#else
+        state = FromIsr ? locks[0].enter_from_isr() : locks[0].enter();
+        return current_shard() % N;
+#endif
+    }
+
+} // namespace fasttime
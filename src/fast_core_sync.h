@@ -0,0 +1,313 @@
+#pragma once
+#include <atomic>
+#include <stdint.h>
+
+#include "esp23_fast_timestamp.h"
+#include "fast_core_local.h"
+
+#if defined(FASTTIME_HOST) && defined(__linux__)
+#include <pthread.h>
+#include <thread>
+#elif !defined(FASTTIME_HOST)
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#endif
+
+/**
+ * @file fast_core_sync.h
+ * @brief Cross-core cycle counter correlation (per-core offset estimation).
+ *
+ * @details
+ * On dual-core ESP32 every core has its own CCOUNT, started at slightly different times, so
+ * @ref cycles_between on timestamps from different cores is off by the counters' offset. The
+ * same applies to the TSC of different host CPUs on some machines.
+ *
+ * @ref calibrate_core_offsets estimates each core's offset to a reference core with ping-pong
+ * exchanges through shared memory: the initiator stamps t1, the responder on the other core
+ * stamps t2, the initiator stamps t3 on the reply. Assuming symmetric paths,
+ * @c offset = t2 - (t1 + t3) / 2, and the exchange with the smallest round trip is kept
+ * (its error is bounded by half that RTT).
+ *
+ * @ref CoreTimestamp records the core together with the ticks, so differences across cores
+ * can be corrected with the resulting @ref CoreClockOffsets.
+ *
+ * @code
+ * static fasttime::CoreClockOffsets offsets;
+ * fasttime::calibrate_core_offsets(offsets); // from a task pinned to a core
+ * auto a = fasttime::CoreTimestamp::now();   // e.g. on core 0
+ * auto b = fasttime::CoreTimestamp::now();   // e.g. on core 1
+ * uint64_t dt = fasttime::cycles_between(a, b, offsets);
+ * @endcode
+ */
+
+namespace fasttime
+{
+
+    /**
+     * @brief Counter offset of every core relative to a reference core.
+     */
+    struct CoreClockOffsets
+    {
+        int64_t offset[FASTTIME_MAX_CORES]; ///< counter(core) - counter(reference), in cycles.
+        uint32_t rtt[FASTTIME_MAX_CORES];   ///< Best round trip seen (error bound is rtt / 2).
+        uint32_t reference;                 ///< Core whose counter is the time base.
+
+        /** @brief Zero offsets (no correction). */
+        inline void reset(uint32_t ref = 0)
+        {
+            for (uint32_t i = 0; i < FASTTIME_MAX_CORES; ++i)
+            {
+                offset[i] = 0;
+                rtt[i] = 0;
+            }
+            reference = ref;
+        }
+
+        /**
+         * @brief Map raw ticks read on @p core onto the reference core's counter.
+         */
+        FASTTIME_ALWAYS_INLINE inline fast_counter_t to_reference(fast_counter_t ticks, uint32_t core) const
+        {
+            return ticks - (fast_counter_t)offset[core % FASTTIME_MAX_CORES];
+        }
+    };
+
+    /**
+     * @brief Timestamp tagged with the core it was read on.
+     */
+    struct CoreTimestamp
+    {
+        Timestamp ts;  ///< Raw ticks of @ref core's counter.
+        uint32_t core; ///< Core that read @ref ts.
+
+        /**
+         * @brief Read the counter and the core id without migrating in between.
+         *
+         * @remarks x86 hosts use RDTSCP (counter and CPU id in one instruction); targets mask
+         *          interrupts around the two reads.
+         */
+        static inline FASTTIME_ALWAYS_INLINE CoreTimestamp now()
+        {
+#if defined(FASTTIME_HOST) && !defined(FASTTIME_MOCK_COUNTER) && (defined(__x86_64__) || defined(__i386__))
+            uint32_t lo, hi, aux;
+            asm volatile("rdtscp" : "=a"(lo), "=d"(hi), "=c"(aux));
+            return CoreTimestamp{Timestamp{(uint64_t(hi) << 32) | lo}, (aux & 0xFFFu) % FASTTIME_MAX_CORES};
+#elif defined(FASTTIME_HOST)
+            for (;;)
+            {
+                const uint32_t c1 = current_core();
+                const Timestamp t = Timestamp::now();
+                if (current_core() == c1)
+                {
+                    return CoreTimestamp{t, c1};
+                }
+            }
+#else
+            ShardLock local;
+            const uint32_t state = local.enter();
+            const CoreTimestamp t{Timestamp::now(), current_core()};
+            local.exit(state);
+            return t;
+#endif
+        }
+
+        /** @brief Timestamp expressed on the reference core's counter. */
+        FASTTIME_ALWAYS_INLINE inline Timestamp on_reference(const CoreClockOffsets &o) const
+        {
+            return Timestamp{o.to_reference(ts.ticks, core)};
+        }
+    };
+
+    /**
+     * @brief Wrap-safe difference @p b - @p a corrected for the cores' counter offsets.
+     */
+    static inline FASTTIME_ALWAYS_INLINE uint64_t cycles_between(const CoreTimestamp a, const CoreTimestamp b,
+                                          const CoreClockOffsets &o)
+    {
+        return cycles_between(a.on_reference(o), b.on_reference(o));
+    }
+
+    // ----------------------------------------------------------------------------
+    //  Ping-pong calibration
+    // ----------------------------------------------------------------------------
+
+    /**
+     * @brief Shared state of one initiator/responder exchange.
+     */
+    struct CoreSyncChannel
+    {
+        std::atomic<uint32_t> seq{0};      ///< Odd: request for round (seq+1)/2 pending; even: replied.
+        std::atomic<fast_counter_t> t2{0}; ///< Responder's stamp for the current round.
+        std::atomic<bool> abort{false};    ///< Set by the initiator to release the responder early.
+    };
+
+    /**
+     * @brief Best exchange of a calibration run.
+     */
+    struct CoreSyncResult
+    {
+        int64_t offset; ///< counter(responder) - counter(initiator).
+        uint32_t rtt;   ///< Round trip of the exchange used (cycles).
+        bool valid;     ///< false if the responder never answered.
+    };
+
+    /**
+     * @brief Responder side: answer @p rounds requests. Run on the core being measured.
+     */
+    static inline void core_sync_respond(CoreSyncChannel &ch, uint32_t rounds)
+    {
+        for (uint32_t i = 0; i < rounds; ++i)
+        {
+            const uint32_t request = 2 * i + 1;
+            while (ch.seq.load(std::memory_order_acquire) != request)
+            {
+                if (ch.abort.load(std::memory_order_relaxed))
+                {
+                    return;
+                }
+            }
+            ch.t2.store(fast_rdcycle(), std::memory_order_relaxed);
+            ch.seq.store(request + 1, std::memory_order_release);
+        }
+    }
+
+    /**
+     * @brief Initiator side: run @p rounds exchanges and keep the minimum-RTT one.
+     *
+     * @param timeout_cycles Give up if a reply takes longer than this.
+     */
+    static inline CoreSyncResult core_sync_initiate(CoreSyncChannel &ch, uint32_t rounds,
+                                                    uint64_t timeout_cycles = FASTTIME_FREQ_HZ / 10)
+    {
+        CoreSyncResult best{0, UINT32_MAX, false};
+        for (uint32_t i = 0; i < rounds; ++i)
+        {
+            const uint32_t request = 2 * i + 1;
+            const Timestamp t1 = Timestamp::now();
+            ch.seq.store(request, std::memory_order_release);
+            Timestamp t3 = t1;
+            while (ch.seq.load(std::memory_order_acquire) != request + 1)
+            {
+                t3 = Timestamp::now();
+                if (cycles_between(t1, t3) > timeout_cycles)
+                {
+                    return best;
+                }
+            }
+            t3 = Timestamp::now();
+            const fast_counter_t t2 = ch.t2.load(std::memory_order_relaxed);
+
+            const uint64_t rtt = cycles_between(t1, t3);
+            if (rtt < best.rtt)
+            {
+                const fast_counter_t mid = t1.ticks + (fast_counter_t)(rtt / 2);
+                best.offset = sizeof(fast_counter_t) == 4 ? int64_t(int32_t(t2 - mid))
+                                                          : int64_t(t2 - mid);
+                best.rtt = uint32_t(rtt);
+                best.valid = true;
+            }
+        }
+        return best;
+    }
+
+    /**
+     * @brief Measure every core's offset to the calling core.
+     *
+     * @param out    Receives offsets; the caller's core becomes the reference.
+     * @param rounds Exchanges per core (the minimum-RTT one is kept).
+     * @return false if some core could not be measured (its offset stays 0).
+     *
+     * @details
+     * - ESP32: spawns a short-lived responder task pinned to each other core. Call from a task
+     *   pinned to one core (Arduino's @c setup()/@c loop() are).
+     * - Linux host: pins an initiator thread to CPU 0 and a responder to each other CPU, so the
+     *   reference is CPU 0 regardless of the caller.
+     */
+    static inline bool calibrate_core_offsets(CoreClockOffsets &out, uint32_t rounds = 64)
+    {
+#if defined(FASTTIME_HOST) && defined(__linux__)
+        out.reset(0);
+        const uint32_t cpus = std::thread::hardware_concurrency();
+        const uint32_t n = cpus < FASTTIME_MAX_CORES ? cpus : FASTTIME_MAX_CORES;
+        bool ok = true;
+        for (uint32_t core = 1; core < n; ++core)
+        {
+            CoreSyncChannel ch;
+            CoreSyncResult r{0, 0, false};
+            auto pin = [](uint32_t cpu) {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(cpu, &set);
+                return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+            };
+            std::thread responder([&] {
+                if (pin(core))
+                {
+                    core_sync_respond(ch, rounds);
+                }
+            });
+            std::thread initiator([&] {
+                if (pin(0))
+                {
+                    r = core_sync_initiate(ch, rounds);
+                }
+            });
+            initiator.join();
+            ch.abort.store(true, std::memory_order_relaxed);
+            responder.join();
+            ok = ok && r.valid;
+            out.offset[core] = r.valid ? r.offset : 0;
+            out.rtt[core] = r.valid ? r.rtt : 0;
+        }
+        return ok;
+#elif defined(FASTTIME_HOST)
+        (void)rounds;
+        out.reset(0);
+        return true;
+#else
+        struct Job
+        {
+            CoreSyncChannel ch;
+            uint32_t rounds;
+            volatile bool done;
+        };
+        const uint32_t self = current_core();
+        out.reset(self);
+        bool ok = true;
+        for (uint32_t core = 0; core < FASTTIME_MAX_CORES; ++core)
+        {
+            if (core == self)
+            {
+                continue;
+            }
+            Job job;
+            job.rounds = rounds;
+            job.done = false;
+            TaskHandle_t handle = nullptr;
+            auto task = [](void *arg) {
+                Job *j = static_cast<Job *>(arg);
+                core_sync_respond(j->ch, j->rounds);
+                j->done = true;
+                vTaskDelete(nullptr);
+            };
+            if (xTaskCreatePinnedToCore(task, "fts_sync", 2048, &job, configMAX_PRIORITIES - 1,
+                                        &handle, core) != pdPASS)
+            {
+                ok = false;
+                continue;
+            }
+            const CoreSyncResult r = core_sync_initiate(job.ch, rounds);
+            job.ch.abort.store(true, std::memory_order_relaxed);
+            while (!job.done)
+            {
+                vTaskDelay(1);
+            }
+            ok = ok && r.valid;
+            out.offset[core] = r.valid ? r.offset : 0;
+            out.rtt[core] = r.valid ? r.rtt : 0;
+        }
+        return ok;
+#endif
+    }
+
+} // namespace fasttime
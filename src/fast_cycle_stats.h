@@ -0,0 +1,275 @@
+#pragma once
+#include <atomic>
+#include <stdint.h>
+
+#include "esp23_fast_timestamp.h"
+
+/**
+ * @file fast_cycle_stats.h
+ * @brief Online mean/variance/min/max of cycle deltas (Welford), mergeable and tear-free.
+ *
+ * @details
+ * - @ref CycleAccumulator: plain Welford state. Recording uses integer arithmetic only
+ *   (mean in Q16 fixed point, M2 in cycles²), so it needs no FPU and cannot overflow the way
+ *   a naive sum of squares does.
+ * - @ref CycleAccumulator::merge combines two accumulators with Chan's parallel formula, e.g.
+ *   one per core.
+ * - @ref CycleStats wraps an accumulator in a sequence lock so another task or core can take
+ *   a consistent @ref CycleStats::snapshot while the owner keeps recording.
+ *
+ * Conversion to time happens only on the read side through @ref UsConverter.
+ *
+ * @code
+ * static fasttime::CycleStats loop_stats;
+ * Timestamp t0 = Timestamp::now();
+ * work();
+ * loop_stats.record(cycles_between(t0, Timestamp::now()));
+ * // elsewhere:
+ * auto s = loop_stats.snapshot();
+ * Serial.printf("mean %llu us, sd %llu us\n", s.mean_us(cvt), s.stddev_us(cvt));
+ * @endcode
+ */
+
+namespace fasttime
+{
+
+    namespace detail
+    {
+        /**
+         * @brief Integer square root (floor) of a 64-bit value.
+         */
+        static inline uint64_t isqrt64(uint64_t v)
+        {
+            uint64_t r = 0;
+            uint64_t bit = uint64_t(1) << 62;
+            while (bit > v)
+            {
+                bit >>= 2;
+            }
+            while (bit != 0)
+            {
+                if (v >= r + bit)
+                {
+                    v -= r + bit;
+                    r = (r >> 1) + bit;
+                }
+                else
+                {
+                    r >>= 1;
+                }
+                bit >>= 2;
+            }
+            return r;
+        }
+
+        /**
+         * @brief Floor division of a signed 64-bit value by an unsigned 32-bit one.
+         *
+         * @details Uses a 32-bit divide when the operands fit (the common case for small
+         *          deviations); @p rem receives the non-negative remainder.
+         */
+        static inline FASTTIME_ALWAYS_INLINE int64_t floor_div(int64_t num, uint32_t den, uint32_t &rem)
+        {
+            int64_t q;
+            int64_t r;
+            if (num >= INT32_MIN && num <= INT32_MAX && den <= INT32_MAX)
+            {
+                q = (int32_t)num / (int32_t)den;
+                r = (int32_t)num % (int32_t)den;
+            }
+            else
+            {
+                q = num / (int64_t)den;
+                r = num % (int64_t)den;
+            }
+            if (r < 0)
+            {
+                q -= 1;
+                r += den;
+            }
+            rem = uint32_t(r);
+            return q;
+        }
+    } // namespace detail
+
+    /**
+     * @brief Welford accumulator for cycle deltas.
+     *
+     * @note Samples are clamped to 32 bits (~17.9 s @ 240 MHz), the natural range of the Xtensa
+     *       counter. M2 saturates instead of wrapping.
+     */
+    struct CycleAccumulator
+    {
+        uint32_t count; ///< Number of samples.
+        uint32_t min;   ///< Smallest sample (cycles).
+        uint32_t max;   ///< Largest sample (cycles).
+        int64_t mean;   ///< Running mean in Q16 cycles (floor).
+        uint32_t rem;   ///< Remainder of the mean division; keeps @ref mean exact over many samples.
+        uint64_t m2;    ///< Sum of squared deviations from the mean (cycles²).
+
+        /** @brief Clear all samples. */
+        inline void reset()
+        {
+            count = 0;
+            min = UINT32_MAX;
+            max = 0;
+            mean = 0;
+            rem = 0;
+            m2 = 0;
+        }
+
+        /**
+         * @brief Add one sample (integer-only Welford update).
+         */
+        FASTTIME_HOT inline void add(uint64_t cycles)
+        {
+            const uint32_t x = cycles > UINT32_MAX ? UINT32_MAX : uint32_t(cycles);
+            if (x < min)
+            {
+                min = x;
+            }
+            if (x > max)
+            {
+                max = x;
+            }
+            ++count;
+
+            const int64_t xq = int64_t(x) << 16;
+            const int64_t d1 = xq - mean;
+            // sum = mean * (count - 1) + rem, so the new mean is mean + floor((d1 + rem) / count).
+            mean += detail::floor_div(d1 + int64_t(rem), count, rem);
+            const int64_t d2 = xq - mean;
+
+            // d1 and d2 share a sign, so the product is non-negative.
+            const uint64_t a = uint64_t(d1 < 0 ? -d1 : d1);
+            const uint64_t b = uint64_t(d2 < 0 ? -d2 : d2);
+            uint64_t inc;
+            if ((a | b) < (uint64_t(1) << 32))
+            {
+                inc = (a * b + (uint64_t(1) << 31)) >> 32;
+            }
+            else if ((a | b) < (uint64_t(1) << 40))
+            {
+                inc = ((a >> 8) * (b >> 8) + (uint64_t(1) << 15)) >> 16;
+            }
+            else
+            {
+                inc = (a >> 16) * (b >> 16);
+            }
+            m2 = (m2 + inc < m2) ? UINT64_MAX : m2 + inc;
+        }
+
+        /**
+         * @brief Fold @p other into this accumulator (Chan et al. parallel update).
+         *
+         * @note Uses floating point; intended for the read side, not the recording path.
+         */
+        inline void merge(const CycleAccumulator &other)
+        {
+            if (other.count == 0)
+            {
+                return;
+            }
+            if (count == 0)
+            {
+                *this = other;
+                return;
+            }
+            const double na = count;
+            const double nb = other.count;
+            const double n = na + nb;
+            const double delta = double(other.mean - mean);
+            const double cross = (delta / 65536.0) * (delta / 65536.0) * na * nb / n;
+            const double total = double(m2) + double(other.m2) + cross;
+
+            mean += int64_t(delta * nb / n);
+            rem = 0;
+            m2 = total >= 18446744073709551615.0 ? UINT64_MAX : uint64_t(total);
+            count += other.count;
+            min = other.min < min ? other.min : min;
+            max = other.max > max ? other.max : max;
+        }
+
+        /** @brief Mean in whole cycles (rounded). */
+        inline uint64_t mean_cycles() const { return count ? uint64_t((mean + 0x8000) >> 16) : 0; }
+
+        /** @brief Sample variance in cycles² (0 for fewer than two samples). */
+        inline uint64_t variance_cycles() const { return count > 1 ? m2 / (count - 1) : 0; }
+
+        /** @brief Sample standard deviation in cycles. */
+        inline uint64_t stddev_cycles() const { return detail::isqrt64(variance_cycles()); }
+
+        inline uint64_t min_us(const UsConverter &cvt) const { return count ? cvt.to_us(min) : 0; }
+        inline uint64_t max_us(const UsConverter &cvt) const { return cvt.to_us(max); }
+        inline uint64_t mean_us(const UsConverter &cvt) const { return cvt.to_us(mean_cycles()); }
+        inline uint64_t stddev_us(const UsConverter &cvt) const { return cvt.to_us(stddev_cycles()); }
+    };
+
+    /**
+     * @brief Single-writer statistics with tear-free snapshots (sequence lock).
+     *
+     * @details
+     * The writer bumps a sequence counter to odd, updates the accumulator and bumps it back to
+     * even; readers copy the accumulator and retry if the sequence changed. Writers never wait.
+     *
+     * @warning Exactly one writer at a time. Use one instance per core/task when several
+     *          contexts record into the same zone, and @ref CycleAccumulator::merge on read.
+     * @warning Do not call @ref snapshot from an ISR that can preempt the writer on the same
+     *          core; it would spin until the interrupted @ref record completes.
+     */
+    class CycleStats
+    {
+    public:
+        CycleStats() { acc_.reset(); }
+
+        /**
+         * @brief Record one cycle delta.
+         */
+        FASTTIME_HOT inline void record(uint64_t cycles)
+        {
+            const uint32_t s = seq_.load(std::memory_order_relaxed);
+            seq_.store(s + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            acc_.add(cycles);
+            seq_.store(s + 2, std::memory_order_release);
+        }
+
+        /**
+         * @brief Clear all samples (writer side).
+         */
+        inline void reset()
+        {
+            const uint32_t s = seq_.load(std::memory_order_relaxed);
+            seq_.store(s + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            acc_.reset();
+            seq_.store(s + 2, std::memory_order_release);
+        }
+
+        /**
+         * @brief Consistent copy of the current state.
+         */
+        inline CycleAccumulator snapshot() const
+        {
+            for (;;)
+            {
+                const uint32_t s1 = seq_.load(std::memory_order_acquire);
+                if (s1 & 1u)
+                {
+                    continue;
+                }
+                CycleAccumulator copy = acc_;
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (seq_.load(std::memory_order_relaxed) == s1)
+                {
+                    return copy;
+                }
+            }
+        }
+
+    private:
+        std::atomic<uint32_t> seq_{0};
+        CycleAccumulator acc_;
+    };
+
+} // namespace fasttime
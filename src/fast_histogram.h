@@ -0,0 +1,179 @@
+#pragma once
+#include <atomic>
+#include <stdint.h>
+
+#include "esp23_fast_timestamp.h"
+
+/**
+ * @file fast_histogram.h
+ * @brief Log-linear cycle histogram for latency percentiles.
+ *
+ * @details
+ * Mean and standard deviation (@ref CycleAccumulator) hide tails. @ref CycleHistogram keeps
+ * counts in log-linear buckets, HDR style: every power of two is split into 2^SubBits linear
+ * sub-buckets, so the relative bucket width is bounded by 2^-SubBits (12.5 % with the default
+ * of 3) across the whole range while the table stays small (240 counters for 32-bit values).
+ *
+ * Recording is a count-leading-zeros, two shifts and one relaxed atomic increment, safe from
+ * any task, ISR or core without a lock. Reads are not an atomic cut; counts recorded during a
+ * read may or may not be included.
+ *
+ * @code
+ * static fasttime::CycleHistogram<> isr_latency;
+ * isr_latency.record(cycles_between(t_raise, Timestamp::now()));
+ * uint64_t p99 = isr_latency.percentile(99.0);
+ * @endcode
+ */
+
+namespace fasttime
+{
+
+    /**
+     * @brief Lock-free log-linear histogram of cycle values.
+     *
+     * @tparam SubBits Linear sub-buckets per power of two, as log2.
+     * @tparam MaxBits Values at or above 2^MaxBits are counted in the last bucket.
+     */
+    template <uint32_t SubBits = 3, uint32_t MaxBits = 32>
+    class CycleHistogram
+    {
+        static_assert(SubBits >= 1 && SubBits < MaxBits && MaxBits <= 64, "bad histogram shape");
+
+    public:
+        static constexpr uint32_t kSub = 1u << SubBits;
+        static constexpr uint32_t kBuckets = (MaxBits - SubBits + 1) * kSub;
+
+        /**
+         * @brief Count one value.
+         */
+        FASTTIME_ALWAYS_INLINE inline void record(uint64_t cycles)
+        {
+            counts_[bucket_of(cycles)].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /** @brief Same as @ref record, which is lock-free at any interrupt level. */
+        FASTTIME_ALWAYS_INLINE inline void record_from_isr(uint64_t cycles) { record(cycles); }
+
+        /**
+         * @brief Bucket index of @p cycles.
+         */
+        static inline FASTTIME_ALWAYS_INLINE uint32_t bucket_of(uint64_t cycles)
+        {
+            if (cycles < kSub)
+            {
+                return uint32_t(cycles);
+            }
+            const uint32_t msb = 63u - uint32_t(__builtin_clzll(cycles));
+            if (msb >= MaxBits)
+            {
+                return kBuckets - 1;
+            }
+            const uint32_t sub = uint32_t(cycles >> (msb - SubBits)) & (kSub - 1);
+            return (msb - SubBits + 1) * kSub + sub;
+        }
+
+        /**
+         * @brief Smallest value that falls into @p bucket.
+         */
+        static inline uint64_t bucket_lower(uint32_t bucket)
+        {
+            if (bucket < kSub)
+            {
+                return bucket;
+            }
+            const uint32_t msb = bucket / kSub + SubBits - 1;
+            return (uint64_t(kSub) | (bucket & (kSub - 1))) << (msb - SubBits);
+        }
+
+        /**
+         * @brief One past the largest value that falls into @p bucket.
+         */
+        static inline uint64_t bucket_upper(uint32_t bucket)
+        {
+            return bucket + 1 < kBuckets ? bucket_lower(bucket + 1) : UINT64_MAX;
+        }
+
+        /** @brief Count in @p bucket. */
+        inline uint32_t bucket_count(uint32_t bucket) const
+        {
+            return counts_[bucket].load(std::memory_order_relaxed);
+        }
+
+        /** @brief Total number of recorded values. */
+        inline uint64_t count() const
+        {
+            uint64_t n = 0;
+            for (uint32_t i = 0; i < kBuckets; ++i)
+            {
+                n += counts_[i].load(std::memory_order_relaxed);
+            }
+            return n;
+        }
+
+        /**
+         * @brief Value below which @p pct percent of the recorded values fall.
+         *
+         * @return Midpoint of the bucket holding that rank (exact below 2^SubBits), 0 if empty.
+         */
+        uint64_t percentile(double pct) const
+        {
+            uint32_t snap[kBuckets];
+            uint64_t n = 0;
+            for (uint32_t i = 0; i < kBuckets; ++i)
+            {
+                snap[i] = counts_[i].load(std::memory_order_relaxed);
+                n += snap[i];
+            }
+            if (n == 0)
+            {
+                return 0;
+            }
+            const double clamped = pct < 0 ? 0 : (pct > 100 ? 100 : pct);
+            uint64_t rank = uint64_t(clamped / 100.0 * double(n) + 0.5);
+            rank = rank == 0 ? 1 : (rank > n ? n : rank);
+            uint64_t seen = 0;
+            uint32_t i = 0;
+            for (; i < kBuckets; ++i)
+            {
+                seen += snap[i];
+                if (seen >= rank)
+                {
+                    break;
+                }
+            }
+            const uint64_t lo = bucket_lower(i);
+            if (i < kSub)
+            {
+                return lo;
+            }
+            return i + 1 < kBuckets ? lo + (bucket_upper(i) - lo) / 2 : lo;
+        }
+
+        /**
+         * @brief Add another histogram's counts into this one.
+         */
+        inline void merge(const CycleHistogram &other)
+        {
+            for (uint32_t i = 0; i < kBuckets; ++i)
+            {
+                counts_[i].fetch_add(other.counts_[i].load(std::memory_order_relaxed),
+                                     std::memory_order_relaxed);
+            }
+        }
+
+        /**
+         * @brief Zero every bucket.
+         */
+        inline void reset()
+        {
+            for (uint32_t i = 0; i < kBuckets; ++i)
+            {
+                counts_[i].store(0, std::memory_order_relaxed);
+            }
+        }
+
+    private:
+        std::atomic<uint32_t> counts_[kBuckets] = {};
+    };
+
+} // namespace fasttime
@@ -0,0 +1,374 @@
+#pragma once
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "esp23_fast_timestamp.h"
+#include "fast_core_local.h"
+#include "fast_registry.h"
+
+#if defined(FASTTIME_HOST) && defined(__linux__)
+#include <dlfcn.h>
+#include <elf.h>
+#include <link.h>
+#elif !defined(FASTTIME_HOST) && defined(__has_include)
+#if __has_include(<esp_memory_utils.h>)
+#include <esp_memory_utils.h>
+#elif __has_include(<soc/soc_memory_layout.h>)
+#include <soc/soc_memory_layout.h>
+#endif
+#endif
+
+/**
+ * @file fast_iram_advisor.h
+ * @brief Cold vs. warm cache timing of registered zones to pick @c IRAM_ATTR candidates.
+ *
+ * @details
+ * Code executed from flash on ESP32 runs through a small cache; the first call after an
+ * eviction stalls for every missed line. @ref IramCandidate pairs a @ref ProfileZone with a
+ * function that exercises it. @ref iram_advise runs each candidate repeatedly in two modes:
+ * - cold: the instruction cache is invalidated right before the call,
+ * - warm: the call directly follows an identical call.
+ *
+ * The miss penalty is median(cold) - median(warm) cycles. Candidates are ranked by penalty
+ * times the zone's recorded call count (its field weight; 1 if the zone never ran), and
+ * those still in flash whose penalty exceeds the threshold are reported as @c IRAM_ATTR
+ * candidates.
+ *
+ * Cache invalidation (@ref iram_advisor_invalidate), overridable with
+ * @c FASTTIME_CACHE_INVALIDATE():
+ * - ESP32: @c Cache_Read_Disable / @c Cache_Flush / @c Cache_Read_Enable of the calling CPU,
+ *   from IRAM with interrupts masked.
+ * - ESP32-S2/S3/C3: @c Cache_Invalidate_ICache_All.
+ * - Host (x86, AArch64): @c clflush / @c dc civac over the candidate's code range (symbol size
+ *   from @c dladdr1 when exported, else @c code_size or 4 KiB), emulating a cold flash cache
+ *   closely enough to validate the ranking.
+ * - Other targets: no invalidation; cold runs only see whatever the other candidates evicted.
+ *
+ * @code
+ * static fasttime::ProfileZone crc_zone("crc32");
+ * static fasttime::IramCandidate crc_probe(crc_zone, [](void *) { crc32(buf, sizeof(buf)); },
+ *                                          nullptr, (const void *)&crc32);
+ * // console command:
+ * fasttime::iram_advise(line_sink, ctx);
+ * @endcode
+ *
+ * @warning The run functions execute with interrupts enabled but right after a cache flush:
+ *          run the advisor from a quiet system (no timing-critical work on the same core).
+ */
+
+#if !defined(FASTTIME_HOST) && !defined(FASTTIME_CACHE_INVALIDATE)
+#if defined(CONFIG_IDF_TARGET_ESP32)
+extern "C" void Cache_Read_Disable(int cpu_no);
+extern "C" void Cache_Read_Enable(int cpu_no);
+extern "C" void Cache_Flush(int cpu_no);
+#elif defined(CONFIG_IDF_TARGET_ESP32S2) || defined(CONFIG_IDF_TARGET_ESP32S3) || \
+    defined(CONFIG_IDF_TARGET_ESP32C3)
+extern "C" void Cache_Invalidate_ICache_All(void);
+#endif
+#endif
+
+namespace fasttime
+{
+
+    class IramCandidate;
+
+    namespace detail
+    {
+        inline std::atomic<IramCandidate *> iram_candidate_head{nullptr};
+    } // namespace detail
+
+    /**
+     * @brief A zone plus the function that exercises it, examined by @ref iram_advise.
+     */
+    class IramCandidate
+    {
+    public:
+        /**
+         * @param zone      Zone being examined (name and field call count).
+         * @param fn        Exercises the zone once.
+         * @param ctx       Passed to @p fn.
+         * @param code      Function whose placement is in question (default: @p fn).
+         * @param code_size Bytes of @p code to flush on host (0: symbol size or 4 KiB).
+         */
+        IramCandidate(const ProfileZone &zone, void (*fn)(void *), void *ctx = nullptr,
+                      const void *code = nullptr, size_t code_size = 0)
+            : zone_(zone), run_(fn), ctx_(ctx),
+              code_(code ? code : reinterpret_cast<const void *>(fn)), code_size_(code_size)
+        {
+            IramCandidate *head = detail::iram_candidate_head.load(std::memory_order_relaxed);
+            do
+            {
+                next_ = head;
+            } while (!detail::iram_candidate_head.compare_exchange_weak(
+                head, this, std::memory_order_release, std::memory_order_relaxed));
+        }
+
+        IramCandidate(const IramCandidate &) = delete;
+        IramCandidate &operator=(const IramCandidate &) = delete;
+
+        inline const ProfileZone &zone() const { return zone_; }
+        inline const void *code() const { return code_; }
+        inline size_t code_size() const { return code_size_; }
+        inline const IramCandidate *next() const { return next_; }
+        inline void run() const { run_(ctx_); }
+
+        /** @brief Most recently constructed candidate. */
+        static inline const IramCandidate *first()
+        {
+            return detail::iram_candidate_head.load(std::memory_order_acquire);
+        }
+
+    private:
+        const ProfileZone &zone_;
+        void (*run_)(void *);
+        void *ctx_;
+        const void *code_;
+        size_t code_size_;
+        IramCandidate *next_ = nullptr;
+    };
+
+    /**
+     * @brief Measurement of one candidate.
+     */
+    struct IramAdvice
+    {
+        const IramCandidate *candidate;
+        uint64_t cold_cycles;    ///< Median with the cache invalidated.
+        uint64_t warm_cycles;    ///< Median with the cache warm.
+        uint64_t penalty_cycles; ///< cold - warm (0 if warm was slower).
+        uint64_t calls;          ///< Zone call count at the time of the run.
+        bool in_iram;            ///< Code already executes from internal RAM.
+
+        /** @brief Ranking weight: penalty times field calls. */
+        inline uint64_t weight() const { return penalty_cycles * (calls ? calls : 1); }
+    };
+
+    /**
+     * @brief Whether @ref iram_advisor_invalidate can invalidate on this platform.
+     *
+     * @remarks Compile-time only; unlike calling the invalidation it never touches the cache.
+     */
+    static constexpr bool iram_advisor_can_invalidate()
+    {
+#if defined(FASTTIME_CACHE_INVALIDATE) ||                                                           \
+    (defined(FASTTIME_HOST) && (defined(__x86_64__) || defined(__i386__) || defined(__aarch64__))) || \
+    (!defined(FASTTIME_HOST) &&                                                                     \
+     (defined(CONFIG_IDF_TARGET_ESP32) || defined(CONFIG_IDF_TARGET_ESP32S2) ||                     \
+      defined(CONFIG_IDF_TARGET_ESP32S3) || defined(CONFIG_IDF_TARGET_ESP32C3)))
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /**
+     * @brief Invalidate the instruction cache (or, on host, the lines of [@p code, +@p len)).
+     *
+     * @return false if this platform has no way to invalidate.
+     *
+     * @remarks Never inlined: on ESP32 it must execute from IRAM while the cache is off.
+     */
+    static inline __attribute__((noinline)) FASTTIME_HOT bool
+    iram_advisor_invalidate(const void *code, size_t len)
+    {
+#if defined(FASTTIME_CACHE_INVALIDATE)
+        (void)code;
+        (void)len;
+        FASTTIME_CACHE_INVALIDATE();
+        return true;
+#elif defined(FASTTIME_HOST) && (defined(__x86_64__) || defined(__i386__) || defined(__aarch64__))
+        const uintptr_t begin = reinterpret_cast<uintptr_t>(code) & ~uintptr_t(63);
+        const uintptr_t end = reinterpret_cast<uintptr_t>(code) + len;
+        for (uintptr_t p = begin; p < end; p += 64)
+        {
+#if defined(__aarch64__)
+            asm volatile("dc civac, %0" : : "r"(p) : "memory");
+#else
+            __builtin_ia32_clflush(reinterpret_cast<const void *>(p));
+#endif
+        }
+#if defined(__aarch64__)
+        asm volatile("dsb ish; isb" : : : "memory");
+#else
+        asm volatile("mfence" : : : "memory");
+#endif
+        return true;
+#elif !defined(FASTTIME_HOST) && defined(CONFIG_IDF_TARGET_ESP32)
+        (void)code;
+        (void)len;
+        ShardLock irq;
+        const uint32_t state = irq.enter();
+        const int cpu = int(current_core());
+        Cache_Read_Disable(cpu);
+        Cache_Flush(cpu);
+        Cache_Read_Enable(cpu);
+        irq.exit(state);
+        return true;
+#elif !defined(FASTTIME_HOST) && (defined(CONFIG_IDF_TARGET_ESP32S2) || \
+                                  defined(CONFIG_IDF_TARGET_ESP32S3) || defined(CONFIG_IDF_TARGET_ESP32C3))
+        (void)code;
+        (void)len;
+        ShardLock irq;
+        const uint32_t state = irq.enter();
+        Cache_Invalidate_ICache_All();
+        irq.exit(state);
+        return true;
+#else
+        (void)code;
+        (void)len;
+        return false;
+#endif
+    }
+
+    namespace detail
+    {
+        static inline uint64_t median_inplace(uint64_t *v, uint32_t n)
+        {
+            for (uint32_t i = 1; i < n; ++i)
+            {
+                const uint64_t x = v[i];
+                uint32_t j = i;
+                for (; j > 0 && v[j - 1] > x; --j)
+                {
+                    v[j] = v[j - 1];
+                }
+                v[j] = x;
+            }
+            return n ? v[n / 2] : 0;
+        }
+
+        static inline size_t iram_code_size(const IramCandidate &c)
+        {
+            if (c.code_size())
+            {
+                return c.code_size();
+            }
+#if defined(FASTTIME_HOST) && defined(__linux__)
+            Dl_info info;
+            const ElfW(Sym) *sym = nullptr;
+            if (dladdr1(c.code(), &info, reinterpret_cast<void **>(const_cast<ElfW(Sym) **>(&sym)), RTLD_DL_SYMENT) && sym &&
+                sym->st_size)
+            {
+                return size_t(sym->st_size);
+            }
+#endif
+            return 4096;
+        }
+
+        static inline bool iram_contains(const void *code)
+        {
+#if !defined(FASTTIME_HOST) && defined(SOC_IRAM_LOW) && defined(SOC_IRAM_HIGH)
+            const uintptr_t p = reinterpret_cast<uintptr_t>(code);
+            return p >= SOC_IRAM_LOW && p < SOC_IRAM_HIGH;
+#else
+            (void)code;
+            return false;
+#endif
+        }
+    } // namespace detail
+
+    /**
+     * @brief Measure one candidate with @p runs cold and @p runs warm calls (at most 31).
+     */
+    static inline IramAdvice iram_measure(const IramCandidate &c, uint32_t runs = 15)
+    {
+        uint64_t cold[31], warm[31];
+        runs = runs == 0 ? 1 : (runs > 31 ? 31 : runs);
+        const size_t len = detail::iram_code_size(c);
+        for (uint32_t i = 0; i < runs; ++i)
+        {
+            iram_advisor_invalidate(c.code(), len);
+            Timestamp t0 = Timestamp::now();
+            c.run();
+            cold[i] = cycles_between(t0, Timestamp::now());
+
+            c.run();
+            t0 = Timestamp::now();
+            c.run();
+            warm[i] = cycles_between(t0, Timestamp::now());
+        }
+        IramAdvice a;
+        a.candidate = &c;
+        a.cold_cycles = detail::median_inplace(cold, runs);
+        a.warm_cycles = detail::median_inplace(warm, runs);
+        a.penalty_cycles = a.cold_cycles > a.warm_cycles ? a.cold_cycles - a.warm_cycles : 0;
+        a.calls = c.zone().snapshot().count;
+        a.in_iram = detail::iram_contains(c.code());
+        return a;
+    }
+
+    /**
+     * @brief Measure every candidate, heaviest weight first.
+     *
+     * @return Entries written (at most @p max).
+     */
+    static inline uint32_t iram_rank(IramAdvice *out, uint32_t max, uint32_t runs = 15)
+    {
+        if (max == 0)
+        {
+            return 0;
+        }
+        uint32_t n = 0;
+        for (const IramCandidate *c = IramCandidate::first(); c; c = c->next())
+        {
+            const IramAdvice a = iram_measure(*c, runs);
+            if (n < max)
+            {
+                ++n;
+            }
+            else if (a.weight() <= out[n - 1].weight())
+            {
+                continue;
+            }
+            uint32_t j = n - 1;
+            for (; j > 0 && out[j - 1].weight() < a.weight(); --j)
+            {
+                out[j] = out[j - 1];
+            }
+            out[j] = a;
+        }
+        return n;
+    }
+
+    /**
+     * @brief Run the advisor and print the ranking plus @c IRAM_ATTR candidates into @p sink.
+     *
+     * @param min_penalty Cycles of penalty below which a function is not worth IRAM.
+     */
+    static inline void iram_advise(LineSink sink, void *ctx, uint32_t runs = 15,
+                                   uint64_t min_penalty = 200,
+                                   const NsConverter &cvt = NsConverter::make())
+    {
+        IramAdvice advice[32];
+        const uint32_t n = iram_rank(advice, 32, runs);
+        char line[192];
+        snprintf(line, sizeof(line), "iram advisor: %u candidates, invalidation %s", n,
+                 iram_advisor_can_invalidate() ? "on" : "unavailable");
+        sink(ctx, line);
+        for (uint32_t i = 0; i < n; ++i)
+        {
+            const IramAdvice &a = advice[i];
+            snprintf(line, sizeof(line),
+                     "  %-24s cold=%llu warm=%llu penalty=%llu cycles (%llu ns) calls=%llu %p%s",
+                     a.candidate->zone().name, (unsigned long long)a.cold_cycles,
+                     (unsigned long long)a.warm_cycles, (unsigned long long)a.penalty_cycles,
+                     (unsigned long long)cvt.to_ns(a.penalty_cycles), (unsigned long long)a.calls,
+                     a.candidate->code(), a.in_iram ? " [iram]" : "");
+            sink(ctx, line);
+        }
+        for (uint32_t i = 0; i < n; ++i)
+        {
+            const IramAdvice &a = advice[i];
+            if (!a.in_iram && a.penalty_cycles >= min_penalty)
+            {
+                snprintf(line, sizeof(line), "IRAM_ATTR candidate: %s (code %p, %llu cycles per cold call)",
+                         a.candidate->zone().name, a.candidate->code(),
+                         (unsigned long long)a.penalty_cycles);
+                sink(ctx, line);
+            }
+        }
+    }
+
+} // namespace fasttime
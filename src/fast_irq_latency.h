@@ -0,0 +1,312 @@
+#pragma once
+#include <atomic>
+#include <stdint.h>
+
+#include "esp23_fast_timestamp.h"
+#include "fast_core_local.h"
+#include "fast_core_sync.h"
+#include "fast_histogram.h"
+
+#if defined(FASTTIME_HOST) && defined(__linux__)
+#include <sched.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#endif
+
+/**
+ * @file fast_irq_latency.h
+ * @brief Interrupt latency probe: hardware trigger → ISR entry, per interrupt source.
+ *
+ * @details
+ * The code that raises an event (a GPIO write looped back to an input, a software interrupt,
+ * an alarm programmed for a known cycle count) stamps it with @ref IrqLatencyProbe::trigger,
+ * and the ISR calls @ref IrqLatencyProbe::isr_enter as its first statement. The difference is
+ * recorded into one @ref CycleHistogram per source.
+ *
+ * The trigger and the ISR may run on different cores. Both stamps carry their core
+ * (@ref CoreTimestamp); with @ref CoreClockOffsets from @ref calibrate_core_offsets they are
+ * compared on the reference counter. Without offsets a cross-core pair is only counted, since
+ * per-core counters on ESP32 are not aligned (host TSCs are treated as synchronized).
+ *
+ * On Linux, @ref HostIrqTimer emulates the hardware with a POSIX timer delivering a real-time
+ * signal (@c timer_create + @c SIGRTMIN), so the pipeline can be exercised without a board.
+ *
+ * @code
+ * static fasttime::IrqLatencyProbe<> probe;
+ *
+ * void IRAM_ATTR on_edge() { probe.isr_enter(0); ... }
+ *
+ * probe.trigger(0);
+ * digitalWrite(LOOPBACK_PIN, HIGH);
+ * ...
+ * uint64_t p99 = probe.histogram(0).percentile(99.0);
+ * @endcode
+ *
+ * @note The trigger stamp is taken before the write, so the result includes the write itself
+ *       (a few cycles for a GPIO register store).
+ */
+
+namespace fasttime
+{
+
+    /**
+     * @brief Trigger→ISR latency histograms for up to @p Sources interrupt sources.
+     *
+     * @details One outstanding trigger per source. A trigger that is never handled is
+     *          overwritten by the next one and counted as lost; an ISR entry without a
+     *          pending trigger is counted as spurious.
+     */
+    template <uint32_t Sources = 8>
+    class IrqLatencyProbe
+    {
+        static_assert(Sources > 0, "need at least one source");
+
+    public:
+        /**
+         * @brief Use @p offsets to compare stamps taken on different cores (nullptr: none).
+         *
+         * @warning The offsets must outlive the probe.
+         */
+        inline void set_offsets(const CoreClockOffsets *offsets) { offsets_ = offsets; }
+
+        /**
+         * @brief Stamp the trigger of @p source; call immediately before raising it.
+         */
+        FASTTIME_ALWAYS_INLINE inline void trigger(uint32_t source) { trigger_at(source, CoreTimestamp::now()); }
+
+        /**
+         * @brief Record a trigger at a known time (e.g. the cycle count an alarm was set for).
+         */
+        FASTTIME_ALWAYS_INLINE inline void trigger_at(uint32_t source, const CoreTimestamp at)
+        {
+            Source &s = sources_[source % Sources];
+            if (s.pending.exchange(0, std::memory_order_acquire))
+            {
+                s.lost.fetch_add(1, std::memory_order_relaxed);
+            }
+            s.armed = at;
+            s.pending.store(1, std::memory_order_release);
+        }
+
+        /**
+         * @brief Stamp ISR entry for @p source and record the latency.
+         *
+         * @remarks Lock-free at any interrupt level; call first thing in the handler.
+         */
+        FASTTIME_ALWAYS_INLINE inline void isr_enter(uint32_t source)
+        {
+            const CoreTimestamp now = CoreTimestamp::now();
+            Source &s = sources_[source % Sources];
+            if (!s.pending.exchange(0, std::memory_order_acquire))
+            {
+                s.spurious.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            const CoreTimestamp at = s.armed;
+            Timestamp a = at.ts;
+            Timestamp b = now.ts;
+            if (offsets_)
+            {
+                a = at.on_reference(*offsets_);
+                b = now.on_reference(*offsets_);
+            }
+#if !defined(FASTTIME_HOST)
+            else if (at.core != now.core)
+            {
+                s.cross_core.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+#endif
+            if (before(b, a))
+            {
+                // Alarm fired ahead of the expected count, or offset error.
+                s.early.fetch_add(1, std::memory_order_relaxed);
+                s.hist.record(0);
+                return;
+            }
+            s.hist.record(cycles_between(a, b));
+        }
+
+        /** @brief Latency histogram of @p source (cycles). */
+        inline const CycleHistogram<> &histogram(uint32_t source) const
+        {
+            return sources_[source % Sources].hist;
+        }
+
+        /** @brief ISR entries without a pending trigger. */
+        inline uint32_t spurious(uint32_t source) const
+        {
+            return sources_[source % Sources].spurious.load(std::memory_order_relaxed);
+        }
+
+        /** @brief Triggers overwritten before their ISR ran. */
+        inline uint32_t lost(uint32_t source) const
+        {
+            return sources_[source % Sources].lost.load(std::memory_order_relaxed);
+        }
+
+        /** @brief ISR entries that appeared to precede their trigger (recorded as 0). */
+        inline uint32_t early(uint32_t source) const
+        {
+            return sources_[source % Sources].early.load(std::memory_order_relaxed);
+        }
+
+        /** @brief Cross-core pairs skipped because no offsets were set. */
+        inline uint32_t cross_core(uint32_t source) const
+        {
+            return sources_[source % Sources].cross_core.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Clear every source.
+         *
+         * @warning Call while no triggers are outstanding.
+         */
+        inline void reset()
+        {
+            for (uint32_t i = 0; i < Sources; ++i)
+            {
+                Source &s = sources_[i];
+                s.pending.store(0, std::memory_order_relaxed);
+                s.spurious.store(0, std::memory_order_relaxed);
+                s.lost.store(0, std::memory_order_relaxed);
+                s.early.store(0, std::memory_order_relaxed);
+                s.cross_core.store(0, std::memory_order_relaxed);
+                s.hist.reset();
+            }
+        }
+
+        static constexpr uint32_t sources() { return Sources; }
+
+    private:
+        struct alignas(FASTTIME_CACHELINE) Source
+        {
+            std::atomic<uint32_t> pending{0};
+            CoreTimestamp armed{Timestamp{0}, 0};
+            std::atomic<uint32_t> spurious{0};
+            std::atomic<uint32_t> lost{0};
+            std::atomic<uint32_t> early{0};
+            std::atomic<uint32_t> cross_core{0};
+            CycleHistogram<> hist;
+        };
+
+        const CoreClockOffsets *offsets_ = nullptr;
+        Source sources_[Sources];
+    };
+
+#if defined(FASTTIME_HOST) && defined(__linux__)
+    // ----------------------------------------------------------------------------
+    // Host emulation: POSIX timer + real-time signal
+    // ----------------------------------------------------------------------------
+
+    /**
+     * @brief Emulated interrupt source: a one-shot POSIX timer whose signal handler is the ISR.
+     *
+     * @details @ref fire stamps the trigger and arms the timer with the shortest expiry; the
+     *          kernel delivers @c signo to the process and the handler calls
+     *          @ref IrqLatencyProbe::isr_enter. The measured latency is timer programming plus
+     *          signal delivery, the host analogue of register write plus interrupt dispatch.
+     *
+     * @note Link with @c -lrt on glibc older than 2.17.
+     */
+    template <typename Probe>
+    class HostIrqTimer
+    {
+    public:
+        HostIrqTimer(Probe &probe, uint32_t source) : probe_(probe), source_(source) {}
+
+        ~HostIrqTimer() { stop(); }
+
+        HostIrqTimer(const HostIrqTimer &) = delete;
+        HostIrqTimer &operator=(const HostIrqTimer &) = delete;
+
+        /**
+         * @brief Install the handler for @p signo and create the timer.
+         *
+         * @param signo Signal to use; defaults to @c SIGRTMIN.
+         */
+        bool start(int signo = -1)
+        {
+            signo_ = signo < 0 ? SIGRTMIN : signo;
+            struct sigaction sa;
+            memset(&sa, 0, sizeof(sa));
+            sa.sa_sigaction = &HostIrqTimer::on_signal;
+            sa.sa_flags = SA_SIGINFO | SA_RESTART;
+            sigemptyset(&sa.sa_mask);
+            if (sigaction(signo_, &sa, nullptr) != 0)
+            {
+                return false;
+            }
+            struct sigevent sev;
+            memset(&sev, 0, sizeof(sev));
+            sev.sigev_notify = SIGEV_SIGNAL;
+            sev.sigev_signo = signo_;
+            sev.sigev_value.sival_ptr = this;
+            started_ = timer_create(CLOCK_MONOTONIC, &sev, &timer_) == 0;
+            return started_;
+        }
+
+        /**
+         * @brief Raise the emulated interrupt once.
+         */
+        bool fire()
+        {
+            struct itimerspec its;
+            memset(&its, 0, sizeof(its));
+            its.it_value.tv_nsec = 1;
+            probe_.trigger(source_);
+            return timer_settime(timer_, 0, &its, nullptr) == 0;
+        }
+
+        /**
+         * @brief Raise the interrupt and spin until its handler has run.
+         */
+        bool fire_and_wait()
+        {
+            const uint32_t before = handled_.load(std::memory_order_acquire);
+            if (!fire())
+            {
+                return false;
+            }
+            while (handled_.load(std::memory_order_acquire) == before)
+            {
+                sched_yield();
+            }
+            return true;
+        }
+
+        /** @brief Number of handler invocations. */
+        inline uint32_t handled() const { return handled_.load(std::memory_order_relaxed); }
+
+        /** @brief Delete the timer (the signal disposition is left installed). */
+        void stop()
+        {
+            if (started_)
+            {
+                timer_delete(timer_);
+                started_ = false;
+            }
+        }
+
+    private:
+        static void on_signal(int, siginfo_t *info, void *)
+        {
+            HostIrqTimer *self = static_cast<HostIrqTimer *>(info->si_value.sival_ptr);
+            if (self)
+            {
+                self->probe_.isr_enter(self->source_);
+                self->handled_.fetch_add(1, std::memory_order_release);
+            }
+        }
+
+        Probe &probe_;
+        uint32_t source_;
+        int signo_ = 0;
+        bool started_ = false;
+        timer_t timer_{};
+        std::atomic<uint32_t> handled_{0};
+    };
+#endif
+
+} // namespace fasttime
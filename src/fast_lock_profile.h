@@ -0,0 +1,406 @@
+#pragma once
+#include <atomic>
+#include <stdint.h>
+#include <stdio.h>
+#include <type_traits>
+
+#include "esp23_fast_timestamp.h"
+#include "fast_histogram.h"
+
+#if defined(FASTTIME_HOST)
+#include <mutex>
+#include <pthread.h>
+#else
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#endif
+
+/**
+ * @file fast_lock_profile.h
+ * @brief Wait and hold time profiling for mutexes and spinlocks, with top holders by call site.
+ *
+ * @details
+ * @ref InstrumentedLock wraps a lock (a @ref FreeRtosMutex, @ref PortMuxLock, @ref StdMutex or
+ * @ref PthreadSpinLock adapter) and keeps a @ref LockProfile:
+ * - acquire wait: counter read before the attempt to counter read after acquisition,
+ * - hold: acquisition to release,
+ * - per call site (return address of @c lock()) hold totals, keeping the @p TopSites heaviest.
+ *
+ * Cost: an uncontended @c lock() takes one counter read (a successful @c try_lock fast path
+ * records zero wait and reuses that read as the hold start), a contended one two; @c unlock()
+ * takes one. Every statistic is updated while the lock is still held, so the lock itself
+ * serializes the writers.
+ *
+ * @code
+ * static fasttime::InstrumentedLock<fasttime::FreeRtosMutex> spi_bus;
+ * {
+ *     std::lock_guard<decltype(spi_bus)> guard(spi_bus);   // or spi_bus.lock() / unlock()
+ *     spi_transfer();
+ * }
+ * spi_bus.profile().dump(line_sink, ctx);
+ * @endcode
+ *
+ * @note Call sites are code addresses; symbolize with @c addr2line -e firmware.elf.
+ */
+
+namespace fasttime
+{
+
+    /**
+     * @brief Hold statistics of one call site.
+     */
+    struct LockSite
+    {
+        const void *site;    ///< Return address of the @c lock() call.
+        uint32_t count;      ///< Acquisitions from this site.
+        uint64_t hold_total; ///< Cycles held in total.
+        uint64_t hold_max;   ///< Longest single hold.
+    };
+
+    /**
+     * @brief Statistics of one lock.
+     *
+     * @tparam TopSites Call sites tracked; when full, a new site replaces the lightest one.
+     */
+    template <uint32_t TopSites = 8>
+    class LockProfile
+    {
+    public:
+        /** @brief Acquire wait times (cycles). */
+        inline const CycleHistogram<> &wait() const { return wait_; }
+
+        /** @brief Hold times (cycles). */
+        inline const CycleHistogram<> &hold() const { return hold_; }
+
+        /**
+         * @brief Acquisitions that had to wait.
+         *
+         * @remarks Stays 0 for adapters without a real @c try_lock (@c kTryLock false); the
+         *          @ref wait histogram still has their waits.
+         */
+        inline uint32_t contended() const { return contended_.load(std::memory_order_relaxed); }
+
+        /**
+         * @brief Copy the tracked sites, heaviest total hold first.
+         * @return Number of sites written (at most @p max).
+         */
+        uint32_t top_holders(LockSite *out, uint32_t max) const
+        {
+            LockSite copy[TopSites];
+            uint32_t n = 0;
+            for (uint32_t i = 0; i < TopSites; ++i)
+            {
+                if (sites_[i].site)
+                {
+                    copy[n++] = sites_[i];
+                }
+            }
+            // Insertion sort; TopSites is small.
+            for (uint32_t i = 1; i < n; ++i)
+            {
+                const LockSite v = copy[i];
+                uint32_t j = i;
+                for (; j > 0 && copy[j - 1].hold_total < v.hold_total; --j)
+                {
+                    copy[j] = copy[j - 1];
+                }
+                copy[j] = v;
+            }
+            n = n < max ? n : max;
+            for (uint32_t i = 0; i < n; ++i)
+            {
+                out[i] = copy[i];
+            }
+            return n;
+        }
+
+        /**
+         * @brief One summary line plus one line per top holder into @p sink.
+         */
+        void dump(void (*sink)(void *ctx, const char *line), void *ctx, const char *name,
+                  const NsConverter &cvt = NsConverter::make()) const
+        {
+            char line[160];
+            snprintf(line, sizeof(line),
+                     "lock %s: n=%llu contended=%u wait p50/p99=%llu/%llu ns hold p50/p99=%llu/%llu ns",
+                     name, (unsigned long long)hold_.count(), contended(),
+                     (unsigned long long)cvt.to_ns(wait_.percentile(50.0)),
+                     (unsigned long long)cvt.to_ns(wait_.percentile(99.0)),
+                     (unsigned long long)cvt.to_ns(hold_.percentile(50.0)),
+                     (unsigned long long)cvt.to_ns(hold_.percentile(99.0)));
+            sink(ctx, line);
+            LockSite top[TopSites];
+            const uint32_t n = top_holders(top, TopSites);
+            for (uint32_t i = 0; i < n; ++i)
+            {
+                snprintf(line, sizeof(line), "  site %p: n=%u total=%llu ns max=%llu ns", top[i].site,
+                         top[i].count, (unsigned long long)cvt.to_ns(top[i].hold_total),
+                         (unsigned long long)cvt.to_ns(top[i].hold_max));
+                sink(ctx, line);
+            }
+        }
+
+        /**
+         * @brief Clear all statistics.
+         *
+         * @warning Call while holding the lock (or while it is idle).
+         */
+        void reset()
+        {
+            wait_.reset();
+            hold_.reset();
+            contended_.store(0, std::memory_order_relaxed);
+            for (uint32_t i = 0; i < TopSites; ++i)
+            {
+                sites_[i] = LockSite{nullptr, 0, 0, 0};
+            }
+        }
+
+        /// @cond internal
+        FASTTIME_ALWAYS_INLINE inline void on_acquired(uint64_t wait_cycles, bool contended)
+        {
+            wait_.record(wait_cycles);
+            if (contended)
+            {
+                contended_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        FASTTIME_ALWAYS_INLINE inline void on_release(const void *site, uint64_t hold_cycles)
+        {
+            hold_.record(hold_cycles);
+            uint32_t lightest = 0;
+            for (uint32_t i = 0; i < TopSites; ++i)
+            {
+                LockSite &s = sites_[i];
+                if (s.site == site)
+                {
+                    ++s.count;
+                    s.hold_total += hold_cycles;
+                    s.hold_max = hold_cycles > s.hold_max ? hold_cycles : s.hold_max;
+                    return;
+                }
+                if (!s.site)
+                {
+                    // Slots fill in order: no match beyond the first free one.
+                    lightest = i;
+                    break;
+                }
+                if (s.hold_total < sites_[lightest].hold_total)
+                {
+                    lightest = i;
+                }
+            }
+            // Space-saving replacement: the newcomer inherits the evicted total so heavy
+            // sites that arrive late can still climb.
+            LockSite &s = sites_[lightest];
+            s.site = site;
+            s.count = 1;
+            s.hold_total += hold_cycles;
+            s.hold_max = hold_cycles;
+        }
+        /// @endcond
+
+    private:
+        CycleHistogram<> wait_;
+        CycleHistogram<> hold_;
+        std::atomic<uint32_t> contended_{0};
+        LockSite sites_[TopSites] = {};
+    };
+
+    /// @cond internal
+    namespace detail
+    {
+        /// @c Lock::kTryLock if the adapter declares it, true otherwise.
+        template <typename Lock, typename = void>
+        struct lock_can_try : std::true_type
+        {
+        };
+
+        template <typename Lock>
+        struct lock_can_try<Lock, decltype(void(Lock::kTryLock))> : std::integral_constant<bool, Lock::kTryLock>
+        {
+        };
+    } // namespace detail
+    /// @endcond
+
+    /**
+     * @brief Profiling wrapper around a lock adapter.
+     *
+     * @tparam Lock     Adapter with @c try_lock(), @c lock(), @c unlock(). An adapter whose
+     *                  @c try_lock() always fails declares @c static @c constexpr @c bool
+     *                  @c kTryLock @c = @c false, so its acquisitions are not all counted as
+     *                  contended.
+     * @tparam TopSites Call sites tracked.
+     *
+     * @details Satisfies @c Lockable, so it works with @c std::lock_guard / @c std::unique_lock
+     *          (the recorded site is then inside the guard's constructor; call @c lock()
+     *          directly for precise sites).
+     */
+    template <typename Lock, uint32_t TopSites = 8>
+    class InstrumentedLock
+    {
+    public:
+        template <typename... Args>
+        explicit InstrumentedLock(Args &&...args) : lock_(static_cast<Args &&>(args)...) {}
+
+        InstrumentedLock(const InstrumentedLock &) = delete;
+        InstrumentedLock &operator=(const InstrumentedLock &) = delete;
+
+        /**
+         * @brief Acquire, recording wait time and the caller's address.
+         */
+        __attribute__((noinline)) void lock()
+        {
+            const Timestamp t0 = Timestamp::now();
+            if (lock_.try_lock())
+            {
+                acquired(t0, t0, false, __builtin_return_address(0));
+                return;
+            }
+            lock_.lock();
+            acquired(t0, Timestamp::now(), detail::lock_can_try<Lock>::value, __builtin_return_address(0));
+        }
+
+        /**
+         * @brief Acquire if free (zero wait recorded).
+         */
+        __attribute__((noinline)) bool try_lock()
+        {
+            const Timestamp t0 = Timestamp::now();
+            if (!lock_.try_lock())
+            {
+                return false;
+            }
+            acquired(t0, t0, false, __builtin_return_address(0));
+            return true;
+        }
+
+        /**
+         * @brief Record the hold time and release.
+         */
+        inline void unlock()
+        {
+            const uint64_t held = cycles_between(held_since_, Timestamp::now());
+            profile_.on_release(site_, held);
+            lock_.unlock();
+        }
+
+        inline const LockProfile<TopSites> &profile() const { return profile_; }
+        inline LockProfile<TopSites> &profile() { return profile_; }
+
+        /** @brief The wrapped adapter. */
+        inline Lock &native() { return lock_; }
+
+    private:
+        FASTTIME_ALWAYS_INLINE inline void acquired(Timestamp t0, Timestamp t1, bool contended, const void *site)
+        {
+            held_since_ = t1;
+            site_ = site;
+            profile_.on_acquired(cycles_between(t0, t1), contended);
+        }
+
+        Lock lock_;
+        Timestamp held_since_{0};
+        const void *site_ = nullptr;
+        LockProfile<TopSites> profile_;
+    };
+
+    // ----------------------------------------------------------------------------
+    // Lock adapters
+    // ----------------------------------------------------------------------------
+
+#if defined(FASTTIME_HOST)
+    /**
+     * @brief @c std::mutex adapter.
+     */
+    class StdMutex
+    {
+    public:
+        inline bool try_lock() { return m_.try_lock(); }
+        inline void lock() { m_.lock(); }
+        inline void unlock() { m_.unlock(); }
+
+    private:
+        std::mutex m_;
+    };
+
+    /**
+     * @brief @c pthread_spinlock_t adapter.
+     */
+    class PthreadSpinLock
+    {
+    public:
+        PthreadSpinLock() { pthread_spin_init(&s_, PTHREAD_PROCESS_PRIVATE); }
+        ~PthreadSpinLock() { pthread_spin_destroy(&s_); }
+
+        PthreadSpinLock(const PthreadSpinLock &) = delete;
+        PthreadSpinLock &operator=(const PthreadSpinLock &) = delete;
+
+        inline bool try_lock() { return pthread_spin_trylock(&s_) == 0; }
+        inline void lock() { pthread_spin_lock(&s_); }
+        inline void unlock() { pthread_spin_unlock(&s_); }
+
+    private:
+        pthread_spinlock_t s_;
+    };
+#else
+    /**
+     * @brief FreeRTOS mutex adapter (statically allocated, priority inheritance).
+     *
+     * @warning Task context only.
+     */
+    class FreeRtosMutex
+    {
+    public:
+        FreeRtosMutex() : h_(xSemaphoreCreateMutexStatic(&buf_)) {}
+        ~FreeRtosMutex() { vSemaphoreDelete(h_); }
+
+        FreeRtosMutex(const FreeRtosMutex &) = delete;
+        FreeRtosMutex &operator=(const FreeRtosMutex &) = delete;
+
+        inline bool try_lock() { return xSemaphoreTake(h_, 0) == pdTRUE; }
+        inline void lock() { xSemaphoreTake(h_, portMAX_DELAY); }
+        inline void unlock() { xSemaphoreGive(h_); }
+
+        inline SemaphoreHandle_t handle() const { return h_; }
+
+    private:
+        StaticSemaphore_t buf_;
+        SemaphoreHandle_t h_;
+    };
+
+    /**
+     * @brief ESP-IDF @c portMUX_TYPE spinlock adapter (critical section, interrupts masked).
+     *
+     * @remarks Without @c portTRY_ENTER_CRITICAL every acquisition takes the two-read path and
+     *          none is counted as contended (see @ref LockProfile::contended).
+     */
+    class PortMuxLock
+    {
+    public:
+#if defined(portTRY_ENTER_CRITICAL)
+        static constexpr bool kTryLock = true;
+#else
+        static constexpr bool kTryLock = false;
+#endif
+
+        inline bool try_lock()
+        {
+#if defined(portTRY_ENTER_CRITICAL)
+            return portTRY_ENTER_CRITICAL(&mux_, 0) == pdPASS;
+#else
+            return false;
+#endif
+        }
+        inline void lock() { portENTER_CRITICAL(&mux_); }
+        inline void unlock() { portEXIT_CRITICAL(&mux_); }
+
+        inline portMUX_TYPE *native() { return &mux_; }
+
+    private:
+        portMUX_TYPE mux_ = portMUX_INITIALIZER_UNLOCKED;
+    };
+#endif
+
+} // namespace fasttime
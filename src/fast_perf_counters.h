@@ -0,0 +1,549 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp23_fast_timestamp.h"
+
+#if defined(FASTTIME_HOST) && defined(__linux__) && !defined(FASTTIME_MOCK_COUNTER)
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define FASTTIME_PERF_LINUX 1
+#endif
+
+/**
+ * @file fast_perf_counters.h
+ * @brief Hardware performance counters captured next to the cycle counter.
+ *
+ * @details
+ * Cycles say how slow a region is, not why. @ref PerfTimestamp captures a @ref Timestamp plus
+ * a snapshot of up to @ref FASTTIME_PERF_MAX_EVENTS other counters, and @ref PerfStats turns
+ * the deltas into IPC and per-kilo-instruction miss rates. The events are requested by
+ * meaning (@ref PerfEvent) and mapped per platform:
+ *
+ * | PerfEvent         | Xtensa PERFMON (ESP32, S3)        | Linux perf_event_open          |
+ * |-------------------|-----------------------------------|--------------------------------|
+ * | kInstructions     | INSN, all instructions            | HW_INSTRUCTIONS                |
+ * | kICacheStalls     | I_STALL, instruction-cache miss   | L1I read misses                |
+ * | kDCacheStalls     | D_STALL, data-cache miss          | L1D read misses                |
+ * | kBranchMisses     | —                                 | HW_BRANCH_MISSES               |
+ * | kStallCycles      | D_STALL, any reason               | HW_STALLED_CYCLES_BACKEND      |
+ *
+ * On ESP32 the I-cache stall count is the flash-cache penalty of code running from flash.
+ * Xtensa events are stall cycles, Linux cache events are miss counts.
+ * Bare-metal RISC-V targets expose only @c minstret (instructions). An event the platform
+ * cannot count reads as 0 and @ref PerfCounterSet::available reports it.
+ *
+ * Counters are per core (Xtensa) or per thread (Linux): open and read a @ref PerfCounterSet
+ * on the core/thread being measured. On Linux a read is one @c read() syscall on the group.
+ *
+ * For named zones in the profiling registry, see @ref ProfilePerfZone in fast_registry.h: it
+ * works with @ref FASTTIME_ZONE and @ref registry_dump prints its IPC and miss rates.
+ *
+ * @code
+ * static const fasttime::PerfEvent ev[] = {fasttime::PerfEvent::kInstructions,
+ *                                          fasttime::PerfEvent::kICacheStalls};
+ * fasttime::PerfCounterSet pmu;
+ * pmu.open(ev, 2);
+ * fasttime::PerfStats stats;
+ * auto t0 = fasttime::PerfTimestamp::now(pmu);
+ * work();
+ * stats.record(fasttime::perf_between(t0, fasttime::PerfTimestamp::now(pmu)));
+ * double ipc = stats.ipc();
+ * @endcode
+ */
+
+/**
+ * @def FASTTIME_PERF_MAX_EVENTS
+ * @brief Counters captured per snapshot (hardware limit of the platform).
+ */
+#ifndef FASTTIME_PERF_MAX_EVENTS
+#if defined(FASTTIME_PERF_LINUX)
+#define FASTTIME_PERF_MAX_EVENTS 4
+#elif defined(__XTENSA__) && !defined(FASTTIME_MOCK_COUNTER)
+#define FASTTIME_PERF_MAX_EVENTS 2
+#else
+#define FASTTIME_PERF_MAX_EVENTS 1
+#endif
+#endif
+
+namespace fasttime
+{
+
+    /**
+     * @brief Portable event selection.
+     */
+    enum class PerfEvent : uint8_t
+    {
+        kNone = 0,
+        kInstructions,
+        kICacheStalls,
+        kDCacheStalls,
+        kBranchMisses,
+        kStallCycles,
+    };
+
+    /**
+     * @brief Short name of @p e for reports.
+     */
+    static inline const char *perf_event_name(PerfEvent e)
+    {
+        switch (e)
+        {
+        case PerfEvent::kInstructions:
+            return "insn";
+        case PerfEvent::kICacheStalls:
+            return "icache";
+        case PerfEvent::kDCacheStalls:
+            return "dcache";
+        case PerfEvent::kBranchMisses:
+            return "branch-miss";
+        case PerfEvent::kStallCycles:
+            return "stall";
+        default:
+            return "none";
+        }
+    }
+
+#if defined(__XTENSA__) && !defined(FASTTIME_MOCK_COUNTER)
+    /**
+     * @brief Xtensa LX performance monitor registers (ERI space) and event encodings.
+     *
+     * @details Same layout the ESP-IDF @c perfmon component programs. PMCTRL holds
+     *          TRACELEVEL [7:4], KRNLCNT [3], SELECT [12:8] and MASK [31:16].
+     */
+    namespace xtperf
+    {
+        static constexpr uint32_t kPmg = 0x00101000;    ///< Global enable (bit 0).
+        static constexpr uint32_t kPm0 = 0x00101080;    ///< Counter n at kPm0 + 4n.
+        static constexpr uint32_t kPmCtrl0 = 0x00101100; ///< Control n at kPmCtrl0 + 4n.
+        static constexpr uint32_t kPmStat0 = 0x00101180; ///< Status n at kPmStat0 + 4n.
+
+        static constexpr uint32_t kSelectInsn = 2;
+        static constexpr uint32_t kSelectDStall = 3;
+        static constexpr uint32_t kSelectIStall = 4;
+
+        static constexpr uint32_t kMaskInsnAll = 0x8DFF;
+        static constexpr uint32_t kMaskIStallCacheMiss = 0x0001;
+        static constexpr uint32_t kMaskIStallAll = 0x003F;
+        static constexpr uint32_t kMaskDStallCacheMiss = 0x0004;
+        static constexpr uint32_t kMaskDStallAll = 0x007F;
+
+        static inline uint32_t read(uint32_t reg)
+        {
+            uint32_t v;
+            asm volatile("rer %0, %1" : "=a"(v) : "a"(reg));
+            return v;
+        }
+
+        static inline void write(uint32_t reg, uint32_t v)
+        {
+            asm volatile("wer %0, %1; isync" : : "a"(v), "a"(reg));
+        }
+
+        /// PMCTRL value counting @p select / @p mask at every interrupt level.
+        static constexpr uint32_t control(uint32_t select, uint32_t mask)
+        {
+            return (0xFu << 4) | ((select & 0x1Fu) << 8) | (mask << 16);
+        }
+    } // namespace xtperf
+#endif
+
+    /**
+     * @brief Raw counter values of one snapshot.
+     */
+    struct PerfSnapshot
+    {
+        uint64_t v[FASTTIME_PERF_MAX_EVENTS];
+    };
+
+    /**
+     * @brief The configured counters of the calling core (target) or thread (Linux).
+     */
+    class PerfCounterSet
+    {
+    public:
+        PerfCounterSet() = default;
+        PerfCounterSet(const PerfCounterSet &) = delete;
+        PerfCounterSet &operator=(const PerfCounterSet &) = delete;
+        ~PerfCounterSet() { close(); }
+
+        /**
+         * @brief Program @p n events (at most @ref FASTTIME_PERF_MAX_EVENTS).
+         *
+         * @return Number of events the hardware actually counts.
+         */
+        uint32_t open(const PerfEvent *events, uint32_t n)
+        {
+            close();
+            n_ = n < FASTTIME_PERF_MAX_EVENTS ? n : FASTTIME_PERF_MAX_EVENTS;
+            uint32_t ok = 0;
+            for (uint32_t i = 0; i < n_; ++i)
+            {
+                events_[i] = events[i];
+                available_[i] = false;
+            }
+#if defined(FASTTIME_PERF_LINUX)
+            group_ = -1;
+            for (uint32_t i = 0; i < n_; ++i)
+            {
+                struct perf_event_attr attr;
+                memset(&attr, 0, sizeof(attr));
+                attr.size = sizeof(attr);
+                if (!linux_event(events_[i], attr))
+                {
+                    fd_[i] = -1;
+                    continue;
+                }
+                attr.disabled = group_ < 0;
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID;
+                fd_[i] = int(syscall(SYS_perf_event_open, &attr, 0, -1, group_, 0));
+                if (fd_[i] < 0)
+                {
+                    continue;
+                }
+                ioctl(fd_[i], PERF_EVENT_IOC_ID, &id_[i]);
+                if (group_ < 0)
+                {
+                    group_ = fd_[i];
+                }
+                available_[i] = true;
+                ++ok;
+            }
+            if (group_ >= 0)
+            {
+                ioctl(group_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+                ioctl(group_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+            }
+#elif defined(__XTENSA__) && !defined(FASTTIME_MOCK_COUNTER)
+            xtperf::write(xtperf::kPmg, 0);
+            for (uint32_t i = 0; i < n_; ++i)
+            {
+                uint32_t select = 0, mask = 0;
+                switch (events_[i])
+                {
+                case PerfEvent::kInstructions:
+                    select = xtperf::kSelectInsn;
+                    mask = xtperf::kMaskInsnAll;
+                    break;
+                case PerfEvent::kICacheStalls:
+                    select = xtperf::kSelectIStall;
+                    mask = xtperf::kMaskIStallCacheMiss;
+                    break;
+                case PerfEvent::kDCacheStalls:
+                    select = xtperf::kSelectDStall;
+                    mask = xtperf::kMaskDStallCacheMiss;
+                    break;
+                case PerfEvent::kStallCycles:
+                    // One counter per event: data stalls dominate on ESP32 internal RAM code.
+                    select = xtperf::kSelectDStall;
+                    mask = xtperf::kMaskDStallAll;
+                    break;
+                default:
+                    continue;
+                }
+                xtperf::write(xtperf::kPmCtrl0 + 4 * i, xtperf::control(select, mask));
+                xtperf::write(xtperf::kPm0 + 4 * i, 0);
+                xtperf::write(xtperf::kPmStat0 + 4 * i, 0xFF);
+                available_[i] = true;
+                ++ok;
+            }
+            xtperf::write(xtperf::kPmg, 1);
+#elif defined(__riscv) && !defined(FASTTIME_HOST) && !defined(FASTTIME_MOCK_COUNTER)
+            for (uint32_t i = 0; i < n_; ++i)
+            {
+                available_[i] = events_[i] == PerfEvent::kInstructions;
+                ok += available_[i];
+            }
+#endif
+            return ok;
+        }
+
+        /** @brief Release the counters. */
+        void close()
+        {
+#if defined(FASTTIME_PERF_LINUX)
+            for (uint32_t i = 0; i < n_; ++i)
+            {
+                if (available_[i])
+                {
+                    ::close(fd_[i]);
+                }
+            }
+            group_ = -1;
+#elif defined(__XTENSA__) && !defined(FASTTIME_MOCK_COUNTER)
+            if (n_)
+            {
+                xtperf::write(xtperf::kPmg, 0);
+            }
+#endif
+            n_ = 0;
+        }
+
+        /**
+         * @brief Read every configured counter.
+         */
+        inline PerfSnapshot read() const
+        {
+            PerfSnapshot s;
+            for (uint32_t i = 0; i < FASTTIME_PERF_MAX_EVENTS; ++i)
+            {
+                s.v[i] = 0;
+            }
+#if defined(FASTTIME_PERF_LINUX)
+            if (group_ >= 0)
+            {
+                struct
+                {
+                    uint64_t nr;
+                    struct
+                    {
+                        uint64_t value;
+                        uint64_t id;
+                    } e[FASTTIME_PERF_MAX_EVENTS];
+                } buf;
+                if (::read(group_, &buf, sizeof(buf)) > 0)
+                {
+                    for (uint64_t k = 0; k < buf.nr && k < FASTTIME_PERF_MAX_EVENTS; ++k)
+                    {
+                        for (uint32_t i = 0; i < n_; ++i)
+                        {
+                            if (available_[i] && id_[i] == buf.e[k].id)
+                            {
+                                s.v[i] = buf.e[k].value;
+                            }
+                        }
+                    }
+                }
+            }
+#elif defined(__XTENSA__) && !defined(FASTTIME_MOCK_COUNTER)
+            for (uint32_t i = 0; i < n_; ++i)
+            {
+                if (available_[i])
+                {
+                    s.v[i] = xtperf::read(xtperf::kPm0 + 4 * i);
+                }
+            }
+#elif defined(__riscv) && !defined(FASTTIME_HOST) && !defined(FASTTIME_MOCK_COUNTER)
+            for (uint32_t i = 0; i < n_; ++i)
+            {
+                if (available_[i])
+                {
+#if __riscv_xlen == 64
+                    uint64_t v;
+                    asm volatile("csrr %0, minstret" : "=r"(v));
+                    s.v[i] = v;
+#else
+                    uint32_t v;
+                    asm volatile("csrr %0, minstret" : "=r"(v));
+                    s.v[i] = v;
+#endif
+                }
+            }
+#endif
+            return s;
+        }
+
+        inline uint32_t size() const { return n_; }
+        inline PerfEvent event(uint32_t i) const { return events_[i]; }
+        inline bool available(uint32_t i) const { return i < n_ && available_[i]; }
+
+        /** @brief Index of @p e among the configured events, or -1. */
+        inline int index_of(PerfEvent e) const
+        {
+            for (uint32_t i = 0; i < n_; ++i)
+            {
+                if (events_[i] == e && available_[i])
+                {
+                    return int(i);
+                }
+            }
+            return -1;
+        }
+
+        /** @brief Width of the hardware counters (deltas wrap at this width). */
+        static constexpr uint32_t counter_bits()
+        {
+#if defined(FASTTIME_PERF_LINUX)
+            return 64;
+#else
+            return 32;
+#endif
+        }
+
+    private:
+#if defined(FASTTIME_PERF_LINUX)
+        static bool linux_event(PerfEvent e, struct perf_event_attr &attr)
+        {
+            attr.type = PERF_TYPE_HARDWARE;
+            switch (e)
+            {
+            case PerfEvent::kInstructions:
+                attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+                return true;
+            case PerfEvent::kICacheStalls:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = PERF_COUNT_HW_CACHE_L1I | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                              (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+                return true;
+            case PerfEvent::kDCacheStalls:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                              (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+                return true;
+            case PerfEvent::kBranchMisses:
+                attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+                return true;
+            case PerfEvent::kStallCycles:
+                attr.config = PERF_COUNT_HW_STALLED_CYCLES_BACKEND;
+                return true;
+            default:
+                return false;
+            }
+        }
+
+        int fd_[FASTTIME_PERF_MAX_EVENTS] = {};
+        uint64_t id_[FASTTIME_PERF_MAX_EVENTS] = {};
+        int group_ = -1;
+#endif
+        PerfEvent events_[FASTTIME_PERF_MAX_EVENTS] = {};
+        bool available_[FASTTIME_PERF_MAX_EVENTS] = {};
+        uint32_t n_ = 0;
+    };
+
+    /**
+     * @brief Cycle timestamp plus performance counter snapshot.
+     */
+    struct PerfTimestamp
+    {
+        Timestamp ts;
+        PerfSnapshot counters;
+
+        /**
+         * @brief Read the counters and the cycle counter back to back.
+         */
+        static inline PerfTimestamp now(const PerfCounterSet &set)
+        {
+            PerfTimestamp t;
+            t.counters = set.read();
+            t.ts = Timestamp::now();
+            return t;
+        }
+    };
+
+    /**
+     * @brief Difference of two @ref PerfTimestamp.
+     */
+    struct PerfDelta
+    {
+        uint64_t cycles;
+        uint64_t counts[FASTTIME_PERF_MAX_EVENTS];
+    };
+
+    /**
+     * @brief @p b - @p a for the cycle counter and every event (wrap-safe).
+     */
+    static inline PerfDelta perf_between(const PerfTimestamp &a, const PerfTimestamp &b)
+    {
+        PerfDelta d;
+        d.cycles = cycles_between(a.ts, b.ts);
+        for (uint32_t i = 0; i < FASTTIME_PERF_MAX_EVENTS; ++i)
+        {
+            d.counts[i] = PerfCounterSet::counter_bits() == 64
+                              ? b.counters.v[i] - a.counters.v[i]
+                              : uint64_t(uint32_t(b.counters.v[i] - a.counters.v[i]));
+        }
+        return d;
+    }
+
+    /**
+     * @brief Accumulated cycles and events of a zone, with IPC and miss rates.
+     *
+     * @details Construct from the @ref PerfCounterSet whose events are recorded so the ratios
+     *          know which slot holds instructions. Until then (default construction) there is
+     *          no instruction slot and @ref ipc / @ref per_kilo_insn return 0.
+     */
+    class PerfStats
+    {
+    public:
+        PerfStats() = default;
+        explicit PerfStats(const PerfCounterSet &set) : insn_index_(set.index_of(PerfEvent::kInstructions)) {}
+
+        /** @brief Take the instruction slot from @p set (e.g. once it has been opened). */
+        inline void bind(const PerfCounterSet &set) { insn_index_ = set.index_of(PerfEvent::kInstructions); }
+
+        FASTTIME_HOT inline void record(const PerfDelta &d)
+        {
+            ++count_;
+            cycles_ += d.cycles;
+            for (uint32_t i = 0; i < FASTTIME_PERF_MAX_EVENTS; ++i)
+            {
+                totals_[i] += d.counts[i];
+            }
+        }
+
+        inline uint64_t count() const { return count_; }
+        inline uint64_t cycles() const { return cycles_; }
+        inline uint64_t total(uint32_t i) const { return totals_[i]; }
+
+        /** @brief Instructions per cycle (0 if instructions are not counted). */
+        inline double ipc() const
+        {
+            return insn_index_ >= 0 && cycles_ ? double(totals_[insn_index_]) / double(cycles_) : 0.0;
+        }
+
+        /** @brief Events of slot @p i per 1000 instructions. */
+        inline double per_kilo_insn(uint32_t i) const
+        {
+            return insn_index_ >= 0 && totals_[insn_index_]
+                       ? 1000.0 * double(totals_[i]) / double(totals_[insn_index_])
+                       : 0.0;
+        }
+
+        /** @brief Events of slot @p i as a fraction of cycles (stall ratio). */
+        inline double per_cycle(uint32_t i) const
+        {
+            return cycles_ ? double(totals_[i]) / double(cycles_) : 0.0;
+        }
+
+        inline void reset()
+        {
+            count_ = 0;
+            cycles_ = 0;
+            for (uint32_t i = 0; i < FASTTIME_PERF_MAX_EVENTS; ++i)
+            {
+                totals_[i] = 0;
+            }
+        }
+
+    private:
+        int insn_index_ = -1;
+        uint64_t count_ = 0;
+        uint64_t cycles_ = 0;
+        uint64_t totals_[FASTTIME_PERF_MAX_EVENTS] = {};
+    };
+
+    /**
+     * @brief RAII guard recording its scope into a @ref PerfStats.
+     */
+    class PerfScope
+    {
+    public:
+        PerfScope(const PerfCounterSet &set, PerfStats &stats)
+            : set_(set), stats_(stats), start_(PerfTimestamp::now(set)) {}
+        ~PerfScope() { stats_.record(perf_between(start_, PerfTimestamp::now(set_))); }
+
+        PerfScope(const PerfScope &) = delete;
+        PerfScope &operator=(const PerfScope &) = delete;
+
+    private:
+        const PerfCounterSet &set_;
+        PerfStats &stats_;
+        PerfTimestamp start_;
+    };
+
+} // namespace fasttime
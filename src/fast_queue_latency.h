@@ -0,0 +1,294 @@
+#pragma once
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp23_fast_timestamp.h"
+#include "fast_core_sync.h"
+#include "fast_histogram.h"
+#include "fast_registry.h"
+#include "fast_ring_buffer.h"
+
+#if !defined(FASTTIME_HOST)
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#endif
+
+/**
+ * @file fast_queue_latency.h
+ * @brief Per-queue dwell time and throughput for producer/consumer pipelines.
+ *
+ * @details
+ * Items travel inside a @ref Stamped envelope that carries the @ref CoreTimestamp of the send
+ * call, so no side table or allocation is needed: the consumer computes the dwell time from
+ * the item itself. Every queue owns a @ref QueueProfile whose dwell histogram and item counter
+ * register in the profiling registry under the queue's name, so @ref registry_dump shows each
+ * pipeline stage next to the zones.
+ *
+ * @warning The registry never unlinks, so a registered queue must have static storage duration
+ *          (namespace scope or function-local @c static). Construct queues that live on the
+ *          stack, on the heap or inside a destructible object with @ref Registration::kUnlinked;
+ *          their statistics stay available through @c profile().
+ *
+ * - @ref ProfiledQueue: FreeRTOS queue with static storage.
+ * - @ref ProfiledSpscQueue: lock-free @ref RingBuffer (host tests, core-to-core handoff).
+ *
+ * Producer and consumer often run on different cores. Set @ref CoreClockOffsets with
+ * @ref QueueProfile::set_offsets; without them cross-core items on a target are counted but
+ * not timed.
+ *
+ * @code
+ * static fasttime::ProfiledQueue<SensorSample, 16> sensor_q("q.sensor->filter");
+ * sensor_q.send(sample);                 // sensor task
+ * sensor_q.receive(sample);              // filter task: dwell recorded
+ * double rate = sensor_q.profile().throughput_per_sec();
+ * @endcode
+ */
+
+namespace fasttime
+{
+
+    /**
+     * @brief Queue item with its enqueue timestamp.
+     */
+    template <typename T>
+    struct Stamped
+    {
+        T value;
+        CoreTimestamp enqueued;
+    };
+
+    /**
+     * @brief Dwell histogram, throughput and drop counts of one queue.
+     */
+    class QueueProfile
+    {
+    public:
+        /**
+         * @param name Registry name (static string) for the dwell histogram and item counter.
+         * @param reg  @ref Registration::kUnlinked unless this profile has static storage duration.
+         */
+        explicit QueueProfile(const char *name, Registration reg = Registration::kLinked)
+            : dwell_(name, reg), items_(name, reg), rate_since_(Timestamp::now()) {}
+
+        QueueProfile(const QueueProfile &) = delete;
+        QueueProfile &operator=(const QueueProfile &) = delete;
+
+        /** @brief Use @p offsets to time items that crossed cores (nullptr: none). */
+        inline void set_offsets(const CoreClockOffsets *offsets) { offsets_ = offsets; }
+
+        /** @brief Stamp @p item at send time. */
+        template <typename T>
+        FASTTIME_ALWAYS_INLINE inline void stamp(Stamped<T> &item) const
+        {
+            item.enqueued = CoreTimestamp::now();
+        }
+
+        /** @brief Record the dwell of a received @p item. */
+        template <typename T>
+        FASTTIME_ALWAYS_INLINE inline void on_dequeue(const Stamped<T> &item)
+        {
+            const CoreTimestamp now = CoreTimestamp::now();
+            items_.add();
+            if (offsets_)
+            {
+                dwell_.record(cycles_between(item.enqueued, now, *offsets_));
+                return;
+            }
+#if !defined(FASTTIME_HOST)
+            if (item.enqueued.core != now.core)
+            {
+                cross_core_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+#endif
+            dwell_.record(cycles_between(item.enqueued.ts, now.ts));
+        }
+
+        /** @brief Count a send that failed because the queue was full. */
+        FASTTIME_HOT inline void on_rejected() { rejected_.fetch_add(1, std::memory_order_relaxed); }
+
+        /** @brief Dwell times (cycles). */
+        inline const CycleHistogram<> &dwell() const { return dwell_.histogram(); }
+
+        /** @brief Items received. */
+        inline uint64_t dequeued() const { return items_.value(); }
+
+        /** @brief Sends rejected because the queue was full. */
+        inline uint32_t rejected() const { return rejected_.load(std::memory_order_relaxed); }
+
+        /** @brief Cross-core items not timed because no offsets were set. */
+        inline uint32_t cross_core() const { return cross_core_.load(std::memory_order_relaxed); }
+
+        /**
+         * @brief Items received per second since the previous call (single caller).
+         */
+        double throughput_per_sec(uint64_t freq_hz = FASTTIME_FREQ_HZ)
+        {
+            const Timestamp now = Timestamp::now();
+            const uint64_t count = items_.value();
+            const uint64_t cycles = cycles_between(rate_since_, now);
+            const double rate = cycles ? double(count - rate_count_) * double(freq_hz) / double(cycles) : 0.0;
+            rate_since_ = now;
+            rate_count_ = count;
+            return rate;
+        }
+
+        /**
+         * @brief Clear the statistics.
+         *
+         * @warning Only excludes writers on the calling core.
+         */
+        inline void reset()
+        {
+            dwell_.reset();
+            items_.reset();
+            rejected_.store(0, std::memory_order_relaxed);
+            cross_core_.store(0, std::memory_order_relaxed);
+            rate_since_ = Timestamp::now();
+            rate_count_ = 0;
+        }
+
+    private:
+        ProfileHistogram dwell_;
+        ProfileCounter items_;
+        const CoreClockOffsets *offsets_ = nullptr;
+        std::atomic<uint32_t> rejected_{0};
+        std::atomic<uint32_t> cross_core_{0};
+        Timestamp rate_since_;
+        uint64_t rate_count_ = 0;
+    };
+
+    /**
+     * @brief Lock-free single-producer / single-consumer queue with dwell profiling.
+     *
+     * @warning Registered by default: give the queue static storage duration or pass
+     *          @ref Registration::kUnlinked, otherwise the registry keeps a dangling entry.
+     */
+    template <typename T, size_t Capacity>
+    class ProfiledSpscQueue
+    {
+    public:
+        explicit ProfiledSpscQueue(const char *name, Registration reg = Registration::kLinked)
+            : profile_(name, reg) {}
+
+        /** @brief Producer side. @return false if full. */
+        FASTTIME_ALWAYS_INLINE inline bool push(const T &v)
+        {
+            Stamped<T> item{v, CoreTimestamp{Timestamp{0}, 0}};
+            profile_.stamp(item);
+            if (!ring_.push(item))
+            {
+                profile_.on_rejected();
+                return false;
+            }
+            return true;
+        }
+
+        /** @brief Consumer side. @return false if empty. */
+        FASTTIME_ALWAYS_INLINE inline bool pop(T &out)
+        {
+            Stamped<T> item;
+            if (!ring_.pop(item))
+            {
+                return false;
+            }
+            profile_.on_dequeue(item);
+            out = item.value;
+            return true;
+        }
+
+        inline size_t size() const { return ring_.size(); }
+        inline QueueProfile &profile() { return profile_; }
+        inline const QueueProfile &profile() const { return profile_; }
+
+    private:
+        QueueProfile profile_;
+        RingBuffer<Stamped<T>, Capacity> ring_;
+    };
+
+#if !defined(FASTTIME_HOST)
+    /**
+     * @brief FreeRTOS queue of @p Length items with static storage and dwell profiling.
+     *
+     * @details The send timestamp is taken before @c xQueueSend, so time spent blocked on a
+     *          full queue counts as dwell.
+     *
+     * @warning Registered by default: give the queue static storage duration or pass
+     *          @ref Registration::kUnlinked, otherwise the registry keeps a dangling entry.
+     */
+    template <typename T, size_t Length>
+    class ProfiledQueue
+    {
+    public:
+        explicit ProfiledQueue(const char *name, Registration reg = Registration::kLinked)
+            : profile_(name, reg),
+              h_(xQueueCreateStatic(Length, sizeof(Stamped<T>), storage_, &buf_)) {}
+
+        ~ProfiledQueue() { vQueueDelete(h_); }
+
+        ProfiledQueue(const ProfiledQueue &) = delete;
+        ProfiledQueue &operator=(const ProfiledQueue &) = delete;
+
+        bool send(const T &v, TickType_t wait = 0)
+        {
+            Stamped<T> item{v, CoreTimestamp{Timestamp{0}, 0}};
+            profile_.stamp(item);
+            if (xQueueSend(h_, &item, wait) != pdTRUE)
+            {
+                profile_.on_rejected();
+                return false;
+            }
+            return true;
+        }
+
+        bool send_from_isr(const T &v, BaseType_t *woken)
+        {
+            Stamped<T> item{v, CoreTimestamp{Timestamp{0}, 0}};
+            profile_.stamp(item);
+            if (xQueueSendFromISR(h_, &item, woken) != pdTRUE)
+            {
+                profile_.on_rejected();
+                return false;
+            }
+            return true;
+        }
+
+        bool receive(T &out, TickType_t wait = portMAX_DELAY)
+        {
+            Stamped<T> item;
+            if (xQueueReceive(h_, &item, wait) != pdTRUE)
+            {
+                return false;
+            }
+            profile_.on_dequeue(item);
+            out = item.value;
+            return true;
+        }
+
+        bool receive_from_isr(T &out, BaseType_t *woken)
+        {
+            Stamped<T> item;
+            if (xQueueReceiveFromISR(h_, &item, woken) != pdTRUE)
+            {
+                return false;
+            }
+            profile_.on_dequeue(item);
+            out = item.value;
+            return true;
+        }
+
+        inline size_t size() const { return uxQueueMessagesWaiting(h_); }
+        inline QueueHandle_t handle() const { return h_; }
+        inline QueueProfile &profile() { return profile_; }
+        inline const QueueProfile &profile() const { return profile_; }
+
+    private:
+        QueueProfile profile_;
+        StaticQueue_t buf_;
+        uint8_t storage_[Length * sizeof(Stamped<T>)];
+        QueueHandle_t h_;
+    };
+#endif
+
+} // namespace fasttime
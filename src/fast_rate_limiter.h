@@ -0,0 +1,290 @@
+#pragma once
+#include <atomic>
+#include <stdint.h>
+
+#include "esp23_fast_timestamp.h"
+
+#if !defined(FASTTIME_COARSE_MS) && defined(__XTENSA__) && __has_include(<freertos/FreeRTOS.h>)
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+/// Millisecond clock that outlasts a 32-bit counter wrap (FreeRTOS tick; task or ISR context).
+#define FASTTIME_COARSE_MS() (uint32_t(xTaskGetTickCountFromISR()) * uint32_t(portTICK_PERIOD_MS))
+#endif
+
+/**
+ * @file fast_rate_limiter.h
+ * @brief Token-bucket and leaky-bucket rate limiters refilled from the cycle counter.
+ *
+ * @details
+ * Rates are precomputed at init as a fixed-point *cycles per token* value with 8 fractional
+ * bits (Q56.8 in a @c uint64_t), so the hot path is one counter read, a subtraction, a shift
+ * and a compare (no division, no @c millis()). Credit is kept in cycles, which makes refill a
+ * plain addition of @ref cycles_between.
+ *
+ * - @ref TokenBucket: single-producer policing (drop when empty).
+ * - @ref LeakyBucket: single-producer shaping (reports how long to wait until conforming).
+ * - @ref AtomicTokenBucket: lock-free GCRA variant safe to share between cores/ISRs.
+ *
+ * @par Long idle periods
+ * On a 32-bit counter (Xtensa @c CCOUNT), a gap between calls longer than one wrap
+ * (~17.9 s @ 240 MHz) looks shorter by a multiple of 2^32 cycles, which would under-refill a
+ * @ref TokenBucket and under-drain a @ref LeakyBucket. Both also read FASTTIME_COARSE_MS(), a
+ * millisecond clock that does not wrap within the gap (the FreeRTOS tick count on Xtensa;
+ * define it yourself elsewhere), and add back the missed wraps. Without it, call
+ * @c refill() / @c drain() at least once per wrap while idle. 64-bit counters are unaffected.
+ *
+ * @code
+ * static auto log_limit = fasttime::TokenBucket::make(10, 20); // 10 lines/s, bursts of 20
+ * if (log_limit.try_acquire()) { Serial.println(msg); }
+ * @endcode
+ */
+
+namespace fasttime
+{
+
+    /// Fractional bits of the fixed-point cycles-per-token rate.
+    static constexpr uint32_t kRateFracBits = 8;
+
+    namespace detail
+    {
+        /**
+         * @brief Cycles from @p last to @p now, including counter wraps missed in between.
+         *
+         * @param coarse_ms FASTTIME_COARSE_MS() at @p last; updated to its value now.
+         */
+        static inline uint64_t rate_elapsed(const Timestamp last, const Timestamp now, uint32_t &coarse_ms)
+        {
+            uint64_t elapsed = cycles_between(last, now);
+#if defined(FASTTIME_COARSE_MS)
+            if (sizeof(fast_counter_t) == 4)
+            {
+                const uint32_t ms = FASTTIME_COARSE_MS();
+                const uint64_t coarse = uint64_t(ms - coarse_ms) * (FASTTIME_FREQ_HZ / 1000);
+                coarse_ms = ms;
+                // Round the difference to whole wraps; the coarse clock is off by a few ms at most.
+                if (coarse > elapsed + (uint64_t(1) << 31))
+                {
+                    elapsed += ((coarse - elapsed + (uint64_t(1) << 31)) >> 32) << 32;
+                }
+            }
+#else
+            (void)coarse_ms;
+#endif
+            return elapsed;
+        }
+
+        static inline uint32_t rate_coarse_now()
+        {
+#if defined(FASTTIME_COARSE_MS)
+            return FASTTIME_COARSE_MS();
+#else
+            return 0;
+#endif
+        }
+    } // namespace detail
+
+    /**
+     * @brief Fixed-point cycles per token for @p per_sec tokens per second.
+     */
+    static inline uint64_t cycles_per_token_q8(uint32_t per_sec, uint64_t freq_hz = FASTTIME_FREQ_HZ)
+    {
+        const uint64_t rate = per_sec ? per_sec : 1;
+        return ((freq_hz << kRateFracBits) + rate / 2) / rate;
+    }
+
+    /**
+     * @brief Token bucket for a single producer.
+     *
+     * @warning Not safe for concurrent callers; use @ref AtomicTokenBucket across tasks/cores.
+     */
+    struct TokenBucket
+    {
+        uint64_t cost;      ///< Cycles per token (Q56.8).
+        uint64_t burst;     ///< Bucket depth in credit units (Q56.8 cycles).
+        uint64_t credit;    ///< Current credit (Q56.8 cycles).
+        Timestamp last;     ///< Time of the last refill.
+        uint32_t coarse_ms; ///< FASTTIME_COARSE_MS() at @ref last (long-idle correction).
+
+        /**
+         * @brief Build a full bucket.
+         *
+         * @param per_sec  Sustained tokens per second.
+         * @param capacity Maximum burst in tokens.
+         */
+        static inline TokenBucket make(uint32_t per_sec, uint32_t capacity,
+                                       uint64_t freq_hz = FASTTIME_FREQ_HZ,
+                                       const Timestamp now = Timestamp::now())
+        {
+            TokenBucket b;
+            b.cost = cycles_per_token_q8(per_sec, freq_hz);
+            b.burst = b.cost * (capacity ? capacity : 1);
+            b.credit = b.burst;
+            b.last = now;
+            b.coarse_ms = detail::rate_coarse_now();
+            return b;
+        }
+
+        /**
+         * @brief Take @p n tokens if available.
+         * @return true if the tokens were granted.
+         */
+        inline bool try_acquire(uint32_t n = 1, const Timestamp now = Timestamp::now())
+        {
+            refill(now);
+            const uint64_t need = cost * n;
+            if (credit < need)
+            {
+                return false;
+            }
+            credit -= need;
+            return true;
+        }
+
+        /**
+         * @brief Whole tokens currently available (contains a division; not for hot paths).
+         */
+        inline uint32_t available(const Timestamp now = Timestamp::now())
+        {
+            refill(now);
+            return uint32_t(credit / cost);
+        }
+
+        /**
+         * @brief Add the credit earned since @ref last, saturating at @ref burst.
+         */
+        inline void refill(const Timestamp now)
+        {
+            const uint64_t elapsed = detail::rate_elapsed(last, now, coarse_ms);
+            last = now;
+            const uint64_t room = burst - credit;
+            credit = (elapsed >= (room >> kRateFracBits)) ? burst : credit + (elapsed << kRateFracBits);
+        }
+    };
+
+    /**
+     * @brief Leaky bucket (meter form) for a single producer.
+     *
+     * @details The level drains at the configured rate; work that would overflow the bucket is
+     * rejected and @ref wait_cycles tells the caller how long to defer it instead of dropping.
+     */
+    struct LeakyBucket
+    {
+        uint64_t cost;      ///< Cycles per unit (Q56.8).
+        uint64_t limit;     ///< Bucket depth in credit units (Q56.8 cycles).
+        uint64_t level;     ///< Current fill (Q56.8 cycles).
+        Timestamp last;     ///< Time of the last drain.
+        uint32_t coarse_ms; ///< FASTTIME_COARSE_MS() at @ref last (long-idle correction).
+
+        /**
+         * @brief Build an empty bucket.
+         *
+         * @param per_sec  Sustained units per second.
+         * @param capacity Units the bucket holds before rejecting.
+         */
+        static inline LeakyBucket make(uint32_t per_sec, uint32_t capacity,
+                                       uint64_t freq_hz = FASTTIME_FREQ_HZ,
+                                       const Timestamp now = Timestamp::now())
+        {
+            LeakyBucket b;
+            b.cost = cycles_per_token_q8(per_sec, freq_hz);
+            b.limit = b.cost * (capacity ? capacity : 1);
+            b.level = 0;
+            b.last = now;
+            b.coarse_ms = detail::rate_coarse_now();
+            return b;
+        }
+
+        /**
+         * @brief Pour @p n units into the bucket if they fit.
+         * @return true if accepted.
+         */
+        inline bool try_add(uint32_t n = 1, const Timestamp now = Timestamp::now())
+        {
+            drain(now);
+            const uint64_t need = cost * n;
+            if (level + need > limit)
+            {
+                return false;
+            }
+            level += need;
+            return true;
+        }
+
+        /**
+         * @brief Cycles until @p n units would be accepted (0 if they fit now).
+         */
+        inline uint64_t wait_cycles(uint32_t n = 1, const Timestamp now = Timestamp::now())
+        {
+            drain(now);
+            const uint64_t need = cost * n;
+            return (level + need > limit) ? ((level + need - limit) >> kRateFracBits) + 1 : 0;
+        }
+
+        /**
+         * @brief Remove what leaked out since @ref last.
+         */
+        inline void drain(const Timestamp now)
+        {
+            const uint64_t elapsed = detail::rate_elapsed(last, now, coarse_ms);
+            last = now;
+            level = (elapsed >= (level >> kRateFracBits)) ? 0 : level - (elapsed << kRateFracBits);
+        }
+    };
+
+    /**
+     * @brief Lock-free token bucket for multiple producers (GCRA on a 32-bit atomic).
+     *
+     * @details
+     * Stores only the theoretical arrival time (TAT) in the low 32 bits of the counter and
+     * updates it with a CAS loop, so it is safe across tasks, ISRs and cores.
+     *
+     * @warning The interval and burst window must stay below 2^31 cycles (~8.9 s @ 240 MHz).
+     * @warning On dual-core Xtensa each core has its own CCOUNT; the limit is only as precise
+     *          as the offset between the two counters.
+     */
+    struct AtomicTokenBucket
+    {
+        std::atomic<uint32_t> tat; ///< Theoretical arrival time (low 32 bits of the counter).
+        uint32_t interval;          ///< Cycles per token.
+        uint32_t tolerance;         ///< Burst tolerance: (capacity - 1) * interval.
+
+        /**
+         * @brief Configure for @p per_sec tokens per second with bursts of @p capacity.
+         */
+        inline void init(uint32_t per_sec, uint32_t capacity,
+                         uint64_t freq_hz = FASTTIME_FREQ_HZ,
+                         const Timestamp now = Timestamp::now())
+        {
+            interval = uint32_t(cycles_per_token_q8(per_sec, freq_hz) >> kRateFracBits);
+            tolerance = interval * ((capacity ? capacity : 1) - 1);
+            tat.store(uint32_t(now.ticks), std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Take one token if the request conforms.
+         * @return true if granted.
+         */
+        inline bool try_acquire(const Timestamp now = Timestamp::now())
+        {
+            const uint32_t t = uint32_t(now.ticks);
+            uint32_t cur = tat.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                const int32_t ahead = (int32_t)(cur - t);
+                // A valid TAT is never further ahead than tolerance + interval; anything else
+                // is a stale value from before a counter wrap.
+                const bool stale = ahead > (int32_t)(tolerance + interval);
+                if (!stale && ahead > (int32_t)tolerance)
+                {
+                    return false;
+                }
+                const uint32_t next = ((stale || ahead < 0) ? t : cur) + interval;
+                if (tat.compare_exchange_weak(cur, next, std::memory_order_relaxed))
+                {
+                    return true;
+                }
+            }
+        }
+    };
+
+} // namespace fasttime
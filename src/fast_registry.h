@@ -0,0 +1,573 @@
+#pragma once
+#include <atomic>
+#include <stdint.h>
+#include <stdio.h>
+#include <type_traits>
+
+#include "esp23_fast_timestamp.h"
+#include "fast_core_local.h"
+#include "fast_cycle_stats.h"
+#include "fast_histogram.h"
+#include "fast_perf_counters.h"
+#include "fast_sharded_stats.h"
+
+#if defined(ARDUINO)
+#include <Print.h>
+#endif
+
+/**
+ * @file fast_registry.h
+ * @brief Static registry of every profiling zone, counter and histogram.
+ *
+ * @details
+ * Instruments declared at namespace scope link themselves into one intrusive list while static
+ * initializers run, with no heap allocation and no lock (a CAS push onto a constant-initialized
+ * head). Afterwards the list is only read, so iteration and @ref registry_dump are safe from any
+ * task at any time and a single console command can print the whole profile.
+ *
+ * - @ref ProfileZone: @ref ShardedStats of a code region, fed by @ref FASTTIME_ZONE.
+ * - @ref ProfileCounter: per-core event counter.
+ * - @ref ProfileHistogram: @ref CycleHistogram for tail latencies.
+ * - @ref ProfilePerfZone: @ref PerfStats of a code region (IPC, miss rates), fed by
+ *   @ref FASTTIME_ZONE.
+ *
+ * @code
+ * static fasttime::ProfileZone spi_zone("spi.transfer");
+ * static fasttime::ProfileCounter spi_retries("spi.retries");
+ *
+ * void spi_transfer()
+ * {
+ *     FASTTIME_ZONE(spi_zone);
+ *     ...
+ *     spi_retries.add();
+ * }
+ *
+ * // console command:
+ * fasttime::registry_dump(Serial);
+ * @endcode
+ *
+ * @note Entries must have static storage duration; the list never unlinks. Instruments that
+ *       live on the stack, the heap or inside an object that can be destroyed are constructed
+ *       with @ref Registration::kUnlinked and are then only reachable through their owner.
+ */
+
+namespace fasttime
+{
+
+    /**
+     * @brief Kind tag of a @ref RegistryEntry.
+     */
+    enum class RegistryKind : uint8_t
+    {
+        kZone,
+        kCounter,
+        kHistogram,
+        kPerfZone,
+    };
+
+    /**
+     * @brief Whether an instrument links itself into the registry.
+     */
+    enum class Registration : uint8_t
+    {
+        kLinked,   ///< Listed by @ref registry_dump; requires static storage duration.
+        kUnlinked, ///< Standalone; any storage duration, not listed.
+    };
+
+    /**
+     * @brief Intrusive list node shared by every registered instrument.
+     */
+    struct RegistryEntry
+    {
+        const char *name;
+        RegistryKind kind;
+        uint32_t id;         ///< Registration order, starting at 0.
+        RegistryEntry *next; ///< Previously registered entry.
+    };
+
+    namespace detail
+    {
+        inline std::atomic<RegistryEntry *> registry_head{nullptr};
+        inline std::atomic<uint32_t> registry_count{0};
+
+        static inline void registry_link(RegistryEntry *e)
+        {
+            e->id = registry_count.fetch_add(1, std::memory_order_relaxed);
+            RegistryEntry *head = registry_head.load(std::memory_order_relaxed);
+            do
+            {
+                e->next = head;
+            } while (!registry_head.compare_exchange_weak(head, e, std::memory_order_release,
+                                                          std::memory_order_relaxed));
+        }
+    } // namespace detail
+
+    /**
+     * @brief Most recently registered entry; follow @c next for the rest.
+     */
+    static inline const RegistryEntry *registry_first()
+    {
+        return detail::registry_head.load(std::memory_order_acquire);
+    }
+
+    /** @brief Number of registered entries. */
+    static inline uint32_t registry_size()
+    {
+        return detail::registry_count.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Named zone statistics (see @ref ShardedStats).
+     */
+    class ProfileZone : public RegistryEntry
+    {
+    public:
+        explicit ProfileZone(const char *zone_name, Registration reg = Registration::kLinked)
+            : RegistryEntry{zone_name, RegistryKind::kZone, 0, nullptr}
+        {
+            if (reg == Registration::kLinked)
+            {
+                detail::registry_link(this);
+            }
+        }
+
+        FASTTIME_HOT inline void record(uint64_t cycles) { stats_.record(cycles); }
+        FASTTIME_HOT inline void record_from_isr(uint64_t cycles) { stats_.record_from_isr(cycles); }
+        inline CycleAccumulator snapshot() const { return stats_.snapshot(); }
+        inline void reset() { stats_.reset(); }
+
+    private:
+        ShardedStats<> stats_;
+    };
+
+    /**
+     * @brief Named event counter, one shard per core.
+     */
+    class ProfileCounter : public RegistryEntry
+    {
+    public:
+        explicit ProfileCounter(const char *counter_name, Registration reg = Registration::kLinked)
+            : RegistryEntry{counter_name, RegistryKind::kCounter, 0, nullptr}
+        {
+            if (reg == Registration::kLinked)
+            {
+                detail::registry_link(this);
+            }
+        }
+
+        /**
+         * @brief Add @p n to the caller's shard.
+         *
+         * @remarks Safe from tasks (pinned or not) and ISRs up to level 3 on any core.
+         */
+        FASTTIME_HOT inline void add(uint64_t n = 1)
+        {
+            uint32_t state;
+            Shard &s = enter_shard(shards_, state);
+            bump(s, n);
+            s.lock.exit(state);
+        }
+
+        /**
+         * @brief @ref add for any interrupt level (see @ref ShardLock::enter_from_isr).
+         */
+        FASTTIME_HOT inline void add_from_isr(uint64_t n = 1)
+        {
+            uint32_t state;
+            Shard &s = enter_shard<true>(shards_, state);
+            bump(s, n);
+            s.lock.exit(state);
+        }
+
+        /** @brief Sum over all shards. */
+        inline uint64_t value() const
+        {
+            uint64_t total = 0;
+            for (uint32_t i = 0; i < FASTTIME_SHARDS; ++i)
+            {
+                const Shard &s = shards_[i];
+                for (;;)
+                {
+                    const uint32_t s1 = s.seq.load(std::memory_order_acquire);
+                    if (s1 & 1u)
+                    {
+                        continue;
+                    }
+                    const uint64_t v = s.value;
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    if (s.seq.load(std::memory_order_relaxed) == s1)
+                    {
+                        total += v;
+                        break;
+                    }
+                }
+            }
+            return total;
+        }
+
+        /**
+         * @brief Zero every shard.
+         *
+         * @warning Only excludes writers on the calling core.
+         */
+        inline void reset()
+        {
+            for (uint32_t i = 0; i < FASTTIME_SHARDS; ++i)
+            {
+                Shard &s = shards_[i];
+                const uint32_t state = s.lock.enter();
+                const uint32_t seq = s.seq.load(std::memory_order_relaxed);
+                s.seq.store(seq + 1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_release);
+                s.value = 0;
+                s.seq.store(seq + 2, std::memory_order_release);
+                s.lock.exit(state);
+            }
+        }
+
+    private:
+        struct alignas(FASTTIME_CACHELINE) Shard
+        {
+            ShardLock lock;
+            std::atomic<uint32_t> seq{0};
+            uint64_t value = 0;
+        };
+
+        static inline FASTTIME_ALWAYS_INLINE void bump(Shard &s, uint64_t n)
+        {
+            const uint32_t seq = s.seq.load(std::memory_order_relaxed);
+            s.seq.store(seq + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            s.value += n;
+            s.seq.store(seq + 2, std::memory_order_release);
+        }
+
+        Shard shards_[FASTTIME_SHARDS];
+    };
+
+    /**
+     * @brief Named latency histogram (see @ref CycleHistogram).
+     */
+    class ProfileHistogram : public RegistryEntry
+    {
+    public:
+        explicit ProfileHistogram(const char *histogram_name, Registration reg = Registration::kLinked)
+            : RegistryEntry{histogram_name, RegistryKind::kHistogram, 0, nullptr}
+        {
+            if (reg == Registration::kLinked)
+            {
+                detail::registry_link(this);
+            }
+        }
+
+        FASTTIME_HOT inline void record(uint64_t cycles) { hist_.record(cycles); }
+        FASTTIME_HOT inline void record_from_isr(uint64_t cycles) { hist_.record_from_isr(cycles); }
+        inline const CycleHistogram<> &histogram() const { return hist_; }
+        inline void reset() { hist_.reset(); }
+
+    private:
+        CycleHistogram<> hist_;
+    };
+
+    /**
+     * @brief Named zone with hardware counter totals (see @ref PerfStats).
+     *
+     * @details Bound to the @ref PerfCounterSet of the core (target) or thread (Linux) that runs
+     *          the zone; @ref FASTTIME_ZONE snapshots it at scope entry and exit. The set may be
+     *          opened after the zone is constructed. Single writer: record only from the
+     *          context that owns the set.
+     *
+     * @code
+     * static fasttime::PerfCounterSet pmu;   // pmu.open(...) on the measured core
+     * static fasttime::ProfilePerfZone fft_zone("dsp.fft", pmu);
+     *
+     * void fft() { FASTTIME_ZONE(fft_zone); ... }
+     * @endcode
+     */
+    class ProfilePerfZone : public RegistryEntry
+    {
+    public:
+        ProfilePerfZone(const char *zone_name, const PerfCounterSet &set,
+                        Registration reg = Registration::kLinked)
+            : RegistryEntry{zone_name, RegistryKind::kPerfZone, 0, nullptr}, set_(set)
+        {
+            if (reg == Registration::kLinked)
+            {
+                detail::registry_link(this);
+            }
+        }
+
+        FASTTIME_HOT inline void record(const PerfDelta &d)
+        {
+            const uint32_t seq = seq_.load(std::memory_order_relaxed);
+            seq_.store(seq + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            stats_.record(d);
+            seq_.store(seq + 2, std::memory_order_release);
+        }
+
+        /** @brief Consistent copy of the totals, bound to the set's current events. */
+        inline PerfStats snapshot() const
+        {
+            PerfStats s;
+            for (;;)
+            {
+                const uint32_t s1 = seq_.load(std::memory_order_acquire);
+                if (s1 & 1u)
+                {
+                    continue;
+                }
+                s = stats_;
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (seq_.load(std::memory_order_relaxed) == s1)
+                {
+                    break;
+                }
+            }
+            s.bind(set_);
+            return s;
+        }
+
+        inline const PerfCounterSet &counters() const { return set_; }
+
+        /** @brief Clear the totals. Writer side. */
+        inline void reset()
+        {
+            const uint32_t seq = seq_.load(std::memory_order_relaxed);
+            seq_.store(seq + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            stats_.reset();
+            seq_.store(seq + 2, std::memory_order_release);
+        }
+
+    private:
+        const PerfCounterSet &set_;
+        std::atomic<uint32_t> seq_{0};
+        PerfStats stats_;
+    };
+
+    /**
+     * @brief RAII guard recording its lifetime into a zone or histogram.
+     *
+     * @tparam FromIsr Record with the @c _from_isr variant (any interrupt level).
+     */
+    template <typename Sink, bool FromIsr = false>
+    class ZoneScope
+    {
+    public:
+        FASTTIME_ALWAYS_INLINE explicit ZoneScope(Sink &sink) : sink_(sink), start_(Timestamp::now()) {}
+
+        FASTTIME_ALWAYS_INLINE ~ZoneScope()
+        {
+            const uint64_t cycles = cycles_between(start_, Timestamp::now());
+            if constexpr (FromIsr)
+            {
+                sink_.record_from_isr(cycles);
+            }
+            else
+            {
+                sink_.record(cycles);
+            }
+        }
+
+        ZoneScope(const ZoneScope &) = delete;
+        ZoneScope &operator=(const ZoneScope &) = delete;
+
+    private:
+        Sink &sink_;
+        Timestamp start_;
+    };
+
+    /**
+     * @brief @ref ZoneScope of a @ref ProfilePerfZone: cycles and counters at entry and exit.
+     *
+     * @remarks Not always-inline: on Linux each counter read is a syscall.
+     */
+    template <bool FromIsr>
+    class ZoneScope<ProfilePerfZone, FromIsr>
+    {
+    public:
+        explicit ZoneScope(ProfilePerfZone &zone) : zone_(zone), start_(PerfTimestamp::now(zone.counters())) {}
+
+        ~ZoneScope() { zone_.record(perf_between(start_, PerfTimestamp::now(zone_.counters()))); }
+
+        ZoneScope(const ZoneScope &) = delete;
+        ZoneScope &operator=(const ZoneScope &) = delete;
+
+    private:
+        ProfilePerfZone &zone_;
+        PerfTimestamp start_;
+    };
+
+#define FASTTIME_CONCAT_INNER(a, b) a##b
+#define FASTTIME_CONCAT(a, b) FASTTIME_CONCAT_INNER(a, b)
+
+/**
+ * @brief Time the rest of the enclosing scope into @p zone (a ProfileZone, ProfileHistogram or
+ *        ProfilePerfZone).
+ */
+#define FASTTIME_ZONE(zone)                                                          \
+    ::fasttime::ZoneScope<typename std::remove_reference<decltype(zone)>::type>      \
+        FASTTIME_CONCAT(fasttime_zone_, __LINE__)(zone)
+
+/**
+ * @brief @ref FASTTIME_ZONE for interrupt handlers of any level.
+ */
+#define FASTTIME_ZONE_FROM_ISR(zone)                                                     \
+    ::fasttime::ZoneScope<typename std::remove_reference<decltype(zone)>::type, true>    \
+        FASTTIME_CONCAT(fasttime_zone_, __LINE__)(zone)
+
+    // ----------------------------------------------------------------------------
+    // Iteration and dump
+    // ----------------------------------------------------------------------------
+
+    /**
+     * @brief Call @p fn for every registered entry (newest first).
+     */
+    template <typename Fn>
+    static inline void registry_for_each(Fn &&fn)
+    {
+        for (const RegistryEntry *e = registry_first(); e; e = e->next)
+        {
+            fn(*e);
+        }
+    }
+
+    /**
+     * @brief Receives one formatted line (without newline).
+     */
+    using LineSink = void (*)(void *ctx, const char *line);
+
+    namespace detail
+    {
+        /// Print @p ns as microseconds with three decimals.
+        static inline int format_us(char *buf, size_t len, uint64_t ns)
+        {
+            return snprintf(buf, len, "%llu.%03llu", (unsigned long long)(ns / 1000),
+                            (unsigned long long)(ns % 1000));
+        }
+    } // namespace detail
+
+    /**
+     * @brief Format one entry into @p buf.
+     */
+    static inline void registry_format(const RegistryEntry &e, char *buf, size_t len,
+                                       const NsConverter &cvt = NsConverter::make())
+    {
+        char a[24], b[24], c[24], d[24];
+        switch (e.kind)
+        {
+        case RegistryKind::kZone:
+        {
+            const CycleAccumulator s = static_cast<const ProfileZone &>(e).snapshot();
+            detail::format_us(a, sizeof(a), cvt.to_ns(s.mean_cycles()));
+            detail::format_us(b, sizeof(b), cvt.to_ns(s.stddev_cycles()));
+            detail::format_us(c, sizeof(c), s.count ? cvt.to_ns(s.min) : 0);
+            detail::format_us(d, sizeof(d), cvt.to_ns(s.max));
+            snprintf(buf, len, "zone      %-24s n=%-10llu mean=%s us sd=%s us min=%s us max=%s us",
+                     e.name, (unsigned long long)s.count, a, b, c, d);
+            break;
+        }
+        case RegistryKind::kCounter:
+            snprintf(buf, len, "counter   %-24s %llu", e.name,
+                     (unsigned long long)static_cast<const ProfileCounter &>(e).value());
+            break;
+        case RegistryKind::kHistogram:
+        {
+            const CycleHistogram<> &h = static_cast<const ProfileHistogram &>(e).histogram();
+            detail::format_us(a, sizeof(a), cvt.to_ns(h.percentile(50.0)));
+            detail::format_us(b, sizeof(b), cvt.to_ns(h.percentile(90.0)));
+            detail::format_us(c, sizeof(c), cvt.to_ns(h.percentile(99.0)));
+            detail::format_us(d, sizeof(d), cvt.to_ns(h.percentile(99.9)));
+            snprintf(buf, len, "histogram %-24s n=%-10llu p50=%s us p90=%s us p99=%s us p99.9=%s us",
+                     e.name, (unsigned long long)h.count(), a, b, c, d);
+            break;
+        }
+        case RegistryKind::kPerfZone:
+        {
+            // Misses per 1000 instructions; kStallCycles as a share of cycles.
+            const ProfilePerfZone &z = static_cast<const ProfilePerfZone &>(e);
+            const PerfStats s = z.snapshot();
+            detail::format_us(a, sizeof(a), s.count() ? cvt.to_ns(s.cycles() / s.count()) : 0);
+            int pos = snprintf(buf, len, "perfzone  %-24s n=%-10llu mean=%s us ipc=%.2f", e.name,
+                               (unsigned long long)s.count(), a, s.ipc());
+            for (uint32_t i = 0; i < z.counters().size() && pos >= 0 && size_t(pos) < len; ++i)
+            {
+                const PerfEvent ev = z.counters().event(i);
+                if (!z.counters().available(i) || ev == PerfEvent::kInstructions)
+                {
+                    continue;
+                }
+                pos += ev == PerfEvent::kStallCycles
+                           ? snprintf(buf + pos, len - pos, " %s=%.1f%%", perf_event_name(ev),
+                                      100.0 * s.per_cycle(i))
+                           : snprintf(buf + pos, len - pos, " %s=%.2f/ki", perf_event_name(ev),
+                                      s.per_kilo_insn(i));
+            }
+            break;
+        }
+        }
+    }
+
+    /**
+     * @brief Format every registered entry, one line each, into @p sink.
+     */
+    static inline void registry_dump(LineSink sink, void *ctx,
+                                     const NsConverter &cvt = NsConverter::make())
+    {
+        char line[192];
+        registry_for_each([&](const RegistryEntry &e) {
+            registry_format(e, line, sizeof(line), cvt);
+            sink(ctx, line);
+        });
+    }
+
+#if defined(ARDUINO)
+    /**
+     * @brief Dump to a serial port or any other Arduino @c Print.
+     */
+    static inline void registry_dump(Print &out, const NsConverter &cvt = NsConverter::make())
+    {
+        registry_dump([](void *ctx, const char *line) { static_cast<Print *>(ctx)->println(line); },
+                      &out, cvt);
+    }
+#endif
+
+    /**
+     * @brief Dump to a stdio stream (host tools, ESP-IDF console).
+     */
+    static inline void registry_dump(FILE *out, const NsConverter &cvt = NsConverter::make())
+    {
+        registry_dump([](void *ctx, const char *line) { fprintf(static_cast<FILE *>(ctx), "%s\n", line); },
+                      out, cvt);
+    }
+
+    /**
+     * @brief Reset every registered instrument.
+     *
+     * @warning Same caveat as the individual resets: call while instruments are idle.
+     */
+    static inline void registry_reset()
+    {
+        for (const RegistryEntry *e = registry_first(); e; e = e->next)
+        {
+            RegistryEntry *m = const_cast<RegistryEntry *>(e);
+            switch (e->kind)
+            {
+            case RegistryKind::kZone:
+                static_cast<ProfileZone *>(m)->reset();
+                break;
+            case RegistryKind::kCounter:
+                static_cast<ProfileCounter *>(m)->reset();
+                break;
+            case RegistryKind::kHistogram:
+                static_cast<ProfileHistogram *>(m)->reset();
+                break;
+            case RegistryKind::kPerfZone:
+                static_cast<ProfilePerfZone *>(m)->reset();
+                break;
+            }
+        }
+    }
+
+} // namespace fasttime
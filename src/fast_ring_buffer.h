@@ -0,0 +1,100 @@
+#pragma once
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp23_fast_timestamp.h"
+#include "fast_core_local.h"
+
+/**
+ * @file fast_ring_buffer.h
+ * @brief Fixed-size single-producer / single-consumer ring buffer.
+ *
+ * @details
+ * Head and tail are free-running 32-bit counters on separate cache lines; the producer only
+ * writes the head, the consumer only writes the tail, so neither side ever blocks and no
+ * read-modify-write atomics are needed. A full buffer rejects the push (the caller decides
+ * whether to count a drop or retry).
+ *
+ * "Single producer" means one context at a time: several tasks or ISRs on one core may share
+ * the producer side if they exclude each other (e.g. with @ref ShardLock).
+ */
+
+namespace fasttime
+{
+
+    /**
+     * @brief Lock-free SPSC ring of @p Capacity elements.
+     *
+     * @tparam T        Trivially copyable element type.
+     * @tparam Capacity Power of two.
+     */
+    template <typename T, size_t Capacity>
+    class RingBuffer
+    {
+        static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+        static_assert(Capacity <= (size_t(1) << 31), "indices are 32-bit");
+
+    public:
+        /**
+         * @brief Append @p v. Producer side.
+         * @return false if the buffer is full.
+         */
+        FASTTIME_ALWAYS_INLINE inline bool push(const T &v)
+        {
+            const uint32_t head = head_.load(std::memory_order_relaxed);
+            if (head - tail_.load(std::memory_order_acquire) >= Capacity)
+            {
+                return false;
+            }
+            slots_[head & (Capacity - 1)] = v;
+            head_.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * @brief Remove the oldest element into @p out. Consumer side.
+         * @return false if the buffer is empty.
+         */
+        FASTTIME_ALWAYS_INLINE inline bool pop(T &out)
+        {
+            const uint32_t tail = tail_.load(std::memory_order_relaxed);
+            if (tail == head_.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+            out = slots_[tail & (Capacity - 1)];
+            tail_.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * @brief Oldest element without removing it, or nullptr. Consumer side.
+         */
+        inline const T *peek() const
+        {
+            const uint32_t tail = tail_.load(std::memory_order_relaxed);
+            if (tail == head_.load(std::memory_order_acquire))
+            {
+                return nullptr;
+            }
+            return &slots_[tail & (Capacity - 1)];
+        }
+
+        /** @brief Elements currently stored (approximate while both sides run). */
+        inline size_t size() const
+        {
+            return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+        }
+
+        inline bool empty() const { return size() == 0; }
+
+        static constexpr size_t capacity() { return Capacity; }
+
+    private:
+        alignas(FASTTIME_CACHELINE) std::atomic<uint32_t> head_{0};
+        alignas(FASTTIME_CACHELINE) std::atomic<uint32_t> tail_{0};
+        T slots_[Capacity];
+    };
+
+} // namespace fasttime
@@ -0,0 +1,355 @@
+#pragma once
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "esp23_fast_timestamp.h"
+#include "fast_core_local.h"
+#include "fast_registry.h"
+#include "fast_ring_buffer.h"
+
+#if defined(FASTTIME_HOST) && defined(__linux__)
+#include <dlfcn.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/time.h>
+#include <ucontext.h>
+#endif
+
+/**
+ * @file fast_sampling_profiler.h
+ * @brief Statistical profiler: periodic interrupt samples the interrupted PC.
+ *
+ * @details
+ * Zones only measure what is annotated. @ref SamplingProfiler instead records, at a fixed rate,
+ * where each core was executing: the timer handler captures the interrupted program counter,
+ * stamps it with the cycle counter and pushes it into a per-core @ref RingBuffer (lock-free,
+ * ISR safe). A low-priority task calls @ref SamplingProfiler::drain to fold the samples into a
+ * PC histogram; @ref SamplingProfiler::dump prints the hottest addresses for offline
+ * symbolization:
+ *
+ *     addr2line -f -C -e firmware.elf 0x400d1234 ...
+ *
+ * Capturing the PC:
+ * - Xtensa: @c EPC1, valid at the start of a level-1 timer ISR. Register window exceptions in
+ *   the interrupt dispatcher can overwrite it, so an occasional sample lands in the vector code.
+ * - RISC-V: @c mepc of the interrupted context.
+ * - Linux: @c setitimer(ITIMER_PROF) delivers @c SIGPROF; the handler reads the PC from the
+ *   @c ucontext_t. Host dumps print module-relative offsets so PIE binaries symbolize.
+ *
+ * @code
+ * static fasttime::SamplingProfiler<> prof;
+ * void IRAM_ATTR on_timer() { prof.sample_from_isr(); }   // e.g. 1-10 kHz hardware timer
+ * // later:
+ * prof.drain();
+ * prof.dump(sink, ctx);
+ * @endcode
+ */
+
+namespace fasttime
+{
+
+    /**
+     * @brief One raw profiler sample.
+     */
+    struct PcSample
+    {
+        uint64_t ticks; ///< Cycle counter at the sample.
+        uintptr_t pc;   ///< Interrupted program counter.
+        uint32_t core;  ///< Core that was interrupted.
+    };
+
+    /**
+     * @brief Aggregated count of one program counter.
+     */
+    struct PcCount
+    {
+        uintptr_t pc;
+        uint32_t count;
+    };
+
+    /**
+     * @brief Timer-driven PC sampler with per-core buffers and a PC histogram.
+     *
+     * @tparam RingCapacity Samples buffered per core between drains (power of two).
+     * @tparam Buckets      Distinct PCs in the histogram (power of two).
+     */
+    template <size_t RingCapacity = 1024, size_t Buckets = 1024>
+    class SamplingProfiler
+    {
+        static_assert((Buckets & (Buckets - 1)) == 0, "bucket count must be a power of two");
+
+    public:
+        /**
+         * @brief Record @p pc as interrupted on the calling core.
+         *
+         * @remarks Safe from tasks (pinned or not), signal handlers and ISRs up to level 3.
+         */
+        FASTTIME_ALWAYS_INLINE inline void record(uintptr_t pc)
+        {
+            uint32_t state;
+            Core &c = enter_shard(cores_, state);
+            const bool ok = c.ring.push(PcSample{Timestamp::now().ticks, pc, current_core()});
+            c.lock.exit(state);
+            if (!ok)
+            {
+                c.dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        /**
+         * @brief @ref record for any interrupt level (see @ref ShardLock::enter_from_isr).
+         */
+        FASTTIME_ALWAYS_INLINE inline void record_from_isr(uintptr_t pc)
+        {
+            uint32_t state;
+            Core &c = enter_shard<true>(cores_, state);
+            const bool ok = c.ring.push(PcSample{Timestamp::now().ticks, pc, current_core()});
+            c.lock.exit(state);
+            if (!ok)
+            {
+                c.dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+#if !defined(FASTTIME_HOST)
+        /**
+         * @brief Sample the interrupted PC. Call first thing in the profiling timer ISR.
+         */
+        FASTTIME_ALWAYS_INLINE inline void sample_from_isr()
+        {
+            uint32_t pc;
+#if defined(__XTENSA__)
+            asm volatile("rsr.epc1 %0" : "=a"(pc));
+#elif defined(__riscv)
+            asm volatile("csrr %0, mepc" : "=r"(pc));
+#endif
+            record_from_isr(pc);
+        }
+#endif
+
+        /**
+         * @brief Move buffered samples into the histogram; @p on_sample sees each raw sample.
+         *
+         * @return Samples drained. Single consumer.
+         */
+        template <typename Fn>
+        size_t drain(Fn &&on_sample)
+        {
+            size_t n = 0;
+            PcSample s;
+            for (uint32_t i = 0; i < FASTTIME_SHARDS; ++i)
+            {
+                while (cores_[i].ring.pop(s))
+                {
+                    on_sample(static_cast<const PcSample &>(s));
+                    add(s.pc);
+                    ++n;
+                }
+            }
+            return n;
+        }
+
+        /** @brief Move buffered samples into the histogram. */
+        inline size_t drain()
+        {
+            return drain([](const PcSample &) {});
+        }
+
+        /**
+         * @brief Hottest PCs, most samples first.
+         * @return Entries written (at most @p max).
+         */
+        uint32_t top(PcCount *out, uint32_t max) const
+        {
+            if (max == 0)
+            {
+                return 0;
+            }
+            uint32_t n = 0;
+            for (size_t i = 0; i < Buckets; ++i)
+            {
+                if (!counts_[i])
+                {
+                    continue;
+                }
+                const PcCount v{pcs_[i], counts_[i]};
+                if (n < max)
+                {
+                    ++n;
+                }
+                else if (v.count <= out[n - 1].count)
+                {
+                    continue;
+                }
+                uint32_t j = n - 1;
+                for (; j > 0 && out[j - 1].count < v.count; --j)
+                {
+                    out[j] = out[j - 1];
+                }
+                out[j] = v;
+            }
+            return n;
+        }
+
+        /**
+         * @brief Print the @p max hottest PCs with their share of all samples.
+         */
+        void dump(LineSink sink, void *ctx, uint32_t max = 32) const
+        {
+            PcCount top_pcs[64];
+            const uint32_t n = top(top_pcs, max < 64 ? max : 64);
+            char line[192];
+            snprintf(line, sizeof(line), "samples=%llu distinct=%u dropped=%u unbinned=%u",
+                     (unsigned long long)total_, distinct_, dropped(), unbinned_);
+            sink(ctx, line);
+            for (uint32_t i = 0; i < n; ++i)
+            {
+                const double pct = total_ ? 100.0 * top_pcs[i].count / double(total_) : 0.0;
+#if defined(FASTTIME_HOST) && defined(__linux__)
+                Dl_info info;
+                if (dladdr(reinterpret_cast<void *>(top_pcs[i].pc), &info) && info.dli_fname)
+                {
+                    snprintf(line, sizeof(line), "%6.2f%% %8u  %s+0x%llx", pct, top_pcs[i].count,
+                             info.dli_fname,
+                             (unsigned long long)(top_pcs[i].pc - uintptr_t(info.dli_fbase)));
+                    sink(ctx, line);
+                    continue;
+                }
+#endif
+                snprintf(line, sizeof(line), "%6.2f%% %8u  0x%llx", pct, top_pcs[i].count,
+                         (unsigned long long)top_pcs[i].pc);
+                sink(ctx, line);
+            }
+        }
+
+        /** @brief Samples folded into the histogram so far. */
+        inline uint64_t samples() const { return total_; }
+
+        /** @brief Samples lost because a core's buffer was full. */
+        inline uint32_t dropped() const
+        {
+            uint32_t total = 0;
+            for (uint32_t i = 0; i < FASTTIME_SHARDS; ++i)
+            {
+                total += cores_[i].dropped.load(std::memory_order_relaxed);
+            }
+            return total;
+        }
+
+        /** @brief Clear the histogram (buffered samples are kept). Consumer side. */
+        void reset()
+        {
+            for (size_t i = 0; i < Buckets; ++i)
+            {
+                pcs_[i] = 0;
+                counts_[i] = 0;
+            }
+            total_ = 0;
+            distinct_ = 0;
+            unbinned_ = 0;
+        }
+
+#if defined(FASTTIME_HOST) && defined(__linux__)
+        /**
+         * @brief Sample this process at @p hz of consumed CPU time (SIGPROF).
+         *
+         * @warning One profiler can be active at a time.
+         */
+        bool start(uint32_t hz = 1000)
+        {
+            active_ = this;
+            struct sigaction sa;
+            memset(&sa, 0, sizeof(sa));
+            sa.sa_sigaction = &SamplingProfiler::on_sigprof;
+            sa.sa_flags = SA_SIGINFO | SA_RESTART;
+            sigemptyset(&sa.sa_mask);
+            if (sigaction(SIGPROF, &sa, nullptr) != 0)
+            {
+                return false;
+            }
+            struct itimerval it;
+            it.it_interval.tv_sec = 0;
+            it.it_interval.tv_usec = hz >= 1000000 ? 1 : long(1000000 / (hz ? hz : 1));
+            it.it_value = it.it_interval;
+            return setitimer(ITIMER_PROF, &it, nullptr) == 0;
+        }
+
+        /** @brief Stop sampling (the handler stays installed but idle). */
+        void stop()
+        {
+            struct itimerval it;
+            memset(&it, 0, sizeof(it));
+            setitimer(ITIMER_PROF, &it, nullptr);
+            active_ = nullptr;
+        }
+#endif
+
+    private:
+        void add(uintptr_t pc)
+        {
+            ++total_;
+            // Fibonacci hash, linear probing.
+            size_t i = size_t((uint64_t(pc) * 0x9E3779B97F4A7C15ULL) >> 32) & (Buckets - 1);
+            for (size_t probe = 0; probe < Buckets; ++probe, i = (i + 1) & (Buckets - 1))
+            {
+                if (counts_[i] && pcs_[i] == pc)
+                {
+                    ++counts_[i];
+                    return;
+                }
+                if (!counts_[i])
+                {
+                    pcs_[i] = pc;
+                    counts_[i] = 1;
+                    ++distinct_;
+                    return;
+                }
+            }
+            ++unbinned_;
+        }
+
+#if defined(FASTTIME_HOST) && defined(__linux__)
+        static void on_sigprof(int, siginfo_t *, void *uc)
+        {
+            SamplingProfiler *self = active_;
+            if (!self)
+            {
+                return;
+            }
+            const ucontext_t *ctx = static_cast<const ucontext_t *>(uc);
+#if defined(__x86_64__)
+            const uintptr_t pc = uintptr_t(ctx->uc_mcontext.gregs[REG_RIP]);
+#elif defined(__i386__)
+            const uintptr_t pc = uintptr_t(ctx->uc_mcontext.gregs[REG_EIP]);
+#elif defined(__aarch64__)
+            const uintptr_t pc = uintptr_t(ctx->uc_mcontext.pc);
+#elif defined(__riscv)
+            const uintptr_t pc = uintptr_t(ctx->uc_mcontext.__gregs[REG_PC]);
+#else
+            const uintptr_t pc = 0;
+            (void)ctx;
+#endif
+            self->record(pc);
+        }
+
+        static inline SamplingProfiler *volatile active_ = nullptr;
+#endif
+
+        struct Core
+        {
+            ShardLock lock;
+            std::atomic<uint32_t> dropped{0};
+            RingBuffer<PcSample, RingCapacity> ring;
+        };
+
+        Core cores_[FASTTIME_SHARDS];
+        uintptr_t pcs_[Buckets] = {};
+        uint32_t counts_[Buckets] = {};
+        uint64_t total_ = 0;
+        uint32_t distinct_ = 0;
+        uint32_t unbinned_ = 0;
+    };
+
+} // namespace fasttime
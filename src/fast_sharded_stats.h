@@ -0,0 +1,118 @@
+#pragma once
+#include <stdint.h>
+
+#include "esp23_fast_timestamp.h"
+#include "fast_core_local.h"
+#include "fast_cycle_stats.h"
+
+/**
+ * @file fast_sharded_stats.h
+ * @brief Per-core (per-thread on host) sharded zone statistics merged on read.
+ *
+ * @details
+ * Each core records into its own @ref CycleStats shard, so the recording path touches no
+ * memory shared with the other core: a core-local @ref ShardLock (interrupt mask on target)
+ * plus the shard's sequence-lock update. Readers take a tear-free snapshot of every shard
+ * and merge them with @ref CycleAccumulator::merge, never blocking writers.
+ *
+ * @note The merged result is consistent per shard; it is not an atomic cut across shards.
+ *
+ * @code
+ * static fasttime::ShardedStats<> spi_zone;
+ * Timestamp t0 = Timestamp::now();
+ * spi_transfer();
+ * spi_zone.record(cycles_between(t0, Timestamp::now()));
+ * // any core, any time:
+ * CycleAccumulator all = spi_zone.snapshot();
+ * @endcode
+ */
+
+namespace fasttime
+{
+
+    /**
+     * @brief Zone statistics sharded by @ref current_shard.
+     *
+     * @tparam Shards Number of shards (defaults to @ref FASTTIME_SHARDS).
+     */
+    template <uint32_t Shards = FASTTIME_SHARDS>
+    class ShardedStats
+    {
+        static_assert(Shards > 0, "need at least one shard");
+
+    public:
+        /**
+         * @brief Record one cycle delta into the caller's shard.
+         *
+         * @remarks Safe from tasks (pinned or not) and ISRs up to level 3 on any core.
+         */
+        FASTTIME_ALWAYS_INLINE inline void record(uint64_t cycles)
+        {
+            uint32_t state;
+            Shard &s = enter_shard(shards_, state);
+            s.stats.record(cycles);
+            s.lock.exit(state);
+        }
+
+        /**
+         * @brief @ref record for any interrupt level (see @ref ShardLock::enter_from_isr).
+         */
+        FASTTIME_ALWAYS_INLINE inline void record_from_isr(uint64_t cycles)
+        {
+            uint32_t state;
+            Shard &s = enter_shard<true>(shards_, state);
+            s.stats.record(cycles);
+            s.lock.exit(state);
+        }
+
+        /**
+         * @brief Merge all shards into one accumulator.
+         */
+        inline CycleAccumulator snapshot() const
+        {
+            CycleAccumulator out;
+            out.reset();
+            for (uint32_t i = 0; i < Shards; ++i)
+            {
+                out.merge(shards_[i].stats.snapshot());
+            }
+            return out;
+        }
+
+        /**
+         * @brief Snapshot of a single shard (e.g. per-core breakdown).
+         */
+        inline CycleAccumulator shard_snapshot(uint32_t shard) const
+        {
+            return shards_[shard % Shards].stats.snapshot();
+        }
+
+        /**
+         * @brief Clear every shard.
+         *
+         * @warning Only excludes writers on the calling core; call while the zone is idle
+         *          elsewhere.
+         */
+        inline void reset()
+        {
+            for (uint32_t i = 0; i < Shards; ++i)
+            {
+                const uint32_t state = shards_[i].lock.enter();
+                shards_[i].stats.reset();
+                shards_[i].lock.exit(state);
+            }
+        }
+
+        static constexpr uint32_t shards() { return Shards; }
+
+    private:
+        struct alignas(FASTTIME_CACHELINE) Shard
+        {
+            ShardLock lock;
+            CycleStats stats;
+        };
+
+        Shard shards_[Shards];
+    };
+
+} // namespace fasttime
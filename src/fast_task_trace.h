@@ -0,0 +1,352 @@
+#pragma once
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp23_fast_timestamp.h"
+#include "fast_trace.h"
+
+#if defined(FASTTIME_HOST)
+#include <sched.h>
+#include <thread>
+#include <time.h>
+#include <utility>
+#else
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#endif
+
+/**
+ * @file fast_task_trace.h
+ * @brief Task context-switch tracing and per-task CPU time / run-queue wait analysis.
+ *
+ * @details
+ * Switch events go into @ref task_tracer as @ref TraceType::kTaskSwitchIn,
+ * @ref TraceType::kTaskSwitchOut and @ref TraceType::kTaskReady records:
+ * - On FreeRTOS the scheduler emits them through the trace macros in
+ *   @c fast_task_trace_hooks.h (task id = the TCB address).
+ * - On a host, @ref InstrumentedThread wraps @c std::thread and emits the same records around
+ *   its start, exit and blocking calls, so the analysis can be exercised under Linux.
+ *
+ * @ref TaskTraceAnalyzer consumes drained events and derives per task:
+ * - CPU time: switch-in to switch-out on the same core.
+ * - Run-queue wait: ready (or preempted) to the next switch-in.
+ * - Preemptions: a switch-out followed by a switch-in with no ready event in between, i.e. the
+ *   task never left the ready list. Explicit yields are counted here too.
+ *
+ * @code
+ * // one C++ file:
+ * #define FASTTIME_TASK_TRACE_IMPLEMENTATION
+ * #include <fast_task_trace.h>
+ *
+ * static fasttime::TaskTraceAnalyzer<> tasks;
+ * // periodically, from a low-priority task:
+ * fasttime::task_tracer.drain_ordered([](const fasttime::TraceEvent &e) { tasks.feed(e); });
+ * @endcode
+ */
+
+namespace fasttime
+{
+
+    /**
+     * @brief Tracer fed by the task switch hooks and @ref InstrumentedThread.
+     */
+    inline Tracer<> task_tracer;
+
+    // ----------------------------------------------------------------------------
+    // Analysis
+    // ----------------------------------------------------------------------------
+
+    /**
+     * @brief Accumulated scheduling statistics of one task.
+     */
+    struct TaskTraceStats
+    {
+        uint32_t id;           ///< Task id (TCB address on FreeRTOS).
+        uint64_t cpu_cycles;   ///< Time spent running.
+        uint64_t wait_cycles;  ///< Time spent ready but not running.
+        uint64_t max_wait;     ///< Longest single run-queue wait.
+        uint32_t switches_in;  ///< Times scheduled.
+        uint32_t preemptions;  ///< Switched out while still ready.
+    };
+
+    /**
+     * @brief Per-task CPU time, run-queue wait and preemption counts from drained events.
+     *
+     * @tparam MaxTasks Tasks tracked; further ids are counted in @ref untracked.
+     *
+     * @warning Events must arrive in time order with extended ticks
+     *          (@ref Tracer::drain_ordered).
+     */
+    template <size_t MaxTasks = 32>
+    class TaskTraceAnalyzer
+    {
+    public:
+        /**
+         * @brief Consume one event.
+         */
+        void feed(const TraceEvent &e)
+        {
+            if (e.type != TraceType::kTaskSwitchIn && e.type != TraceType::kTaskSwitchOut &&
+                e.type != TraceType::kTaskReady)
+            {
+                return;
+            }
+            Task *t = find_or_add(e.arg);
+            if (!t)
+            {
+                ++untracked_;
+                return;
+            }
+            if (!started_)
+            {
+                first_ticks_ = e.ticks;
+                started_ = true;
+            }
+            last_ticks_ = e.ticks;
+
+            switch (e.type)
+            {
+            case TraceType::kTaskReady:
+                if (t->state != kRunning && t->state != kReady)
+                {
+                    t->state = kReady;
+                    t->since = e.ticks;
+                }
+                break;
+            case TraceType::kTaskSwitchOut:
+                if (t->state == kRunning)
+                {
+                    t->stats.cpu_cycles += e.ticks - t->since;
+                }
+                // Tentatively preempted; a ready event before the next switch-in means it blocked.
+                t->state = kOut;
+                t->since = e.ticks;
+                break;
+            case TraceType::kTaskSwitchIn:
+                if (t->state == kOut || t->state == kReady)
+                {
+                    const uint64_t wait = e.ticks - t->since;
+                    t->stats.wait_cycles += wait;
+                    t->stats.max_wait = wait > t->stats.max_wait ? wait : t->stats.max_wait;
+                    if (t->state == kOut)
+                    {
+                        ++t->stats.preemptions;
+                    }
+                }
+                ++t->stats.switches_in;
+                t->state = kRunning;
+                t->since = e.ticks;
+                break;
+            default:
+                break;
+            }
+        }
+
+        /**
+         * @brief Call @p fn with the stats of every task seen.
+         *
+         * @remarks Tasks still running are credited up to the last event fed.
+         */
+        template <typename Fn>
+        void for_each(Fn &&fn) const
+        {
+            for (size_t i = 0; i < count_; ++i)
+            {
+                TaskTraceStats s = tasks_[i].stats;
+                if (tasks_[i].state == kRunning)
+                {
+                    s.cpu_cycles += last_ticks_ - tasks_[i].since;
+                }
+                fn(static_cast<const TaskTraceStats &>(s));
+            }
+        }
+
+        /** @brief Cycles between the first and last event fed. */
+        inline uint64_t span_cycles() const { return started_ ? last_ticks_ - first_ticks_ : 0; }
+
+        /** @brief Tasks tracked. */
+        inline size_t tasks() const { return count_; }
+
+        /** @brief Events for tasks beyond @p MaxTasks. */
+        inline uint32_t untracked() const { return untracked_; }
+
+        inline void reset()
+        {
+            count_ = 0;
+            untracked_ = 0;
+            started_ = false;
+        }
+
+    private:
+        enum State : uint8_t
+        {
+            kUnknown,
+            kReady,
+            kRunning,
+            kOut,
+        };
+
+        struct Task
+        {
+            TaskTraceStats stats;
+            uint64_t since;
+            State state;
+        };
+
+        Task *find_or_add(uint32_t id)
+        {
+            for (size_t i = 0; i < count_; ++i)
+            {
+                if (tasks_[i].stats.id == id)
+                {
+                    return &tasks_[i];
+                }
+            }
+            if (count_ == MaxTasks)
+            {
+                return nullptr;
+            }
+            Task &t = tasks_[count_++];
+            t.stats = TaskTraceStats{id, 0, 0, 0, 0, 0};
+            t.since = 0;
+            t.state = kUnknown;
+            return &t;
+        }
+
+        Task tasks_[MaxTasks];
+        size_t count_ = 0;
+        uint32_t untracked_ = 0;
+        bool started_ = false;
+        uint64_t first_ticks_ = 0;
+        uint64_t last_ticks_ = 0;
+    };
+
+#if defined(FASTTIME_HOST)
+    // ----------------------------------------------------------------------------
+    // Host: instrumented thread
+    // ----------------------------------------------------------------------------
+
+    /**
+     * @brief @c std::thread that reports its scheduling to @ref task_tracer.
+     *
+     * @details The kernel's own switches are invisible to user space, so the wrapper emits
+     *          switch-out / ready / switch-in around the blocking calls it offers
+     *          (@ref sleep_for_ns, @ref block, @ref yield) and around the thread's lifetime.
+     *          The task function receives the wrapper to make those calls.
+     */
+    class InstrumentedThread
+    {
+    public:
+        /**
+         * @param id Task id recorded in the trace.
+         * @param fn Callable taking @c InstrumentedThread&.
+         */
+        template <typename Fn>
+        InstrumentedThread(uint32_t id, Fn &&fn) : id_(id)
+        {
+            task_tracer.emit(TraceType::kTaskReady, id_);
+            thread_ = std::thread([this, f = std::forward<Fn>(fn)]() mutable {
+                task_tracer.emit(TraceType::kTaskSwitchIn, id_);
+                f(*this);
+                task_tracer.emit(TraceType::kTaskSwitchOut, id_);
+            });
+        }
+
+        ~InstrumentedThread()
+        {
+            if (thread_.joinable())
+            {
+                thread_.join();
+            }
+        }
+
+        InstrumentedThread(const InstrumentedThread &) = delete;
+        InstrumentedThread &operator=(const InstrumentedThread &) = delete;
+
+        /** @brief Block for @p ns nanoseconds (switch-out, ready on wake-up, switch-in). */
+        void sleep_for_ns(uint64_t ns)
+        {
+            block([ns] {
+                struct timespec ts;
+                ts.tv_sec = time_t(ns / 1000000000ULL);
+                ts.tv_nsec = long(ns % 1000000000ULL);
+                nanosleep(&ts, nullptr);
+            });
+        }
+
+        /**
+         * @brief Run a blocking call (lock, condition wait, I/O) as a block/wake cycle.
+         */
+        template <typename Wait>
+        void block(Wait &&wait)
+        {
+            task_tracer.emit(TraceType::kTaskSwitchOut, id_);
+            wait();
+            task_tracer.emit(TraceType::kTaskReady, id_);
+            task_tracer.emit(TraceType::kTaskSwitchIn, id_);
+        }
+
+        /** @brief Give up the CPU while staying runnable (recorded as a preemption). */
+        void yield()
+        {
+            task_tracer.emit(TraceType::kTaskSwitchOut, id_);
+            sched_yield();
+            task_tracer.emit(TraceType::kTaskSwitchIn, id_);
+        }
+
+        void join() { thread_.join(); }
+
+        inline uint32_t id() const { return id_; }
+
+    private:
+        uint32_t id_;
+        std::thread thread_;
+    };
+#endif
+
+} // namespace fasttime
+
+#if defined(FASTTIME_TASK_TRACE_IMPLEMENTATION)
+// ----------------------------------------------------------------------------
+// FreeRTOS hook implementations (see fast_task_trace_hooks.h)
+// ----------------------------------------------------------------------------
+//
+// The scheduler calls these with interrupts masked, including from the FromISR paths and while
+// the flash cache is disabled, so they are FASTTIME_HOT (IRAM) and everything they reach is
+// inlined. xTaskGetCurrentTaskHandle is part of the kernel, which ESP-IDF keeps in IRAM unless
+// CONFIG_FREERTOS_PLACE_FUNCTIONS_INTO_FLASH is set. Host builds compile the hooks too (the
+// task id is then a per-thread address) so extras/hot_path_check can verify them.
+
+namespace fasttime
+{
+    namespace detail
+    {
+        /// Id of the running task: its TCB address on FreeRTOS.
+        static inline FASTTIME_ALWAYS_INLINE uint32_t current_task_id()
+        {
+#if defined(FASTTIME_HOST)
+            static thread_local char tag;
+            return (uint32_t)(uintptr_t)&tag;
+#else
+            return (uint32_t)(uintptr_t)xTaskGetCurrentTaskHandle();
+#endif
+        }
+    } // namespace detail
+} // namespace fasttime
+
+extern "C" FASTTIME_HOT void fasttime_trace_task_switched_in(void)
+{
+    fasttime::task_tracer.emit(fasttime::TraceType::kTaskSwitchIn, fasttime::detail::current_task_id());
+}
+
+extern "C" FASTTIME_HOT void fasttime_trace_task_switched_out(void)
+{
+    fasttime::task_tracer.emit(fasttime::TraceType::kTaskSwitchOut, fasttime::detail::current_task_id());
+}
+
+extern "C" FASTTIME_HOT void fasttime_trace_task_ready(void *task)
+{
+    fasttime::task_tracer.emit(fasttime::TraceType::kTaskReady, (uint32_t)(uintptr_t)task);
+}
+#endif
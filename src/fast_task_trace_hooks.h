@@ -0,0 +1,43 @@
+#pragma once
+
+/**
+ * @file fast_task_trace_hooks.h
+ * @brief FreeRTOS trace macros that feed @c fasttime::task_tracer (C compatible).
+ *
+ * @details
+ * FreeRTOS calls @c traceTASK_SWITCHED_IN / @c traceTASK_SWITCHED_OUT from the scheduler and
+ * @c traceMOVED_TASK_TO_READY_STATE whenever a task enters the ready list. The kernel only
+ * picks these up when they are defined while @c tasks.c is compiled, so force-include this
+ * header into the FreeRTOS component (ESP-IDF):
+ *
+ * @code
+ * # main/CMakeLists.txt
+ * idf_component_get_property(freertos_lib freertos COMPONENT_LIB)
+ * target_compile_options(${freertos_lib} PRIVATE -include fast_task_trace_hooks.h)
+ * target_include_directories(${freertos_lib} PRIVATE ${FASTTIME_SRC_DIR})
+ * @endcode
+ *
+ * and define @c FASTTIME_TASK_TRACE_IMPLEMENTATION in exactly one C++ file before including
+ * @c fast_task_trace.h, which emits the hook functions below. Prebuilt Arduino cores cannot be
+ * re-hooked this way; use Arduino as an ESP-IDF component.
+ */
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    void fasttime_trace_task_switched_in(void);
+    void fasttime_trace_task_switched_out(void);
+    void fasttime_trace_task_ready(void *task);
+
+#ifdef __cplusplus
+}
+#endif
+
+#undef traceTASK_SWITCHED_IN
+#undef traceTASK_SWITCHED_OUT
+#undef traceMOVED_TASK_TO_READY_STATE
+#define traceTASK_SWITCHED_IN() fasttime_trace_task_switched_in()
+#define traceTASK_SWITCHED_OUT() fasttime_trace_task_switched_out()
+#define traceMOVED_TASK_TO_READY_STATE(pxTCB) fasttime_trace_task_ready((void *)(pxTCB))
@@ -0,0 +1,324 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "esp23_fast_timestamp.h"
+
+/**
+ * @file fast_time_transfer.h
+ * @brief Transport-agnostic two-way time transfer (PTP-style) between devices.
+ *
+ * @details
+ * A client and a server exchange small datagrams over any transport (UDP, ESP-NOW, BLE, a UART):
+ *
+ *     client                  server
+ *     t1  ── request ──►  t2
+ *     t4  ◄── reply ───   t3
+ *
+ * All four stamps come from @ref Timestamp::now, extended to 64 bits and converted to
+ * nanoseconds of each side's local clock. Per exchange:
+ * - offset = ((t2 - t1) + (t3 - t4)) / 2   (server clock minus client clock)
+ * - delay  = (t4 - t1) - (t3 - t2)         (round trip excluding server turnaround)
+ *
+ * Queuing only ever adds delay, so the client keeps a window of recent exchanges, uses the
+ * minimum-delay one as the current offset, and fits a line through the minimum-delay sample
+ * of each window to estimate skew (relative frequency error). @ref TimeTransferClient::to_server_ns
+ * then maps any local time onto the server's clock.
+ *
+ * The module never touches a socket: the application passes a send callback and feeds every
+ * received datagram to @c on_datagram. That makes it usable on ESP32 and testable on a host with
+ * a loopback socket or an in-memory link that injects asymmetric delay.
+ *
+ * @note Asymmetric paths bias the offset by half the asymmetry; no two-way method can see it.
+ */
+
+namespace fasttime
+{
+
+    /**
+     * @brief Sends one datagram. Returns false if it could not be queued.
+     */
+    using DatagramSend = bool (*)(void *ctx, const void *data, size_t len);
+
+    /**
+     * @brief Wire format of a time-transfer message (little-endian, 40 bytes).
+     */
+    struct TimeTransferPacket
+    {
+        static constexpr uint32_t kMagic = 0x46545331; ///< "FTS1"
+        static constexpr uint16_t kRequest = 1;
+        static constexpr uint16_t kReply = 2;
+
+        uint32_t magic;
+        uint16_t type;
+        uint16_t seq;
+        uint64_t t1; ///< Client send time (client ns).
+        uint64_t t2; ///< Server receive time (server ns).
+        uint64_t t3; ///< Server send time (server ns).
+        uint64_t reserved;
+    };
+    static_assert(sizeof(TimeTransferPacket) == 40, "packet layout must not depend on the ABI");
+
+    /**
+     * @brief Local clock in nanoseconds: extended cycle counter × nominal period.
+     */
+    class LocalNsClock
+    {
+    public:
+        explicit LocalNsClock(uint64_t freq_hz = FASTTIME_FREQ_HZ)
+            : cvt_(NsConverter::make(freq_hz)), clock_(CycleExtender::make()) {}
+
+        /**
+         * @brief Local nanoseconds at @p ts, advancing the clock to it.
+         *
+         * @warning For the protocol's own stamps: feed them in order, at least once per counter
+         *          wrap. Convert arbitrary timestamps with @ref ns_at.
+         */
+        inline uint64_t ns(const Timestamp ts) { return cvt_.to_ns(clock_.extend(ts)); }
+
+        inline uint64_t now() { return ns(Timestamp::now()); }
+
+        /**
+         * @brief Local nanoseconds at @p ts without moving the clock.
+         *
+         * @details @p ts may lie before or after the latest protocol stamp, by up to half a
+         *          counter wrap on 32-bit counters (~8.9 s @ 240 MHz) and without a practical
+         *          limit on 64-bit ones.
+         */
+        inline uint64_t ns_at(const Timestamp ts) const
+        {
+            const int64_t delta = sizeof(fast_counter_t) == 4
+                                      ? int64_t(int32_t(ts.ticks - clock_.last))
+                                      : int64_t(ts.ticks - clock_.last);
+            const uint64_t base = cvt_.to_ns(clock_.ext);
+            const uint64_t off = cvt_.to_ns(uint64_t(delta < 0 ? -delta : delta));
+            return delta < 0 ? base - off : base + off;
+        }
+
+    private:
+        NsConverter cvt_;
+        CycleExtender clock_;
+    };
+
+    /**
+     * @brief Server side: answers requests with its receive/send stamps.
+     */
+    class TimeTransferServer
+    {
+    public:
+        TimeTransferServer(DatagramSend send, void *ctx, uint64_t freq_hz = FASTTIME_FREQ_HZ)
+            : send_(send), ctx_(ctx), clock_(freq_hz) {}
+
+        /**
+         * @brief Handle a received datagram.
+         *
+         * @param rx Timestamp taken when the datagram arrived (as early as possible).
+         * @return true if it was a request and a reply was sent.
+         */
+        bool on_datagram(const void *data, size_t len, const Timestamp rx = Timestamp::now())
+        {
+            TimeTransferPacket p;
+            if (len != sizeof(p))
+            {
+                return false;
+            }
+            memcpy(&p, data, sizeof(p));
+            if (p.magic != TimeTransferPacket::kMagic || p.type != TimeTransferPacket::kRequest)
+            {
+                return false;
+            }
+            p.type = TimeTransferPacket::kReply;
+            p.t2 = clock_.ns(rx);
+            p.t3 = clock_.now();
+            return send_(ctx_, &p, sizeof(p));
+        }
+
+    private:
+        DatagramSend send_;
+        void *ctx_;
+        LocalNsClock clock_;
+    };
+
+    /**
+     * @brief Result of one completed exchange.
+     */
+    struct TimeTransferSample
+    {
+        uint64_t local_ns; ///< Client time of the exchange midpoint.
+        int64_t offset_ns; ///< Server minus client.
+        uint64_t delay_ns; ///< Round-trip path delay.
+    };
+
+    /**
+     * @brief Client side: runs exchanges and estimates offset and skew to the server.
+     *
+     * @tparam Window Exchanges per minimum-delay filter window.
+     * @tparam Fits   Filtered samples kept for the skew regression.
+     */
+    template <size_t Window = 8, size_t Fits = 8>
+    class TimeTransferClient
+    {
+        static_assert(Window > 0 && Fits >= 2, "need a window and at least two fit points");
+
+    public:
+        TimeTransferClient(DatagramSend send, void *ctx, uint64_t freq_hz = FASTTIME_FREQ_HZ)
+            : send_(send), ctx_(ctx), clock_(freq_hz) {}
+
+        /**
+         * @brief Send a request. Call periodically; only the latest request is matched.
+         */
+        bool poll()
+        {
+            TimeTransferPacket p;
+            memset(&p, 0, sizeof(p));
+            p.magic = TimeTransferPacket::kMagic;
+            p.type = TimeTransferPacket::kRequest;
+            p.seq = ++seq_;
+            p.t1 = clock_.now();
+            return send_(ctx_, &p, sizeof(p));
+        }
+
+        /**
+         * @brief Handle a received datagram.
+         *
+         * @param rx Timestamp taken when the datagram arrived.
+         * @return true if it completed an exchange.
+         */
+        bool on_datagram(const void *data, size_t len, const Timestamp rx = Timestamp::now())
+        {
+            TimeTransferPacket p;
+            if (len != sizeof(p))
+            {
+                return false;
+            }
+            memcpy(&p, data, sizeof(p));
+            if (p.magic != TimeTransferPacket::kMagic || p.type != TimeTransferPacket::kReply ||
+                p.seq != seq_)
+            {
+                return false;
+            }
+            const uint64_t t4 = clock_.ns(rx);
+            const int64_t fwd = int64_t(p.t2 - p.t1);
+            const int64_t rev = int64_t(p.t3 - t4);
+            const int64_t rtt = int64_t(t4 - p.t1) - int64_t(p.t3 - p.t2);
+
+            TimeTransferSample s;
+            s.local_ns = p.t1 + (t4 - p.t1) / 2;
+            s.offset_ns = (fwd + rev) / 2;
+            s.delay_ns = rtt < 0 ? 0 : uint64_t(rtt);
+            last_ = s;
+            ++seq_; // drop duplicates of this reply
+
+            if (window_n_ == 0 || s.delay_ns < window_best_.delay_ns)
+            {
+                window_best_ = s;
+            }
+            if (++window_n_ == Window)
+            {
+                add_fit(window_best_);
+                window_n_ = 0;
+            }
+            if (!have_best_ || s.delay_ns <= best_.delay_ns ||
+                s.local_ns - best_.local_ns > stale_ns_)
+            {
+                best_ = s;
+                have_best_ = true;
+            }
+            return true;
+        }
+
+        /** @brief true once at least one exchange completed. */
+        inline bool synced() const { return have_best_; }
+
+        /** @brief Most recent raw exchange. */
+        inline const TimeTransferSample &last() const { return last_; }
+
+        /**
+         * @brief Estimated skew in ppb (server frequency relative to client), 0 until enough
+         *        windows have been filtered.
+         */
+        inline int32_t skew_ppb() const { return int32_t(skew_ * 1e9); }
+
+        /**
+         * @brief Offset (server - client) at local time @p local_ns, extrapolated with the skew.
+         */
+        inline int64_t offset_at(uint64_t local_ns) const
+        {
+            const double dt = double(int64_t(local_ns - best_.local_ns));
+            return best_.offset_ns + int64_t(skew_ * dt);
+        }
+
+        /**
+         * @brief Map a local timestamp onto the server's clock (ns).
+         *
+         * @details @p ts may be older than the latest exchange (e.g. a trace event); see
+         *          @ref LocalNsClock::ns_at for the range.
+         */
+        inline uint64_t to_server_ns(const Timestamp ts) const
+        {
+            const uint64_t local = clock_.ns_at(ts);
+            return local + uint64_t(offset_at(local));
+        }
+
+        /**
+         * @brief Age after which a lower-delay but older sample stops anchoring the offset.
+         */
+        inline void set_stale_ns(uint64_t ns) { stale_ns_ = ns; }
+
+        /** @brief Local clock used for t1/t4 (shared with @ref to_server_ns). */
+        inline LocalNsClock &clock() { return clock_; }
+
+    private:
+        /// Least-squares slope of offset against local time over the filtered samples.
+        void add_fit(const TimeTransferSample &s)
+        {
+            fits_[fit_head_] = s;
+            fit_head_ = (fit_head_ + 1) % Fits;
+            if (fit_n_ < Fits)
+            {
+                ++fit_n_;
+            }
+            if (fit_n_ < 2)
+            {
+                return;
+            }
+            const TimeTransferSample &ref = s;
+            double sx = 0, sy = 0, sxx = 0, sxy = 0;
+            for (size_t i = 0; i < fit_n_; ++i)
+            {
+                const double x = double(int64_t(fits_[i].local_ns - ref.local_ns));
+                const double y = double(fits_[i].offset_ns - ref.offset_ns);
+                sx += x;
+                sy += y;
+                sxx += x * x;
+                sxy += x * y;
+            }
+            const double n = double(fit_n_);
+            const double den = n * sxx - sx * sx;
+            if (den > 0)
+            {
+                skew_ = (n * sxy - sx * sy) / den;
+            }
+        }
+
+        DatagramSend send_;
+        void *ctx_;
+        LocalNsClock clock_;
+        uint16_t seq_ = 0;
+
+        TimeTransferSample last_{0, 0, 0};
+        TimeTransferSample best_{0, 0, 0};
+        bool have_best_ = false;
+        uint64_t stale_ns_ = 10000000000ULL; // 10 s
+
+        TimeTransferSample window_best_{0, 0, 0};
+        size_t window_n_ = 0;
+
+        TimeTransferSample fits_[Fits];
+        size_t fit_head_ = 0;
+        size_t fit_n_ = 0;
+        double skew_ = 0;
+    };
+
+} // namespace fasttime
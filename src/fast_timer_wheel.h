@@ -0,0 +1,341 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp23_fast_timestamp.h"
+
+/**
+ * @file fast_timer_wheel.h
+ * @brief Hashed hierarchical timing wheel driven by the CPU cycle counter.
+ *
+ * @details
+ * Intended for large numbers of short-lived timeouts (retransmits, watchdogs) where
+ * @c esp_timer is too expensive per arm/disarm:
+ * - O(1) @ref TimerWheel::schedule_after and @ref TimerWheel::cancel.
+ * - Intrusive nodes from a fixed pool sized at compile time; no heap.
+ * - @ref TimerWheel::advance fires everything that expired since the previous call in one batch,
+ *   skipping empty slots with an occupancy mask.
+ *
+ * Wheel ticks are @c 2^tick_shift cycles. Level 0 resolves single ticks, each further level is
+ * @c 2^LevelBits times coarser and is cascaded down as time passes. Timers beyond the top
+ * level are parked in its last slot and re-placed on each cascade.
+ *
+ * @par Wrap behavior
+ * Time is tracked with a @ref CycleExtender, so the 32-bit Xtensa counter is handled as long
+ * as @ref TimerWheel::advance runs at least once per counter wrap (~17.9 s @ 240 MHz).
+ *
+ * @warning Not thread-safe. Own the wheel from a single task (or guard it externally).
+ *
+ * @code
+ * static fasttime::TimerWheel<256> wheel;
+ * auto h = wheel.schedule_after(cycles, on_timeout, &conn);
+ * // ...
+ * wheel.cancel(h);
+ * // in the main loop:
+ * wheel.advance(fasttime::Timestamp::now());
+ * @endcode
+ */
+
+namespace fasttime
+{
+
+    /**
+     * @brief Reference to a scheduled timer.
+     *
+     * @details The generation guards against cancelling a node that has since been reused.
+     */
+    struct TimerHandle
+    {
+        uint32_t index;      ///< Pool slot.
+        uint32_t generation; ///< Pool generation at schedule time (0 = invalid).
+
+        inline bool valid() const { return generation != 0; }
+    };
+
+    /**
+     * @brief Timer expiry callback. Runs from @ref TimerWheel::advance.
+     */
+    using TimerCallback = void (*)(void *ctx);
+
+    /**
+     * @brief Hierarchical timing wheel with a fixed node pool.
+     *
+     * @tparam Capacity  Maximum number of concurrently armed timers.
+     * @tparam LevelBits log2 of the slots per level (max 6, level-0 occupancy is a 64-bit mask).
+     * @tparam Levels    Number of wheel levels (at least 2, so far timers have a level to wait in
+     *                   and be cascaded from). Range is @c 2^(LevelBits*Levels) ticks.
+     */
+    template <size_t Capacity, uint32_t LevelBits = 6, uint32_t Levels = 4>
+    class TimerWheel
+    {
+        static_assert(Capacity > 0 && Capacity < 0xFFFFFFFFu, "Capacity must fit a 32-bit index");
+        static_assert(LevelBits >= 1 && LevelBits <= 6, "LevelBits must be in [1, 6]");
+        static_assert(Levels >= 2 && LevelBits * Levels <= 48, "need two or more levels within a 48-bit range");
+
+    public:
+        /**
+         * @brief Create an empty wheel.
+         *
+         * @param tick_shift log2 of the tick length in cycles (12 → ~17 µs @ 240 MHz).
+         * @param start      Time origin; later timestamps must not precede it.
+         */
+        explicit TimerWheel(uint32_t tick_shift = 12, const Timestamp start = Timestamp::now())
+            : shift_(tick_shift), clock_(CycleExtender::make(start))
+        {
+            base_ = (clock_.ext >> shift_) + 1;
+            for (uint32_t i = 0; i < kLevelSlots; ++i)
+            {
+                slots_[i].next = slots_[i].prev = &slots_[i];
+            }
+            for (size_t i = 0; i < Capacity; ++i)
+            {
+                nodes_[i].next = (i + 1 < Capacity) ? &nodes_[i + 1] : nullptr;
+                nodes_[i].generation = 1;
+                nodes_[i].slot = kFree;
+            }
+            free_ = &nodes_[0];
+        }
+
+        TimerWheel(const TimerWheel &) = delete;
+        TimerWheel &operator=(const TimerWheel &) = delete;
+
+        /**
+         * @brief Arm a timer @p cycles from now.
+         * @return Handle, or an invalid handle if the pool is exhausted.
+         */
+        inline TimerHandle schedule_after(uint64_t cycles, TimerCallback cb, void *ctx)
+        {
+            return schedule_after(Timestamp::now(), cycles, cb, ctx);
+        }
+
+        /**
+         * @brief Arm a timer @p cycles after @p now.
+         *
+         * @details The expiry is rounded up to the next tick, so a timer never fires early.
+         *
+         * @warning @p now must not precede the timestamp of the last @ref advance.
+         */
+        TimerHandle schedule_after(const Timestamp now, uint64_t cycles, TimerCallback cb, void *ctx)
+        {
+            Node *n = static_cast<Node *>(free_);
+            if (n == nullptr)
+            {
+                return TimerHandle{0, 0};
+            }
+            free_ = n->next;
+
+            const uint64_t round = (uint64_t(1) << shift_) - 1;
+            n->expiry = (clock_.peek(now) + cycles + round) >> shift_;
+            n->cb = cb;
+            n->ctx = ctx;
+            place(n);
+            ++armed_;
+            return TimerHandle{uint32_t(n - nodes_), n->generation};
+        }
+
+        /**
+         * @brief Disarm a pending timer.
+         * @return true if the timer was still pending (it will not fire).
+         */
+        bool cancel(const TimerHandle h)
+        {
+            if (h.index >= Capacity)
+            {
+                return false;
+            }
+            Node *n = &nodes_[h.index];
+            if (n->generation != h.generation || n->slot == kFree)
+            {
+                return false;
+            }
+            unlink(n);
+            release(n);
+            return true;
+        }
+
+        /**
+         * @brief Fire every timer that expired up to @p now.
+         *
+         * @details Callbacks may schedule or cancel timers, including ones in the same batch.
+         * @return Number of callbacks invoked.
+         */
+        size_t advance(const Timestamp now)
+        {
+            const uint64_t target = clock_.extend(now) >> shift_;
+            size_t fired = 0;
+
+            while (base_ <= target)
+            {
+                if (armed_ == 0)
+                {
+                    base_ = target + 1;
+                    break;
+                }
+
+                const uint32_t index = uint32_t(base_ & kMask);
+                if (index == 0)
+                {
+                    cascade();
+                }
+                else if (((occupied_ >> index) & 1u) == 0)
+                {
+                    // Jump to the next occupied level-0 slot or the next cascade point.
+                    const uint64_t occ = occupied_ >> index;
+                    const uint64_t next = occ ? base_ + uint32_t(__builtin_ctzll(occ))
+                                              : (base_ | kMask) + 1;
+                    base_ = next < target + 1 ? next : target + 1;
+                    continue;
+                }
+
+                Link batch;
+                batch.next = batch.prev = &batch;
+                splice(index, &batch);
+                ++base_;
+
+                while (batch.next != &batch)
+                {
+                    Node *n = static_cast<Node *>(batch.next);
+                    const TimerCallback cb = n->cb;
+                    void *const ctx = n->ctx;
+                    unlink(n);
+                    release(n);
+                    cb(ctx);
+                    ++fired;
+                }
+            }
+            return fired;
+        }
+
+        /** @brief Number of timers currently armed. */
+        inline size_t armed() const { return armed_; }
+
+        /** @brief Length of one wheel tick in cycles. */
+        inline uint64_t tick_cycles() const { return uint64_t(1) << shift_; }
+
+    private:
+        static constexpr uint32_t kSlots = 1u << LevelBits;
+        static constexpr uint64_t kMask = kSlots - 1;
+        static constexpr uint32_t kLevelSlots = kSlots * Levels;
+        static constexpr uint32_t kFree = 0xFFFF;
+        static constexpr uint32_t kDetached = 0xFFFE;
+
+        struct Link
+        {
+            Link *next;
+            Link *prev;
+        };
+
+        struct Node : Link
+        {
+            uint64_t expiry;     ///< Absolute expiry tick.
+            TimerCallback cb;
+            void *ctx;
+            uint32_t generation; ///< Bumped on release; never 0.
+            uint32_t slot;       ///< Wheel slot, @ref kDetached while firing, @ref kFree in the pool.
+        };
+
+        static_assert(kLevelSlots < kDetached, "slot index collides with node states");
+
+        void place(Node *n)
+        {
+            uint64_t e = n->expiry < base_ ? base_ : n->expiry;
+            const uint64_t delta = e - base_;
+            uint32_t level = 0;
+            while (level + 1 < Levels && delta >= (uint64_t(1) << ((level + 1) * LevelBits)))
+            {
+                ++level;
+            }
+            if (delta >= (uint64_t(1) << (Levels * LevelBits)))
+            {
+                e = base_ + (uint64_t(1) << (Levels * LevelBits)) - 1;
+            }
+
+            const uint32_t idx = uint32_t((e >> (level * LevelBits)) & kMask);
+            const uint32_t slot = level * kSlots + idx;
+            Link *head = &slots_[slot];
+            n->slot = slot;
+            n->prev = head->prev;
+            n->next = head;
+            head->prev->next = n;
+            head->prev = n;
+            if (level == 0)
+            {
+                occupied_ |= uint64_t(1) << idx;
+            }
+        }
+
+        void unlink(Node *n)
+        {
+            n->prev->next = n->next;
+            n->next->prev = n->prev;
+            if (n->slot < kSlots && slots_[n->slot].next == &slots_[n->slot])
+            {
+                occupied_ &= ~(uint64_t(1) << n->slot);
+            }
+        }
+
+        void release(Node *n)
+        {
+            n->slot = kFree;
+            if (++n->generation == 0)
+            {
+                n->generation = 1;
+            }
+            n->next = free_;
+            free_ = n;
+            --armed_;
+        }
+
+        /// Move level-0 slot @p index onto @p out and mark its nodes detached.
+        void splice(uint32_t index, Link *out)
+        {
+            Link *head = &slots_[index];
+            if (head->next == head)
+            {
+                return;
+            }
+            for (Link *l = head->next; l != head; l = l->next)
+            {
+                static_cast<Node *>(l)->slot = kDetached;
+            }
+            out->next = head->next;
+            out->prev = head->prev;
+            out->next->prev = out;
+            out->prev->next = out;
+            head->next = head->prev = head;
+            occupied_ &= ~(uint64_t(1) << index);
+        }
+
+        /// Re-place the coarse slots whose period starts at @ref base_.
+        void cascade()
+        {
+            for (uint32_t level = 1; level < Levels; ++level)
+            {
+                const uint32_t idx = uint32_t((base_ >> (level * LevelBits)) & kMask);
+                Link *head = &slots_[level * kSlots + idx];
+                Link *l = head->next;
+                head->next = head->prev = head;
+                while (l != head)
+                {
+                    Link *next = l->next;
+                    place(static_cast<Node *>(l));
+                    l = next;
+                }
+                if (idx != 0)
+                {
+                    break;
+                }
+            }
+        }
+
+        uint32_t shift_;
+        CycleExtender clock_;
+        uint64_t base_;          ///< Next tick to process.
+        uint64_t occupied_ = 0;  ///< Level-0 slot occupancy mask.
+        size_t armed_ = 0;
+        Link *free_ = nullptr;
+        Link slots_[kLevelSlots];
+        Node nodes_[Capacity];
+    };
+
+} // namespace fasttime
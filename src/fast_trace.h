@@ -0,0 +1,271 @@
+#pragma once
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp23_fast_timestamp.h"
+#include "fast_core_local.h"
+#include "fast_core_sync.h"
+#include "fast_ring_buffer.h"
+
+/**
+ * @file fast_trace.h
+ * @brief Per-core event trace: fixed-size records in per-core ring buffers.
+ *
+ * @details
+ * Every @ref TraceEvent is 16 bytes: raw counter ticks, a type, the recording core and a
+ * 32-bit argument (task handle, zone id, value). @ref Tracer keeps one @ref RingBuffer per
+ * core (per @ref current_shard on host); @ref Tracer::emit masks interrupts on the local core
+ * (@ref ShardLock) for the push, so tasks and ISRs on that core form a single producer and the
+ * other core never contends. When a ring is full the event is dropped and counted.
+ *
+ * A reader task drains the rings. @ref Tracer::drain_ordered merges them in time order, maps
+ * every core onto the reference counter (@ref CoreClockOffsets) and extends the ticks to 64
+ * bits, which is what analysis code (@ref TaskTraceAnalyzer) expects.
+ *
+ * @par Wrap period
+ * On 32-bit counters, drain at least every few seconds (events must be < 2^31 cycles apart to
+ * order and extend correctly).
+ */
+
+/**
+ * @def FASTTIME_TRACE_CAPACITY
+ * @brief Default per-core ring size in events (power of two).
+ */
+#ifndef FASTTIME_TRACE_CAPACITY
+#if defined(FASTTIME_HOST)
+#define FASTTIME_TRACE_CAPACITY 1024
+#else
+#define FASTTIME_TRACE_CAPACITY 256
+#endif
+#endif
+
+namespace fasttime
+{
+
+    /**
+     * @brief Event kinds. Values are part of the trace format; append only.
+     */
+    enum class TraceType : uint8_t
+    {
+        kNone = 0,
+        kZoneBegin = 1,     ///< arg: zone id.
+        kZoneEnd = 2,       ///< arg: zone id.
+        kTaskSwitchIn = 3,  ///< arg: task id, now running on @c core.
+        kTaskSwitchOut = 4, ///< arg: task id, stopped running on @c core.
+        kTaskReady = 5,     ///< arg: task id, moved to the ready list.
+        kMarker = 6,        ///< arg: user value.
+        kValue = 7,         ///< arg: user value; aux: channel.
+    };
+
+    /**
+     * @brief Short lowercase name of @p type (@c "unknown" for values this build does not know).
+     */
+    static inline const char *trace_type_name(TraceType type)
+    {
+        switch (type)
+        {
+        case TraceType::kNone:
+            return "none";
+        case TraceType::kZoneBegin:
+            return "zone_begin";
+        case TraceType::kZoneEnd:
+            return "zone_end";
+        case TraceType::kTaskSwitchIn:
+            return "switch_in";
+        case TraceType::kTaskSwitchOut:
+            return "switch_out";
+        case TraceType::kTaskReady:
+            return "ready";
+        case TraceType::kMarker:
+            return "marker";
+        case TraceType::kValue:
+            return "value";
+        }
+        return "unknown";
+    }
+
+    /**
+     * @brief One trace record.
+     */
+    struct TraceEvent
+    {
+        uint64_t ticks; ///< Raw counter ticks in a ring; extended reference ticks once drained.
+        uint32_t arg;   ///< Type-specific argument.
+        TraceType type;
+        uint8_t core;  ///< Core that recorded the event.
+        uint16_t aux;  ///< Type-specific extra (e.g. channel).
+    };
+    static_assert(sizeof(TraceEvent) == 16, "trace records are 16 bytes");
+
+    /**
+     * @brief Per-core trace rings.
+     *
+     * @tparam Capacity Events per core (power of two).
+     */
+    template <size_t Capacity = FASTTIME_TRACE_CAPACITY>
+    class Tracer
+    {
+    public:
+        /**
+         * @brief Record an event on the calling core.
+         *
+         * @remarks Safe from tasks (pinned or not), scheduler hooks and ISRs up to level 3. The
+         *          ring and the event's core are both taken with interrupts masked, so they agree.
+         * @return false if tracing is disabled or the core's ring is full.
+         */
+        FASTTIME_ALWAYS_INLINE inline bool emit(TraceType type, uint32_t arg, uint16_t aux = 0)
+        {
+            if (!enabled_.load(std::memory_order_relaxed))
+            {
+                return false;
+            }
+            uint32_t state;
+            Core &c = enter_shard(cores_, state);
+            const bool ok = c.ring.push(make_event(type, arg, aux));
+            c.lock.exit(state);
+            return counted(c, ok);
+        }
+
+        /**
+         * @brief @ref emit for any interrupt level (see @ref ShardLock::enter_from_isr).
+         */
+        FASTTIME_ALWAYS_INLINE inline bool emit_from_isr(TraceType type, uint32_t arg, uint16_t aux = 0)
+        {
+            if (!enabled_.load(std::memory_order_relaxed))
+            {
+                return false;
+            }
+            uint32_t state;
+            Core &c = enter_shard<true>(cores_, state);
+            const bool ok = c.ring.push(make_event(type, arg, aux));
+            c.lock.exit(state);
+            return counted(c, ok);
+        }
+
+        /** @brief Turn recording on or off (events emitted while off are not counted). */
+        inline void set_enabled(bool on) { enabled_.store(on, std::memory_order_relaxed); }
+
+        inline bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+        /**
+         * @brief Pop the oldest raw event of ring @p shard. Single consumer.
+         */
+        inline bool pop(uint32_t shard, TraceEvent &out)
+        {
+            return cores_[shard % FASTTIME_SHARDS].ring.pop(out);
+        }
+
+        /**
+         * @brief Drain every ring in global time order.
+         *
+         * @details Raw ticks are mapped onto the reference core with @p offsets (if given) and
+         *          extended to 64 bits; @p fn receives events with those ticks. Single consumer.
+         *          Stops after @p max_events, leaving the rest queued.
+         *
+         * @return Number of events delivered.
+         */
+        template <typename Fn>
+        size_t drain_ordered(Fn &&fn, const CoreClockOffsets *offsets = nullptr, size_t max_events = SIZE_MAX)
+        {
+            size_t n = 0;
+            while (n < max_events)
+            {
+                int best = -1;
+                const TraceEvent *best_ev = nullptr;
+                Timestamp best_ts{0};
+                for (uint32_t i = 0; i < FASTTIME_SHARDS; ++i)
+                {
+                    const TraceEvent *e = cores_[i].ring.peek();
+                    if (!e)
+                    {
+                        continue;
+                    }
+                    const Timestamp ts = map(*e, offsets);
+                    if (best < 0 || before(ts, best_ts))
+                    {
+                        best = int(i);
+                        best_ev = e;
+                        best_ts = ts;
+                    }
+                }
+                if (best < 0)
+                {
+                    return n;
+                }
+                TraceEvent ev = *best_ev;
+                cores_[best].ring.pop(ev);
+                if (!extender_started_)
+                {
+                    extender_ = CycleExtender::make(best_ts);
+                    extender_started_ = true;
+                }
+                // Offset error can put an event marginally before its predecessor.
+                ev.ticks = before(best_ts, Timestamp{extender_.last}) ? extender_.ext
+                                                                      : extender_.extend(best_ts);
+                fn(static_cast<const TraceEvent &>(ev));
+                ++n;
+            }
+            return n;
+        }
+
+        /** @brief Events dropped from ring @p shard because it was full. */
+        inline uint32_t dropped(uint32_t shard) const
+        {
+            return cores_[shard % FASTTIME_SHARDS].dropped.load(std::memory_order_relaxed);
+        }
+
+        /** @brief Events dropped from all rings. */
+        inline uint32_t dropped() const
+        {
+            uint32_t total = 0;
+            for (uint32_t i = 0; i < FASTTIME_SHARDS; ++i)
+            {
+                total += dropped(i);
+            }
+            return total;
+        }
+
+        static constexpr size_t capacity() { return Capacity; }
+
+    private:
+        static inline Timestamp map(const TraceEvent &e, const CoreClockOffsets *offsets)
+        {
+            const Timestamp raw{(fast_counter_t)e.ticks};
+            return offsets ? CoreTimestamp{raw, e.core}.on_reference(*offsets) : raw;
+        }
+
+        struct Core
+        {
+            ShardLock lock;
+            std::atomic<uint32_t> dropped{0};
+            RingBuffer<TraceEvent, Capacity> ring;
+        };
+
+        static inline FASTTIME_ALWAYS_INLINE TraceEvent make_event(TraceType type, uint32_t arg, uint16_t aux)
+        {
+            TraceEvent ev;
+            ev.ticks = Timestamp::now().ticks;
+            ev.arg = arg;
+            ev.type = type;
+            ev.core = uint8_t(current_core());
+            ev.aux = aux;
+            return ev;
+        }
+
+        static inline FASTTIME_ALWAYS_INLINE bool counted(Core &c, bool ok)
+        {
+            if (!ok)
+            {
+                c.dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+            return ok;
+        }
+
+        std::atomic<bool> enabled_{true};
+        Core cores_[FASTTIME_SHARDS];
+        CycleExtender extender_{0, 0};
+        bool extender_started_ = false;
+    };
+
+} // namespace fasttime
@@ -0,0 +1,757 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "esp23_fast_timestamp.h"
+#include "fast_histogram.h"
+#include "fast_registry.h"
+#include "fast_task_trace.h"
+#include "fast_trace.h"
+#include "fast_trace_format.h"
+
+#if defined(FASTTIME_HOST)
+#include <errno.h>
+#include <memory>
+#include <unistd.h>
+#endif
+
+/**
+ * @file fast_trace_analysis.h
+ * @brief Host-side analysis of captured traces: zone spans, percentiles, tasks, timeline.
+ *
+ * @details
+ * Host only. It works with any source of @ref fast_trace_format.h blocks: a
+ * @ref TraceFileWriter file, a @ref TraceSectorLog dump, or a UART capture piped through
+ * @ref TraceByteDecoder. Memory use is fixed by the template parameters and does not depend
+ * on the trace length, so multi-GB captures stream through.
+ *
+ * @ref TraceAnalyzer derives:
+ * - Zone spans per core from @ref TraceType::kZoneBegin / @ref TraceType::kZoneEnd pairs
+ *   (@c arg = zone id), nested up to @c MaxDepth. Each zone gets a count, total and self time,
+ *   min/max and p50/p90/p99/p99.9 from a log-linear histogram (12.5 % resolution).
+ * - A critical path for each zone: for its slowest instance, the chain of heaviest nested
+ *   zones.
+ * - Per-task CPU time, run-queue wait and preemptions (@ref TaskTraceAnalyzer).
+ * - A timeline: a fixed number of buckets that double in width as the trace grows, each with
+ *   its events, drops, task switches and zone busy time.
+ *
+ * Ticks convert to time with the frequency recorded in the block headers, or with a
+ * calibrated value (e.g. the slope of a @ref ClockMapping fit) via @ref TraceAnalyzer::set_freq.
+ * When a new session starts (the block sequence restarts, e.g. after a reboot), ticks are
+ * rebased so time keeps increasing, and open spans are discarded.
+ *
+ * @code
+ * fasttime::TraceAnalyzer<> a;
+ * fasttime::TraceByteDecoder dec;
+ * dec.read_fd(0, [&](fasttime::TraceBlockReader &b) { a.feed_block(b); });
+ * a.finish();
+ * a.report(stdout);
+ * @endcode
+ */
+
+#if defined(FASTTIME_HOST)
+
+namespace fasttime
+{
+
+    // ------------------------------------------------------------------------------------------
+    // Streaming decode
+    // ------------------------------------------------------------------------------------------
+
+    /**
+     * @brief Finds intact blocks in a byte stream delivered in arbitrary pieces.
+     *
+     * @details Keeps at most one partial block (up to @p max_block bytes) between calls.
+     *          Garbage and corrupt blocks are skipped by resynchronizing on the block magic.
+     */
+    class TraceByteDecoder
+    {
+    public:
+        explicit TraceByteDecoder(size_t max_block = size_t(1) << 20)
+            : cap_(max_block * 2), max_block_(max_block), buf_(new uint8_t[max_block * 2])
+        {
+        }
+
+        /**
+         * @brief Consume @p len bytes; @p on_block receives each intact block.
+         */
+        template <typename OnBlock>
+        void feed(const uint8_t *data, size_t len, OnBlock &&on_block)
+        {
+            while (len)
+            {
+                const size_t n = len < cap_ - fill_ ? len : cap_ - fill_;
+                memcpy(buf_.get() + fill_, data, n);
+                fill_ += n;
+                data += n;
+                len -= n;
+                parse(on_block);
+            }
+        }
+
+        /**
+         * @brief Read @p fd to the end.
+         * @return false on a read error.
+         */
+        template <typename OnBlock>
+        bool read_fd(int fd, OnBlock &&on_block)
+        {
+            for (;;)
+            {
+                const ssize_t n = ::read(fd, buf_.get() + fill_, cap_ - fill_);
+                if (n < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (n <= 0)
+                {
+                    skipped_ += fill_;
+                    fill_ = 0;
+                    return n == 0;
+                }
+                fill_ += size_t(n);
+                bytes_ += uint64_t(n);
+                parse(on_block);
+            }
+        }
+
+        /** @brief Bytes read by @ref read_fd. */
+        inline uint64_t bytes() const { return bytes_; }
+        /** @brief Bytes that were not part of an intact block. */
+        inline uint64_t skipped_bytes() const { return skipped_; }
+        /** @brief Intact blocks delivered. */
+        inline uint64_t blocks() const { return blocks_; }
+
+    private:
+        template <typename OnBlock>
+        void parse(OnBlock &on_block)
+        {
+            size_t pos = 0;
+            while (fill_ - pos >= sizeof(TraceBlockHeader))
+            {
+                size_t at = pos + trace_find_block(buf_.get() + pos, fill_ - pos);
+                if (at == fill_)
+                {
+                    at = fill_ - (sizeof(kTraceBlockMagic) - 1); // may be a partial magic
+                }
+                skipped_ += at - pos;
+                pos = at;
+                if (fill_ - pos < sizeof(TraceBlockHeader))
+                {
+                    break;
+                }
+                TraceBlockHeader h;
+                memcpy(&h, buf_.get() + pos, sizeof(h));
+                const size_t total = size_t(h.header_size) + h.payload_bytes;
+                if (h.header_size < sizeof(TraceBlockHeader) || total > max_block_)
+                {
+                    ++skipped_;
+                    ++pos;
+                    continue;
+                }
+                if (fill_ - pos < total)
+                {
+                    break; // wait for the rest
+                }
+                TraceBlockReader block;
+                if (block.open(buf_.get() + pos, total))
+                {
+                    ++blocks_;
+                    on_block(block);
+                    pos += total;
+                }
+                else
+                {
+                    ++skipped_;
+                    ++pos;
+                }
+            }
+            // Keep a trailing partial magic/block for the next piece.
+            if (pos == 0 && fill_ == cap_)
+            {
+                skipped_ += 1;
+                pos = 1;
+            }
+            memmove(buf_.get(), buf_.get() + pos, fill_ - pos);
+            fill_ -= pos;
+        }
+
+        size_t cap_;
+        size_t max_block_;
+        std::unique_ptr<uint8_t[]> buf_;
+        size_t fill_ = 0;
+        uint64_t bytes_ = 0;
+        uint64_t skipped_ = 0;
+        uint64_t blocks_ = 0;
+    };
+
+    // ------------------------------------------------------------------------------------------
+    // Analysis
+    // ------------------------------------------------------------------------------------------
+
+    /**
+     * @brief Log-linear histogram with 64-bit counts, for offline use (not thread-safe).
+     */
+    struct TraceDurationHistogram
+    {
+        using Shape = CycleHistogram<3, 48>;
+        uint64_t counts[Shape::kBuckets];
+
+        inline void record(uint64_t cycles) { ++counts[Shape::bucket_of(cycles)]; }
+
+        /** @brief Bucket midpoint holding @p pct percent of @p n values (see @ref CycleHistogram::percentile). */
+        uint64_t percentile(double pct, uint64_t n) const
+        {
+            if (!n)
+            {
+                return 0;
+            }
+            uint64_t rank = uint64_t(pct / 100.0 * double(n) + 0.5);
+            rank = rank == 0 ? 1 : (rank > n ? n : rank);
+            uint64_t seen = 0;
+            uint32_t i = 0;
+            for (; i + 1 < Shape::kBuckets; ++i)
+            {
+                seen += counts[i];
+                if (seen >= rank)
+                {
+                    break;
+                }
+            }
+            const uint64_t lo = Shape::bucket_lower(i);
+            return i < Shape::kSub || i + 1 == Shape::kBuckets ? lo : lo + (Shape::bucket_upper(i) - lo) / 2;
+        }
+    };
+
+    /**
+     * @brief Statistics of one zone id.
+     */
+    template <size_t MaxPath>
+    struct TraceZoneSummary
+    {
+        uint32_t id;
+        uint64_t count;
+        uint64_t total_cycles;
+        uint64_t self_cycles; ///< Total minus time in nested zones.
+        uint64_t min_cycles;
+        uint64_t max_cycles;
+        uint64_t worst_at;    ///< Begin ticks of the slowest instance.
+        uint8_t worst_core;
+        uint32_t path_len;    ///< Entries in the slowest instance's critical path.
+        uint32_t path_id[MaxPath];
+        uint64_t path_cycles[MaxPath];
+        TraceDurationHistogram hist;
+    };
+
+    /**
+     * @brief One timeline bucket.
+     */
+    struct TraceTimelineBucket
+    {
+        uint64_t events;
+        uint64_t dropped;     ///< Drops reported by blocks starting in this bucket.
+        uint64_t switches;    ///< Task switch-ins.
+        uint64_t zone_cycles; ///< Outermost-zone time, summed over cores.
+    };
+
+    /**
+     * @brief Streaming trace analyzer with fixed memory.
+     *
+     * @tparam MaxZones Distinct zone ids tracked (others are counted in @ref untracked_zones).
+     * @tparam MaxTasks Tasks tracked.
+     * @tparam MaxDepth Zone nesting depth per core.
+     * @tparam MaxPath  Critical-path entries kept per zone.
+     */
+    template <size_t MaxZones = 1024, size_t MaxTasks = 256, size_t MaxDepth = 32, size_t MaxPath = 8>
+    class TraceAnalyzer
+    {
+        static_assert((MaxZones & (MaxZones - 1)) == 0, "MaxZones must be a power of two");
+
+    public:
+        using Zone = TraceZoneSummary<MaxPath>;
+
+        /**
+         * @param buckets Timeline buckets (fixed; they widen as the trace grows).
+         */
+        explicit TraceAnalyzer(uint32_t buckets = 24)
+            : zones_(new Zone[MaxZones]()), cores_(new Core[FASTTIME_MAX_CORES]()),
+              timeline_(new TraceTimelineBucket[buckets ? buckets : 1]()), buckets_(buckets ? buckets : 1)
+        {
+        }
+
+        /**
+         * @brief Use @p hz instead of the frequency recorded in the trace (0: recorded).
+         */
+        inline void set_freq(double hz) { freq_override_ = hz; }
+
+        /** @brief Frequency used for conversions. */
+        inline double freq() const
+        {
+            return freq_override_ > 0 ? freq_override_ : (freq_hz_ ? double(freq_hz_) : double(FASTTIME_FREQ_HZ));
+        }
+
+        /**
+         * @brief Note a block header (sequence gaps, drops, sessions), then feed its events.
+         */
+        void feed_block(TraceBlockReader &block)
+        {
+            const TraceBlockHeader &h = block.header();
+            if (blocks_ && h.seq <= last_seq_)
+            {
+                new_session_ = true;
+            }
+            else if (blocks_ && h.seq > last_seq_ + 1)
+            {
+                lost_blocks_ += h.seq - last_seq_ - 1;
+            }
+            last_seq_ = h.seq;
+            ++blocks_;
+            freq_hz_ = h.freq_hz ? h.freq_hz : freq_hz_;
+            dropped_ += h.dropped;
+            pending_dropped_ += h.dropped;
+            TraceEvent ev;
+            while (block.next(ev))
+            {
+                feed(ev);
+            }
+        }
+
+        /**
+         * @brief Consume one event (time-ordered within a session).
+         */
+        void feed(const TraceEvent &in)
+        {
+            TraceEvent e = in;
+            if (new_session_ || (events_ && e.ticks + rebase_ < last_ticks_))
+            {
+                start_session(e.ticks);
+            }
+            e.ticks += rebase_;
+            if (!events_)
+            {
+                first_ticks_ = e.ticks;
+            }
+            last_ticks_ = e.ticks;
+            ++events_;
+
+            TraceTimelineBucket &b = bucket(e.ticks);
+            ++b.events;
+            b.dropped += pending_dropped_;
+            pending_dropped_ = 0;
+
+            const uint32_t core = e.core % FASTTIME_MAX_CORES;
+            cores_seen_ = core + 1 > cores_seen_ ? core + 1 : cores_seen_;
+            switch (e.type)
+            {
+            case TraceType::kZoneBegin:
+                begin_zone(cores_[core], e);
+                break;
+            case TraceType::kZoneEnd:
+                end_zone(cores_[core], e);
+                break;
+            case TraceType::kTaskSwitchIn:
+                ++b.switches;
+                tasks_.feed(e);
+                break;
+            case TraceType::kTaskSwitchOut:
+            case TraceType::kTaskReady:
+                tasks_.feed(e);
+                break;
+            default:
+                break;
+            }
+        }
+
+        /**
+         * @brief End of input: spans still open are counted in @ref open_spans.
+         */
+        void finish()
+        {
+            for (uint32_t c = 0; c < FASTTIME_MAX_CORES; ++c)
+            {
+                open_spans_ += cores_[c].depth;
+                cores_[c].depth = 0;
+            }
+        }
+
+        /** @brief Call @p fn with every zone seen. */
+        template <typename Fn>
+        void for_each_zone(Fn &&fn) const
+        {
+            for (size_t i = 0; i < MaxZones; ++i)
+            {
+                if (zones_[i].count)
+                {
+                    fn(static_cast<const Zone &>(zones_[i]));
+                }
+            }
+        }
+
+        /** @brief Call @p fn(bucket, start_ticks, width_ticks) for every timeline bucket in use. */
+        template <typename Fn>
+        void for_each_bucket(Fn &&fn) const
+        {
+            const uint64_t used = events_ ? (last_ticks_ - first_ticks_) / width_ + 1 : 0;
+            for (uint64_t i = 0; i < used && i < buckets_; ++i)
+            {
+                fn(static_cast<const TraceTimelineBucket &>(timeline_[i]), first_ticks_ + i * width_, width_);
+            }
+        }
+
+        inline const TaskTraceAnalyzer<MaxTasks> &tasks() const { return tasks_; }
+
+        /** @brief Ticks converted to ns with @ref freq. */
+        inline double to_ns(uint64_t ticks) const { return double(ticks) * 1e9 / freq(); }
+
+        inline uint64_t events() const { return events_; }
+        inline uint64_t blocks() const { return blocks_; }
+        inline uint64_t span_ticks() const { return events_ ? last_ticks_ - first_ticks_ : 0; }
+        inline uint32_t sessions() const { return events_ ? sessions_ : 0; }
+        inline uint32_t cores() const { return cores_seen_; }
+        inline uint64_t lost_blocks() const { return lost_blocks_; }
+        inline uint64_t dropped_events() const { return dropped_; }
+        /** @brief Zone ends with no matching begin on that core. */
+        inline uint64_t unmatched_ends() const { return unmatched_; }
+        /** @brief Spans abandoned: begin without end, nesting too deep, or cut by a session end. */
+        inline uint64_t open_spans() const { return open_spans_; }
+        inline uint64_t untracked_zones() const { return untracked_; }
+
+        /**
+         * @brief Name lookup for zone and task ids; return nullptr to print the id.
+         */
+        using NameFn = const char *(*)(void *ctx, uint32_t id);
+
+        /**
+         * @brief Format the full report, one line at a time, into @p sink.
+         *
+         * @param max_zones Zones listed (by total time).
+         */
+        void report(LineSink sink, void *ctx, NameFn name = nullptr, void *name_ctx = nullptr,
+                    size_t max_zones = 40) const
+        {
+            char line[384];
+            char a[32], b[32], c[32], d[32], e[32], f[32];
+            snprintf(line, sizeof(line),
+                     "trace: %llu events, %llu blocks, %u session(s), %u core(s), %s span, %.0f Hz",
+                     (unsigned long long)events_, (unsigned long long)blocks_, sessions(), cores_seen_,
+                     fmt(a, span_ticks()), freq());
+            sink(ctx, line);
+            snprintf(line, sizeof(line),
+                     "losses: %llu dropped events, %llu lost blocks, %llu unmatched ends, %llu open spans, "
+                     "%llu untracked zones",
+                     (unsigned long long)dropped_, (unsigned long long)lost_blocks_, (unsigned long long)unmatched_,
+                     (unsigned long long)open_spans_, (unsigned long long)untracked_);
+            sink(ctx, line);
+
+            // Zones by total time (selection without allocation).
+            sink(ctx, "");
+            snprintf(line, sizeof(line), "%-24s %10s %10s %10s %10s %10s %10s %10s %10s", "zone", "count",
+                     "total", "self", "p50", "p90", "p99", "p99.9", "max");
+            sink(ctx, line);
+            uint64_t bound = UINT64_MAX;
+            size_t bound_index = SIZE_MAX;
+            for (size_t listed = 0; listed < max_zones; ++listed)
+            {
+                size_t best = SIZE_MAX;
+                for (size_t i = 0; i < MaxZones; ++i)
+                {
+                    const Zone &z = zones_[i];
+                    if (!z.count || z.total_cycles > bound || (z.total_cycles == bound && i <= bound_index))
+                    {
+                        continue;
+                    }
+                    if (best == SIZE_MAX || z.total_cycles > zones_[best].total_cycles)
+                    {
+                        best = i;
+                    }
+                }
+                if (best == SIZE_MAX)
+                {
+                    break;
+                }
+                const Zone &z = zones_[best];
+                bound = z.total_cycles;
+                bound_index = best;
+                char id[32], g[32];
+                snprintf(line, sizeof(line), "%-24s %10llu %10s %10s %10s %10s %10s %10s %10s",
+                         label(id, sizeof(id), z.id, name, name_ctx), (unsigned long long)z.count,
+                         fmt(a, z.total_cycles), fmt(b, z.self_cycles), fmt(c, z.hist.percentile(50, z.count)),
+                         fmt(d, z.hist.percentile(90, z.count)), fmt(e, z.hist.percentile(99, z.count)),
+                         fmt(f, z.hist.percentile(99.9, z.count)), fmt(g, z.max_cycles));
+                sink(ctx, line);
+                if (z.path_len)
+                {
+                    int n = snprintf(line, sizeof(line), "  slowest at %s on core %u:", fmt(a, z.worst_at - first_ticks_),
+                                     unsigned(z.worst_core));
+                    for (uint32_t k = 0; k < z.path_len && n > 0 && size_t(n) < sizeof(line); ++k)
+                    {
+                        n += snprintf(line + n, sizeof(line) - size_t(n), " > %s %s",
+                                      label(id, sizeof(id), z.path_id[k], name, name_ctx), fmt(b, z.path_cycles[k]));
+                    }
+                    sink(ctx, line);
+                }
+            }
+
+            // Tasks.
+            if (tasks_.tasks())
+            {
+                sink(ctx, "");
+                snprintf(line, sizeof(line), "%-24s %10s %8s %10s %10s %8s %8s", "task", "cpu", "util", "wait",
+                         "max wait", "runs", "preempt");
+                sink(ctx, line);
+                const uint64_t span = tasks_.span_cycles();
+                tasks_.for_each([&](const TaskTraceStats &s) {
+                    char id[32];
+                    snprintf(line, sizeof(line), "%-24s %10s %7.2f%% %10s %10s %8u %8u",
+                             label(id, sizeof(id), s.id, name, name_ctx), fmt(a, s.cpu_cycles),
+                             span ? 100.0 * double(s.cpu_cycles) / double(span) : 0.0, fmt(b, s.wait_cycles),
+                             fmt(c, s.max_wait), s.switches_in, s.preemptions);
+                    sink(ctx, line);
+                });
+            }
+
+            // Timeline.
+            sink(ctx, "");
+            snprintf(line, sizeof(line), "%-12s %12s %10s %10s %8s", "time", "events/s", "switches", "dropped",
+                     "busy");
+            sink(ctx, line);
+            const uint32_t cores = cores_seen_ ? cores_seen_ : 1;
+            for_each_bucket([&](const TraceTimelineBucket &bk, uint64_t start, uint64_t width) {
+                // The last bucket ends at the last event.
+                width = last_ticks_ - start < width ? last_ticks_ - start + 1 : width;
+                const double secs = to_ns(width) / 1e9;
+                snprintf(line, sizeof(line), "%-12s %12.0f %10llu %10llu %7.1f%%", fmt(a, start - first_ticks_),
+                         double(bk.events) / secs, (unsigned long long)bk.switches, (unsigned long long)bk.dropped,
+                         100.0 * double(bk.zone_cycles) / (double(width) * cores));
+                sink(ctx, line);
+            });
+        }
+
+        /** @brief @ref report to a stdio stream. */
+        void report(FILE *out, NameFn name = nullptr, void *name_ctx = nullptr, size_t max_zones = 40) const
+        {
+            report([](void *ctx, const char *line) { fprintf(static_cast<FILE *>(ctx), "%s\n", line); }, out, name,
+                   name_ctx, max_zones);
+        }
+
+    private:
+        struct Frame
+        {
+            uint32_t id;
+            uint64_t begin;
+            uint64_t child_cycles;
+            uint32_t path_len;
+            uint32_t path_id[MaxPath];
+            uint64_t path_cycles[MaxPath];
+        };
+
+        struct Core
+        {
+            uint32_t depth;
+            Frame stack[MaxDepth];
+        };
+
+        /// Human-readable duration of @p ticks.
+        const char *fmt(char *buf, uint64_t ticks) const
+        {
+            const double ns = to_ns(ticks);
+            if (ns < 1e3)
+            {
+                snprintf(buf, 32, "%.0fns", ns);
+            }
+            else if (ns < 1e6)
+            {
+                snprintf(buf, 32, "%.2fus", ns / 1e3);
+            }
+            else if (ns < 1e9)
+            {
+                snprintf(buf, 32, "%.2fms", ns / 1e6);
+            }
+            else
+            {
+                snprintf(buf, 32, "%.3fs", ns / 1e9);
+            }
+            return buf;
+        }
+
+        static const char *label(char *buf, size_t len, uint32_t id, NameFn name, void *ctx)
+        {
+            const char *n = name ? name(ctx, id) : nullptr;
+            if (n)
+            {
+                return n;
+            }
+            snprintf(buf, len, "0x%08lx", (unsigned long)id);
+            return buf;
+        }
+
+        void start_session(uint64_t ticks)
+        {
+            new_session_ = false;
+            if (!events_)
+            {
+                return;
+            }
+            // Continue the time axis right after the previous session.
+            rebase_ = last_ticks_ + 1 - ticks;
+            ++sessions_;
+            for (uint32_t c = 0; c < FASTTIME_MAX_CORES; ++c)
+            {
+                open_spans_ += cores_[c].depth;
+                cores_[c].depth = 0;
+            }
+        }
+
+        TraceTimelineBucket &bucket(uint64_t ticks)
+        {
+            uint64_t i = (ticks - first_ticks_) / width_;
+            while (i >= buckets_)
+            {
+                // Halve the resolution: merge neighbours.
+                for (uint32_t k = 0; k < buckets_; ++k)
+                {
+                    TraceTimelineBucket m{};
+                    for (uint32_t j = 2 * k; j < 2 * k + 2 && j < buckets_; ++j)
+                    {
+                        m.events += timeline_[j].events;
+                        m.dropped += timeline_[j].dropped;
+                        m.switches += timeline_[j].switches;
+                        m.zone_cycles += timeline_[j].zone_cycles;
+                    }
+                    timeline_[k] = m;
+                }
+                width_ *= 2;
+                i = (ticks - first_ticks_) / width_;
+            }
+            return timeline_[i];
+        }
+
+        Zone *zone(uint32_t id)
+        {
+            uint32_t h = id * 0x9E3779B1u;
+            for (size_t probe = 0; probe < MaxZones; ++probe)
+            {
+                Zone &z = zones_[(h + probe) & (MaxZones - 1)];
+                if (z.count && z.id == id)
+                {
+                    return &z;
+                }
+                if (!z.count)
+                {
+                    if (zones_used_ * 4 >= MaxZones * 3)
+                    {
+                        return nullptr; // keep probes short
+                    }
+                    ++zones_used_;
+                    z.id = id;
+                    z.min_cycles = UINT64_MAX;
+                    return &z;
+                }
+            }
+            return nullptr;
+        }
+
+        void begin_zone(Core &c, const TraceEvent &e)
+        {
+            if (c.depth == MaxDepth)
+            {
+                ++open_spans_;
+                return;
+            }
+            Frame &f = c.stack[c.depth++];
+            f.id = e.arg;
+            f.begin = e.ticks;
+            f.child_cycles = 0;
+            f.path_len = 0;
+        }
+
+        void end_zone(Core &c, const TraceEvent &e)
+        {
+            uint32_t k = c.depth;
+            while (k && c.stack[k - 1].id != e.arg)
+            {
+                --k;
+            }
+            if (!k)
+            {
+                ++unmatched_;
+                return;
+            }
+            // Frames above the match never ended (lost events).
+            open_spans_ += c.depth - k;
+            c.depth = k - 1;
+            const Frame &f = c.stack[k - 1];
+            const uint64_t dur = e.ticks - f.begin;
+            Zone *z = zone(f.id);
+            if (!z)
+            {
+                ++untracked_;
+            }
+            else
+            {
+                ++z->count;
+                z->total_cycles += dur;
+                z->self_cycles += dur > f.child_cycles ? dur - f.child_cycles : 0;
+                z->min_cycles = dur < z->min_cycles ? dur : z->min_cycles;
+                z->hist.record(dur);
+                if (z->count == 1 || dur > z->max_cycles)
+                {
+                    z->max_cycles = dur;
+                    z->worst_at = f.begin;
+                    z->worst_core = e.core;
+                    z->path_len = f.path_len;
+                    memcpy(z->path_id, f.path_id, sizeof(uint32_t) * f.path_len);
+                    memcpy(z->path_cycles, f.path_cycles, sizeof(uint64_t) * f.path_len);
+                }
+            }
+            if (c.depth)
+            {
+                Frame &parent = c.stack[c.depth - 1];
+                parent.child_cycles += dur;
+                if (!parent.path_len || dur > parent.path_cycles[0])
+                {
+                    parent.path_id[0] = f.id;
+                    parent.path_cycles[0] = dur;
+                    const uint32_t tail = f.path_len < MaxPath - 1 ? f.path_len : uint32_t(MaxPath - 1);
+                    memcpy(parent.path_id + 1, f.path_id, sizeof(uint32_t) * tail);
+                    memcpy(parent.path_cycles + 1, f.path_cycles, sizeof(uint64_t) * tail);
+                    parent.path_len = 1 + tail;
+                }
+            }
+            else
+            {
+                bucket(e.ticks).zone_cycles += dur;
+            }
+        }
+
+        std::unique_ptr<Zone[]> zones_;
+        std::unique_ptr<Core[]> cores_;
+        std::unique_ptr<TraceTimelineBucket[]> timeline_;
+        uint32_t buckets_;
+        uint64_t width_ = 1024;
+        TaskTraceAnalyzer<MaxTasks> tasks_;
+        double freq_override_ = 0;
+        uint32_t freq_hz_ = 0;
+        uint64_t events_ = 0;
+        uint64_t blocks_ = 0;
+        uint64_t first_ticks_ = 0;
+        uint64_t last_ticks_ = 0;
+        uint64_t rebase_ = 0;
+        uint32_t last_seq_ = 0;
+        uint32_t sessions_ = 1;
+        uint32_t cores_seen_ = 0;
+        bool new_session_ = false;
+        uint64_t lost_blocks_ = 0;
+        uint64_t dropped_ = 0;
+        uint64_t pending_dropped_ = 0;
+        uint64_t unmatched_ = 0;
+        uint64_t open_spans_ = 0;
+        uint64_t untracked_ = 0;
+        size_t zones_used_ = 0;
+    };
+
+} // namespace fasttime
+
+#endif // FASTTIME_HOST
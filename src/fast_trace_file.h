@@ -0,0 +1,782 @@
+#pragma once
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "esp23_fast_timestamp.h"
+#include "fast_trace.h"
+#include "fast_trace_format.h"
+#include "fast_trace_stream.h"
+
+#if defined(FASTTIME_HOST) && defined(__unix__)
+#include <condition_variable>
+#include <fcntl.h>
+#include <mutex>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#define FASTTIME_TRACE_MMAP 1
+#elif !defined(FASTTIME_HOST) && __has_include(<esp_partition.h>)
+#include <esp_partition.h>
+#define FASTTIME_TRACE_PARTITION 1
+#endif
+
+/**
+ * @file fast_trace_file.h
+ * @brief Trace captures larger than RAM: block files, a flash sector log, zero-copy readers.
+ *
+ * @details
+ * All writers store @ref fast_trace_format.h blocks unchanged, and they all fit behind a
+ * @ref TraceStream.
+ *
+ * - Host: @ref TraceFileWriter appends to a memory-mapped file. The file grows in large
+ *   chunks, a background thread msyncs the written part, and the appending thread only copies
+ *   memory. After a crash the file ends in zero padding, which the readers skip.
+ * - ESP32 flash: @ref TraceSectorLog turns a raw data partition into a circular log of
+ *   sectors. Each sector starts with a 16-byte header holding a sequence number, and blocks
+ *   never straddle sectors. Sectors are written sequentially and erased just before reuse, so
+ *   every sector is erased once per lap (even wear, no metadata sector). On open, the log
+ *   resumes after the newest sector.
+ * - SD card: the card's controller does wear leveling. Use @ref trace_write_stdio on a VFS
+ *   file (ESP-IDF) or @ref trace_write_print on an Arduino @c File. Full @ref TraceStream
+ *   buffers are a multiple of the 512-byte card sector.
+ *
+ * Flash and SD writes stall for milliseconds, so run them through @ref TraceAsyncWriter.
+ *
+ * On the reading side, @ref TraceFileView iterates the blocks of a contiguous image (a mapped
+ * file, a capture buffer). @ref TraceLogView iterates a sector log oldest-first (a mapped
+ * partition on target, or a @c parttool.py dump on a host). Both hand out
+ * @ref TraceBlockReader objects that decode straight from the mapped bytes.
+ *
+ * @code
+ * // Host: stream to a file
+ * fasttime::TraceFileWriter file;
+ * file.open("capture.ftb");
+ * fasttime::TraceStream<> stream(fasttime::TraceFileWriter::sink, &file);
+ * ...
+ * stream.flush(true);
+ * file.close();
+ *
+ * // Read it back
+ * fasttime::TraceFileMapping map;
+ * map.open("capture.ftb");
+ * fasttime::TraceFileView view(map.data(), map.size());
+ * view.for_each([](const fasttime::TraceEvent &e) { ... });
+ * @endcode
+ */
+
+namespace fasttime
+{
+
+    // ------------------------------------------------------------------------------------------
+    // Readers
+    // ------------------------------------------------------------------------------------------
+
+    /**
+     * @brief Zero-copy iteration over the blocks in a contiguous byte range.
+     *
+     * @details Bytes that do not start an intact block (padding, a torn tail, corruption) are
+     *          skipped up to the next block magic and counted in @ref skipped_bytes.
+     */
+    class TraceFileView
+    {
+    public:
+        TraceFileView(const uint8_t *data, size_t len) : data_(data), len_(len) {}
+
+        /**
+         * @brief Open the next intact block into @p block.
+         * @return false at the end of the range.
+         */
+        bool next(TraceBlockReader &block)
+        {
+            while (pos_ + sizeof(TraceBlockHeader) <= len_)
+            {
+                if (block.open(data_ + pos_, len_ - pos_))
+                {
+                    pos_ += block.size();
+                    note(block.header());
+                    return true;
+                }
+                const size_t skip = 1 + trace_find_block(data_ + pos_ + 1, len_ - pos_ - 1);
+                if (!padding(data_ + pos_, skip))
+                {
+                    skipped_ += skip;
+                }
+                pos_ += skip;
+            }
+            return false;
+        }
+
+        /**
+         * @brief Decode every remaining event into @p fn.
+         * @return Events delivered.
+         */
+        template <typename Fn>
+        uint64_t for_each(Fn &&fn)
+        {
+            uint64_t n = 0;
+            TraceBlockReader block;
+            TraceEvent ev;
+            while (next(block))
+            {
+                while (block.next(ev))
+                {
+                    fn(static_cast<const TraceEvent &>(ev));
+                    ++n;
+                }
+            }
+            return n;
+        }
+
+        /** @brief Restart from the beginning (counters are kept). */
+        inline void rewind() { pos_ = 0; }
+
+        inline uint64_t blocks() const { return blocks_; }
+        /** @brief Blocks missing from sequence-number gaps. */
+        inline uint64_t lost_blocks() const { return lost_; }
+        /** @brief Events the producer reported as dropped (block headers). */
+        inline uint64_t dropped_events() const { return dropped_; }
+        /** @brief Non-padding bytes that were not part of an intact block. */
+        inline uint64_t skipped_bytes() const { return skipped_; }
+
+    private:
+        static inline bool padding(const uint8_t *p, size_t n)
+        {
+            for (size_t i = 0; i < n; ++i)
+            {
+                if (p[i] != 0x00 && p[i] != 0xFF)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        inline void note(const TraceBlockHeader &h)
+        {
+            // A sequence restart is a new stream (e.g. a reboot), not a loss.
+            if (blocks_ && h.seq > last_seq_ + 1)
+            {
+                lost_ += h.seq - last_seq_ - 1;
+            }
+            last_seq_ = h.seq;
+            dropped_ += h.dropped;
+            ++blocks_;
+        }
+
+        const uint8_t *data_;
+        size_t len_;
+        size_t pos_ = 0;
+        uint32_t last_seq_ = 0;
+        uint64_t blocks_ = 0;
+        uint64_t lost_ = 0;
+        uint64_t dropped_ = 0;
+        uint64_t skipped_ = 0;
+    };
+
+    static constexpr uint32_t kTraceSectorMagic = 0x31535446; ///< "FTS1"
+
+    /**
+     * @brief Header at the start of every sector of a @ref TraceSectorLog.
+     */
+    struct TraceSectorHeader
+    {
+        uint32_t magic;
+        uint32_t seq;      ///< Increases by one per sector written, across laps and reboots.
+        uint32_t reserved; ///< 0xFFFFFFFF (left erased).
+        uint32_t crc;      ///< CRC-32 of the fields above.
+    };
+    static_assert(sizeof(TraceSectorHeader) == 16, "sector header is 16 bytes");
+
+    namespace detail
+    {
+        static inline bool trace_sector_valid(const TraceSectorHeader &h)
+        {
+            return h.magic == kTraceSectorMagic && h.crc == crc32(&h, offsetof(TraceSectorHeader, crc));
+        }
+    } // namespace detail
+
+    /**
+     * @brief Zero-copy iteration over a @ref TraceSectorLog image, oldest sector first.
+     */
+    class TraceLogView
+    {
+    public:
+        /**
+         * @param data        Start of the log (e.g. from @c esp_partition_mmap).
+         * @param len         Log size, a multiple of @p sector_size.
+         * @param sector_size Flash erase unit.
+         */
+        TraceLogView(const uint8_t *data, size_t len, uint32_t sector_size = 4096)
+            : data_(data), sectors_(uint32_t(len / sector_size)), sector_size_(sector_size)
+        {
+            // Oldest = smallest sequence number (wrap-safe against the newest).
+            bool any = false;
+            uint32_t newest = 0;
+            for (uint32_t s = 0; s < sectors_; ++s)
+            {
+                TraceSectorHeader h;
+                if (header(s, h) && (!any || int32_t(h.seq - newest) > 0))
+                {
+                    newest = h.seq;
+                    newest_ = s;
+                    any = true;
+                }
+            }
+            left_ = any ? sectors_ : 0;
+            sector_ = any ? (newest_ + 1) % sectors_ : 0;
+            newest_seq_ = newest;
+        }
+
+        /**
+         * @brief Open the next intact block into @p block.
+         * @return false after the newest sector.
+         */
+        bool next(TraceBlockReader &block)
+        {
+            for (;;)
+            {
+                if (view_valid_ && view_.next(block))
+                {
+                    return true;
+                }
+                if (!left_)
+                {
+                    return false;
+                }
+                view_valid_ = false;
+                TraceSectorHeader h;
+                const uint32_t s = sector_;
+                sector_ = (sector_ + 1) % sectors_;
+                --left_;
+                // Only sectors of the current lap: behind the newest by less than a full lap.
+                if (header(s, h) && newest_seq_ - h.seq < sectors_)
+                {
+                    const uint8_t *p = data_ + size_t(s) * sector_size_;
+                    view_ = TraceFileView(p + sizeof(TraceSectorHeader), sector_size_ - sizeof(TraceSectorHeader));
+                    view_valid_ = true;
+                    ++sectors_read_;
+                }
+            }
+        }
+
+        /** @brief Decode every remaining event into @p fn. @return Events delivered. */
+        template <typename Fn>
+        uint64_t for_each(Fn &&fn)
+        {
+            uint64_t n = 0;
+            TraceBlockReader block;
+            TraceEvent ev;
+            while (next(block))
+            {
+                while (block.next(ev))
+                {
+                    fn(static_cast<const TraceEvent &>(ev));
+                    ++n;
+                }
+            }
+            return n;
+        }
+
+        /** @brief Sectors holding data visited so far. */
+        inline uint32_t sectors_read() const { return sectors_read_; }
+
+    private:
+        inline bool header(uint32_t s, TraceSectorHeader &h) const
+        {
+            memcpy(&h, data_ + size_t(s) * sector_size_, sizeof(h));
+            return detail::trace_sector_valid(h);
+        }
+
+        const uint8_t *data_;
+        uint32_t sectors_;
+        uint32_t sector_size_;
+        uint32_t newest_ = 0;
+        uint32_t newest_seq_ = 0;
+        uint32_t sector_ = 0;
+        uint32_t left_ = 0;
+        uint32_t sectors_read_ = 0;
+        TraceFileView view_{nullptr, 0};
+        bool view_valid_ = false;
+    };
+
+    // ------------------------------------------------------------------------------------------
+    // Flash sector log
+    // ------------------------------------------------------------------------------------------
+
+    /**
+     * @brief Raw flash access for @ref TraceSectorLog (see @ref trace_partition_flash).
+     *
+     * @details Writes only clear bits, as on NOR flash. Every call returns false on error.
+     */
+    struct TraceFlash
+    {
+        bool (*read)(void *ctx, uint32_t offset, void *dst, size_t len);
+        bool (*write)(void *ctx, uint32_t offset, const void *src, size_t len);
+        bool (*erase)(void *ctx, uint32_t offset, size_t len);
+        void *ctx;
+        uint32_t size;        ///< Bytes available (a multiple of @ref sector_size).
+        uint32_t sector_size; ///< Erase unit.
+    };
+
+    /**
+     * @brief Circular, wear-leveled log of trace blocks on raw flash.
+     *
+     * @details Each block is written once, with no read-modify-write. A block that does not
+     *          fit in the rest of the current sector starts the next sector, and the unused
+     *          tail stays erased. Blocks larger than a sector minus its header are rejected, so
+     *          pair this with a @ref TraceStream whose buffer is at most that size.
+     *
+     * @code
+     * static fasttime::TraceSectorLog log(fasttime::trace_partition_flash(
+     *     esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "trace")));
+     * static fasttime::TraceAsyncWriter writer(fasttime::TraceSectorLog::write, &log);
+     * static fasttime::TraceStream<2048> stream(fasttime::TraceAsyncWriter::sink, &writer);
+     *
+     * log.open(); writer.start();
+     * @endcode
+     */
+    class TraceSectorLog
+    {
+    public:
+        explicit TraceSectorLog(const TraceFlash &flash) : flash_(flash) {}
+
+        /**
+         * @brief Find the newest sector and resume after its last block.
+         * @return false if the flash geometry is unusable or a read fails.
+         */
+        bool open()
+        {
+            open_ = false;
+            const uint32_t sectors = flash_.sector_size ? flash_.size / flash_.sector_size : 0;
+            if (sectors < 2 || flash_.sector_size <= sizeof(TraceSectorHeader) + sizeof(TraceBlockHeader))
+            {
+                return false;
+            }
+            bool any = false;
+            uint32_t newest = 0;
+            uint32_t newest_seq = 0;
+            for (uint32_t s = 0; s < sectors; ++s)
+            {
+                TraceSectorHeader h;
+                if (!flash_.read(flash_.ctx, s * flash_.sector_size, &h, sizeof(h)))
+                {
+                    return false;
+                }
+                if (detail::trace_sector_valid(h) && (!any || int32_t(h.seq - newest_seq) > 0))
+                {
+                    newest = s;
+                    newest_seq = h.seq;
+                    any = true;
+                }
+            }
+            if (!any)
+            {
+                // Empty log: the first append erases sector 0.
+                sector_ = sectors - 1;
+                seq_ = 0;
+                pos_ = flash_.sector_size;
+                open_ = true;
+                return true;
+            }
+            sector_ = newest;
+            seq_ = newest_seq;
+            // Walk the block headers to the first erased word.
+            uint32_t pos = sizeof(TraceSectorHeader);
+            while (pos + sizeof(TraceBlockHeader) <= flash_.sector_size)
+            {
+                TraceBlockHeader b;
+                if (!flash_.read(flash_.ctx, sector_ * flash_.sector_size + pos, &b, sizeof(b)))
+                {
+                    return false;
+                }
+                // Bounded by subtraction: a torn header's sizes must not wrap the sum.
+                const uint32_t room = flash_.sector_size - pos;
+                if (b.magic != kTraceBlockMagic || b.header_size < sizeof(TraceBlockHeader) ||
+                    b.header_size > room || b.payload_bytes > room - b.header_size)
+                {
+                    // Erased (resume here) or a torn block (skip the rest of the sector).
+                    if (b.magic != 0xFFFFFFFFu)
+                    {
+                        pos = flash_.sector_size;
+                    }
+                    break;
+                }
+                pos += b.header_size + b.payload_bytes;
+            }
+            pos_ = pos;
+            open_ = true;
+            return true;
+        }
+
+        /**
+         * @brief Append one encoded block.
+         * @return false on a flash error, an oversized block or before @ref open.
+         */
+        bool append(const uint8_t *data, size_t len)
+        {
+            if (!open_ || len > flash_.sector_size - sizeof(TraceSectorHeader))
+            {
+                return false;
+            }
+            if (len > flash_.sector_size - pos_ && !next_sector())
+            {
+                return false;
+            }
+            if (!flash_.write(flash_.ctx, sector_ * flash_.sector_size + pos_, data, len))
+            {
+                return false;
+            }
+            pos_ += uint32_t(len);
+            bytes_ += len;
+            return true;
+        }
+
+        /** @brief @ref TraceWriteFn adapter; @p self is the log. */
+        static bool write(void *self, const uint8_t *data, size_t len)
+        {
+            return static_cast<TraceSectorLog *>(self)->append(data, len);
+        }
+
+        /** @brief Bytes appended since @ref open. */
+        inline uint64_t bytes() const { return bytes_; }
+        /** @brief Sectors erased since @ref open. */
+        inline uint32_t erases() const { return erases_; }
+        /** @brief Sequence number of the sector being written. */
+        inline uint32_t sector_seq() const { return seq_; }
+
+    private:
+        bool next_sector()
+        {
+            const uint32_t sectors = flash_.size / flash_.sector_size;
+            const uint32_t s = (sector_ + 1) % sectors;
+            if (!flash_.erase(flash_.ctx, s * flash_.sector_size, flash_.sector_size))
+            {
+                return false;
+            }
+            ++erases_;
+            TraceSectorHeader h{kTraceSectorMagic, seq_ + 1, 0xFFFFFFFFu, 0};
+            h.crc = crc32(&h, offsetof(TraceSectorHeader, crc));
+            if (!flash_.write(flash_.ctx, s * flash_.sector_size, &h, sizeof(h)))
+            {
+                return false;
+            }
+            sector_ = s;
+            seq_ = h.seq;
+            pos_ = sizeof(TraceSectorHeader);
+            return true;
+        }
+
+        TraceFlash flash_;
+        uint32_t sector_ = 0;
+        uint32_t seq_ = 0;
+        uint32_t pos_ = 0;
+        uint32_t erases_ = 0;
+        uint64_t bytes_ = 0;
+        bool open_ = false;
+    };
+
+#if defined(FASTTIME_TRACE_PARTITION)
+    /**
+     * @brief @ref TraceFlash for an ESP-IDF data partition (@c nullptr gives an unusable log).
+     */
+    static inline TraceFlash trace_partition_flash(const esp_partition_t *part)
+    {
+        TraceFlash f{};
+        f.read = [](void *ctx, uint32_t off, void *dst, size_t len) {
+            return esp_partition_read(static_cast<const esp_partition_t *>(ctx), off, dst, len) == ESP_OK;
+        };
+        f.write = [](void *ctx, uint32_t off, const void *src, size_t len) {
+            return esp_partition_write(static_cast<const esp_partition_t *>(ctx), off, src, len) == ESP_OK;
+        };
+        f.erase = [](void *ctx, uint32_t off, size_t len) {
+            return esp_partition_erase_range(static_cast<const esp_partition_t *>(ctx), off, len) == ESP_OK;
+        };
+        f.ctx = const_cast<esp_partition_t *>(part);
+        f.size = part ? part->size - part->size % part->erase_size : 0;
+        f.sector_size = part ? part->erase_size : 4096;
+        return f;
+    }
+
+    /**
+     * @brief Map a trace partition read-only for a @ref TraceLogView.
+     *
+     * @return Mapped address (release @p handle with @c esp_partition_munmap), or nullptr.
+     */
+    static inline const uint8_t *trace_partition_map(const esp_partition_t *part, esp_partition_mmap_handle_t &handle)
+    {
+        const void *p = nullptr;
+        if (!part || esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, &p, &handle) != ESP_OK)
+        {
+            return nullptr;
+        }
+        return static_cast<const uint8_t *>(p);
+    }
+#endif
+
+    // ------------------------------------------------------------------------------------------
+    // Files
+    // ------------------------------------------------------------------------------------------
+
+    /**
+     * @brief @ref TraceWriteFn for a stdio stream (e.g. an SD card file on the ESP-IDF VFS);
+     *        @p ctx is the @c FILE.
+     */
+    static inline bool trace_write_stdio(void *ctx, const uint8_t *data, size_t len)
+    {
+        return fwrite(data, 1, len, static_cast<FILE *>(ctx)) == len;
+    }
+
+#if defined(FASTTIME_TRACE_MMAP)
+    /**
+     * @brief Appends blocks to a memory-mapped file, growing it in chunks.
+     *
+     * @details @ref append is a @c memcpy, plus an @c ftruncate and a remap once per chunk. A
+     *          background thread msyncs the new pages every @c sync_ms. @ref close trims the
+     *          file to its contents. Single appender.
+     */
+    class TraceFileWriter
+    {
+    public:
+        TraceFileWriter() = default;
+        ~TraceFileWriter() { close(); }
+
+        TraceFileWriter(const TraceFileWriter &) = delete;
+        TraceFileWriter &operator=(const TraceFileWriter &) = delete;
+
+        /**
+         * @brief Create (or truncate) @p path.
+         *
+         * @param chunk   Growth step in bytes (rounded up to whole pages).
+         * @param sync_ms Background msync period; 0 leaves writeback to the kernel.
+         */
+        bool open(const char *path, size_t chunk = size_t(64) << 20, uint32_t sync_ms = 200)
+        {
+            close();
+            const size_t page = size_t(sysconf(_SC_PAGESIZE));
+            chunk_ = (chunk + page - 1) / page * page;
+            fd_ = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (fd_ < 0 || !grow(chunk_))
+            {
+                close();
+                return false;
+            }
+            size_.store(0, std::memory_order_relaxed);
+            synced_ = 0;
+            stop_ = false;
+            if (sync_ms)
+            {
+                syncer_ = std::thread([this, sync_ms] { sync_loop(sync_ms); });
+            }
+            return true;
+        }
+
+        /** @brief Copy @p len bytes to the end of the file. */
+        bool append(const uint8_t *data, size_t len)
+        {
+            if (fd_ < 0)
+            {
+                return false;
+            }
+            const size_t at = size_.load(std::memory_order_relaxed);
+            if (at + len > mapped_ && !grow((at + len + chunk_ - 1) / chunk_ * chunk_))
+            {
+                return false;
+            }
+            memcpy(map_ + at, data, len);
+            size_.store(at + len, std::memory_order_release);
+            return true;
+        }
+
+        /** @brief Write everything appended so far to the file (blocking). */
+        bool sync()
+        {
+            std::lock_guard<std::mutex> g(mutex_);
+            return sync_locked();
+        }
+
+        /** @brief Stop the syncer, flush, trim the file to its contents and unmap it. */
+        void close()
+        {
+            if (syncer_.joinable())
+            {
+                {
+                    std::lock_guard<std::mutex> g(mutex_);
+                    stop_ = true;
+                }
+                cv_.notify_one();
+                syncer_.join();
+            }
+            if (map_)
+            {
+                sync();
+                munmap(map_, mapped_);
+                map_ = nullptr;
+                mapped_ = 0;
+            }
+            if (fd_ >= 0)
+            {
+                // On failure the zero padding stays; readers skip it.
+                const bool trimmed = ftruncate(fd_, off_t(size_.load(std::memory_order_relaxed))) == 0;
+                (void)trimmed;
+                ::close(fd_);
+                fd_ = -1;
+            }
+        }
+
+        /** @brief Bytes appended. */
+        inline uint64_t size() const { return size_.load(std::memory_order_relaxed); }
+
+        /** @brief @ref TraceWriteFn adapter; @p self is the writer. */
+        static bool write(void *self, const uint8_t *data, size_t len)
+        {
+            return static_cast<TraceFileWriter *>(self)->append(data, len);
+        }
+
+        /**
+         * @brief @ref TraceSink adapter: copies the block and completes at once (the copy is
+         *        cheap; disk writeback happens in the syncer).
+         */
+        static bool sink(void *self, TraceTransfer &xfer, const uint8_t *data, size_t len)
+        {
+            if (!static_cast<TraceFileWriter *>(self)->append(data, len))
+            {
+                return false;
+            }
+            xfer.complete();
+            return true;
+        }
+
+    private:
+        bool grow(size_t bytes)
+        {
+            std::lock_guard<std::mutex> g(mutex_);
+            if (ftruncate(fd_, off_t(bytes)) != 0)
+            {
+                return false;
+            }
+            void *p;
+#if defined(__linux__)
+            p = map_ ? mremap(map_, mapped_, bytes, MREMAP_MAYMOVE)
+                     : mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+#else
+            if (map_)
+            {
+                munmap(map_, mapped_);
+                map_ = nullptr;
+            }
+            p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+#endif
+            if (p == MAP_FAILED)
+            {
+                return false;
+            }
+            map_ = static_cast<uint8_t *>(p);
+            mapped_ = bytes;
+            return true;
+        }
+
+        bool sync_locked()
+        {
+            const size_t end = size_.load(std::memory_order_acquire);
+            if (!map_ || end <= synced_)
+            {
+                return true;
+            }
+            const size_t page = size_t(sysconf(_SC_PAGESIZE));
+            const size_t from = synced_ / page * page;
+            const bool ok = msync(map_ + from, end - from, MS_SYNC) == 0;
+            if (ok)
+            {
+                synced_ = end;
+            }
+            return ok;
+        }
+
+        void sync_loop(uint32_t sync_ms)
+        {
+            std::unique_lock<std::mutex> g(mutex_);
+            while (!stop_)
+            {
+                cv_.wait_for(g, std::chrono::milliseconds(sync_ms), [this] { return stop_; });
+                sync_locked();
+            }
+        }
+
+        int fd_ = -1;
+        uint8_t *map_ = nullptr;
+        size_t mapped_ = 0;
+        size_t chunk_ = 0;
+        size_t synced_ = 0;
+        std::atomic<size_t> size_{0};
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        std::thread syncer_;
+        bool stop_ = false;
+    };
+
+    /**
+     * @brief Read-only mapping of a whole file, for @ref TraceFileView or @ref TraceLogView.
+     */
+    class TraceFileMapping
+    {
+    public:
+        TraceFileMapping() = default;
+        ~TraceFileMapping() { close(); }
+
+        TraceFileMapping(const TraceFileMapping &) = delete;
+        TraceFileMapping &operator=(const TraceFileMapping &) = delete;
+
+        bool open(const char *path)
+        {
+            close();
+            const int fd = ::open(path, O_RDONLY);
+            if (fd < 0)
+            {
+                return false;
+            }
+            struct stat st;
+            if (fstat(fd, &st) != 0)
+            {
+                ::close(fd);
+                return false;
+            }
+            size_ = size_t(st.st_size);
+            void *p = size_ ? mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+            ::close(fd);
+            if (p == MAP_FAILED)
+            {
+                size_ = 0;
+                return false;
+            }
+            data_ = static_cast<const uint8_t *>(p);
+            if (data_)
+            {
+                madvise(const_cast<uint8_t *>(data_), size_, MADV_SEQUENTIAL);
+            }
+            return true;
+        }
+
+        void close()
+        {
+            if (data_)
+            {
+                munmap(const_cast<uint8_t *>(data_), size_);
+            }
+            data_ = nullptr;
+            size_ = 0;
+        }
+
+        inline const uint8_t *data() const { return data_; }
+        inline size_t size() const { return size_; }
+
+    private:
+        const uint8_t *data_ = nullptr;
+        size_t size_ = 0;
+    };
+#endif
+
+} // namespace fasttime
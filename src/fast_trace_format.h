@@ -0,0 +1,330 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "esp23_fast_timestamp.h"
+#include "fast_trace.h"
+
+/**
+ * @file fast_trace_format.h
+ * @brief Compact, self-delimiting block encoding of @ref TraceEvent streams.
+ *
+ * @details
+ * A trace stream or file is a sequence of blocks. Each block stands alone, so a reader can
+ * start anywhere (scan for the magic), and a lost block costs only its own events.
+ *
+ * Block header (little-endian, @ref TraceBlockHeader, 40 bytes):
+ *
+ * | Offset | Size | Field                                                        |
+ * |--------|------|--------------------------------------------------------------|
+ * | 0      | 4    | magic @c "FTB1"                                              |
+ * | 4      | 2    | version (1)                                                  |
+ * | 6      | 2    | header size (40); readers skip unknown trailing fields       |
+ * | 8      | 4    | payload bytes                                                |
+ * | 12     | 4    | events in the payload                                        |
+ * | 16     | 8    | base ticks: extended ticks the first delta is relative to    |
+ * | 24     | 4    | block sequence number (gaps are lost blocks)                 |
+ * | 28     | 4    | events dropped since the previous block                      |
+ * | 32     | 4    | CRC-32 (IEEE) of the payload                                 |
+ * | 36     | 4    | nominal tick frequency in Hz                                 |
+ *
+ * Record (1 to @ref kTraceMaxRecord bytes):
+ * - tag byte: bits 0-3 type (15: a full type byte follows), bits 4-6 core (7: a core byte
+ *   follows), bit 7 aux present,
+ * - varint: zigzag tick delta from the previous record (from base ticks for the first),
+ * - varint: arg,
+ * - varint: aux, if flagged.
+ *
+ * A typical task switch encodes in 4-6 bytes instead of 16.
+ */
+
+namespace fasttime
+{
+
+    static constexpr uint32_t kTraceBlockMagic = 0x31425446; ///< "FTB1"
+    static constexpr uint16_t kTraceBlockVersion = 1;
+    static constexpr size_t kTraceMaxRecord = 24;
+
+    /**
+     * @brief In-memory image of a block header.
+     */
+    struct TraceBlockHeader
+    {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t header_size;
+        uint32_t payload_bytes;
+        uint32_t events;
+        uint64_t base_ticks;
+        uint32_t seq;
+        uint32_t dropped;
+        uint32_t crc;
+        uint32_t freq_hz;
+    };
+    static_assert(sizeof(TraceBlockHeader) == 40, "block header is 40 bytes");
+
+    /**
+     * @brief CRC-32 (IEEE 802.3, reflected) of @p len bytes, continuing from @p crc.
+     *
+     * @remarks Nibble table: 64 bytes of constants, two lookups per byte.
+     */
+    static inline uint32_t crc32(const void *data, size_t len, uint32_t crc = 0)
+    {
+        static const uint32_t kTable[16] = {
+            0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4,
+            0x4DB26158, 0x5005713C, 0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+            0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+        };
+        const uint8_t *p = static_cast<const uint8_t *>(data);
+        crc = ~crc;
+        for (size_t i = 0; i < len; ++i)
+        {
+            crc = (crc >> 4) ^ kTable[(crc ^ p[i]) & 0x0F];
+            crc = (crc >> 4) ^ kTable[(crc ^ (uint32_t(p[i]) >> 4)) & 0x0F];
+        }
+        return ~crc;
+    }
+
+    namespace detail
+    {
+        static inline uint8_t *put_varint(uint8_t *p, uint64_t v)
+        {
+            while (v >= 0x80)
+            {
+                *p++ = uint8_t(v) | 0x80;
+                v >>= 7;
+            }
+            *p++ = uint8_t(v);
+            return p;
+        }
+
+        /// @return nullptr on truncation or overlong encoding.
+        static inline const uint8_t *get_varint(const uint8_t *p, const uint8_t *end, uint64_t &v)
+        {
+            v = 0;
+            for (uint32_t shift = 0; p < end && shift < 64; shift += 7)
+            {
+                const uint8_t b = *p++;
+                v |= uint64_t(b & 0x7F) << shift;
+                if (!(b & 0x80))
+                {
+                    return p;
+                }
+            }
+            return nullptr;
+        }
+
+        static inline uint64_t zigzag(int64_t v) { return (uint64_t(v) << 1) ^ uint64_t(v >> 63); }
+        static inline int64_t unzigzag(uint64_t v) { return int64_t(v >> 1) ^ -int64_t(v & 1); }
+    } // namespace detail
+
+    /**
+     * @brief Writes one block into a caller-provided buffer.
+     *
+     * @code
+     * fasttime::TraceBlockEncoder enc;
+     * enc.begin(buf, sizeof(buf), seq++);
+     * while (have_event && enc.append(ev)) { ... }
+     * size_t len = enc.finish(dropped);   // header + payload, ready to send
+     * @endcode
+     */
+    class TraceBlockEncoder
+    {
+    public:
+        /**
+         * @brief Start a block in @p buf (at least header + one record).
+         */
+        inline void begin(uint8_t *buf, size_t capacity, uint32_t seq,
+                          uint32_t freq_hz = uint32_t(FASTTIME_FREQ_HZ))
+        {
+            buf_ = buf;
+            end_ = buf + capacity;
+            p_ = buf + sizeof(TraceBlockHeader);
+            hdr_ = TraceBlockHeader{kTraceBlockMagic, kTraceBlockVersion, uint16_t(sizeof(TraceBlockHeader)),
+                                    0, 0, 0, seq, 0, 0, freq_hz};
+        }
+
+        /**
+         * @brief Encode @p ev (64-bit extended ticks).
+         * @return false if the block is full; the event was not written.
+         */
+        inline bool append(const TraceEvent &ev)
+        {
+            if (size_t(end_ - p_) < kTraceMaxRecord)
+            {
+                return false;
+            }
+            if (hdr_.events == 0)
+            {
+                hdr_.base_ticks = ev.ticks;
+                last_ = ev.ticks;
+            }
+            const uint8_t type = uint8_t(ev.type);
+            uint8_t tag = uint8_t((type < 15 ? type : 15) | ((ev.core < 7 ? ev.core : 7) << 4) |
+                                  (ev.aux ? 0x80 : 0));
+            uint8_t *p = p_;
+            *p++ = tag;
+            if (type >= 15)
+            {
+                *p++ = type;
+            }
+            if (ev.core >= 7)
+            {
+                *p++ = ev.core;
+            }
+            p = detail::put_varint(p, detail::zigzag(int64_t(ev.ticks - last_)));
+            p = detail::put_varint(p, ev.arg);
+            if (ev.aux)
+            {
+                p = detail::put_varint(p, ev.aux);
+            }
+            last_ = ev.ticks;
+            p_ = p;
+            ++hdr_.events;
+            return true;
+        }
+
+        /**
+         * @brief Write the header (with CRC) and return the block size in bytes.
+         *
+         * @param dropped Events lost since the previous block (recorded in the header).
+         */
+        inline size_t finish(uint32_t dropped = 0)
+        {
+            hdr_.dropped = dropped;
+            hdr_.payload_bytes = uint32_t(p_ - buf_ - sizeof(TraceBlockHeader));
+            hdr_.crc = crc32(buf_ + sizeof(TraceBlockHeader), hdr_.payload_bytes);
+            memcpy(buf_, &hdr_, sizeof(hdr_));
+            return size();
+        }
+
+        inline uint32_t events() const { return hdr_.events; }
+        inline uint32_t seq() const { return hdr_.seq; }
+        /** @brief Bytes left for records; @ref append succeeds while this is >= @ref kTraceMaxRecord. */
+        inline size_t remaining() const { return size_t(end_ - p_); }
+        inline size_t size() const { return size_t(p_ - buf_); }
+        inline bool empty() const { return hdr_.events == 0; }
+
+    private:
+        uint8_t *buf_ = nullptr;
+        uint8_t *end_ = nullptr;
+        uint8_t *p_ = nullptr;
+        uint64_t last_ = 0;
+        TraceBlockHeader hdr_{};
+    };
+
+    /**
+     * @brief Zero-copy view of one encoded block.
+     */
+    class TraceBlockReader
+    {
+    public:
+        /**
+         * @brief Parse the block at @p data.
+         *
+         * @return false if @p len does not hold a complete, intact block.
+         */
+        inline bool open(const uint8_t *data, size_t len, bool verify_crc = true)
+        {
+            if (len < sizeof(TraceBlockHeader))
+            {
+                return false;
+            }
+            memcpy(&hdr_, data, sizeof(hdr_));
+            if (hdr_.magic != kTraceBlockMagic || hdr_.version != kTraceBlockVersion ||
+                hdr_.header_size < sizeof(TraceBlockHeader) || hdr_.header_size > len ||
+                hdr_.payload_bytes > len - hdr_.header_size) // no overflow with a 32-bit size_t
+            {
+                return false;
+            }
+            p_ = data + hdr_.header_size;
+            end_ = p_ + hdr_.payload_bytes;
+            if (verify_crc && crc32(p_, hdr_.payload_bytes) != hdr_.crc)
+            {
+                return false;
+            }
+            last_ = hdr_.base_ticks;
+            left_ = hdr_.events;
+            return true;
+        }
+
+        /**
+         * @brief Decode the next record.
+         * @return false at the end of the block or on a malformed record.
+         */
+        inline bool next(TraceEvent &ev)
+        {
+            if (!left_ || p_ >= end_)
+            {
+                return false;
+            }
+            const uint8_t tag = *p_++;
+            uint8_t type = tag & 0x0F;
+            uint8_t core = (tag >> 4) & 0x07;
+            if (type == 15)
+            {
+                if (p_ >= end_)
+                {
+                    return false;
+                }
+                type = *p_++;
+            }
+            if (core == 7)
+            {
+                if (p_ >= end_)
+                {
+                    return false;
+                }
+                core = *p_++;
+            }
+            uint64_t delta, arg, aux = 0;
+            if (!(p_ = detail::get_varint(p_, end_, delta)) || !(p_ = detail::get_varint(p_, end_, arg)) ||
+                ((tag & 0x80) && !(p_ = detail::get_varint(p_, end_, aux))))
+            {
+                p_ = end_;
+                return false;
+            }
+            last_ += uint64_t(detail::unzigzag(delta));
+            ev.ticks = last_;
+            ev.arg = uint32_t(arg);
+            ev.type = TraceType(type);
+            ev.core = core;
+            ev.aux = uint16_t(aux);
+            --left_;
+            return true;
+        }
+
+        inline const TraceBlockHeader &header() const { return hdr_; }
+
+        /** @brief Total block size (header + payload). */
+        inline size_t size() const { return size_t(hdr_.header_size) + hdr_.payload_bytes; }
+
+    private:
+        TraceBlockHeader hdr_{};
+        const uint8_t *p_ = nullptr;
+        const uint8_t *end_ = nullptr;
+        uint64_t last_ = 0;
+        uint32_t left_ = 0;
+    };
+
+    /**
+     * @brief Offset of the next block magic in [@p data, +@p len), or @p len if none.
+     *
+     * @details Resynchronizes a byte stream (e.g. UART capture) after corruption.
+     */
+    static inline size_t trace_find_block(const uint8_t *data, size_t len)
+    {
+        for (size_t i = 0; i + 4 <= len; ++i)
+        {
+            uint32_t m;
+            memcpy(&m, data + i, 4);
+            if (m == kTraceBlockMagic)
+            {
+                return i;
+            }
+        }
+        return len;
+    }
+
+} // namespace fasttime
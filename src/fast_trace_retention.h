@@ -0,0 +1,577 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <type_traits>
+
+#include "esp23_fast_timestamp.h"
+#include "fast_core_local.h"
+#include "fast_core_sync.h"
+#include "fast_registry.h"
+#include "fast_trace.h"
+#include "fast_trace_format.h"
+
+#if defined(FASTTIME_HOST) && defined(__unix__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#elif !defined(FASTTIME_HOST) && __has_include(<esp_attr.h>)
+#include <esp_attr.h>
+#endif
+
+/**
+ * @file fast_trace_retention.h
+ * @brief Post-mortem trace: the last events before a reset, kept in memory that survives it.
+ *
+ * @details
+ * @ref RetainedTraceImage is a plain block of per-core rings meant for memory the startup
+ * code does not clear: @ref FASTTIME_NOINIT (internal RAM, survives software, panic and
+ * watchdog resets) or @ref FASTTIME_RTC_NOINIT (RTC memory, also survives deep sleep). On a
+ * host, @ref RetainedTraceFile maps it from a file, so it survives the process being killed.
+ *
+ * @ref RetainedTrace records into the image with the same cost and rules as
+ * @ref Tracer::emit. After a reset, @ref RetainedTrace::recover walks the previous session's
+ * events in time order, then @ref RetainedTrace::start begins a new session:
+ *
+ * @code
+ * FASTTIME_NOINIT static fasttime::RetainedTraceImage<> crash_image;
+ * static fasttime::RetainedTrace<> crash(crash_image);
+ *
+ * void setup()
+ * {
+ *     Serial.begin(115200);
+ *     crash.dump(Serial);      // whatever the previous boot recorded, if anything
+ *     crash.start();
+ * }
+ * void loop() { crash.emit(fasttime::TraceType::kMarker, step); ... }
+ * @endcode
+ *
+ * @par Integrity
+ * The header (session number, tick frequency, epoch anchor) carries a CRC-32. Slots are
+ * written word by word with a check word last, which mixes the slot contents with the session
+ * number: a slot torn by the reset, or left over from an older session, fails the check and is
+ * skipped. Only 32/64-bit stores are used (ESP32 RTC slow memory has no byte writes).
+ *
+ * @par Time base
+ * Ticks are mapped onto the reference core (@ref set_offsets) and extended to 64 bits per
+ * ring. Extension is exact while each core records at least once per counter wrap
+ * (~17.9 s @ 240 MHz on 32-bit counters). @ref set_epoch anchors the session to wall time.
+ */
+
+/**
+ * @def FASTTIME_NOINIT
+ * @brief Place a variable in RAM that is not cleared at startup (@c .noinit).
+ *
+ * @def FASTTIME_RTC_NOINIT
+ * @brief Place a variable in RTC memory that is not cleared at startup (ESP32; same as
+ *        @ref FASTTIME_NOINIT elsewhere).
+ */
+#if defined(FASTTIME_HOST)
+#define FASTTIME_NOINIT
+#define FASTTIME_RTC_NOINIT
+#elif defined(__NOINIT_ATTR) && defined(RTC_NOINIT_ATTR)
+#define FASTTIME_NOINIT __NOINIT_ATTR
+#define FASTTIME_RTC_NOINIT RTC_NOINIT_ATTR
+#else
+#define FASTTIME_NOINIT __attribute__((section(".noinit")))
+#define FASTTIME_RTC_NOINIT FASTTIME_NOINIT
+#endif
+
+/**
+ * @def FASTTIME_RETAINED_CAPACITY
+ * @brief Default retained events per core (power of two), 24 bytes each.
+ */
+#ifndef FASTTIME_RETAINED_CAPACITY
+#if defined(FASTTIME_HOST)
+#define FASTTIME_RETAINED_CAPACITY 256
+#else
+#define FASTTIME_RETAINED_CAPACITY 64
+#endif
+#endif
+
+namespace fasttime
+{
+
+    static constexpr uint32_t kRetainedTraceMagic = 0x31525446; ///< "FTR1"
+    static constexpr uint32_t kRetainedTraceVersion = 1;
+
+    /**
+     * @brief Session header of a retained trace.
+     */
+    struct RetainedTraceHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t shards;       ///< Rings in the image.
+        uint32_t capacity;     ///< Slots per ring.
+        uint32_t boot;         ///< Session number, incremented by every @ref RetainedTrace::start.
+        uint32_t freq_hz;      ///< Tick frequency.
+        uint64_t start_ticks;  ///< Extended reference ticks when the session started.
+        uint64_t epoch_ticks;  ///< Extended reference ticks of the wall-clock anchor.
+        uint64_t epoch_ns;     ///< Unix-epoch ns at @ref epoch_ticks (0: no anchor).
+        uint32_t reserved;
+        uint32_t crc;          ///< CRC-32 of the fields above.
+    };
+
+    /**
+     * @brief One retained event, written as whole words.
+     */
+    struct RetainedSlot
+    {
+        uint64_t ticks; ///< Extended reference ticks.
+        uint32_t arg;
+        uint32_t meta;  ///< type | core << 8 | aux << 16.
+        uint32_t seq;   ///< Position in the ring's sequence.
+        uint32_t check; ///< @ref detail::retained_check of the above and the session.
+    };
+    static_assert(sizeof(RetainedSlot) == 24, "retained slots are 24 bytes");
+
+    /**
+     * @brief Memory image of a retained trace. Place it with @ref FASTTIME_NOINIT.
+     *
+     * @details Trivial type: it must not be touched by constructors at startup.
+     */
+    template <size_t Capacity = FASTTIME_RETAINED_CAPACITY>
+    struct RetainedTraceImage
+    {
+        static_assert(Capacity && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+        struct Ring
+        {
+            uint32_t head;     ///< Next sequence number.
+            uint32_t reserved;
+            uint64_t last;     ///< Raw reference ticks of the last event.
+            uint64_t ext;      ///< Extended ticks matching @ref last.
+            RetainedSlot slots[Capacity];
+        };
+
+        RetainedTraceHeader header;
+        Ring rings[FASTTIME_SHARDS];
+    };
+
+    /**
+     * @brief What @ref RetainedTrace::recover found.
+     */
+    struct RetainedTraceInfo
+    {
+        bool valid;           ///< The image held an intact header.
+        uint32_t boot;        ///< Session the events belong to.
+        uint32_t freq_hz;
+        uint64_t start_ticks; ///< Session start (extended reference ticks).
+        uint64_t epoch_ticks; ///< Wall-clock anchor: @ref epoch_ns at these ticks.
+        uint64_t epoch_ns;    ///< 0 if the session was never anchored.
+        uint64_t last_ticks;  ///< Most recent event, i.e. shortly before the reset.
+        uint32_t events;      ///< Events delivered.
+        uint32_t torn;        ///< Slots skipped because their check failed.
+
+        /** @brief Unix-epoch ns of @p ticks, or 0 without an anchor. */
+        inline uint64_t to_epoch_ns(uint64_t ticks) const
+        {
+            if (!epoch_ns || !freq_hz)
+            {
+                return 0;
+            }
+            const NsConverter cvt = NsConverter::make(freq_hz);
+            return ticks >= epoch_ticks ? epoch_ns + cvt.to_ns(ticks - epoch_ticks)
+                                        : epoch_ns - cvt.to_ns(epoch_ticks - ticks);
+        }
+    };
+
+    namespace detail
+    {
+        static inline FASTTIME_ALWAYS_INLINE uint32_t retained_check(uint64_t ticks, uint32_t arg, uint32_t meta,
+                                                                     uint32_t seq, uint32_t boot)
+        {
+            uint32_t h = (seq ^ boot) * 0x9E3779B1u;
+            h = (h ^ uint32_t(ticks) ^ (uint32_t(ticks >> 32) * 0x85EBCA77u)) * 0xC2B2AE3Du;
+            h = (h ^ arg ^ (meta * 0x27D4EB2Fu)) * 0x165667B1u;
+            return h ^ (h >> 15) ^ kRetainedTraceMagic;
+        }
+
+        static inline uint32_t retained_header_crc(const RetainedTraceHeader &h)
+        {
+            return crc32(&h, offsetof(RetainedTraceHeader, crc));
+        }
+    } // namespace detail
+
+    /**
+     * @brief Records into, and recovers from, a @ref RetainedTraceImage.
+     *
+     * @tparam Capacity Slots per core; must match the image.
+     */
+    template <size_t Capacity = FASTTIME_RETAINED_CAPACITY>
+    class RetainedTrace
+    {
+    public:
+        using Image = RetainedTraceImage<Capacity>;
+
+        explicit RetainedTrace(Image &image) : image_(&image) {}
+
+        /**
+         * @brief Visit the events of the session recorded before the reset, oldest first.
+         *
+         * @details Call before @ref start. @p fn receives @ref TraceEvent values with extended
+         *          reference ticks. Does not modify the image.
+         */
+        template <typename Fn>
+        RetainedTraceInfo recover(Fn &&fn) const
+        {
+            RetainedTraceInfo info{};
+            const RetainedTraceHeader h = image_->header;
+            if (h.magic != kRetainedTraceMagic || h.version != kRetainedTraceVersion ||
+                h.shards != FASTTIME_SHARDS || h.capacity != Capacity ||
+                h.crc != detail::retained_header_crc(h))
+            {
+                return info;
+            }
+            info.valid = true;
+            info.boot = h.boot;
+            info.freq_hz = h.freq_hz;
+            info.start_ticks = h.start_ticks;
+            info.epoch_ticks = h.epoch_ticks;
+            info.epoch_ns = h.epoch_ns;
+
+            // Per ring: the newest intact slot bounds the readable window.
+            uint32_t next[FASTTIME_SHARDS];
+            uint32_t end[FASTTIME_SHARDS];
+            for (uint32_t r = 0; r < FASTTIME_SHARDS; ++r)
+            {
+                const typename Image::Ring &ring = image_->rings[r];
+                bool any = false;
+                uint32_t newest = 0;
+                for (uint32_t i = 0; i < Capacity; ++i)
+                {
+                    const RetainedSlot &s = ring.slots[i];
+                    if (intact(s, i, h.boot) && (!any || int32_t(s.seq - newest) > 0))
+                    {
+                        newest = s.seq;
+                        any = true;
+                    }
+                }
+                end[r] = any ? newest + 1 : 0;
+                next[r] = end[r] > Capacity ? end[r] - uint32_t(Capacity) : 0;
+                const RetainedSlot &after = ring.slots[end[r] & (Capacity - 1)];
+                if (any && after.seq == end[r] && !intact(after, end[r] & (Capacity - 1), h.boot))
+                {
+                    ++info.torn; // write cut short by the reset
+                }
+            }
+
+            for (;;)
+            {
+                int best = -1;
+                const RetainedSlot *best_slot = nullptr;
+                for (uint32_t r = 0; r < FASTTIME_SHARDS; ++r)
+                {
+                    while (next[r] != end[r])
+                    {
+                        const uint32_t i = next[r] & (Capacity - 1);
+                        const RetainedSlot &s = image_->rings[r].slots[i];
+                        if (s.seq == next[r] && intact(s, i, h.boot))
+                        {
+                            if (best < 0 || s.ticks < best_slot->ticks)
+                            {
+                                best = int(r);
+                                best_slot = &s;
+                            }
+                            break;
+                        }
+                        ++info.torn;
+                        ++next[r];
+                    }
+                }
+                if (best < 0)
+                {
+                    return info;
+                }
+                ++next[best];
+                TraceEvent ev;
+                ev.ticks = best_slot->ticks;
+                ev.arg = best_slot->arg;
+                ev.type = TraceType(best_slot->meta & 0xFF);
+                ev.core = uint8_t(best_slot->meta >> 8);
+                ev.aux = uint16_t(best_slot->meta >> 16);
+                info.last_ticks = ev.ticks;
+                ++info.events;
+                fn(static_cast<const TraceEvent &>(ev));
+            }
+        }
+
+        /**
+         * @brief Begin a new session: bump the session number and clear the rings.
+         *
+         * @details Until this is called, @ref emit does nothing, so the previous session stays
+         *          recoverable.
+         */
+        void start(uint32_t freq_hz = uint32_t(FASTTIME_FREQ_HZ))
+        {
+            Image &img = *image_;
+            const bool had = img.header.magic == kRetainedTraceMagic &&
+                             img.header.crc == detail::retained_header_crc(img.header);
+            const Timestamp now = reference_now();
+            RetainedTraceHeader h{};
+            h.magic = kRetainedTraceMagic;
+            h.version = kRetainedTraceVersion;
+            h.shards = FASTTIME_SHARDS;
+            h.capacity = uint32_t(Capacity);
+            h.boot = had ? img.header.boot + 1 : 1;
+            h.freq_hz = freq_hz;
+            h.start_ticks = uint64_t(now.ticks);
+            h.crc = detail::retained_header_crc(h);
+            img.header = h;
+            for (uint32_t r = 0; r < FASTTIME_SHARDS; ++r)
+            {
+                typename Image::Ring &ring = img.rings[r];
+                const uint32_t state = locks_[r].enter();
+                ring.head = 0;
+                ring.last = uint64_t(now.ticks);
+                ring.ext = uint64_t(now.ticks);
+                locks_[r].exit(state);
+            }
+            active_ = true;
+        }
+
+        /** @brief Stop recording (the image keeps its contents). */
+        inline void stop() { active_ = false; }
+
+        inline bool active() const { return active_; }
+
+        /**
+         * @brief Map every core's ticks onto @p offsets' reference core from now on.
+         *
+         * @details Call before @ref start; @p offsets must outlive the recorder.
+         */
+        inline void set_offsets(const CoreClockOffsets *offsets) { offsets_ = offsets; }
+
+        /**
+         * @brief Anchor the session to wall time: @p epoch_ns is "now".
+         *
+         * @code
+         * crash.set_epoch(fasttime::epoch_now_ns());   // after SNTP sync
+         * @endcode
+         */
+        void set_epoch(uint64_t epoch_ns)
+        {
+            uint32_t state;
+            const uint32_t shard = enter_shard_index(locks_, state);
+            const uint64_t ext = extend(image_->rings[shard], reference_now());
+            locks_[shard].exit(state);
+            RetainedTraceHeader h = image_->header;
+            h.epoch_ticks = ext;
+            h.epoch_ns = epoch_ns;
+            h.crc = detail::retained_header_crc(h);
+            image_->header = h;
+        }
+
+        /**
+         * @brief Record an event on the calling core.
+         *
+         * @remarks Safe from tasks (pinned or not) and ISRs up to level 3.
+         * @return false before @ref start.
+         */
+        FASTTIME_ALWAYS_INLINE inline bool emit(TraceType type, uint32_t arg, uint16_t aux = 0)
+        {
+            if (!active_)
+            {
+                return false;
+            }
+            uint32_t state;
+            const uint32_t shard = enter_shard_index(locks_, state);
+            put(image_->rings[shard], type, arg, aux);
+            locks_[shard].exit(state);
+            return true;
+        }
+
+        /**
+         * @brief @ref emit for any interrupt level (see @ref ShardLock::enter_from_isr).
+         */
+        FASTTIME_ALWAYS_INLINE inline bool emit_from_isr(TraceType type, uint32_t arg, uint16_t aux = 0)
+        {
+            if (!active_)
+            {
+                return false;
+            }
+            uint32_t state;
+            const uint32_t shard = enter_shard_index<true>(locks_, state);
+            put(image_->rings[shard], type, arg, aux);
+            locks_[shard].exit(state);
+            return true;
+        }
+
+        /**
+         * @brief Print the recovered session into @p sink, times relative to the last event.
+         *
+         * @return What @ref recover found.
+         */
+        RetainedTraceInfo dump(LineSink sink, void *ctx) const
+        {
+            // Two passes: the first finds the last event, the second prints relative to it.
+            const RetainedTraceInfo scan = recover([](const TraceEvent &) {});
+            if (!scan.valid)
+            {
+                sink(ctx, "retained trace: none");
+                return scan;
+            }
+            char line[128];
+            char when[48] = "no wall-clock anchor";
+            const uint64_t last_ns = scan.to_epoch_ns(scan.last_ticks);
+            if (last_ns)
+            {
+                snprintf(when, sizeof(when), "last event at %llu.%06llu s",
+                         (unsigned long long)(last_ns / 1000000000ULL),
+                         (unsigned long long)(last_ns % 1000000000ULL / 1000));
+            }
+            snprintf(line, sizeof(line), "retained trace: session %lu, %lu events, %lu torn, %s",
+                     (unsigned long)scan.boot, (unsigned long)scan.events, (unsigned long)scan.torn, when);
+            sink(ctx, line);
+            const NsConverter cvt = NsConverter::make(scan.freq_hz ? scan.freq_hz : FASTTIME_FREQ_HZ);
+            return recover([&](const TraceEvent &e) {
+                char us[24];
+                detail::format_us(us, sizeof(us), cvt.to_ns(scan.last_ticks - e.ticks));
+                snprintf(line, sizeof(line), "  -%s us  core %u  %-10s arg=%lu aux=%u", us, unsigned(e.core),
+                         trace_type_name(e.type), (unsigned long)e.arg, unsigned(e.aux));
+                sink(ctx, line);
+            });
+        }
+
+#if defined(ARDUINO)
+        /** @brief @ref dump to a serial port or any other Arduino @c Print. */
+        RetainedTraceInfo dump(Print &out) const
+        {
+            return dump([](void *ctx, const char *line) { static_cast<Print *>(ctx)->println(line); }, &out);
+        }
+#endif
+
+        /** @brief @ref dump to a stdio stream. */
+        RetainedTraceInfo dump(FILE *out) const
+        {
+            return dump([](void *ctx, const char *line) { fprintf(static_cast<FILE *>(ctx), "%s\n", line); },
+                        out);
+        }
+
+        inline Image &image() { return *image_; }
+
+    private:
+        static inline bool intact(const RetainedSlot &s, uint32_t index, uint32_t boot)
+        {
+            return (s.seq & (Capacity - 1)) == index &&
+                   s.check == detail::retained_check(s.ticks, s.arg, s.meta, s.seq, boot);
+        }
+
+        FASTTIME_ALWAYS_INLINE inline Timestamp reference_now() const
+        {
+            const CoreTimestamp t = CoreTimestamp::now();
+            return offsets_ ? t.on_reference(*offsets_) : t.ts;
+        }
+
+        static FASTTIME_ALWAYS_INLINE inline uint64_t extend(typename Image::Ring &ring, const Timestamp ts)
+        {
+            const Timestamp last{(fast_counter_t)ring.last};
+            // Offset error can put an event marginally before its predecessor.
+            if (before(ts, last))
+            {
+                return ring.ext;
+            }
+            ring.ext += cycles_between(last, ts);
+            ring.last = uint64_t(ts.ticks);
+            return ring.ext;
+        }
+
+        FASTTIME_ALWAYS_INLINE inline void put(typename Image::Ring &ring, TraceType type, uint32_t arg,
+                                               uint16_t aux)
+        {
+            const CoreTimestamp t = CoreTimestamp::now();
+            const uint64_t ticks = extend(ring, offsets_ ? t.on_reference(*offsets_) : t.ts);
+            const uint32_t meta = uint32_t(type) | (t.core & 0xFFu) << 8 | uint32_t(aux) << 16;
+            const uint32_t seq = ring.head;
+            volatile RetainedSlot &s = ring.slots[seq & (Capacity - 1)];
+            s.seq = seq;
+            s.ticks = ticks;
+            s.arg = arg;
+            s.meta = meta;
+            s.check = detail::retained_check(ticks, arg, meta, seq, image_->header.boot);
+            ring.head = seq + 1;
+        }
+
+        Image *image_;
+        const CoreClockOffsets *offsets_ = nullptr;
+        volatile bool active_ = false;
+        ShardLock locks_[FASTTIME_SHARDS];
+    };
+
+#if defined(FASTTIME_HOST) && defined(__unix__)
+    /**
+     * @brief Host stand-in for noinit memory: a @ref RetainedTraceImage in a shared file mapping.
+     *
+     * @details Stores land in the page cache, so the image survives the process crashing or
+     *          being killed (not a power loss). A new or mismatched file reads as no session.
+     *
+     * @code
+     * fasttime::RetainedTraceFile<> file;
+     * file.open("crash.ftr");
+     * fasttime::RetainedTrace<> crash(*file.image());
+     * crash.dump(stdout);
+     * crash.start();
+     * @endcode
+     */
+    template <size_t Capacity = FASTTIME_RETAINED_CAPACITY>
+    class RetainedTraceFile
+    {
+    public:
+        using Image = RetainedTraceImage<Capacity>;
+
+        RetainedTraceFile() = default;
+        ~RetainedTraceFile() { close(); }
+
+        RetainedTraceFile(const RetainedTraceFile &) = delete;
+        RetainedTraceFile &operator=(const RetainedTraceFile &) = delete;
+
+        /** @brief Map (creating if needed) @p path. @return false on error. */
+        bool open(const char *path)
+        {
+            close();
+            const int fd = ::open(path, O_RDWR | O_CREAT, 0644);
+            if (fd < 0)
+            {
+                return false;
+            }
+            struct stat st;
+            if (fstat(fd, &st) != 0 || (size_t(st.st_size) != sizeof(Image) && ftruncate(fd, 0) != 0) ||
+                ftruncate(fd, sizeof(Image)) != 0)
+            {
+                ::close(fd);
+                return false;
+            }
+            void *p = mmap(nullptr, sizeof(Image), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (p == MAP_FAILED)
+            {
+                return false;
+            }
+            image_ = static_cast<Image *>(p);
+            return true;
+        }
+
+        /** @brief Write the image back to the file now (survives a host power loss). */
+        bool sync() { return image_ && msync(image_, sizeof(Image), MS_SYNC) == 0; }
+
+        void close()
+        {
+            if (image_)
+            {
+                munmap(image_, sizeof(Image));
+                image_ = nullptr;
+            }
+        }
+
+        inline Image *image() { return image_; }
+
+    private:
+        Image *image_ = nullptr;
+    };
+#endif
+
+    static_assert(std::is_trivial<RetainedTraceImage<>>::value, "the image must not need construction");
+
+} // namespace fasttime
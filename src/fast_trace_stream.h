@@ -0,0 +1,546 @@
+#pragma once
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp23_fast_timestamp.h"
+#include "fast_core_sync.h"
+#include "fast_trace.h"
+#include "fast_trace_format.h"
+
+#if defined(FASTTIME_HOST)
+#include <condition_variable>
+#include <errno.h>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+#else
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#if defined(ARDUINO)
+#include <Print.h>
+#endif
+#if __has_include(<driver/uart.h>)
+#include <driver/uart.h>
+#define FASTTIME_TRACE_UART 1
+#endif
+#endif
+
+/**
+ * @file fast_trace_stream.h
+ * @brief Non-blocking trace transport: double-buffered encoded blocks to an asynchronous sink.
+ *
+ * @details
+ * Producers only ever touch the @ref Tracer rings (a few dozen cycles, never blocking). A
+ * single consumer calls @ref TraceStream::pump, which drains the rings in time order, encodes
+ * the events into @ref fast_trace_format.h blocks in one of two buffers, and hands a filled
+ * buffer to a @ref TraceSink while it fills the other. The sink owns that buffer until it
+ * calls @ref TraceTransfer::complete; a DMA driver does so from its end-of-transfer ISR, the
+ * bundled @ref TraceAsyncWriter from its writer task/thread.
+ *
+ * While the link is idle, @ref TraceStream::pump sends whatever is encoded (low latency);
+ * while it is busy, blocks grow up to the buffer size (high throughput).
+ *
+ * When a block is full and the previous one is still in flight, @ref TraceBackpressure picks
+ * what gives:
+ * - @c kBlock: the pump waits for the sink. Nothing is lost in the stream; if the link stays
+ *   too slow, the rings fill and @ref Tracer::emit drops (and counts) new events.
+ * - @c kDropNewest: the pump returns and leaves events in the rings, which then drop new
+ *   events at the producer. The consumer task never stalls.
+ * - @c kDropOldest: the full block is discarded and encoding continues, so the stream keeps
+ *   the most recent events. The lost block shows as a sequence gap.
+ *
+ * Every block header carries the events dropped since the previous block (ring and stream
+ * drops), so the decoder knows exactly where the holes are.
+ *
+ * @code
+ * static fasttime::Tracer<> tracer;
+ * static fasttime::TraceAsyncWriter writer(fasttime::trace_write_print, &Serial);
+ * static fasttime::TraceStream<> stream(fasttime::TraceAsyncWriter::sink, &writer);
+ *
+ * void setup() { Serial.begin(2000000); writer.start(); }
+ * void loop()  { stream.pump(tracer); delay(1); }
+ * @endcode
+ *
+ * @remarks The ESP32 UART writer goes through the IDF UART driver (ring buffer + FIFO ISR);
+ *          a UHCI/GDMA sink can be plugged in as a @ref TraceSink without other changes.
+ */
+
+/**
+ * @def FASTTIME_TRACE_STREAM_BYTES
+ * @brief Default size of each of the two block buffers.
+ */
+#ifndef FASTTIME_TRACE_STREAM_BYTES
+#define FASTTIME_TRACE_STREAM_BYTES 4096
+#endif
+
+namespace fasttime
+{
+
+    /**
+     * @brief Completion flag shared between a @ref TraceStream and its sink.
+     */
+    struct TraceTransfer
+    {
+        std::atomic<bool> busy{false};
+
+        /** @brief The sink is done with the buffer. Safe from ISRs (e.g. DMA done) and other cores. */
+        FASTTIME_HOT inline void complete() { busy.store(false, std::memory_order_release); }
+    };
+
+    /**
+     * @brief Start sending @p len bytes at @p data.
+     *
+     * @details The buffer stays valid until @c xfer.complete() is called, which may happen
+     *          before the sink returns (synchronous sinks).
+     * @return false if the sink rejected the block (it must not call complete() then).
+     */
+    using TraceSink = bool (*)(void *ctx, TraceTransfer &xfer, const uint8_t *data, size_t len);
+
+    /**
+     * @brief What @ref TraceStream does when a block is full and the sink is still busy.
+     */
+    enum class TraceBackpressure : uint8_t
+    {
+        kBlock,      ///< Wait for the sink.
+        kDropNewest, ///< Stop draining; the rings drop new events.
+        kDropOldest, ///< Discard the full block and keep encoding.
+    };
+
+    /**
+     * @brief Stream counters.
+     */
+    struct TraceStreamStats
+    {
+        uint64_t events;         ///< Events encoded into sent blocks.
+        uint64_t bytes;          ///< Bytes handed to the sink.
+        uint32_t blocks;         ///< Blocks handed to the sink.
+        uint32_t dropped_events; ///< Events lost (rings, discarded and rejected blocks).
+        uint32_t dropped_blocks; ///< Blocks discarded or rejected by the sink.
+        uint32_t stalls;         ///< Times a full block found the sink busy.
+    };
+
+    namespace detail
+    {
+        static inline void trace_stream_wait()
+        {
+#if defined(FASTTIME_HOST)
+            std::this_thread::yield();
+#else
+            vTaskDelay(1);
+#endif
+        }
+    } // namespace detail
+
+    /**
+     * @brief Double-buffered encoder in front of a @ref TraceSink.
+     *
+     * @tparam BufferBytes Size of each block buffer (>= 64).
+     *
+     * @remarks Single consumer: call @ref pump, @ref write and @ref flush from one task.
+     */
+    template <size_t BufferBytes = FASTTIME_TRACE_STREAM_BYTES>
+    class TraceStream
+    {
+        static_assert(BufferBytes >= sizeof(TraceBlockHeader) + kTraceMaxRecord, "buffer too small");
+
+    public:
+        TraceStream(TraceSink sink, void *ctx, TraceBackpressure policy = TraceBackpressure::kBlock,
+                    uint32_t freq_hz = uint32_t(FASTTIME_FREQ_HZ))
+            : sink_(sink), ctx_(ctx), policy_(policy), freq_hz_(freq_hz)
+        {
+            enc_.begin(buf_[0], BufferBytes, seq_++, freq_hz_);
+        }
+
+        /**
+         * @brief Move events from @p tracer into blocks and send as the sink allows.
+         *
+         * @return Events taken from the rings.
+         */
+        template <size_t Capacity>
+        size_t pump(Tracer<Capacity> &tracer, const CoreClockOffsets *offsets = nullptr)
+        {
+            const uint32_t ring_dropped = tracer.dropped();
+            dropped_ += ring_dropped - ring_dropped_seen_;
+            stats_.dropped_events += ring_dropped - ring_dropped_seen_;
+            ring_dropped_seen_ = ring_dropped;
+
+            size_t n = 0;
+            for (;;)
+            {
+                if (enc_.remaining() < kTraceMaxRecord && !rotate())
+                {
+                    return n;
+                }
+                // Every record fits: the budget assumes the worst-case record size.
+                const size_t budget = enc_.remaining() / kTraceMaxRecord;
+                const size_t got =
+                    tracer.drain_ordered([this](const TraceEvent &ev) { enc_.append(ev); }, offsets, budget);
+                n += got;
+                if (got < budget)
+                {
+                    break;
+                }
+            }
+            if (!enc_.empty() && !xfer_.busy.load(std::memory_order_acquire))
+            {
+                send();
+            }
+            return n;
+        }
+
+        /**
+         * @brief Encode one event (64-bit extended ticks, non-decreasing).
+         *
+         * @return false if the event was dropped (@c kDropNewest with the sink busy).
+         */
+        bool write(const TraceEvent &ev)
+        {
+            if (enc_.remaining() < kTraceMaxRecord && !rotate())
+            {
+                ++dropped_;
+                ++stats_.dropped_events;
+                return false;
+            }
+            enc_.append(ev);
+            return true;
+        }
+
+        /**
+         * @brief Send the partial block, waiting for the sink if it is busy.
+         *
+         * @param wait_done Also wait until the sink has finished with it.
+         */
+        void flush(bool wait_done = false)
+        {
+            if (!enc_.empty())
+            {
+                wait_idle();
+                send();
+            }
+            if (wait_done)
+            {
+                wait_idle();
+            }
+        }
+
+        /** @brief True while a block is in flight. */
+        inline bool busy() const { return xfer_.busy.load(std::memory_order_acquire); }
+
+        inline const TraceStreamStats &stats() const { return stats_; }
+
+        inline void set_policy(TraceBackpressure policy) { policy_ = policy; }
+        inline TraceBackpressure policy() const { return policy_; }
+
+        static constexpr size_t buffer_bytes() { return BufferBytes; }
+
+    private:
+        /// Make room in a full block. @return false if encoding must pause (kDropNewest).
+        bool rotate()
+        {
+            if (xfer_.busy.load(std::memory_order_acquire))
+            {
+                ++stats_.stalls;
+                switch (policy_)
+                {
+                case TraceBackpressure::kBlock:
+                    wait_idle();
+                    break;
+                case TraceBackpressure::kDropNewest:
+                    return false;
+                case TraceBackpressure::kDropOldest:
+                    dropped_ += enc_.events();
+                    stats_.dropped_events += enc_.events();
+                    ++stats_.dropped_blocks;
+                    enc_.begin(buf_[fill_], BufferBytes, seq_++, freq_hz_);
+                    return true;
+                }
+            }
+            send();
+            return true;
+        }
+
+        void wait_idle()
+        {
+            while (xfer_.busy.load(std::memory_order_acquire))
+            {
+                detail::trace_stream_wait();
+            }
+        }
+
+        /// Hand the filled buffer to the sink (which must be idle) and switch buffers.
+        void send()
+        {
+            const uint32_t events = enc_.events();
+            const size_t len = enc_.finish(dropped_);
+            xfer_.busy.store(true, std::memory_order_relaxed);
+            if (sink_(ctx_, xfer_, buf_[fill_], len))
+            {
+                dropped_ = 0;
+                stats_.events += events;
+                stats_.bytes += len;
+                ++stats_.blocks;
+                fill_ ^= 1;
+            }
+            else
+            {
+                xfer_.busy.store(false, std::memory_order_relaxed);
+                dropped_ += events;
+                stats_.dropped_events += events;
+                ++stats_.dropped_blocks;
+            }
+            enc_.begin(buf_[fill_], BufferBytes, seq_++, freq_hz_);
+        }
+
+        TraceSink sink_;
+        void *ctx_;
+        TraceBackpressure policy_;
+        uint32_t freq_hz_;
+        TraceTransfer xfer_;
+        TraceBlockEncoder enc_;
+        uint32_t fill_ = 0;
+        uint32_t seq_ = 0;
+        uint32_t dropped_ = 0;
+        uint32_t ring_dropped_seen_ = 0;
+        TraceStreamStats stats_{};
+        alignas(4) uint8_t buf_[2][BufferBytes];
+    };
+
+    // ------------------------------------------------------------------------------------------
+    // Asynchronous writer
+    // ------------------------------------------------------------------------------------------
+
+    /**
+     * @brief Blocking write of @p len bytes. @return false on error.
+     */
+    using TraceWriteFn = bool (*)(void *ctx, const uint8_t *data, size_t len);
+
+    /**
+     * @brief Runs a blocking @ref TraceWriteFn on its own thread (host) or task (FreeRTOS), so
+     *        it can serve as a @ref TraceSink.
+     *
+     * @details One block at a time, which is all a @ref TraceStream submits.
+     */
+    class TraceAsyncWriter
+    {
+    public:
+        TraceAsyncWriter(TraceWriteFn write, void *ctx) : write_(write), ctx_(ctx) {}
+        ~TraceAsyncWriter() { stop(); }
+
+        TraceAsyncWriter(const TraceAsyncWriter &) = delete;
+        TraceAsyncWriter &operator=(const TraceAsyncWriter &) = delete;
+
+        /**
+         * @brief Start the writer.
+         *
+         * @param priority FreeRTOS priority (ignored on host).
+         * @param core     FreeRTOS core affinity (ignored on host).
+         */
+        bool start(uint32_t priority = 5, int core = 0)
+        {
+            if (running_)
+            {
+                return true;
+            }
+            stop_ = false;
+#if defined(FASTTIME_HOST)
+            (void)priority;
+            (void)core;
+            thread_ = std::thread([this] { run(); });
+            running_ = true;
+#else
+            auto task = [](void *self) {
+                static_cast<TraceAsyncWriter *>(self)->run();
+                static_cast<TraceAsyncWriter *>(self)->exited_ = true;
+                vTaskDelete(nullptr);
+            };
+            exited_ = false;
+            running_ = xTaskCreatePinnedToCore(task, "fts_stream", 3072, this, UBaseType_t(priority), &task_,
+                                               core) == pdPASS;
+#endif
+            return running_;
+        }
+
+        /** @brief Finish the pending block and stop the writer. */
+        void stop()
+        {
+            if (!running_)
+            {
+                return;
+            }
+#if defined(FASTTIME_HOST)
+            {
+                std::lock_guard<std::mutex> g(mutex_);
+                stop_ = true;
+            }
+            cv_.notify_one();
+            thread_.join();
+#else
+            stop_ = true;
+            xTaskNotifyGive(task_);
+            while (!exited_)
+            {
+                vTaskDelay(1);
+            }
+#endif
+            running_ = false;
+        }
+
+        /**
+         * @brief @ref TraceSink entry point; @p self is the writer.
+         */
+        static bool sink(void *self, TraceTransfer &xfer, const uint8_t *data, size_t len)
+        {
+            TraceAsyncWriter &w = *static_cast<TraceAsyncWriter *>(self);
+            if (!w.running_)
+            {
+                return false;
+            }
+#if defined(FASTTIME_HOST)
+            {
+                std::lock_guard<std::mutex> g(w.mutex_);
+                if (w.job_.data)
+                {
+                    return false;
+                }
+                w.job_ = Job{&xfer, data, len};
+            }
+            w.cv_.notify_one();
+#else
+            if (w.job_.data)
+            {
+                return false;
+            }
+            w.job_.xfer = &xfer;
+            w.job_.len = len;
+            std::atomic_thread_fence(std::memory_order_release);
+            w.job_.data = data;
+            xTaskNotifyGive(w.task_);
+#endif
+            return true;
+        }
+
+        /** @brief Failed writes (their blocks are lost). */
+        inline uint32_t errors() const { return errors_.load(std::memory_order_relaxed); }
+
+    private:
+        struct Job
+        {
+            TraceTransfer *xfer;
+            const uint8_t *volatile data;
+            size_t len;
+        };
+
+        void run()
+        {
+            for (;;)
+            {
+                Job job;
+#if defined(FASTTIME_HOST)
+                {
+                    std::unique_lock<std::mutex> g(mutex_);
+                    cv_.wait(g, [this] { return job_.data || stop_; });
+                    if (!job_.data)
+                    {
+                        return;
+                    }
+                    job = job_;
+                }
+#else
+                while (!job_.data)
+                {
+                    if (stop_)
+                    {
+                        return;
+                    }
+                    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+                }
+                std::atomic_thread_fence(std::memory_order_acquire);
+                job.xfer = job_.xfer;
+                job.data = job_.data;
+                job.len = job_.len;
+#endif
+                if (!write_(ctx_, job.data, job.len))
+                {
+                    errors_.fetch_add(1, std::memory_order_relaxed);
+                }
+#if defined(FASTTIME_HOST)
+                {
+                    std::lock_guard<std::mutex> g(mutex_);
+                    job_.data = nullptr;
+                }
+#else
+                job_.data = nullptr;
+#endif
+                job.xfer->complete();
+            }
+        }
+
+        TraceWriteFn write_;
+        void *ctx_;
+        Job job_{nullptr, nullptr, 0};
+        std::atomic<uint32_t> errors_{0};
+        volatile bool stop_ = false;
+        bool running_ = false;
+#if defined(FASTTIME_HOST)
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        std::thread thread_;
+#else
+        TaskHandle_t task_ = nullptr;
+        volatile bool exited_ = false;
+#endif
+    };
+
+    // ------------------------------------------------------------------------------------------
+    // Write functions
+    // ------------------------------------------------------------------------------------------
+
+#if defined(FASTTIME_HOST)
+    /**
+     * @brief @ref TraceWriteFn for a file descriptor; @p ctx points to the @c int fd.
+     */
+    static inline bool trace_write_fd(void *ctx, const uint8_t *data, size_t len)
+    {
+        const int fd = *static_cast<const int *>(ctx);
+        while (len)
+        {
+            const ssize_t n = ::write(fd, data, len);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return false;
+            }
+            data += n;
+            len -= size_t(n);
+        }
+        return true;
+    }
+#else
+#if defined(ARDUINO)
+    /**
+     * @brief @ref TraceWriteFn for an Arduino @c Print (e.g. @c Serial, @c Serial1); @p ctx is
+     *        the @c Print.
+     */
+    static inline bool trace_write_print(void *ctx, const uint8_t *data, size_t len)
+    {
+        return static_cast<Print *>(ctx)->write(data, len) == len;
+    }
+#endif
+
+#if defined(FASTTIME_TRACE_UART)
+    /**
+     * @brief @ref TraceWriteFn for an installed IDF UART driver; @p ctx is the port number
+     *        cast to a pointer.
+     */
+    static inline bool trace_write_uart(void *ctx, const uint8_t *data, size_t len)
+    {
+        return uart_write_bytes(uart_port_t(intptr_t(ctx)), data, len) == int(len);
+    }
+#endif
+#endif
+
+} // namespace fasttime
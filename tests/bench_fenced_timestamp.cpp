@@ -0,0 +1,84 @@
+// Host benchmark: cost and spread of fenced Timestamp::now_begin()/now_end() against plain now().
+//
+// Empty regions show what each probe pair costs; the short memory-bound region shows how much
+// the fences reduce the spread of a measurement that the CPU could otherwise overlap with the
+// surrounding code.
+
+#include <esp23_fast_timestamp.h>
+#include <fast_cycle_stats.h>
+
+#include <stdio.h>
+
+using namespace fasttime;
+
+static constexpr uint32_t kSamples = 200000;
+static volatile uint32_t sink[64];
+static uint32_t chain[4096];
+
+// A dependent load chain followed by stores: long enough to be reordered around, short enough
+// that the probes matter.
+static inline void region(uint32_t seed)
+{
+    uint32_t at = seed & 4095;
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+        at = chain[at];
+    }
+    for (uint32_t i = 0; i < 64; ++i)
+    {
+        sink[i] = sink[i] + at;
+    }
+}
+
+static void report(const char *name, const CycleAccumulator &s)
+{
+    printf("%-10s mean %5llu cycles, sd %4llu, min %5llu, max %7llu\n", name,
+           (unsigned long long)s.mean_cycles(), (unsigned long long)s.stddev_cycles(),
+           (unsigned long long)s.min, (unsigned long long)s.max);
+}
+
+int main()
+{
+    for (uint32_t i = 0; i < 4096; ++i)
+    {
+        chain[i] = (i * 2654435761u) & 4095;
+    }
+
+    CycleAccumulator plain_empty, fenced_empty, plain, fenced;
+    plain_empty.reset();
+    fenced_empty.reset();
+    plain.reset();
+    fenced.reset();
+    bool ordered = true;
+
+    for (uint32_t i = 0; i < kSamples; ++i)
+    {
+        Timestamp a = Timestamp::now();
+        Timestamp b = Timestamp::now();
+        plain_empty.add(cycles_between(a, b));
+
+        Timestamp c = Timestamp::now_begin();
+        Timestamp d = Timestamp::now_end();
+        fenced_empty.add(cycles_between(c, d));
+        ordered = ordered && !before(d, c);
+
+        Timestamp e = Timestamp::now();
+        region(i);
+        Timestamp f = Timestamp::now();
+        plain.add(cycles_between(e, f));
+
+        Timestamp g = Timestamp::now_begin();
+        region(i);
+        Timestamp h = Timestamp::now_end();
+        fenced.add(cycles_between(g, h));
+    }
+
+    printf("backend %s, %u samples\n", FASTTIME_BACKEND, kSamples);
+    report("now()", plain_empty);
+    report("fenced", fenced_empty);
+    report("region", plain);
+    report("region+f", fenced);
+    printf("fence cost %+lld cycles per pair\n",
+           (long long)fenced_empty.mean_cycles() - (long long)plain_empty.mean_cycles());
+    return ordered ? 0 : 1;
+}
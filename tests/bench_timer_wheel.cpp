@@ -0,0 +1,97 @@
+// Host benchmark: arm, cancel and expire 100k timers on the real cycle counter.
+//
+// Reports cycles per operation for TimerWheel next to a binary-heap timer queue
+// (std::priority_queue, lazy cancellation), the usual software alternative.
+
+#include <esp23_fast_timestamp.h>
+#include <fast_timer_wheel.h>
+
+#include <queue>
+#include <random>
+#include <vector>
+
+using namespace fasttime;
+
+static constexpr size_t kTimers = 100000;
+static constexpr uint64_t kSpread = 2400000000ull; // deadlines over ~1 s of cycles
+
+static TimerWheel<kTimers> wheel(8); // 256-cycle ticks
+static TimerHandle handles[kTimers];
+static uint64_t fired = 0;
+
+static void on_timeout(void *) { ++fired; }
+
+struct HeapTimer
+{
+    uint64_t due;
+    uint32_t index;
+    bool operator<(const HeapTimer &o) const { return due > o.due; }
+};
+
+int main()
+{
+    std::mt19937_64 rng(100000);
+    std::vector<uint64_t> after(kTimers);
+    for (auto &a : after)
+    {
+        a = rng() % kSpread + 1;
+    }
+
+    // TimerWheel. Expiry is driven by a simulated clock so the run does not wait a second.
+    const Timestamp base = Timestamp::now();
+    Timestamp t0 = Timestamp::now();
+    for (size_t i = 0; i < kTimers; ++i)
+    {
+        handles[i] = wheel.schedule_after(base, after[i], on_timeout, nullptr);
+    }
+    const uint64_t arm = cycles_between(t0, Timestamp::now());
+
+    t0 = Timestamp::now();
+    for (size_t i = 0; i < kTimers; i += 2)
+    {
+        wheel.cancel(handles[i]);
+    }
+    const uint64_t cancel = cycles_between(t0, Timestamp::now());
+
+    t0 = Timestamp::now();
+    for (uint64_t sim = 0; wheel.armed(); sim += 100000)
+    {
+        wheel.advance(Timestamp{fast_counter_t(base.ticks + sim)});
+    }
+    const uint64_t expire = cycles_between(t0, Timestamp::now());
+
+    // Binary heap with a cancelled flag per timer.
+    std::priority_queue<HeapTimer> heap;
+    std::vector<bool> cancelled(kTimers);
+    uint64_t heap_fired = 0;
+    t0 = Timestamp::now();
+    for (size_t i = 0; i < kTimers; ++i)
+    {
+        heap.push(HeapTimer{after[i], uint32_t(i)});
+    }
+    const uint64_t heap_arm = cycles_between(t0, Timestamp::now());
+    t0 = Timestamp::now();
+    for (size_t i = 0; i < kTimers; i += 2)
+    {
+        cancelled[i] = true;
+    }
+    const uint64_t heap_cancel = cycles_between(t0, Timestamp::now());
+    t0 = Timestamp::now();
+    for (uint64_t sim = 0; !heap.empty(); sim += 100000)
+    {
+        while (!heap.empty() && heap.top().due <= sim)
+        {
+            heap_fired += !cancelled[heap.top().index];
+            heap.pop();
+        }
+    }
+    const uint64_t heap_expire = cycles_between(t0, Timestamp::now());
+
+    printf("backend %s, %zu timers, %llu fired\n", FASTTIME_BACKEND, kTimers, (unsigned long long)fired);
+    printf("%-12s %10s %10s %14s\n", "", "arm", "cancel", "expire/fired");
+    printf("%-12s %10.1f %10.1f %14.1f  cycles\n", "TimerWheel", double(arm) / kTimers,
+           double(cancel) / (kTimers / 2), double(expire) / double(fired ? fired : 1));
+    printf("%-12s %10.1f %10.1f %14.1f  cycles\n", "binary heap", double(heap_arm) / kTimers,
+           double(heap_cancel) / (kTimers / 2), double(heap_expire) / double(heap_fired ? heap_fired : 1));
+    return fired == kTimers / 2 && heap_fired == kTimers / 2 ? 0 : 1;
+}
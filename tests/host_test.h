@@ -0,0 +1,57 @@
+#pragma once
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Minimal assertions for the host tests in this directory (see run_host_tests.sh).
+//
+// CHECK* report the failing expression with its location and keep going; main() returns
+// host_test_result() so the runner sees the failure count.
+
+inline int host_test_failures = 0;
+
+#define CHECK(cond)                                                                   \
+    do                                                                                \
+    {                                                                                 \
+        if (!(cond))                                                                  \
+        {                                                                             \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            ++host_test_failures;                                                     \
+        }                                                                             \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                                      \
+    do                                                                                      \
+    {                                                                                       \
+        const long long va_ = (long long)(a), vb_ = (long long)(b);                        \
+        if (va_ != vb_)                                                                     \
+        {                                                                                   \
+            fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", __FILE__,     \
+                    __LINE__, #a, #b, va_, vb_);                                            \
+            ++host_test_failures;                                                           \
+        }                                                                                   \
+    } while (0)
+
+#define CHECK_NEAR(a, b, tol)                                                               \
+    do                                                                                      \
+    {                                                                                       \
+        const double va_ = double(a), vb_ = double(b);                                      \
+        if (!(fabs(va_ - vb_) <= double(tol)))                                              \
+        {                                                                                   \
+            fprintf(stderr, "%s:%d: CHECK_NEAR(%s, %s, %s) failed: %.6g vs %.6g\n",         \
+                    __FILE__, __LINE__, #a, #b, #tol, va_, vb_);                            \
+            ++host_test_failures;                                                           \
+        }                                                                                   \
+    } while (0)
+
+/** @brief Exit status for main(): 0 when every check passed. */
+static inline int host_test_result(const char *name)
+{
+    if (host_test_failures)
+    {
+        fprintf(stderr, "%s: %d check(s) failed\n", name, host_test_failures);
+        return 1;
+    }
+    printf("%s: ok\n", name);
+    return 0;
+}
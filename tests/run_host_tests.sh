@@ -0,0 +1,61 @@
+#!/bin/sh
+# Build and run the host tests (tests/test_*.cpp); with --bench, also the host benchmarks
+# (tests/bench_*.cpp).
+#
+# Usage: tests/run_host_tests.sh [--bench] [extra compiler flags]
+# Env:   CXX (default g++)
+#
+# Linux x86-64 / AArch64 / RISC-V. A test is built once per "// host-test-variant: <flags>"
+# line it contains (once with no extra flags if it has none), so the same checks can run
+# against e.g. the 64-bit and the 32-bit mock counter. "// host-test-variant(<uname -m>): <flags>"
+# lines only apply on that machine (e.g. ISA flags such as -mavx2 on x86_64).
+set -eu
+
+dir=$(cd "$(dirname "$0")" && pwd)
+src="$dir/../src"
+out="${TMPDIR:-/tmp}/fasttime_host_tests.$$"
+mkdir -p "$out"
+trap 'rm -rf "$out"' EXIT INT TERM
+
+CXX=${CXX:-g++}
+arch=$(uname -m)
+pattern="test_*.cpp"
+if [ "${1:-}" = "--bench" ]; then
+    pattern="test_*.cpp bench_*.cpp"
+    shift
+fi
+
+failed=0
+ran=0
+for p in $pattern; do
+    for t in "$dir"/$p; do
+        [ -f "$t" ] || continue
+        name=$(basename "$t" .cpp)
+        variants=$(sed -n -e 's|^// host-test-variant: *||p' \
+            -e "s|^// host-test-variant($arch): *||p" "$t")
+        [ -n "$variants" ] || variants=" "
+        n=0
+        # One build per variant line; word splitting of $flags is intended. set -e does not
+        # apply on the left of ||, hence the explicit exits.
+        echo "$variants" | while IFS= read -r flags; do
+            n=$((n + 1))
+            bin="$out/$name.$n"
+            # shellcheck disable=SC2086
+            $CXX -std=gnu++17 -O2 -g -Wall -Wextra -Wshadow -Werror -I"$src" -I"$dir" $flags "$@" \
+                "$t" -o "$bin" -pthread -lrt || exit 1
+            [ -n "${flags# }" ] && echo "[$name $flags]"
+            "$bin" || exit 1
+        done || failed=$((failed + 1))
+        ran=$((ran + 1))
+    done
+done
+
+if [ "$ran" = 0 ]; then
+    echo "run_host_tests: no tests found" >&2
+    exit 1
+fi
+if [ "$failed" != 0 ]; then
+    echo "run_host_tests: $failed of $ran FAILED" >&2
+    exit 1
+fi
+echo "run_host_tests: ok ($ran)"
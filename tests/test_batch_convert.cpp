@@ -0,0 +1,191 @@
+// Batch cycle→µs/ns conversion: every path (AVX2, SSE2 or NEON lanes plus the scalar tail,
+// the 64-bit and the q != 32 loops) matches UsConverter::to_us / NsConverter::to_ns element by
+// element, for inputs at the 32- and 64-bit wrap boundaries, every length up to a few vectors
+// and unaligned starts. One build per ISA so each SIMD path runs; -mno-sse2 forces the scalar
+// loop.
+//
+// host-test-variant: -O2
+// host-test-variant(x86_64): -mavx2
+// host-test-variant(x86_64): -mno-sse2
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <fast_batch_convert.h>
+
+#include "host_test.h"
+
+using namespace fasttime;
+
+namespace
+{
+    const uint32_t kEdges32[] = {0u,          1u,          2u,          3u,         239u,
+                                 240u,        1000u,       0x7FFFFFFFu, 0x80000000u, 0x80000001u,
+                                 0xFFFFFFFDu, 0xFFFFFFFEu, 0xFFFFFFFFu};
+
+    const uint64_t kEdges64[] = {0ull,
+                                 1ull,
+                                 0xFFFFFFFFull,
+                                 0x100000000ull,
+                                 0x100000001ull,
+                                 0x7FFFFFFFFFFFFFFFull,
+                                 0x8000000000000000ull,
+                                 0xFFFFFFFFFFFFFFFEull,
+                                 0xFFFFFFFFFFFFFFFFull,
+                                 240000000ull * 3600 * 24 * 365};
+
+    const uint64_t kFreqs[] = {FASTTIME_FREQ_HZ, 240000000ull, 160000000ull, 80000000ull, 40000000ull,
+                               1000000ull, 32768ull};
+
+    constexpr size_t kMaxLen = 19;
+
+    // Exact floor(c * k / 2^shift), the value to_us returns whenever c * k fits 64 bits.
+    uint64_t exact_us(uint64_t c, const UsConverter &cvt)
+    {
+        __extension__ typedef unsigned __int128 u128;
+        return (uint64_t)(((u128)c * cvt.k) >> cvt.shift);
+    }
+
+    // to_us wraps once c * k exceeds 64 bits; the Q32 batch paths keep the exact quotient there,
+    // the q != 32 loop wraps exactly like to_us.
+    uint64_t expected_us(uint64_t c, const UsConverter &cvt)
+    {
+        const bool fits = cvt.k == 0 || c <= UINT64_MAX / cvt.k;
+        return cvt.shift != 32 || fits ? cvt.to_us(c) : exact_us(c, cvt);
+    }
+
+    template <typename T>
+    void fill(T *in, size_t n, const T *edges, size_t edge_count, size_t rotate)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            in[i] = edges[(i + rotate) % edge_count];
+        }
+    }
+
+    void check_us32(const UsConverter &cvt)
+    {
+        const size_t edge_count = sizeof(kEdges32) / sizeof(kEdges32[0]);
+        uint32_t buf[kMaxLen + 1];
+        uint64_t out[kMaxLen + 2];
+        for (size_t skew = 0; skew < 2; ++skew)
+        {
+            for (size_t n = 0; n <= kMaxLen; ++n)
+            {
+                uint32_t *in = buf + skew;
+                fill(in, n, kEdges32, edge_count, n);
+                out[n + skew] = 0xA5A5A5A5A5A5A5A5ull;
+                cycles_to_us(in, out + skew, n, cvt);
+                for (size_t i = 0; i < n; ++i)
+                {
+                    const uint64_t want = expected_us(in[i], cvt);
+                    if (out[i + skew] != want)
+                    {
+                        fprintf(stderr, "us32 k=%llu shift=%u n=%zu c=%u: %llu != %llu\n",
+                                (unsigned long long)cvt.k, cvt.shift, n, in[i],
+                                (unsigned long long)out[i + skew], (unsigned long long)want);
+                        ++host_test_failures;
+                    }
+                }
+                CHECK_EQ(out[n + skew], 0xA5A5A5A5A5A5A5A5ull); // no store past the end
+            }
+        }
+    }
+
+    void check_us64(const UsConverter &cvt)
+    {
+        const size_t edge_count = sizeof(kEdges64) / sizeof(kEdges64[0]);
+        uint64_t in[kMaxLen];
+        uint64_t out[kMaxLen + 1];
+        for (size_t n = 0; n <= kMaxLen; ++n)
+        {
+            fill(in, n, kEdges64, edge_count, n);
+            out[n] = 0xA5A5A5A5A5A5A5A5ull;
+            cycles_to_us(in, out, n, cvt);
+            for (size_t i = 0; i < n; ++i)
+            {
+                CHECK_EQ(out[i], expected_us(in[i], cvt));
+            }
+            CHECK_EQ(out[n], 0xA5A5A5A5A5A5A5A5ull);
+        }
+    }
+
+    void check_ns(const NsConverter &cvt)
+    {
+        uint32_t buf[kMaxLen + 1];
+        uint64_t in64[kMaxLen];
+        uint64_t out[kMaxLen + 2];
+        for (size_t skew = 0; skew < 2; ++skew)
+        {
+            for (size_t n = 0; n <= kMaxLen; ++n)
+            {
+                uint32_t *in = buf + skew;
+                fill(in, n, kEdges32, sizeof(kEdges32) / sizeof(kEdges32[0]), n);
+                out[n + skew] = 0xA5A5A5A5A5A5A5A5ull;
+                cycles_to_ns(in, out + skew, n, cvt);
+                for (size_t i = 0; i < n; ++i)
+                {
+                    if (out[i + skew] != cvt.to_ns(in[i]))
+                    {
+                        fprintf(stderr, "ns32 k=%llu n=%zu c=%u: %llu != %llu\n",
+                                (unsigned long long)cvt.k, n, in[i],
+                                (unsigned long long)out[i + skew],
+                                (unsigned long long)cvt.to_ns(in[i]));
+                        ++host_test_failures;
+                    }
+                }
+                CHECK_EQ(out[n + skew], 0xA5A5A5A5A5A5A5A5ull);
+            }
+        }
+        for (size_t n = 0; n <= kMaxLen; ++n)
+        {
+            fill(in64, n, kEdges64, sizeof(kEdges64) / sizeof(kEdges64[0]), n);
+            cycles_to_ns(in64, out, n, cvt);
+            for (size_t i = 0; i < n; ++i)
+            {
+                CHECK_EQ(out[i], cvt.to_ns(in64[i]));
+            }
+        }
+    }
+
+    // Consecutive deltas around 2^32: the values cycles_between() yields across a counter wrap.
+    void wrap_deltas()
+    {
+        const UsConverter us = UsConverter::make();
+        const NsConverter ns = NsConverter::make();
+        uint32_t in[64];
+        uint64_t out_us[64], out_ns[64];
+        for (uint32_t i = 0; i < 64; ++i)
+        {
+            in[i] = (0xFFFFFFFFu - 31u) + i; // 2^32 - 32 ... 2^32 - 1, then 0 ... 31
+        }
+        cycles_to_us(in, out_us, 64, us);
+        cycles_to_ns(in, out_ns, 64, ns);
+        for (uint32_t i = 0; i < 64; ++i)
+        {
+            CHECK_EQ(out_us[i], us.to_us(in[i]));
+            CHECK_EQ(out_ns[i], ns.to_ns(in[i]));
+        }
+    }
+} // namespace
+
+int main()
+{
+#if defined(__AVX2__)
+    if (!__builtin_cpu_supports("avx2"))
+    {
+        printf("test_batch_convert: CPU without AVX2, skipped\n");
+        return 0;
+    }
+#endif
+    for (uint64_t f : kFreqs)
+    {
+        check_us32(UsConverter::make(f));
+        check_us32(UsConverter::make(f, 20));
+        check_us64(UsConverter::make(f));
+        check_us64(UsConverter::make(f, 20));
+        check_ns(NsConverter::make(f));
+    }
+    wrap_deltas();
+    return host_test_result("test_batch_convert");
+}
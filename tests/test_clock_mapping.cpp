@@ -0,0 +1,118 @@
+// ClockMapping against a mock counter running off nominal: no update is mistaken for a wall
+// clock step (even at 2000 ppm, where the nominal slope alone misses by 2 ms per second), the
+// fit recovers the drift and a small error bound, conversions between updates track the wall
+// clock, and a real step is reported once and the fit recovers from it.
+//
+// host-test-variant: -DFASTTIME_MOCK_COUNTER
+// host-test-variant: -DFASTTIME_MOCK_COUNTER -DFASTTIME_MOCK_COUNTER_BITS=32
+
+#include <stdint.h>
+
+#include <fast_clock_mapping.h>
+
+#include "host_test.h"
+
+using namespace fasttime;
+
+namespace
+{
+    __extension__ typedef unsigned __int128 u128;
+
+    // Wall clock of the simulated system: the counter runs at freq_hz, epoch starts at base.
+    struct Wall
+    {
+        uint64_t freq_hz;
+        uint64_t base_ns;
+        int64_t step_ns;
+    };
+    Wall wall;
+
+    uint64_t true_epoch_ns(uint64_t cycles)
+    {
+        return wall.base_ns + uint64_t(int64_t((u128)cycles * 1000000000u / wall.freq_hz) + wall.step_ns);
+    }
+
+    uint64_t mock_epoch_ns() { return true_epoch_ns(fasttime_mock_cycles); }
+
+    void start(int32_t ppm)
+    {
+        wall.freq_hz = uint64_t(int64_t(FASTTIME_FREQ_HZ) + int64_t(FASTTIME_FREQ_HZ) / 1000000 * ppm);
+        wall.base_ns = 1700000000ull * 1000000000ull;
+        wall.step_ns = 0;
+        fasttime_mock_cycles = 12345;
+    }
+
+    // Advance the simulated time by ms milliseconds of wall clock.
+    void advance_ms(uint64_t ms) { fasttime_mock_cycles += wall.freq_hz / 1000 * ms; }
+
+    void drift(int32_t ppm)
+    {
+        start(ppm);
+        ClockMapping<> m(mock_epoch_ns);
+        CHECK_EQ(m.error_bound_ns(), UINT32_MAX);
+
+        bool all_continuous = true;
+        for (int i = 0; i < 20; ++i)
+        {
+            all_continuous = m.update() && all_continuous;
+            advance_ms(1000);
+        }
+        CHECK(all_continuous);
+
+        // Positive drift_ppb: the counter runs slow, i.e. more ns per cycle than nominal.
+        const double expected_ppb = (double(FASTTIME_FREQ_HZ) / double(wall.freq_hz) - 1.0) * 1e9;
+        CHECK_NEAR(m.drift_ppb(), expected_ppb, 5);
+        CHECK(m.error_bound_ns() < 100);
+
+        // Conversions between updates, including ones before the last sample.
+        advance_ms(500);
+        CHECK_NEAR(double(m.now_epoch_ns()), double(mock_epoch_ns()), 20);
+        const Timestamp earlier{(fast_counter_t)(fasttime_mock_cycles - wall.freq_hz * 3)};
+        CHECK_NEAR(double(m.to_epoch_ns(earlier)), double(true_epoch_ns(fasttime_mock_cycles - wall.freq_hz * 3)),
+                   20);
+    }
+
+    void wall_step(int32_t ppm)
+    {
+        start(ppm);
+        ClockMapping<> m(mock_epoch_ns);
+        for (int i = 0; i < 10; ++i)
+        {
+            CHECK(m.update());
+            advance_ms(1000);
+        }
+
+        // SNTP steps the wall clock by 50 ms: reported once, then the fit starts over.
+        wall.step_ns = 50000000;
+        CHECK(!m.update());
+        CHECK_NEAR(double(m.now_epoch_ns()), double(mock_epoch_ns()), 20);
+        for (int i = 0; i < 10; ++i)
+        {
+            advance_ms(1000);
+            CHECK(m.update());
+        }
+        const double expected_ppb = (double(FASTTIME_FREQ_HZ) / double(wall.freq_hz) - 1.0) * 1e9;
+        CHECK_NEAR(m.drift_ppb(), expected_ppb, 5);
+        CHECK(m.error_bound_ns() < 100);
+        advance_ms(250);
+        CHECK_NEAR(double(m.now_epoch_ns()), double(mock_epoch_ns()), 20);
+
+        // A step backwards as well.
+        wall.step_ns = -20000000;
+        advance_ms(1000);
+        CHECK(!m.update());
+        advance_ms(1000);
+        CHECK(m.update());
+    }
+} // namespace
+
+int main()
+{
+    const int32_t ppms[] = {0, 50, -50, 500, -500, 2000, -2000, 10000};
+    for (int32_t ppm : ppms)
+    {
+        drift(ppm);
+        wall_step(ppm);
+    }
+    return host_test_result("test_clock_mapping");
+}
@@ -0,0 +1,97 @@
+// PiServo / KalmanServo against a simulated reference: +40 ppm frequency error stepping to
+// +55 ppm halfway (a temperature change), ~1.2 µs (1 sigma) measurement noise, one sample per
+// simulated second. Checks the frequency estimate and the prediction error half a second after
+// each sample, once settled.
+
+#include <esp23_fast_timestamp.h>
+#include <fast_clock_servo.h>
+
+#include "host_test.h"
+
+using namespace fasttime;
+
+namespace
+{
+    constexpr uint32_t kSamples = 3600;
+    constexpr uint32_t kSettle = 120; // samples ignored after start and after the step
+
+    uint32_t rng = 12345;
+
+    int32_t noise_ns()
+    {
+        // Sum of four uniforms in [-1024, 1024): roughly normal, sigma ~1.2 µs.
+        int32_t sum = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            rng = rng * 1664525u + 1013904223u;
+            sum += int32_t(rng >> 21) - 1024;
+        }
+        return sum;
+    }
+
+    struct Result
+    {
+        int64_t min_err;
+        int64_t max_err;
+        double rms_err;
+        int32_t freq_ppb; ///< Final estimate.
+    };
+
+    template <typename Servo>
+    Result simulate(Servo &servo)
+    {
+        rng = 12345;
+        uint64_t local = 1000000000ULL;
+        uint64_t ref = 5000000000ULL;
+        int64_t ppb = 40000;
+        Result r{INT64_MAX, INT64_MIN, 0, 0};
+        double sum_sq = 0;
+        uint32_t n = 0;
+        for (uint32_t i = 0; i < kSamples; ++i)
+        {
+            if (i == kSamples / 2)
+            {
+                ppb = 55000;
+            }
+            local += 1000000000ULL;
+            ref += 1000000000ULL + ppb;
+            servo.sample(local, ref + noise_ns());
+
+            const bool settled = (i >= kSettle && i < kSamples / 2) || i >= kSamples / 2 + kSettle;
+            if (settled)
+            {
+                const int64_t err = int64_t(servo.to_reference_ns(local + 500000000ULL) -
+                                            (ref + 500000000ULL + ppb / 2));
+                r.min_err = err < r.min_err ? err : r.min_err;
+                r.max_err = err > r.max_err ? err : r.max_err;
+                sum_sq += double(err) * double(err);
+                ++n;
+            }
+        }
+        r.rms_err = sqrt(sum_sq / n);
+        r.freq_ppb = servo.freq_ppb();
+        return r;
+    }
+} // namespace
+
+int main()
+{
+    PiServo pi;
+    KalmanServo kalman;
+    const Result p = simulate(pi);
+    const Result k = simulate(kalman);
+    printf("PI:     error %lld..%lld ns, rms %.0f ns, freq %d ppb\n", (long long)p.min_err,
+           (long long)p.max_err, p.rms_err, int(p.freq_ppb));
+    printf("Kalman: error %lld..%lld ns, rms %.0f ns, freq %d ppb\n", (long long)k.min_err,
+           (long long)k.max_err, k.rms_err, int(k.freq_ppb));
+
+    // PI feeds each sample's noise straight into the frequency: errors of a few noise sigmas.
+    CHECK(p.min_err > -4000 && p.max_err < 4000);
+    CHECK(p.rms_err < 1500);
+    CHECK_NEAR(p.freq_ppb, 55000, 5000);
+    // The Kalman filter averages the noise down to a fraction of one sigma.
+    CHECK(k.min_err > -2000 && k.max_err < 2000);
+    CHECK(k.rms_err < 600);
+    CHECK_NEAR(k.freq_ppb, 55000, 500);
+    return host_test_result("test_clock_servo");
+}
@@ -0,0 +1,153 @@
+// Cross-core offsets: cycles_between(CoreTimestamp...) applies the per-core correction (also
+// across a 32-bit wrap), CoreTimestamp::now() reports the CPU it is pinned to, and ping-pong
+// calibration between pinned threads yields offsets within half the round trip (near 0 on a
+// host with a synchronized TSC) and a bounded round trip.
+//
+// host-test-variant: -O2
+// host-test-variant: -DFASTTIME_MOCK_COUNTER -DFASTTIME_MOCK_COUNTER_BITS=32
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+
+#include <thread>
+
+#include <fast_core_sync.h>
+
+#include "host_test.h"
+
+using namespace fasttime;
+
+namespace
+{
+    const fast_counter_t kMax = fast_counter_t(~fast_counter_t(0));
+
+    bool pin(uint32_t cpu)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+    }
+
+    uint32_t cpu_count()
+    {
+        const uint32_t cpus = std::thread::hardware_concurrency();
+        return cpus < FASTTIME_MAX_CORES ? cpus : FASTTIME_MAX_CORES;
+    }
+
+    // |offset| <= rtt / 2 whenever t1 <= t2 <= t3 on a common time base (+1 for the halving).
+    bool within_half_rtt(int64_t offset, uint32_t rtt)
+    {
+        const int64_t bound = int64_t(rtt / 2) + 1;
+        return offset <= bound && offset >= -bound;
+    }
+
+    void corrected_differences()
+    {
+        CoreClockOffsets o;
+        o.reset();
+        o.offset[1] = 1000;
+        o.offset[2] = -5000;
+
+        const CoreTimestamp a{Timestamp{5000}, 0};
+        CHECK_EQ(cycles_between(a, CoreTimestamp{Timestamp{7000}, 1}, o), 1000);
+        CHECK_EQ(cycles_between(a, CoreTimestamp{Timestamp{1000}, 2}, o), 1000);
+        CHECK_EQ(cycles_between(a, a, o), 0);
+
+        // Same core: the offsets cancel.
+        const CoreTimestamp b{Timestamp{1000}, 2};
+        CHECK_EQ(cycles_between(b, CoreTimestamp{Timestamp{1250}, 2}, o), 250);
+
+        // Reference stamp just before the wrap, the other core's stamp after it.
+        const CoreTimestamp late{Timestamp{kMax - 99}, 0};
+        CHECK_EQ(cycles_between(late, CoreTimestamp{Timestamp{fast_counter_t(100 + 1000)}, 1}, o), 200);
+        CHECK_EQ(cycles_between(late, CoreTimestamp{Timestamp{fast_counter_t(100 - 5000)}, 2}, o), 200);
+
+        // Core ids beyond FASTTIME_MAX_CORES wrap like current_core() does.
+        CHECK_EQ(o.to_reference(7000, FASTTIME_MAX_CORES + 1), 6000);
+    }
+
+    void pinned_core_ids()
+    {
+        const uint32_t n = cpu_count();
+        for (uint32_t cpu = 0; cpu < n; ++cpu)
+        {
+            uint32_t seen = UINT32_MAX;
+            std::thread t([&] {
+                if (pin(cpu))
+                {
+                    seen = CoreTimestamp::now().core;
+                }
+            });
+            t.join();
+            if (seen != UINT32_MAX)
+            {
+                CHECK_EQ(seen, cpu);
+            }
+        }
+    }
+
+    void ping_pong()
+    {
+        // Unpinned pair: on a single CPU every reply needs a context switch, hence the long
+        // timeout. Both sides read the same counter, so the offset is bounded by rtt / 2.
+        {
+            CoreSyncChannel ch;
+            std::thread responder([&] { core_sync_respond(ch, 16); });
+            const CoreSyncResult r = core_sync_initiate(ch, 16, FASTTIME_FREQ_HZ * 10);
+            ch.abort.store(true, std::memory_order_relaxed);
+            responder.join();
+            CHECK(r.valid);
+            CHECK(within_half_rtt(r.offset, r.rtt));
+        }
+
+        // No responder: the initiator gives up after the timeout instead of hanging.
+#if !defined(FASTTIME_MOCK_COUNTER)
+        {
+            CoreSyncChannel ch;
+            const CoreSyncResult r = core_sync_initiate(ch, 4, FASTTIME_FREQ_HZ / 1000);
+            CHECK(!r.valid);
+        }
+#endif
+    }
+
+    void calibration()
+    {
+        CoreClockOffsets o;
+        o.reset(3);
+        o.offset[0] = 42;
+        CHECK(calibrate_core_offsets(o, 64));
+        CHECK_EQ(o.reference, 0);
+        CHECK_EQ(o.offset[0], 0);
+        CHECK_EQ(o.rtt[0], 0);
+
+        const uint32_t n = cpu_count();
+        for (uint32_t core = 1; core < n; ++core)
+        {
+            CHECK(within_half_rtt(o.offset[core], o.rtt[core]));
+#if !defined(FASTTIME_MOCK_COUNTER)
+            // Best of 64 exchanges between two spinning cores: well under a millisecond.
+            CHECK(o.rtt[core] > 0);
+            CHECK(o.rtt[core] < FASTTIME_FREQ_HZ / 1000);
+#endif
+        }
+        for (uint32_t core = n; core < FASTTIME_MAX_CORES; ++core)
+        {
+            CHECK_EQ(o.offset[core], 0);
+        }
+        if (n < 2)
+        {
+            printf("test_core_sync: single CPU, cross-core calibration not exercised\n");
+        }
+    }
+} // namespace
+
+int main()
+{
+    corrected_differences();
+    pinned_core_ids();
+    ping_pong();
+    calibration();
+    return host_test_result("test_core_sync");
+}
@@ -0,0 +1,158 @@
+// Counter backend selection and wrap handling, without target hardware or QEMU.
+//
+// The selection table preprocesses esp23_fast_timestamp.h with each target's predefined macros
+// (so no target assembly is compiled) and checks the backend it picks. The runtime checks drive
+// the mock counter, once as a 64-bit counter and once as a 32-bit counter wrapping like CCOUNT.
+//
+// host-test-variant: -DFASTTIME_MOCK_COUNTER
+// host-test-variant: -DFASTTIME_MOCK_COUNTER -DFASTTIME_MOCK_COUNTER_BITS=32
+
+#include <esp23_fast_timestamp.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#include "host_test.h"
+
+using namespace fasttime;
+
+namespace
+{
+    // ------------------------------------------------------------------------------------------
+    // Selection table
+    // ------------------------------------------------------------------------------------------
+
+    struct Selection
+    {
+        bool ok;             ///< Preprocessing succeeded.
+        std::string backend; ///< FASTTIME_BACKEND with the string literals joined.
+        bool host;           ///< FASTTIME_HOST defined.
+    };
+
+    Selection select(const char *flags)
+    {
+        std::string src = __FILE__;
+        src = src.substr(0, src.find_last_of('/') + 1) + "../src";
+        const char *cxx = getenv("CXX") ? getenv("CXX") : "g++";
+        const std::string cmd = std::string("printf '#include <esp23_fast_timestamp.h>\\nbackend= FASTTIME_BACKEND "
+                                            "host= FASTTIME_HOST\\n' | ") +
+                                cxx + " -std=gnu++17 -x c++ -E -P -I" + src + " " + flags + " - 2>/dev/null";
+        FILE *p = popen(cmd.c_str(), "r");
+        Selection s{false, "", false};
+        if (!p)
+        {
+            return s;
+        }
+        char line[512];
+        while (fgets(line, sizeof(line), p))
+        {
+            if (strncmp(line, "backend=", 8) != 0)
+            {
+                continue;
+            }
+            const char *host = strstr(line, "host=");
+            for (const char *c = line + 8; c < host; ++c)
+            {
+                if (*c != '"' && *c != ' ')
+                {
+                    s.backend += *c;
+                }
+            }
+            s.host = strstr(host, "FASTTIME_HOST") == nullptr;
+        }
+        s.ok = pclose(p) == 0;
+        return s;
+    }
+
+    void expect(const char *flags, const char *backend, bool host)
+    {
+        const Selection s = select(flags);
+        if (!s.ok || s.backend != backend || s.host != host)
+        {
+            fprintf(stderr, "selection for '%s': got %s%s%s, want %s%s\n", flags,
+                    s.ok ? "" : "(error) ", s.backend.c_str(), s.host ? " host" : "", backend,
+                    host ? " host" : "");
+            ++host_test_failures;
+        }
+    }
+
+    void selection_table()
+    {
+        // ESP32 / S2 / S3
+        expect("-DARDUINO -D__XTENSA__", "xtensa-ccount", false);
+        // Firmware on RISC-V (C3, C6, P4, ...) reads the machine counter.
+        expect("-U__linux__ -DARDUINO -D__riscv -D__riscv_xlen=32", "riscv32-mcycle", false);
+        expect("-U__linux__ -D__riscv -D__riscv_xlen=64", "riscv64-mcycle", false);
+        expect("-U__linux__ -D__riscv -D__riscv_xlen=32 -DFASTTIME_RISCV_USER_COUNTER", "riscv32-cycle", false);
+        // Linux on RISC-V only has the user-level CSR.
+        expect("-D__riscv -D__riscv_xlen=64", "riscv64-cycle", true);
+        // The mock wins over any architecture.
+        expect("-D__riscv -D__riscv_xlen=32 -DFASTTIME_MOCK_COUNTER", "mock", true);
+        expect("-D__XTENSA__ -DFASTTIME_MOCK_COUNTER", "mock", true);
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)
+        expect("", "host-tsc", true);
+        // Arduino on an unknown core has no counter.
+        const Selection none = select("-DARDUINO");
+        CHECK(!none.ok);
+#endif
+    }
+
+    // ------------------------------------------------------------------------------------------
+    // Mock counter
+    // ------------------------------------------------------------------------------------------
+
+    constexpr bool kNarrow = FASTTIME_MOCK_COUNTER_BITS == 32;
+
+    void mock_counter()
+    {
+        CHECK(strcmp(FASTTIME_BACKEND, "mock") == 0);
+        CHECK_EQ(sizeof(fast_counter_t), kNarrow ? 4 : 8);
+
+        fasttime_mock_cycles = 0x123456789ull;
+        CHECK(Timestamp::now().ticks == fast_counter_t(0x123456789ull));
+        CHECK(Timestamp::now_begin().ticks == Timestamp::now_end().ticks);
+        CHECK_EQ(fast_rdcycle32(), 0x23456789u);
+    }
+
+    void wrap_handling()
+    {
+        // An interval straddling the 32-bit wrap.
+        fasttime_mock_cycles = 0xFFFFFF00u;
+        const Timestamp a = Timestamp::now();
+        fasttime_mock_cycles = 0x100000100ull;
+        const Timestamp b = Timestamp::now();
+        CHECK_EQ(cycles_between(a, b), 0x200);
+        CHECK(before(a, b));
+        CHECK(!before(b, a));
+        CHECK_EQ(ShortTimestamp::now().ticks - ShortTimestamp{0xFFFFFF00u}.ticks, 0x200);
+
+        // The extender counts every wrap as long as it sees one stamp per wrap.
+        fasttime_mock_cycles = 0xF0000000u;
+        CycleExtender ext = CycleExtender::make(Timestamp::now());
+        const uint64_t start = ext.ext;
+        uint64_t t = 0xF0000000u;
+        for (int i = 0; i < 12; ++i) // 3 s steps at 1 GHz-ish: several wraps
+        {
+            t += 3000000000ull;
+            fasttime_mock_cycles = t;
+            CHECK_EQ(ext.peek(Timestamp::now()) - start, t - 0xF0000000u);
+            CHECK_EQ(ext.extend(Timestamp::now()) - start, t - 0xF0000000u);
+        }
+        // One step longer than a wrap is the documented limit for 32-bit counters only.
+        t += 0x100000010ull;
+        fasttime_mock_cycles = t;
+        CHECK_EQ(ext.extend(Timestamp::now()) - start, kNarrow ? t - 0xF0000000u - 0x100000000ull : t - 0xF0000000u);
+    }
+} // namespace
+
+int main()
+{
+    if (!kNarrow)
+    {
+        selection_table();
+    }
+    mock_counter();
+    wrap_handling();
+    return host_test_result("test_counter_backend");
+}
@@ -0,0 +1,207 @@
+// CycleAccumulator / CycleStats: the Q16 Welford mean stays exact (mean and remainder match
+// the integer sum) over long runs, variance tracks a double-precision reference, Chan merges
+// agree with a single pass, and CycleStats snapshots taken during recording are never torn.
+
+#include <math.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <thread>
+
+#include <fast_cycle_stats.h>
+
+#include "host_test.h"
+
+using namespace fasttime;
+
+namespace
+{
+    __extension__ typedef unsigned __int128 u128;
+
+    struct Reference
+    {
+        uint64_t n = 0;
+        double mean = 0.0;
+        double m2 = 0.0;
+        u128 sum = 0;
+        uint32_t min = UINT32_MAX;
+        uint32_t max = 0;
+
+        void add(uint32_t x)
+        {
+            ++n;
+            sum += x;
+            const double d = double(x) - mean;
+            mean += d / double(n);
+            m2 += d * (double(x) - mean);
+            min = x < min ? x : min;
+            max = x > max ? x : max;
+        }
+
+        double variance() const { return n > 1 ? m2 / double(n - 1) : 0.0; }
+    };
+
+    uint32_t lcg(uint64_t &s)
+    {
+        s = s * 6364136223846793005ULL + 1442695040888963407ULL;
+        return uint32_t(s >> 32);
+    }
+
+    /// The recorded mean is floor(sum * 2^16 / n) with the exact remainder.
+    void check_exact(const CycleAccumulator &a, const Reference &r)
+    {
+        const u128 q = r.sum << 16;
+        CHECK_EQ(a.count, r.n);
+        CHECK(a.mean == int64_t(q / r.n));
+        CHECK_EQ(a.rem, uint32_t(q % r.n));
+        CHECK_EQ(a.min, r.min);
+        CHECK_EQ(a.max, r.max);
+    }
+
+    void check_close(const CycleAccumulator &a, const Reference &r)
+    {
+        CHECK_NEAR(double(a.mean_cycles()), r.mean, 1.0);
+        CHECK_NEAR(double(a.variance_cycles()), r.variance(), r.variance() * 1e-6 + 1.0);
+    }
+
+    void long_runs()
+    {
+        // Small deltas around a large mean: the case the remainder exists for.
+        {
+            CycleAccumulator a;
+            a.reset();
+            Reference r;
+            for (uint32_t i = 0; i < 10000000; ++i)
+            {
+                const uint32_t x = 1000 + (i % 3);
+                a.add(x);
+                r.add(x);
+            }
+            check_exact(a, r);
+            check_close(a, r);
+        }
+        // Spread over every m2 product range: deviations below 2^16, below 2^24 and beyond
+        // (few samples there, or m2 would pass 2^64).
+        const uint32_t spans[] = {100, 1u << 20, 1u << 30};
+        const uint32_t counts[] = {2000000, 2000000, 150};
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            CycleAccumulator a;
+            a.reset();
+            Reference r;
+            uint64_t seed = spans[k];
+            for (uint32_t i = 0; i < counts[k]; ++i)
+            {
+                const uint32_t x = 5000 + lcg(seed) % spans[k];
+                a.add(x);
+                r.add(x);
+            }
+            check_exact(a, r);
+            check_close(a, r);
+            printf("span %10u: mean %llu (ref %.1f), sd %llu (ref %.1f)\n", spans[k],
+                   (unsigned long long)a.mean_cycles(), r.mean, (unsigned long long)a.stddev_cycles(),
+                   sqrt(r.variance()));
+        }
+        // m2 beyond 2^64 saturates instead of wrapping; the mean stays exact.
+        {
+            CycleAccumulator a;
+            a.reset();
+            Reference r;
+            for (uint32_t i = 0; i < 100000; ++i)
+            {
+                const uint32_t x = i & 1 ? 3000000000u : 1000;
+                a.add(x);
+                r.add(x);
+            }
+            CHECK(a.m2 == UINT64_MAX);
+            check_exact(a, r);
+        }
+        // Samples beyond 32 bits clamp.
+        CycleAccumulator a;
+        a.reset();
+        a.add(uint64_t(1) << 40);
+        CHECK_EQ(a.max, UINT32_MAX);
+        CHECK_EQ(a.mean_cycles(), UINT32_MAX);
+    }
+
+    void merges()
+    {
+        // Four shards with different distributions and sizes, merged in two orders.
+        CycleAccumulator parts[4];
+        Reference all;
+        uint64_t seed = 42;
+        const uint32_t sizes[] = {1, 1000, 250000, 37};
+        const uint32_t bases[] = {100, 20000, 3000, 900000};
+        for (uint32_t p = 0; p < 4; ++p)
+        {
+            parts[p].reset();
+            for (uint32_t i = 0; i < sizes[p]; ++i)
+            {
+                const uint32_t x = bases[p] + lcg(seed) % (bases[p] / 2 + 1);
+                parts[p].add(x);
+                all.add(x);
+            }
+        }
+        CycleAccumulator fwd, rev, empty;
+        fwd.reset();
+        rev.reset();
+        empty.reset();
+        for (uint32_t p = 0; p < 4; ++p)
+        {
+            fwd.merge(parts[p]);
+            rev.merge(parts[3 - p]);
+            fwd.merge(empty);
+        }
+        const CycleAccumulator *merged[] = {&fwd, &rev};
+        for (const CycleAccumulator *m : merged)
+        {
+            CHECK_EQ(m->count, all.n);
+            CHECK_EQ(m->min, all.min);
+            CHECK_EQ(m->max, all.max);
+            check_close(*m, all);
+        }
+    }
+
+    void torn_snapshots()
+    {
+        // Alternating 100/300: any consistent state has mean == floor(sum * 2^16 / count).
+        static CycleStats stats;
+        std::atomic<bool> done{false};
+        std::thread writer([&] {
+            for (uint32_t i = 0; i < 2000000; ++i)
+            {
+                stats.record(i & 1 ? 300 : 100);
+            }
+            done.store(true);
+        });
+        uint32_t snapshots = 0, bad = 0;
+        while (!done.load())
+        {
+            const CycleAccumulator s = stats.snapshot();
+            ++snapshots;
+            if (!s.count)
+            {
+                continue;
+            }
+            const uint64_t sum = uint64_t(s.count / 2) * 400 + (s.count & 1) * 100;
+            const uint64_t q = sum << 16;
+            if (s.mean != int64_t(q / s.count) || s.rem != q % s.count || s.min != 100 ||
+                (s.count > 1 && s.max != 300))
+            {
+                ++bad;
+            }
+        }
+        writer.join();
+        printf("seqlock: %u snapshots during recording\n", snapshots);
+        CHECK_EQ(bad, 0);
+        CHECK_EQ(stats.snapshot().count, 2000000);
+    }
+} // namespace
+
+int main()
+{
+    long_runs();
+    merges();
+    torn_snapshots();
+    return host_test_result("test_cycle_stats");
+}
@@ -0,0 +1,115 @@
+// IRAM advisor: ranking order and bounds (including max == 0) and the report. The counting
+// variant replaces the cache invalidation to check that only measurements invalidate.
+//
+// host-test-variant: -O2
+// host-test-variant: -DTEST_COUNT_INVALIDATIONS
+
+#if defined(TEST_COUNT_INVALIDATIONS)
+inline unsigned test_invalidations = 0;
+#define FASTTIME_CACHE_INVALIDATE() (++test_invalidations)
+#endif
+
+#include <string.h>
+
+#include <fast_iram_advisor.h>
+
+#include "host_test.h"
+
+using namespace fasttime;
+
+namespace
+{
+#if defined(TEST_COUNT_INVALIDATIONS) || defined(__x86_64__) || defined(__aarch64__)
+    static_assert(iram_advisor_can_invalidate(), "override or host code-range flush");
+#endif
+
+    volatile uint32_t sink;
+
+    __attribute__((noinline)) void short_work(void *)
+    {
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            sink = sink * 31 + i;
+        }
+    }
+
+    __attribute__((noinline)) void long_work(void *)
+    {
+        for (uint32_t i = 0; i < 4096; ++i)
+        {
+            sink = sink * 31 + i;
+        }
+    }
+
+    ProfileZone short_zone("iram.short");
+    ProfileZone long_zone("iram.long");
+    IramCandidate short_probe(short_zone, &short_work);
+    IramCandidate long_probe(long_zone, &long_work);
+
+    constexpr uint32_t kRuns = 5;
+
+    void ranking()
+    {
+        // Field weight: the short function runs far more often.
+        for (uint32_t i = 0; i < 1000; ++i)
+        {
+            FASTTIME_ZONE(short_zone);
+            short_work(nullptr);
+        }
+
+        IramAdvice out[4];
+        memset(out, 0xff, sizeof(out));
+        CHECK_EQ(iram_rank(out, 0, kRuns), 0);
+        CHECK(out[0].candidate == reinterpret_cast<const IramCandidate *>(~uintptr_t(0)));
+
+        CHECK_EQ(iram_rank(out, 4, kRuns), 2);
+        CHECK(out[0].weight() >= out[1].weight());
+        CHECK(out[0].candidate != out[1].candidate);
+        for (uint32_t i = 0; i < 2; ++i)
+        {
+            CHECK_EQ(out[i].calls, out[i].candidate == &short_probe ? 1000 : 0);
+            CHECK(out[i].cold_cycles > 0 && out[i].warm_cycles > 0);
+            CHECK(!out[i].in_iram);
+        }
+        CHECK_EQ(iram_rank(out, 1, kRuns), 1);
+    }
+
+    struct Report
+    {
+        char header[192];
+        uint32_t lines;
+    };
+
+    void report()
+    {
+#if defined(TEST_COUNT_INVALIDATIONS)
+        test_invalidations = 0;
+#endif
+        Report r{};
+        iram_advise(
+            [](void *ctx, const char *line) {
+                Report &rep = *static_cast<Report *>(ctx);
+                if (rep.lines++ == 0)
+                {
+                    snprintf(rep.header, sizeof(rep.header), "%s", line);
+                }
+                printf("%s\n", line);
+            },
+            &r, kRuns, ~uint64_t(0));
+        // Header plus one line per candidate; none clears an unreachable threshold.
+        CHECK_EQ(r.lines, 3);
+        CHECK(strstr(r.header, iram_advisor_can_invalidate() ? "2 candidates, invalidation on"
+                                                             : "2 candidates, invalidation unavailable") != nullptr);
+#if defined(TEST_COUNT_INVALIDATIONS)
+        // One invalidation per cold run, none to print availability.
+        CHECK_EQ(test_invalidations, 2 * kRuns);
+#endif
+    }
+} // namespace
+
+int main()
+{
+    ranking();
+    report();
+    return host_test_result("test_iram_advisor");
+}
@@ -0,0 +1,82 @@
+// IrqLatencyProbe bookkeeping, then the full pipeline with HostIrqTimer: a POSIX timer whose
+// SIGRTMIN handler stands in for the ISR.
+
+#include <esp23_fast_timestamp.h>
+#include <fast_irq_latency.h>
+
+#include "host_test.h"
+
+using namespace fasttime;
+
+namespace
+{
+    constexpr uint32_t kSourceA = 0;
+    constexpr uint32_t kSourceTimer = 3;
+    constexpr uint32_t kFires = 500;
+
+    IrqLatencyProbe<4> probe;
+
+    void bookkeeping()
+    {
+        // ISR entry without a trigger.
+        probe.isr_enter(kSourceA);
+        CHECK_EQ(probe.spurious(kSourceA), 1);
+
+        // A trigger overwritten before its ISR ran.
+        probe.trigger(kSourceA);
+        probe.trigger(kSourceA);
+        probe.isr_enter(kSourceA);
+        CHECK_EQ(probe.lost(kSourceA), 1);
+        CHECK_EQ(probe.histogram(kSourceA).count(), 1);
+
+        // An alarm armed for a count in the future that fired "before" it.
+        CoreTimestamp ahead = CoreTimestamp::now();
+        ahead.ts.ticks += 1000000000;
+        probe.trigger_at(kSourceA, ahead);
+        probe.isr_enter(kSourceA);
+        CHECK_EQ(probe.early(kSourceA), 1);
+        CHECK_EQ(probe.histogram(kSourceA).count(), 2);
+
+        // A known trigger time: the latency is at least the gap we left.
+        const CoreTimestamp armed = CoreTimestamp::now();
+        while (cycles_between(armed.ts, Timestamp::now()) < 100000)
+        {
+        }
+        probe.trigger_at(kSourceA, armed);
+        probe.isr_enter(kSourceA);
+        CHECK(probe.histogram(kSourceA).percentile(100.0) >= 100000 - 100000 / 8);
+
+        probe.reset();
+        CHECK_EQ(probe.histogram(kSourceA).count(), 0);
+        CHECK_EQ(probe.spurious(kSourceA), 0);
+    }
+
+    void signal_pipeline()
+    {
+        HostIrqTimer<IrqLatencyProbe<4>> timer(probe, kSourceTimer);
+        CHECK(timer.start());
+        for (uint32_t i = 0; i < kFires; ++i)
+        {
+            CHECK(timer.fire_and_wait());
+        }
+        timer.stop();
+
+        const CycleHistogram<> &h = probe.histogram(kSourceTimer);
+        CHECK_EQ(timer.handled(), kFires);
+        CHECK_EQ(h.count(), kFires);
+        CHECK_EQ(probe.spurious(kSourceTimer), 0);
+        CHECK_EQ(probe.lost(kSourceTimer), 0);
+        CHECK(h.percentile(50.0) > 0);
+        CHECK(h.percentile(50.0) <= h.percentile(99.0));
+        printf("timer+signal latency: p50 %llu, p99 %llu, p100 %llu cycles\n",
+               (unsigned long long)h.percentile(50.0), (unsigned long long)h.percentile(99.0),
+               (unsigned long long)h.percentile(100.0));
+    }
+} // namespace
+
+int main()
+{
+    bookkeeping();
+    signal_pipeline();
+    return host_test_result("test_irq_latency");
+}
@@ -0,0 +1,220 @@
+// InstrumentedLock over the host adapters (StdMutex, PthreadSpinLock): uncontended and
+// contended acquisitions are told apart, wait and hold land in their histograms, holds are
+// attributed to the lock() call site, the space-saving table evicts the lightest site, and an
+// adapter without a real try_lock does not count every acquisition as contended.
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include <fast_lock_profile.h>
+
+#include "host_test.h"
+
+using namespace fasttime;
+
+namespace
+{
+    // Adapter whose try_lock always fails, like PortMuxLock without portTRY_ENTER_CRITICAL.
+    class NoTryMutex
+    {
+    public:
+        static constexpr bool kTryLock = false;
+
+        inline bool try_lock() { return false; }
+        inline void lock() { m_.lock(); }
+        inline void unlock() { m_.unlock(); }
+
+    private:
+        std::mutex m_;
+    };
+
+    static_assert(detail::lock_can_try<StdMutex>::value, "adapters default to a real try_lock");
+    static_assert(!detail::lock_can_try<NoTryMutex>::value, "kTryLock = false is honoured");
+
+    void spin_cycles(uint64_t cycles)
+    {
+        const Timestamp t0 = Timestamp::now();
+        while (cycles_between(t0, Timestamp::now()) < cycles)
+        {
+        }
+    }
+
+    // Two distinct call sites; the hold lengths differ, which also keeps them from being folded.
+    template <typename L>
+    __attribute__((noinline)) void hold_long(L &l)
+    {
+        l.lock();
+        spin_cycles(20000);
+        l.unlock();
+    }
+
+    template <typename L>
+    __attribute__((noinline)) void hold_short(L &l)
+    {
+        l.lock();
+        spin_cycles(100);
+        l.unlock();
+    }
+
+    template <typename Lock>
+    void uncontended()
+    {
+        InstrumentedLock<Lock> l;
+        for (int i = 0; i < 100; ++i)
+        {
+            l.lock();
+            l.unlock();
+        }
+        CHECK_EQ(l.profile().contended(), 0);
+        CHECK_EQ(l.profile().wait().count(), 100);
+        CHECK_EQ(l.profile().hold().count(), 100);
+        CHECK_EQ(l.profile().wait().percentile(100.0), 0); // fast path records zero wait
+
+        CHECK(l.try_lock());
+        l.unlock();
+        CHECK_EQ(l.profile().wait().count(), 101);
+        CHECK_EQ(l.profile().contended(), 0);
+    }
+
+    template <typename Lock>
+    void contended()
+    {
+        InstrumentedLock<Lock> l;
+        std::atomic<bool> held{false};
+        std::thread holder([&] {
+            l.lock();
+            held.store(true, std::memory_order_release);
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            l.unlock();
+        });
+        while (!held.load(std::memory_order_acquire))
+        {
+            std::this_thread::yield();
+        }
+
+        // A failed try_lock records nothing.
+        CHECK(!l.try_lock());
+        CHECK_EQ(l.profile().wait().count(), 1);
+
+        const Timestamp t0 = Timestamp::now();
+        l.lock();
+        const uint64_t waited = cycles_between(t0, Timestamp::now());
+        l.unlock();
+        holder.join();
+
+        CHECK_EQ(l.profile().contended(), 1);
+        CHECK_EQ(l.profile().wait().count(), 2);
+        CHECK_EQ(l.profile().hold().count(), 2);
+        // The contended wait is the upper percentile, within histogram bucket resolution.
+        const uint64_t p100 = l.profile().wait().percentile(100.0);
+        CHECK(p100 > 0);
+        CHECK(p100 <= waited + waited / 4);
+        CHECK(p100 >= waited / 2);
+        // The 20 ms hold dominates the hold histogram.
+        CHECK(l.profile().hold().percentile(100.0) >= l.profile().wait().percentile(100.0) / 2);
+    }
+
+    template <typename Lock>
+    void call_sites()
+    {
+        InstrumentedLock<Lock> l;
+        for (int i = 0; i < 10; ++i)
+        {
+            hold_long(l);
+        }
+        for (int i = 0; i < 50; ++i)
+        {
+            hold_short(l);
+        }
+
+        LockSite top[8];
+        CHECK_EQ(l.profile().top_holders(top, 8), 2);
+        CHECK(top[0].site != nullptr && top[1].site != nullptr && top[0].site != top[1].site);
+        CHECK_EQ(top[0].count, 10); // heaviest first: the long holder
+        CHECK_EQ(top[1].count, 50);
+        CHECK(top[0].hold_total >= 10 * 20000);
+        CHECK(top[0].hold_max >= 20000);
+        CHECK(top[1].hold_total >= 50 * 100);
+        CHECK(top[0].hold_total > top[1].hold_total);
+
+        // The same call site maps to the same entry.
+        hold_long(l);
+        LockSite again[8];
+        CHECK_EQ(l.profile().top_holders(again, 8), 2);
+        CHECK(again[0].site == top[0].site);
+        CHECK_EQ(again[0].count, 11);
+
+        CHECK_EQ(l.profile().top_holders(again, 1), 1);
+        l.profile().reset();
+        CHECK_EQ(l.profile().top_holders(again, 8), 0);
+        CHECK_EQ(l.profile().hold().count(), 0);
+        CHECK_EQ(l.profile().contended(), 0);
+    }
+
+    void eviction()
+    {
+        LockProfile<2> p;
+        const char sites[4] = {};
+        const void *a = &sites[0], *b = &sites[1], *c = &sites[2];
+
+        p.on_release(a, 100);
+        p.on_release(b, 50);
+        // Table full: c replaces the lightest (b) and inherits its total.
+        p.on_release(c, 10);
+
+        LockSite top[2];
+        CHECK_EQ(p.top_holders(top, 2), 2);
+        CHECK(top[0].site == a);
+        CHECK_EQ(top[0].hold_total, 100);
+        CHECK(top[1].site == c);
+        CHECK_EQ(top[1].count, 1);
+        CHECK_EQ(top[1].hold_total, 60);
+        CHECK_EQ(top[1].hold_max, 10);
+
+        // b comes back and evicts c (60 < 100); a heavy late site can climb past a.
+        p.on_release(b, 45);
+        CHECK_EQ(p.top_holders(top, 2), 2);
+        CHECK(top[0].site == b);
+        CHECK_EQ(top[0].hold_total, 105);
+        CHECK(top[1].site == a);
+
+        // Existing sites accumulate without eviction.
+        p.on_release(a, 30);
+        CHECK_EQ(p.top_holders(top, 2), 2);
+        CHECK(top[0].site == a);
+        CHECK_EQ(top[0].count, 2);
+        CHECK_EQ(top[0].hold_total, 130);
+        CHECK_EQ(top[0].hold_max, 100);
+        CHECK_EQ(p.hold().count(), 5);
+    }
+
+    void without_try_lock()
+    {
+        InstrumentedLock<NoTryMutex> l;
+        for (int i = 0; i < 10; ++i)
+        {
+            l.lock();
+            l.unlock();
+        }
+        CHECK_EQ(l.profile().contended(), 0);
+        CHECK_EQ(l.profile().wait().count(), 10);
+        CHECK_EQ(l.profile().hold().count(), 10);
+    }
+} // namespace
+
+int main()
+{
+    uncontended<StdMutex>();
+    uncontended<PthreadSpinLock>();
+    contended<StdMutex>();
+    contended<PthreadSpinLock>();
+    call_sites<StdMutex>();
+    call_sites<PthreadSpinLock>();
+    eviction();
+    without_try_lock();
+    return host_test_result("test_lock_profile");
+}
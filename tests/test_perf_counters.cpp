@@ -0,0 +1,135 @@
+// ProfilePerfZone: FASTTIME_ZONE records cycles and counter deltas, registry_dump prints IPC and
+// miss rates, registry_reset clears it. Ratios are checked on synthetic deltas; the hardware
+// path runs when perf_event_open is permitted and is reported as skipped otherwise.
+
+#include <string.h>
+
+#include <fast_registry.h>
+
+#include "host_test.h"
+
+using namespace fasttime;
+
+namespace
+{
+    const PerfEvent kEvents[] = {PerfEvent::kInstructions, PerfEvent::kDCacheStalls,
+                                 PerfEvent::kBranchMisses, PerfEvent::kStallCycles};
+
+    PerfCounterSet pmu;
+    // Constructed before pmu is opened, as a namespace-scope zone on target would be.
+    ProfilePerfZone zone("perf.zone", pmu);
+
+    volatile uint32_t sink;
+
+    __attribute__((noinline)) void work()
+    {
+        for (uint32_t i = 0; i < 100000; ++i)
+        {
+            sink = sink * 31 + i;
+        }
+    }
+
+    bool format_entry(const char *name, char *out, size_t len)
+    {
+        bool found = false;
+        registry_for_each([&](const RegistryEntry &e) {
+            if (!found && strcmp(e.name, name) == 0)
+            {
+                registry_format(e, out, len);
+                found = true;
+            }
+        });
+        return found;
+    }
+
+    void ratios()
+    {
+        PerfDelta d{};
+        d.cycles = 1000;
+        d.counts[0] = 2000;
+        d.counts[1] = 10;
+        d.counts[3] = 250;
+
+        // Unbound: no slot is taken for instructions, so no IPC rather than a wrong one.
+        PerfStats s;
+        s.record(d);
+        s.record(d);
+        CHECK_EQ(s.count(), 2);
+        CHECK_EQ(s.ipc(), 0.0);
+        CHECK_EQ(s.per_kilo_insn(1), 0.0);
+        CHECK_NEAR(s.per_cycle(3), 0.25, 1e-9);
+
+        // Slot 0 counts instructions once bound to a set that has them there.
+        PerfCounterSet set;
+        set.open(kEvents, 4);
+        s.bind(set);
+        if (set.index_of(PerfEvent::kInstructions) == 0)
+        {
+            CHECK_NEAR(s.ipc(), 2.0, 1e-9);
+            CHECK_NEAR(s.per_kilo_insn(1), 5.0, 1e-9);
+        }
+        else
+        {
+            CHECK_EQ(s.ipc(), 0.0);
+        }
+
+        // A set without an instruction counter: no IPC either.
+        PerfCounterSet none;
+        s.bind(none);
+        CHECK_EQ(s.ipc(), 0.0);
+
+        CHECK(strcmp(perf_event_name(PerfEvent::kDCacheStalls), "dcache") == 0);
+        CHECK(strcmp(perf_event_name(PerfEvent::kStallCycles), "stall") == 0);
+    }
+
+    void zone_scope()
+    {
+        const uint32_t before = registry_size();
+        ProfilePerfZone unlinked("perf.unlinked", pmu, Registration::kUnlinked);
+        CHECK_EQ(registry_size(), before);
+
+        const uint32_t counted = pmu.open(kEvents, 4);
+        for (int i = 0; i < 10; ++i)
+        {
+            FASTTIME_ZONE(zone);
+            work();
+        }
+        const PerfStats s = zone.snapshot();
+        CHECK_EQ(s.count(), 10);
+        CHECK(s.cycles() > 0);
+
+        char line[192];
+        CHECK(format_entry("perf.zone", line, sizeof(line)));
+        printf("%s\n", line);
+        CHECK(strncmp(line, "perfzone  perf.zone ", 20) == 0);
+        CHECK(strstr(line, " ipc=") != nullptr);
+
+        if (pmu.index_of(PerfEvent::kInstructions) >= 0)
+        {
+            printf("perf_event_open: %u of 4 events\n", counted);
+            CHECK(s.ipc() > 0.0);
+            CHECK(s.total(0) >= 10 * 100000);
+            if (pmu.available(1))
+            {
+                CHECK(strstr(line, " dcache=") != nullptr);
+            }
+        }
+        else
+        {
+            printf("perf_event_open unavailable: hardware checks skipped\n");
+            CHECK_EQ(s.ipc(), 0.0);
+            CHECK(strstr(line, " dcache=") == nullptr);
+        }
+
+        registry_reset();
+        CHECK_EQ(zone.snapshot().count(), 0);
+        pmu.close();
+    }
+} // namespace
+
+int main()
+{
+    ratios();
+    zone_scope();
+    return host_test_result("test_perf_counters");
+}
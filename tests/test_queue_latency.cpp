@@ -0,0 +1,73 @@
+// ProfiledSpscQueue registration: a static queue shows up in the registry, queues built with
+// Registration::kUnlinked come and go without leaving entries behind.
+
+#include <string.h>
+
+#include <fast_queue_latency.h>
+
+#include "host_test.h"
+
+using namespace fasttime;
+
+namespace
+{
+    ProfiledSpscQueue<uint32_t, 8> static_q("q.static");
+
+    uint32_t entries_named(const char *name)
+    {
+        uint32_t n = 0;
+        registry_for_each([&](const RegistryEntry &e) { n += strcmp(e.name, name) == 0; });
+        return n;
+    }
+
+    void registered_queue()
+    {
+        // Dwell histogram and item counter.
+        CHECK_EQ(entries_named("q.static"), 2);
+
+        for (uint32_t i = 0; i < 8; ++i)
+        {
+            CHECK(static_q.push(i));
+        }
+        CHECK(!static_q.push(8));
+        uint32_t v = 0;
+        for (uint32_t i = 0; i < 8; ++i)
+        {
+            CHECK(static_q.pop(v));
+            CHECK_EQ(v, i);
+        }
+        CHECK(!static_q.pop(v));
+        CHECK_EQ(static_q.profile().dequeued(), 8);
+        CHECK_EQ(static_q.profile().rejected(), 1);
+        CHECK_EQ(static_q.profile().dwell().count(), 8);
+    }
+
+    void unlinked_queues()
+    {
+        const uint32_t before = registry_size();
+        for (uint32_t round = 0; round < 4; ++round)
+        {
+            ProfiledSpscQueue<uint32_t, 4> q("q.scoped", Registration::kUnlinked);
+            CHECK(q.push(round));
+            uint32_t v = 0;
+            CHECK(q.pop(v));
+            CHECK_EQ(v, round);
+            CHECK_EQ(q.profile().dequeued(), 1);
+            CHECK_EQ(q.profile().dwell().count(), 1);
+        }
+        CHECK_EQ(registry_size(), before);
+        CHECK_EQ(entries_named("q.scoped"), 0);
+
+        // The registry is still walkable after the scoped queues are gone.
+        uint32_t lines = 0;
+        registry_dump([](void *ctx, const char *) { ++*static_cast<uint32_t *>(ctx); }, &lines);
+        CHECK_EQ(lines, before);
+    }
+} // namespace
+
+int main()
+{
+    registered_queue();
+    unlinked_queues();
+    return host_test_result("test_queue_latency");
+}
@@ -0,0 +1,118 @@
+// TokenBucket / LeakyBucket / AtomicTokenBucket: rates, bursts and idle periods longer than a
+// 32-bit counter wrap (with the coarse clock, or with a refill heartbeat without it).
+//
+// host-test-variant: -DFASTTIME_MOCK_COUNTER
+// host-test-variant: -DFASTTIME_MOCK_COUNTER -DFASTTIME_MOCK_COUNTER_BITS=32 -DTEST_COARSE_CLOCK
+// host-test-variant: -DFASTTIME_MOCK_COUNTER -DFASTTIME_MOCK_COUNTER_BITS=32
+
+#include <stdint.h>
+
+#if defined(TEST_COARSE_CLOCK)
+inline uint64_t test_now_cycles = 0;
+#define FASTTIME_COARSE_MS() uint32_t(test_now_cycles / (FASTTIME_FREQ_HZ / 1000))
+#endif
+
+#include <esp23_fast_timestamp.h>
+#include <fast_rate_limiter.h>
+
+#include "host_test.h"
+
+using namespace fasttime;
+
+namespace
+{
+    uint64_t now_cycles = 0;
+
+    void set_time(uint64_t cycles)
+    {
+        now_cycles = cycles;
+        fasttime_mock_cycles = cycles;
+#if defined(TEST_COARSE_CLOCK)
+        test_now_cycles = cycles;
+#endif
+    }
+
+    void advance_ms(uint64_t ms) { set_time(now_cycles + ms * (FASTTIME_FREQ_HZ / 1000)); }
+
+    // Idle for @p ms; without a coarse clock on a 32-bit counter, tick the bucket every 5 s.
+    template <typename Tick>
+    void idle_ms(uint64_t ms, Tick &&tick)
+    {
+        const bool heartbeat = sizeof(fast_counter_t) == 4 &&
+#if defined(FASTTIME_COARSE_MS)
+                               false;
+#else
+                               true;
+#endif
+        while (ms)
+        {
+            const uint64_t step = heartbeat && ms > 5000 ? 5000 : ms;
+            advance_ms(step);
+            ms -= step;
+            if (heartbeat)
+            {
+                tick(Timestamp::now());
+            }
+        }
+    }
+
+    void token_bucket()
+    {
+        set_time(0xFFF00000u);
+        TokenBucket b = TokenBucket::make(1, 30); // 1 token/s, bursts of 30
+        int granted = 0;
+        while (b.try_acquire())
+        {
+            ++granted;
+        }
+        CHECK_EQ(granted, 30);
+        advance_ms(2500);
+        CHECK_EQ(b.available(), 2);
+        CHECK(b.try_acquire(2));
+        CHECK(!b.try_acquire());
+
+        // 40 s idle: more than two 32-bit wraps at 240 MHz; the bucket must be full again.
+        idle_ms(40000, [&](const Timestamp t) { b.refill(t); });
+        CHECK_EQ(b.available(), 30);
+    }
+
+    void leaky_bucket()
+    {
+        set_time(0xFFF00000u);
+        LeakyBucket b = LeakyBucket::make(2, 40); // drains 2 units/s, holds 40
+        CHECK(b.try_add(40));
+        CHECK(!b.try_add());
+        CHECK_NEAR(double(b.wait_cycles()), double(FASTTIME_FREQ_HZ) / 2, FASTTIME_FREQ_HZ / 1000);
+        advance_ms(1000);
+        CHECK(b.try_add(2));
+        CHECK(!b.try_add());
+
+        // Draining 40 units takes 20 s; after 30 s idle the bucket must be empty.
+        idle_ms(30000, [&](const Timestamp t) { b.drain(t); });
+        CHECK(b.try_add(40));
+    }
+
+    void atomic_bucket()
+    {
+        set_time(1000);
+        AtomicTokenBucket b;
+        b.init(100, 5); // 100/s, bursts of 5
+        int granted = 0;
+        for (int i = 0; i < 20; ++i)
+        {
+            granted += b.try_acquire();
+        }
+        CHECK_EQ(granted, 5);
+        advance_ms(10);
+        CHECK(b.try_acquire());
+        CHECK(!b.try_acquire());
+    }
+} // namespace
+
+int main()
+{
+    token_bucket();
+    leaky_bucket();
+    atomic_bucket();
+    return host_test_result("test_rate_limiter");
+}
@@ -0,0 +1,134 @@
+// SamplingProfiler: histogram bookkeeping with synthetic PCs (including top()/dump() with no
+// room for entries), then real SIGPROF sampling of a CPU-bound loop via setitimer.
+
+#include <string.h>
+#include <time.h>
+
+#include <fast_sampling_profiler.h>
+
+#include "host_test.h"
+
+using namespace fasttime;
+
+namespace
+{
+    SamplingProfiler<8, 16> small;
+    SamplingProfiler<> prof;
+
+    void count_line(void *ctx, const char *) { ++*static_cast<uint32_t *>(ctx); }
+
+    void bookkeeping()
+    {
+        // Ring overflow: 8 slots per core, 10 records before the first drain.
+        for (uintptr_t i = 0; i < 10; ++i)
+        {
+            small.record(0x1000);
+        }
+        CHECK_EQ(small.drain() + small.dropped(), 10);
+        CHECK(small.dropped() > 0);
+        small.reset();
+
+        // 0x2000 x3, 0x3000 x2, 0x4000 x1.
+        const uintptr_t pcs[] = {0x3000, 0x2000, 0x4000, 0x2000, 0x3000, 0x2000};
+        for (uintptr_t pc : pcs)
+        {
+            small.record(pc);
+        }
+        CHECK_EQ(small.drain(), 6);
+        CHECK_EQ(small.samples(), 6);
+
+        PcCount out[4];
+        memset(out, 0xff, sizeof(out));
+        CHECK_EQ(small.top(out, 0), 0);
+        CHECK_EQ(out[0].count, 0xffffffffu);
+        CHECK_EQ(small.top(out, 2), 2);
+        CHECK_EQ(out[0].pc, 0x2000);
+        CHECK_EQ(out[0].count, 3);
+        CHECK_EQ(out[1].pc, 0x3000);
+        CHECK_EQ(out[1].count, 2);
+        CHECK_EQ(small.top(out, 4), 3);
+        CHECK_EQ(out[2].pc, 0x4000);
+
+        // Header only, then header plus one line per distinct PC.
+        uint32_t lines = 0;
+        small.dump(count_line, &lines, 0);
+        CHECK_EQ(lines, 1);
+        lines = 0;
+        small.dump(count_line, &lines);
+        CHECK_EQ(lines, 4);
+
+        // More distinct PCs than buckets.
+        small.reset();
+        for (uintptr_t i = 1; i <= 20; ++i)
+        {
+            small.record(i * 0x10);
+            small.drain();
+        }
+        CHECK_EQ(small.samples(), 20);
+        CHECK_EQ(small.top(out, 4), 4);
+    }
+
+    __attribute__((noinline)) uint64_t burn(uint64_t n)
+    {
+        volatile uint64_t acc = 1;
+        for (uint64_t i = 0; i < n; ++i)
+        {
+            acc = acc * 6364136223846793005ULL + i;
+        }
+        return acc;
+    }
+
+    double cpu_seconds()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+        return double(ts.tv_sec) + double(ts.tv_nsec) * 1e-9;
+    }
+
+    void sigprof()
+    {
+        CHECK(prof.start(1000));
+        const double t0 = cpu_seconds();
+        uint64_t sink = 0;
+        while (cpu_seconds() - t0 < 0.5)
+        {
+            sink += burn(1000000);
+            prof.drain();
+        }
+        prof.stop();
+        prof.drain();
+        CHECK(sink != 0);
+
+        // ITIMER_PROF fires at most once per kernel tick: 50 samples at HZ=100, 500 at HZ=1000.
+        CHECK(prof.samples() >= 25);
+        CHECK_EQ(prof.dropped(), 0);
+
+        PcCount hot[1];
+        CHECK_EQ(prof.top(hot, 1), 1);
+        const uintptr_t begin = reinterpret_cast<uintptr_t>(&burn);
+        CHECK(hot[0].pc >= begin && hot[0].pc < begin + 256);
+
+        uint32_t in_burn = 0;
+        PcCount all[64];
+        const uint32_t n = prof.top(all, 64);
+        for (uint32_t i = 0; i < n; ++i)
+        {
+            if (all[i].pc >= begin && all[i].pc < begin + 256)
+            {
+                in_burn += all[i].count;
+            }
+        }
+        printf("sigprof: %llu samples, %u distinct PCs, %.1f%% in burn()\n",
+               (unsigned long long)prof.samples(), n, 100.0 * in_burn / double(prof.samples()));
+        CHECK(in_burn * 2 > prof.samples());
+
+        prof.dump([](void *, const char *line) { printf("  %s\n", line); }, nullptr, 3);
+    }
+} // namespace
+
+int main()
+{
+    bookkeeping();
+    sigprof();
+    return host_test_result("test_sampling_profiler");
+}
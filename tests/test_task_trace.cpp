@@ -0,0 +1,152 @@
+// TaskTraceAnalyzer on a scripted switch sequence, on real threads through InstrumentedThread,
+// and the FreeRTOS hook functions (compiled for the host) feeding task_tracer.
+
+#define FASTTIME_TASK_TRACE_IMPLEMENTATION
+#include <esp23_fast_timestamp.h>
+#include <fast_task_trace.h>
+#include <fast_task_trace_hooks.h>
+
+#include "host_test.h"
+
+using namespace fasttime;
+
+namespace
+{
+    TraceEvent ev(uint64_t ticks, TraceType type, uint32_t task)
+    {
+        return TraceEvent{ticks, task, type, 0, 0};
+    }
+
+    template <size_t N>
+    TaskTraceStats stats_of(const TaskTraceAnalyzer<N> &a, uint32_t id)
+    {
+        TaskTraceStats out{};
+        a.for_each([&](const TaskTraceStats &s) {
+            if (s.id == id)
+            {
+                out = s;
+            }
+        });
+        return out;
+    }
+
+    // Task 1 runs, is preempted by task 2, runs again and blocks; task 2 runs until the end.
+    void scripted()
+    {
+        TaskTraceAnalyzer<4> a;
+        a.feed(ev(0, TraceType::kTaskReady, 1));
+        a.feed(ev(10, TraceType::kTaskSwitchIn, 1));   // waited 10
+        a.feed(ev(100, TraceType::kTaskSwitchOut, 1)); // ran 90, still ready: preempted
+        a.feed(ev(100, TraceType::kTaskReady, 2));
+        a.feed(ev(105, TraceType::kTaskSwitchIn, 2));  // waited 5
+        a.feed(ev(150, TraceType::kTaskSwitchOut, 2)); // ran 45, then blocks
+        a.feed(ev(160, TraceType::kTaskReady, 2));
+        a.feed(ev(150, TraceType::kMarker, 7));        // other types are ignored
+        a.feed(ev(170, TraceType::kTaskSwitchIn, 1));  // waited 70 after the preemption
+        a.feed(ev(200, TraceType::kTaskSwitchOut, 1)); // ran 30
+        a.feed(ev(210, TraceType::kTaskReady, 1));     // ... it had blocked
+        a.feed(ev(230, TraceType::kTaskSwitchIn, 2));  // waited 70 since ready at 160
+        a.feed(ev(300, TraceType::kTaskReady, 3));
+
+        CHECK_EQ(a.tasks(), 3);
+        CHECK_EQ(a.span_cycles(), 300);
+        const TaskTraceStats t1 = stats_of(a, 1);
+        CHECK_EQ(t1.cpu_cycles, 120);
+        CHECK_EQ(t1.wait_cycles, 80);
+        CHECK_EQ(t1.max_wait, 70);
+        CHECK_EQ(t1.switches_in, 2);
+        CHECK_EQ(t1.preemptions, 1);
+        const TaskTraceStats t2 = stats_of(a, 2);
+        CHECK_EQ(t2.cpu_cycles, 45 + 70); // still running: credited up to the last event
+        CHECK_EQ(t2.wait_cycles, 75);
+        CHECK_EQ(t2.switches_in, 2);
+        CHECK_EQ(t2.preemptions, 0);
+
+        TaskTraceAnalyzer<2> small;
+        small.feed(ev(0, TraceType::kTaskReady, 1));
+        small.feed(ev(1, TraceType::kTaskReady, 2));
+        small.feed(ev(2, TraceType::kTaskReady, 3));
+        CHECK_EQ(small.untracked(), 1);
+    }
+
+    void spin_cycles(uint64_t cycles)
+    {
+        const Timestamp t0 = Timestamp::now();
+        while (cycles_between(t0, Timestamp::now()) < cycles)
+        {
+        }
+    }
+
+    // Real threads: one sleeps (blocks), one yields (preemptions).
+    void threads()
+    {
+        {
+            InstrumentedThread sleeper(10, [](InstrumentedThread &self) {
+                for (int i = 0; i < 3; ++i)
+                {
+                    spin_cycles(200000);
+                    self.sleep_for_ns(2000000);
+                }
+            });
+            InstrumentedThread yielder(20, [](InstrumentedThread &self) {
+                for (int i = 0; i < 5; ++i)
+                {
+                    spin_cycles(100000);
+                    self.yield();
+                }
+            });
+        }
+
+        TaskTraceAnalyzer<> a;
+        task_tracer.drain_ordered([&](const TraceEvent &e) { a.feed(e); });
+        CHECK_EQ(a.tasks(), 2);
+        const TaskTraceStats s = stats_of(a, 10);
+        CHECK_EQ(s.switches_in, 4);
+        CHECK_EQ(s.preemptions, 0);
+        CHECK(s.cpu_cycles >= 3 * 200000);
+        CHECK(s.cpu_cycles < a.span_cycles());
+        const TaskTraceStats y = stats_of(a, 20);
+        CHECK_EQ(y.switches_in, 6);
+        CHECK_EQ(y.preemptions, 5);
+        CHECK(y.cpu_cycles >= 5 * 100000);
+    }
+
+    // The scheduler hooks record the running task (a per-thread id on host).
+    void hooks()
+    {
+        int tcb = 0;
+        fasttime_trace_task_ready(&tcb);
+        fasttime_trace_task_switched_in();
+        fasttime_trace_task_switched_out();
+
+        uint32_t n = 0;
+        uint32_t self_id = 0;
+        task_tracer.drain_ordered([&](const TraceEvent &e) {
+            switch (n++)
+            {
+            case 0:
+                CHECK(e.type == TraceType::kTaskReady);
+                CHECK_EQ(e.arg, (uint32_t)(uintptr_t)&tcb);
+                break;
+            case 1:
+                CHECK(e.type == TraceType::kTaskSwitchIn);
+                self_id = e.arg;
+                break;
+            default:
+                CHECK(e.type == TraceType::kTaskSwitchOut);
+                CHECK_EQ(e.arg, self_id);
+                break;
+            }
+        });
+        CHECK_EQ(n, 3);
+        CHECK_EQ(self_id, detail::current_task_id());
+    }
+} // namespace
+
+int main()
+{
+    scripted();
+    threads();
+    hooks();
+    return host_test_result("test_task_trace");
+}
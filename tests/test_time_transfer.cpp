@@ -0,0 +1,161 @@
+// Two-way time transfer over a UDP loopback socket pair with simulated path delays.
+//
+// Client and server share the mock counter but convert it with different nominal frequencies,
+// so the server clock has both an offset and a 20 ppm skew against the client. The test delivers
+// each datagram through the kernel, advances the mock counter by the simulated one-way delay
+// (a fixed path delay, plus random queuing on some packets), and checks the offset, delay and
+// skew estimates against the true clocks, with symmetric and asymmetric paths.
+//
+// host-test-variant: -DFASTTIME_MOCK_COUNTER
+// host-test-variant: -DFASTTIME_MOCK_COUNTER -DFASTTIME_MOCK_COUNTER_BITS=32
+
+#include <esp23_fast_timestamp.h>
+#include <fast_time_transfer.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <random>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "host_test.h"
+
+using namespace fasttime;
+
+namespace
+{
+    constexpr uint64_t kClientHz = 240000000;
+    constexpr uint64_t kServerHz = 239995200; // server ns run 20 ppm fast against the client
+    constexpr uint64_t kCyclesPerUs = kClientHz / 1000000;
+
+    struct Socket
+    {
+        int fd;
+        sockaddr_in addr;
+
+        Socket() : fd(socket(AF_INET, SOCK_DGRAM, 0))
+        {
+            addr = sockaddr_in{};
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+            socklen_t len = sizeof(addr);
+            getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len);
+            timeval tv{1, 0};
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        }
+        ~Socket() { close(fd); }
+
+        size_t recv(void *buf, size_t cap) const
+        {
+            const ssize_t n = ::recv(fd, buf, cap, 0);
+            return n < 0 ? 0 : size_t(n);
+        }
+    };
+
+    struct Route
+    {
+        const Socket *from;
+        const Socket *to;
+    };
+
+    bool udp_send(void *ctx, const void *data, size_t len)
+    {
+        const Route &r = *static_cast<const Route *>(ctx);
+        return sendto(r.from->fd, data, len, 0, reinterpret_cast<const sockaddr *>(&r.to->addr),
+                      sizeof(r.to->addr)) == ssize_t(len);
+    }
+
+    uint64_t now_cycles = 0;
+
+    void advance(uint64_t cycles)
+    {
+        now_cycles += cycles;
+        fasttime_mock_cycles = now_cycles;
+    }
+
+    struct Link
+    {
+        uint64_t fwd_us;   ///< Client → server path delay.
+        uint64_t rev_us;   ///< Server → client path delay.
+        std::mt19937 rng{36};
+
+        /// Path delay plus queuing (up to 2 ms) on one packet in four.
+        uint64_t delay_cycles(uint64_t path_us)
+        {
+            const uint64_t queue_us = rng() % 4 == 0 ? rng() % 2000 : 0;
+            return (path_us + queue_us) * kCyclesPerUs;
+        }
+    };
+
+    void run(const char *name, Link link)
+    {
+        Socket client_sock, server_sock;
+        Route to_server{&client_sock, &server_sock};
+        Route to_client{&server_sock, &client_sock};
+
+        now_cycles = 0xF0000000u; // close to a 32-bit wrap
+        fasttime_mock_cycles = now_cycles;
+        TimeTransferServer server(udp_send, &to_client, kServerHz);
+        TimeTransferClient<> client(udp_send, &to_server, kClientHz);
+        // Reference clocks: the true local times of both sides.
+        LocalNsClock truth_client(kClientHz), truth_server(kServerHz);
+        auto true_offset = [&](const Timestamp ts) {
+            return int64_t(truth_server.ns_at(ts) - truth_client.ns_at(ts));
+        };
+
+        TimeTransferPacket buf;
+        Timestamp old_stamp{0};
+        int64_t old_true_server = 0;
+        uint64_t min_delay = UINT64_MAX;
+        for (int i = 0; i < 240; ++i)
+        {
+            advance(100000 * kCyclesPerUs); // poll every 100 ms
+            truth_client.ns(Timestamp::now());
+            truth_server.ns(Timestamp::now());
+            CHECK(client.poll());
+
+            size_t n = server_sock.recv(&buf, sizeof(buf));
+            CHECK_EQ(n, sizeof(buf));
+            advance(link.delay_cycles(link.fwd_us));
+            CHECK(server.on_datagram(&buf, n));
+
+            n = client_sock.recv(&buf, sizeof(buf));
+            CHECK_EQ(n, sizeof(buf));
+            advance(link.delay_cycles(link.rev_us));
+            CHECK(client.on_datagram(&buf, n));
+            min_delay = client.last().delay_ns < min_delay ? client.last().delay_ns : min_delay;
+
+            if (i == 150)
+            {
+                old_stamp = Timestamp::now();
+                old_true_server = int64_t(truth_server.ns_at(old_stamp));
+            }
+            if (i == 200)
+            {
+                // A 5 s old stamp (e.g. a trace event): converting it must not disturb the client.
+                CHECK_NEAR(double(int64_t(client.to_server_ns(old_stamp)) - old_true_server),
+                           double(int64_t(link.fwd_us) - int64_t(link.rev_us)) / 2 * 1000, 5000);
+            }
+        }
+        CHECK(client.synced());
+
+        // Two-way transfer sees the round trip, and half the path asymmetry as offset bias.
+        const Timestamp at = Timestamp::now();
+        const double bias_ns = (double(link.fwd_us) - double(link.rev_us)) / 2 * 1000;
+        const int64_t est = int64_t(client.to_server_ns(at) - truth_client.ns_at(at));
+        printf("%s: offset error %+.0f ns (bias %+.0f), min delay %llu ns, skew %d ppb\n", name,
+               double(est - true_offset(at)) - bias_ns, bias_ns, (unsigned long long)min_delay,
+               int(client.skew_ppb()));
+        CHECK_NEAR(double(est - true_offset(at)), bias_ns, 2000);
+        CHECK_NEAR(double(min_delay), double(link.fwd_us + link.rev_us) * 1000, 1000);
+        CHECK_NEAR(double(client.skew_ppb()), 20000, 1000);
+    }
+} // namespace
+
+int main()
+{
+    run("symmetric", Link{200, 200});
+    run("asymmetric", Link{100, 500});
+    return host_test_result("test_time_transfer");
+}
@@ -0,0 +1,131 @@
+// TimerWheel: every timer fires once, never early and within one tick plus the advance step,
+// across cascades, parked far timers, cancellation and 32-bit counter wraps.
+//
+// host-test-variant: -DFASTTIME_MOCK_COUNTER
+// host-test-variant: -DFASTTIME_MOCK_COUNTER -DFASTTIME_MOCK_COUNTER_BITS=32
+
+#include <esp23_fast_timestamp.h>
+#include <fast_timer_wheel.h>
+
+#include <random>
+
+#include "host_test.h"
+
+using namespace fasttime;
+
+namespace
+{
+    constexpr size_t kTimers = 4096;
+    constexpr uint32_t kShift = 4; // 16-cycle ticks
+
+    struct Pending
+    {
+        uint64_t due;      ///< Extended cycles.
+        uint64_t fired_at; ///< Extended cycles, 0 until fired.
+        int fires;
+    };
+
+    Pending pending[kTimers];
+    uint64_t now_ext = 0; // extended simulated time
+
+    void on_fire(void *ctx)
+    {
+        Pending &p = *static_cast<Pending *>(ctx);
+        p.fired_at = now_ext;
+        ++p.fires;
+    }
+
+    void set_time(uint64_t ext)
+    {
+        now_ext = ext;
+        fasttime_mock_cycles = ext; // the mock truncates to 32 bits when configured so
+    }
+
+    // Small wheel (2 levels × 16 slots = 256 ticks) so most timers park beyond its range.
+    void fires_on_time()
+    {
+        set_time(0xFFFF0000u); // just below a 32-bit wrap
+        TimerWheel<kTimers, 4, 2> wheel(kShift, Timestamp::now());
+        std::mt19937_64 rng(26);
+        TimerHandle handles[kTimers];
+        const uint64_t start = now_ext;
+        for (size_t i = 0; i < kTimers; ++i)
+        {
+            const uint64_t after = rng() % 200000 + 1; // up to ~48 wheel ranges
+            pending[i] = Pending{start + after, 0, 0};
+            handles[i] = wheel.schedule_after(Timestamp::now(), after, on_fire, &pending[i]);
+            CHECK(handles[i].valid());
+        }
+        CHECK_EQ(wheel.armed(), kTimers);
+        // Pool exhausted.
+        CHECK(!wheel.schedule_after(Timestamp::now(), 1, on_fire, nullptr).valid());
+
+        size_t cancelled = 0;
+        for (size_t i = 0; i < kTimers; i += 3)
+        {
+            CHECK(wheel.cancel(handles[i]));
+            CHECK(!wheel.cancel(handles[i])); // second cancel is a no-op
+            ++cancelled;
+        }
+
+        size_t fired = 0;
+        const uint64_t step = 37;
+        while (wheel.armed())
+        {
+            set_time(now_ext + step);
+            fired += wheel.advance(Timestamp::now());
+        }
+        CHECK_EQ(fired, kTimers - cancelled);
+        for (size_t i = 0; i < kTimers; ++i)
+        {
+            const Pending &p = pending[i];
+            if (i % 3 == 0)
+            {
+                CHECK_EQ(p.fires, 0);
+                continue;
+            }
+            CHECK_EQ(p.fires, 1);
+            CHECK(p.fired_at >= p.due);
+            CHECK(p.fired_at < p.due + (uint64_t(1) << kShift) + step);
+        }
+        // Stale handles no longer cancel anything.
+        CHECK(!wheel.cancel(handles[1]));
+    }
+
+    struct Rearm
+    {
+        TimerWheel<8> *wheel;
+        int left;
+    };
+
+    void rearm(void *ctx)
+    {
+        Rearm &r = *static_cast<Rearm *>(ctx);
+        if (--r.left > 0)
+        {
+            r.wheel->schedule_after(Timestamp::now(), 1000, rearm, &r);
+        }
+    }
+
+    // Callbacks may schedule from inside advance().
+    void callback_reschedules()
+    {
+        set_time(1000);
+        TimerWheel<8> wheel(kShift, Timestamp::now());
+        Rearm r{&wheel, 50};
+        wheel.schedule_after(Timestamp::now(), 1000, rearm, &r);
+        while (wheel.armed())
+        {
+            set_time(now_ext + 100);
+            wheel.advance(Timestamp::now());
+        }
+        CHECK_EQ(r.left, 0);
+    }
+} // namespace
+
+int main()
+{
+    fires_on_time();
+    callback_reschedules();
+    return host_test_result("test_timer_wheel");
+}
@@ -0,0 +1,220 @@
+// Trace transport on host: TraceByteDecoder resynchronizing on garbage with the stream cut into
+// pieces of every size, TraceBlockReader rejecting headers that overrun the buffer, and a
+// Tracer -> TraceStream -> TraceFileWriter -> TraceFileView / TraceAnalyzer round trip without
+// loss.
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include <fast_trace.h>
+#include <fast_trace_analysis.h>
+#include <fast_trace_file.h>
+#include <fast_trace_stream.h>
+
+#include "host_test.h"
+
+using namespace fasttime;
+
+namespace
+{
+    constexpr uint32_t kBlocks = 40;
+    constexpr uint32_t kEventsPerBlock = 12;
+
+    /// kBlocks encoded blocks, each preceded by @p garbage bytes (the first by @p lead).
+    std::vector<uint8_t> make_stream(size_t lead, size_t garbage, uint32_t seed)
+    {
+        std::vector<uint8_t> out;
+        auto junk = [&](size_t n) {
+            for (size_t i = 0; i < n; ++i)
+            {
+                seed = seed * 1664525u + 1013904223u;
+                // Mostly noise, sometimes a prefix of the magic to tempt the decoder.
+                out.push_back(i + 3 >= n && (seed & 0x100) ? uint8_t("FTB"[i + 3 - n]) : uint8_t(seed >> 24));
+            }
+        };
+        junk(lead);
+        uint8_t buf[512];
+        uint64_t ticks = 1000;
+        for (uint32_t b = 0; b < kBlocks; ++b)
+        {
+            TraceBlockEncoder enc;
+            enc.begin(buf, sizeof(buf), b);
+            for (uint32_t i = 0; i < kEventsPerBlock; ++i)
+            {
+                ticks += 17 + i;
+                TraceEvent ev{};
+                ev.ticks = ticks;
+                ev.type = TraceType::kMarker;
+                ev.arg = b * kEventsPerBlock + i;
+                CHECK(enc.append(ev));
+            }
+            const size_t len = enc.finish();
+            out.insert(out.end(), buf, buf + len);
+            if (b + 1 < kBlocks)
+            {
+                junk(garbage);
+            }
+        }
+        return out;
+    }
+
+    void decoder_pieces()
+    {
+        const size_t chunks[] = {1, 2, 3, 5, 64, 1 << 20};
+        uint32_t cases = 0;
+        for (size_t lead = 0; lead <= 64; ++lead)
+        {
+            const size_t garbage = lead % 7;
+            const std::vector<uint8_t> stream = make_stream(lead, garbage, uint32_t(lead));
+            for (size_t chunk : chunks)
+            {
+                TraceByteDecoder dec(4096);
+                uint32_t next_arg = 0;
+                bool in_order = true;
+                for (size_t at = 0; at < stream.size(); at += chunk)
+                {
+                    const size_t n = stream.size() - at < chunk ? stream.size() - at : chunk;
+                    dec.feed(stream.data() + at, n, [&](TraceBlockReader &block) {
+                        TraceEvent ev;
+                        while (block.next(ev))
+                        {
+                            in_order = in_order && ev.arg == next_arg;
+                            ++next_arg;
+                        }
+                    });
+                }
+                ++cases;
+                if (dec.blocks() != kBlocks || !in_order ||
+                    dec.skipped_bytes() != lead + garbage * (kBlocks - 1))
+                {
+                    fprintf(stderr, "lead %zu garbage %zu chunk %zu: %llu blocks, %llu skipped\n", lead, garbage,
+                            chunk, (unsigned long long)dec.blocks(), (unsigned long long)dec.skipped_bytes());
+                    CHECK(false);
+                }
+            }
+        }
+        printf("decoder: %u stream/chunk combinations\n", cases);
+    }
+
+    /// Header fields that claim more than the buffer holds, including sums that wrap 32 bits.
+    void corrupt_headers()
+    {
+        uint8_t buf[256];
+        TraceBlockEncoder enc;
+        enc.begin(buf, sizeof(buf), 7);
+        TraceEvent ev{};
+        ev.ticks = 5000;
+        ev.type = TraceType::kMarker;
+        CHECK(enc.append(ev));
+        const size_t len = enc.finish();
+
+        TraceBlockReader reader;
+        CHECK(reader.open(buf, len));
+        CHECK(!reader.open(buf, len - 1, false));
+
+        TraceBlockHeader hdr;
+        memcpy(&hdr, buf, sizeof(hdr));
+        const uint16_t header_sizes[] = {uint16_t(sizeof(hdr)), uint16_t(len), uint16_t(len + 1), 0xFFFF};
+        for (uint16_t header_size : header_sizes)
+        {
+            const uint32_t payloads[] = {uint32_t(len - header_size + 1), 0xFFFFFFFFu,
+                                         uint32_t(0u - header_size), uint32_t(1u - header_size)};
+            for (uint32_t payload : payloads)
+            {
+                TraceBlockHeader bad = hdr;
+                bad.header_size = header_size;
+                bad.payload_bytes = payload;
+                uint8_t copy[256];
+                memcpy(copy, buf, len);
+                memcpy(copy, &bad, sizeof(bad));
+                if (reader.open(copy, len, false))
+                {
+                    fprintf(stderr, "header_size %u payload %u accepted in %zu bytes\n", header_size, payload, len);
+                    CHECK(false);
+                }
+            }
+        }
+    }
+
+    void round_trip()
+    {
+        constexpr uint32_t kPairs = 40000; // 80k events
+        constexpr uint32_t kZone = 3;
+
+        char path[] = "/tmp/fasttime_pipeline.XXXXXX";
+        const int fd = mkstemp(path);
+        CHECK(fd >= 0);
+        close(fd);
+
+        static Tracer<1024> tracer;
+        TraceFileWriter file;
+        CHECK(file.open(path, size_t(1) << 20, 0));
+        {
+            TraceStream<4096> stream(TraceFileWriter::sink, &file);
+            for (uint32_t i = 0; i < kPairs; ++i)
+            {
+                tracer.emit(TraceType::kZoneBegin, kZone);
+                tracer.emit(TraceType::kZoneEnd, kZone);
+                if (i % 128 == 127)
+                {
+                    stream.pump(tracer);
+                }
+            }
+            stream.pump(tracer);
+            stream.flush(true);
+            CHECK_EQ(stream.stats().events, 2 * kPairs);
+            CHECK_EQ(stream.stats().dropped_events, 0);
+            CHECK_EQ(stream.stats().dropped_blocks, 0);
+        }
+        CHECK_EQ(tracer.dropped(), 0);
+        file.close();
+
+        TraceFileMapping map;
+        CHECK(map.open(path));
+        TraceFileView view(map.data(), map.size());
+        uint64_t begins = 0;
+        CHECK_EQ(view.for_each([&](const TraceEvent &e) { begins += e.type == TraceType::kZoneBegin; }),
+                 2 * kPairs);
+        CHECK_EQ(begins, kPairs);
+        CHECK_EQ(view.lost_blocks(), 0);
+        CHECK_EQ(view.dropped_events(), 0);
+        CHECK_EQ(view.skipped_bytes(), 0);
+
+        // The same bytes as a serial capture, in odd-sized pieces, into the analyzer.
+        static TraceAnalyzer<> analyzer;
+        TraceByteDecoder dec;
+        for (size_t at = 0; at < map.size(); at += 7)
+        {
+            const size_t n = map.size() - at < 7 ? map.size() - at : 7;
+            dec.feed(map.data() + at, n, [&](TraceBlockReader &b) { analyzer.feed_block(b); });
+        }
+        analyzer.finish();
+        CHECK_EQ(dec.blocks(), view.blocks());
+        CHECK_EQ(analyzer.events(), 2 * kPairs);
+        CHECK_EQ(analyzer.lost_blocks(), 0);
+        CHECK_EQ(analyzer.open_spans(), 0);
+        CHECK_EQ(analyzer.unmatched_ends(), 0);
+        uint64_t zone_count = 0;
+        analyzer.for_each_zone([&](const TraceAnalyzer<>::Zone &z) {
+            if (z.id == kZone)
+            {
+                zone_count = z.count;
+            }
+        });
+        CHECK_EQ(zone_count, kPairs);
+        printf("round trip: %llu events in %llu blocks, %zu bytes\n", (unsigned long long)analyzer.events(),
+               (unsigned long long)view.blocks(), map.size());
+        unlink(path);
+    }
+} // namespace
+
+int main()
+{
+    decoder_pieces();
+    corrupt_headers();
+    round_trip();
+    return host_test_result("test_trace_pipeline");
+}
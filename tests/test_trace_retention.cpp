@@ -0,0 +1,173 @@
+// RetainedTraceFile across a process restart: a child records into the mapped image and dies
+// on SIGKILL (no exit handlers, no msync); the parent maps the same file and recovers the
+// child's session. Also covers torn slots, the session bump and a mismatched image size.
+
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <fast_trace_retention.h>
+
+#include "host_test.h"
+
+using namespace fasttime;
+
+namespace
+{
+    constexpr uint64_t kEpochNs = 1700000000000000000ULL;
+
+    char path[] = "/tmp/fasttime_retained.XXXXXX";
+
+    /// Child: record @p events markers with args 0..events-1, then crash.
+    void run_child(uint32_t events)
+    {
+        RetainedTraceFile<> file;
+        if (!file.open(path))
+        {
+            _exit(2);
+        }
+        RetainedTrace<> crash(*file.image());
+        crash.start();
+        crash.set_epoch(kEpochNs);
+        for (uint32_t i = 0; i < events; ++i)
+        {
+            crash.emit(TraceType::kMarker, i, uint16_t(i & 0xFFFF));
+        }
+        kill(getpid(), SIGKILL);
+    }
+
+    bool crashed_child(uint32_t events)
+    {
+        const pid_t pid = fork();
+        if (pid == 0)
+        {
+            run_child(events);
+        }
+        int status = 0;
+        return pid > 0 && waitpid(pid, &status, 0) == pid && WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL;
+    }
+
+    struct Recovered
+    {
+        RetainedTraceInfo info;
+        uint32_t first_arg;
+        uint32_t last_arg;
+        bool in_order;
+    };
+
+    Recovered recover(RetainedTrace<> &trace)
+    {
+        Recovered r{};
+        r.in_order = true;
+        bool first = true;
+        uint64_t prev_ticks = 0;
+        r.info = trace.recover([&](const TraceEvent &e) {
+            if (first)
+            {
+                r.first_arg = e.arg;
+                first = false;
+            }
+            else if (e.arg != r.last_arg + 1 || e.ticks < prev_ticks)
+            {
+                r.in_order = false;
+            }
+            CHECK(e.type == TraceType::kMarker);
+            CHECK_EQ(e.aux, e.arg & 0xFFFF);
+            r.last_arg = e.arg;
+            prev_ticks = e.ticks;
+        });
+        return r;
+    }
+
+    void survives_crash()
+    {
+        // Fewer events than one ring holds: all of them come back, whichever core ran them.
+        CHECK(crashed_child(200));
+        RetainedTraceFile<> file;
+        CHECK(file.open(path));
+        RetainedTrace<> trace(*file.image());
+        Recovered r = recover(trace);
+        CHECK(r.info.valid);
+        CHECK_EQ(r.info.boot, 1);
+        CHECK_EQ(r.info.events, 200);
+        CHECK_EQ(r.info.torn, 0);
+        CHECK_EQ(r.first_arg, 0);
+        CHECK_EQ(r.last_arg, 199);
+        CHECK(r.in_order);
+        CHECK(r.info.last_ticks >= r.info.start_ticks);
+        CHECK(r.info.to_epoch_ns(r.info.last_ticks) >= kEpochNs);
+
+        // A slot corrupted after the fact is skipped, not delivered.
+        bool corrupted = false;
+        for (auto &ring : file.image()->rings)
+        {
+            if (!corrupted && ring.head > 10)
+            {
+                ring.slots[5].arg ^= 0x40000000u;
+                corrupted = true;
+            }
+        }
+        CHECK(corrupted);
+        r = recover(trace);
+        CHECK_EQ(r.info.events, 199);
+        CHECK_EQ(r.info.torn, 1);
+        CHECK(!r.in_order);
+
+        // dump() reports the same session.
+        uint32_t lines = 0;
+        trace.dump([](void *ctx, const char *) { ++*static_cast<uint32_t *>(ctx); }, &lines);
+        CHECK_EQ(lines, 1 + 199);
+    }
+
+    void wraps_and_restarts()
+    {
+        // More events than the rings hold: the newest survive, ending with the last one.
+        CHECK(crashed_child(5000));
+        {
+            RetainedTraceFile<> file;
+            CHECK(file.open(path));
+            RetainedTrace<> trace(*file.image());
+            const Recovered r = recover(trace);
+            CHECK(r.info.valid);
+            CHECK_EQ(r.info.boot, 2);
+            CHECK(r.info.events >= FASTTIME_RETAINED_CAPACITY);
+            CHECK(r.info.events <= FASTTIME_SHARDS * FASTTIME_RETAINED_CAPACITY);
+            CHECK_EQ(r.last_arg, 4999);
+
+            // A new session hides the old slots: their checks name the previous session.
+            trace.start();
+            CHECK(trace.emit(TraceType::kMarker, 7, 7));
+        }
+        RetainedTraceFile<> file;
+        CHECK(file.open(path));
+        RetainedTrace<> trace(*file.image());
+        const Recovered r = recover(trace);
+        CHECK_EQ(r.info.boot, 3);
+        CHECK_EQ(r.info.events, 1);
+        CHECK_EQ(r.last_arg, 7);
+    }
+
+    void mismatched_image()
+    {
+        // A file written with another capacity is reset to an empty image of this size.
+        RetainedTraceFile<64> file;
+        CHECK(file.open(path));
+        RetainedTrace<64> trace(*file.image());
+        const RetainedTraceInfo info = trace.recover([](const TraceEvent &) { CHECK(false); });
+        CHECK(!info.valid);
+    }
+} // namespace
+
+int main()
+{
+    const int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    close(fd);
+    survives_crash();
+    wraps_and_restarts();
+    mismatched_image();
+    unlink(path);
+    return host_test_result("test_trace_retention");
+}
@@ -0,0 +1,212 @@
+// TraceSectorLog on an in-memory NOR flash: several laps around the sectors read back through
+// TraceLogView in order, a reopened log resumes after its last block, and torn block headers
+// (sizes that overrun the sector or wrap 32-bit sums) make it skip to the next sector instead
+// of resuming inside garbage or looping.
+
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+#include <fast_trace_file.h>
+
+#include "host_test.h"
+
+using namespace fasttime;
+
+namespace
+{
+    constexpr uint32_t kSectorSize = 256;
+    constexpr uint32_t kSectors = 4;
+    constexpr uint32_t kEventsPerBlock = 10;
+
+    struct MemFlash
+    {
+        std::vector<uint8_t> bytes = std::vector<uint8_t>(kSectors * kSectorSize, 0xFF);
+        uint32_t overwrites = 0; ///< Writes that needed a 0 -> 1 transition (no erase first).
+
+        static bool read(void *ctx, uint32_t offset, void *dst, size_t len)
+        {
+            MemFlash &f = *static_cast<MemFlash *>(ctx);
+            if (offset > f.bytes.size() || len > f.bytes.size() - offset)
+            {
+                return false;
+            }
+            memcpy(dst, f.bytes.data() + offset, len);
+            return true;
+        }
+
+        static bool write(void *ctx, uint32_t offset, const void *src, size_t len)
+        {
+            MemFlash &f = *static_cast<MemFlash *>(ctx);
+            if (offset > f.bytes.size() || len > f.bytes.size() - offset)
+            {
+                return false;
+            }
+            const uint8_t *p = static_cast<const uint8_t *>(src);
+            for (size_t i = 0; i < len; ++i)
+            {
+                f.overwrites += (p[i] & ~f.bytes[offset + i]) != 0;
+                f.bytes[offset + i] &= p[i];
+            }
+            return true;
+        }
+
+        static bool erase(void *ctx, uint32_t offset, size_t len)
+        {
+            MemFlash &f = *static_cast<MemFlash *>(ctx);
+            if (offset % kSectorSize || len != kSectorSize || offset >= f.bytes.size())
+            {
+                return false;
+            }
+            memset(f.bytes.data() + offset, 0xFF, len);
+            return true;
+        }
+
+        TraceFlash flash() { return TraceFlash{read, write, erase, this, uint32_t(bytes.size()), kSectorSize}; }
+    };
+
+    /// Block @p seq holding events seq * kEventsPerBlock ... + kEventsPerBlock - 1.
+    size_t make_block(uint8_t *buf, size_t cap, uint32_t seq)
+    {
+        TraceBlockEncoder enc;
+        enc.begin(buf, cap, seq);
+        for (uint32_t i = 0; i < kEventsPerBlock; ++i)
+        {
+            TraceEvent ev{};
+            ev.ticks = 1000 + uint64_t(seq) * 500 + i * 37;
+            ev.type = TraceType::kMarker;
+            ev.arg = seq * kEventsPerBlock + i;
+            CHECK(enc.append(ev));
+        }
+        return enc.finish();
+    }
+
+    bool append_block(TraceSectorLog &log, uint32_t seq)
+    {
+        uint8_t buf[512];
+        return log.append(buf, make_block(buf, sizeof(buf), seq));
+    }
+
+    /// Events of the log image are consecutive and end with the last event of block @p last.
+    uint64_t check_contents(const MemFlash &f, uint32_t last)
+    {
+        TraceLogView view(f.bytes.data(), f.bytes.size(), kSectorSize);
+        uint32_t expect = 0;
+        bool first = true, ordered = true;
+        const uint64_t n = view.for_each([&](const TraceEvent &ev) {
+            ordered = ordered && (first || ev.arg == expect);
+            first = false;
+            expect = ev.arg + 1;
+        });
+        CHECK(ordered);
+        CHECK(n > 0);
+        CHECK_EQ(expect, (last + 1) * kEventsPerBlock);
+        CHECK(view.sectors_read() <= kSectors);
+        return n;
+    }
+
+    /// Program the first fields of a block header at @p offset, as a power cut would.
+    void tear_header(MemFlash &f, uint32_t offset, uint16_t header_size, uint32_t payload_bytes)
+    {
+        const uint32_t head[3] = {kTraceBlockMagic, uint32_t(kTraceBlockVersion) | uint32_t(header_size) << 16,
+                                  payload_bytes};
+        MemFlash::write(&f, offset, head, sizeof(head));
+    }
+
+    /// Byte offset behind the last block of @p sector (where a reopened log would resume).
+    uint32_t resume_offset(const MemFlash &f, uint32_t sector)
+    {
+        uint32_t pos = sizeof(TraceSectorHeader);
+        for (;;)
+        {
+            TraceBlockHeader b;
+            memcpy(&b, f.bytes.data() + sector * kSectorSize + pos, sizeof(b));
+            if (b.magic != kTraceBlockMagic)
+            {
+                return sector * kSectorSize + pos;
+            }
+            pos += b.header_size + b.payload_bytes;
+        }
+    }
+
+    void laps()
+    {
+        MemFlash f;
+        TraceSectorLog log(f.flash());
+        CHECK(log.open());
+
+        // Roughly 3 blocks per sector: 40 blocks go around the 4 sectors three times.
+        uint32_t seq = 0;
+        for (; seq < 40; ++seq)
+        {
+            CHECK(append_block(log, seq));
+        }
+        CHECK(log.erases() > 2 * kSectors);
+        CHECK_EQ(log.sector_seq(), log.erases());
+        CHECK_EQ(f.overwrites, 0);
+        const uint64_t events = check_contents(f, seq - 1);
+        // At least the three sectors behind the one being written survive.
+        CHECK(events >= (kSectors - 1) * 2 * kEventsPerBlock);
+
+        // Oversized blocks are refused without wrapping the size checks.
+        uint8_t big[kSectorSize] = {};
+        CHECK(!log.append(big, kSectorSize - sizeof(TraceSectorHeader) + 1));
+        CHECK(!log.append(big, SIZE_MAX));
+
+        // A reopened log resumes behind its last block, in the same sector.
+        const uint32_t sector_seq = log.sector_seq();
+        TraceSectorLog again(f.flash());
+        CHECK(again.open());
+        CHECK_EQ(again.sector_seq(), sector_seq);
+        CHECK(append_block(again, seq));
+        CHECK_EQ(again.erases(), 0);
+        CHECK_EQ(f.overwrites, 0);
+        check_contents(f, seq);
+    }
+
+    void torn_headers()
+    {
+        struct Case
+        {
+            uint16_t header_size;
+            uint32_t payload_bytes;
+        };
+        const Case cases[] = {
+            {uint16_t(sizeof(TraceBlockHeader)), 0xFFFFFFFFu},                             // sum wraps short
+            {uint16_t(sizeof(TraceBlockHeader)), 0u - uint32_t(sizeof(TraceBlockHeader))}, // sum wraps to 0
+            {0xFFFF, 0xFFFFFFFFu},                                                         // sizes unwritten
+            {uint16_t(sizeof(TraceBlockHeader)), kSectorSize},                             // overruns the sector
+        };
+        for (const Case &c : cases)
+        {
+            MemFlash f;
+            TraceSectorLog log(f.flash());
+            CHECK(log.open());
+            uint32_t seq = 0;
+            for (; seq < 5; ++seq)
+            {
+                CHECK(append_block(log, seq));
+            }
+            const uint32_t sector = (log.sector_seq() - 1) % kSectors;
+            const uint32_t sector_seq = log.sector_seq();
+            tear_header(f, resume_offset(f, sector), c.header_size, c.payload_bytes);
+
+            // The torn sector is closed: the next block starts a new one.
+            TraceSectorLog again(f.flash());
+            CHECK(again.open());
+            CHECK(append_block(again, seq));
+            CHECK_EQ(again.erases(), 1);
+            CHECK_EQ(again.sector_seq(), sector_seq + 1);
+            CHECK_EQ(f.overwrites, 0);
+            check_contents(f, seq);
+        }
+    }
+} // namespace
+
+int main()
+{
+    laps();
+    torn_headers();
+    return host_test_result("test_trace_sector_log");
+}